@@ -12,6 +12,7 @@
 #include <oMemory/concurrent_object_pool.h>
 #include <oMemory/pool.h>
 #include <functional>
+#include <vector>
 
 namespace ouro {
 
@@ -86,6 +87,8 @@ public:
 
 	// Flushs the Makes and Unmakes queues. This should be called from the thread where 
 	// all device operations have to occur. Returns the number of operations completed.
+	// Assets replaced or unmade are destroyed by a later flush once no thread can
+	// still be reading them (see get()).
 	size_type flush(size_type max_operations = ~0u);
 
 
@@ -93,7 +96,9 @@ public:
 
 	// returns a pointer to an asset. The asset itself may be reloaded or unmade
 	// but this pointer will be stable and useable until remove is called on it
-	// and the next flush() is called.
+	// and the next flush() is called. A thread that dereferences the entry while
+	// another thread may flush() should do so inside an epoch::guard: the asset it
+	// reads won't be destroyed until the guard is released.
 	entry_type get(hash_type key) const;
 	inline entry_type get(const char* name) const { return get(hash(name)); }
 
@@ -138,12 +143,24 @@ private:
 	concurrent_hash_map lookup;
 	concurrent_stack<file_info> makes;
 	concurrent_stack<file_info> unmakes;
+
+	// assets unlinked by flush() waiting out readers, in ticket order
+	struct retired_asset
+	{
+		unsigned int ticket;
+		void* asset;
+	};
+	std::vector<retired_asset> retired;
+
 	lifetime_t lifetime;
 	void** entries;
 	void* missing;
 	void* failed;
 	void* making;
 	bool owns_memory;
+
+	void retire(void* asset);
+	void reclaim(bool all);
 };
 
 }
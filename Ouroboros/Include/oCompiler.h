@@ -44,6 +44,35 @@
 #pragma warning(disable:4481) // nonstandard extension used: override specifier 'override'
 #pragma warning(disable:4324) // structure was padded due to _declspec(align())
 
+#elif defined(__GNUC__)
+
+#define oCACHE_LINE_SIZE 64
+
+#if defined(__x86_64__) || defined(__aarch64__)
+	#define o64BIT 1
+	#define o32BIT 0
+	#define oDEFAULT_MEMORY_ALIGNMENT 16
+#else
+	#define o64BIT 0
+	#define o32BIT 1
+	#define oDEFAULT_MEMORY_ALIGNMENT 8
+#endif
+#define oHAS_DOUBLE_WIDE_ATOMIC_BUG 0
+
+#define oDEBUGBREAK __builtin_trap()
+
+// C++11 support
+#define oALIGNAS(x) __attribute__((aligned(x)))
+#define oALIGNOF(x) __alignof__(x)
+#define oNOEXCEPT noexcept
+#define oTHREAD_LOCAL __thread
+#define oHAS_CBEGIN 1
+
+// low-level optimization support
+#define oRESTRICT __restrict__
+#define oASSUME(x) do { if (!(x)) __builtin_unreachable(); } while(false)
+#define oFORCEINLINE inline __attribute__((always_inline))
+
 #else
 	#error unsupported compiler
 #endif
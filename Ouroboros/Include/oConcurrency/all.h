@@ -4,16 +4,24 @@
 // this to be lazy when including headers in .cpp files. Be explicit.
 #pragma once
 #include <oConcurrency/backoff.h>
+#include <oConcurrency/broadcast_queue.h>
 #include <oConcurrency/concurrency.h>
+#include <oConcurrency/concurrent_bounded_queue.h>
+#include <oConcurrency/concurrent_growable_hash_map.h>
 #include <oConcurrency/concurrent_hash_map.h>
 #include <oConcurrency/concurrent_queue.h>
 #include <oConcurrency/concurrent_queue_opt.h>
 #include <oConcurrency/concurrent_stack.h>
 #include <oConcurrency/coroutine.h>
 #include <oConcurrency/countdown_latch.h>
+#include <oConcurrency/epoch.h>
 #include <oConcurrency/event.h>
+#include <oConcurrency/futex.h>
 #include <oConcurrency/future.h>
 #include <oConcurrency/lock_free_queue.h>
 #include <oConcurrency/mutex.h>
 #include <oConcurrency/tagged_pointer.h>
+#include <oConcurrency/task_graph.h>
 #include <oConcurrency/threadpool.h>
+#include <oConcurrency/work_stealing_deque.h>
+#include <oConcurrency/work_stealing_threadpool.h>
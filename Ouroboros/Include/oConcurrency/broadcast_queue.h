@@ -0,0 +1,329 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Single-producer, multi-consumer broadcast ring: every element pushed is seen
+// by every reader, in order, such as for fanning out frames or events to a
+// fixed set of systems. The number of readers is fixed at initialization and
+// each reader is identified by an index in [0,num_readers). Each reader only
+// advances its own cursor, so readers never contend with each other. The
+// producer may not lap the slowest reader: try_push fails and push spins until
+// that reader catches up. The producer caches the slowest cursor and rescans
+// them only when the ring looks full. Slots keep the last value pushed to them
+// until it is overwritten or the queue is deinitialized.
+
+#pragma once
+#include <oCompiler.h>
+#include <oConcurrency/backoff.h>
+#include <oMemory/allocate.h>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+namespace ouro {
+
+template<typename T>
+class broadcast_queue
+{
+public:
+	typedef uint32_t size_type;
+	typedef T value_type;
+	typedef value_type& reference;
+	typedef const value_type& const_reference;
+	typedef value_type* pointer;
+	typedef const value_type* const_pointer;
+
+	static const size_type max_readers = 64;
+
+	// returns the number of bytes required to pass as memory to initialize().
+	static size_type calc_size(size_type capacity, size_type num_readers);
+
+
+	// non-concurrent api
+
+	// default ctor is uninitialized
+	broadcast_queue();
+
+	// capacity must be a power of two.
+	broadcast_queue(size_type capacity, size_type num_readers, const char* label = "broadcast_queue", const allocator& a = default_allocator);
+	~broadcast_queue();
+
+	// capacity must be a power of two.
+	void initialize(size_type capacity, size_type num_readers, const char* label = "broadcast_queue", const allocator& a = default_allocator);
+
+	// capacity must be a power of two. memory must be cache-line aligned; use
+	// calc_size() to determine its size.
+	void initialize(void* memory, size_type capacity, size_type num_readers);
+
+	// deinitializes the queue and returns the memory passed to initialize()
+	void* deinitialize();
+
+	// Returns the max number of elements that can be stored
+	size_type capacity() const { return mask ? (mask + 1) : 0; }
+
+	size_type num_readers() const { return nreaders; }
+
+
+	// producer api: only one thread may push at a time
+
+	// Returns false if the slowest reader is a full ring behind
+	bool try_push(const_reference val);
+
+	// Spins until the slowest reader makes room
+	void push(const_reference val);
+
+	// Pushes as many of the specified values as there is room for and returns
+	// the number pushed.
+	size_type try_push(const_pointer vals, size_type num_vals);
+
+
+	// reader api: each reader index may be used by only one thread at a time
+
+	// Returns false if the reader has seen every element pushed
+	bool try_pop(size_type reader, reference val);
+
+	// Spins until an element is available to the reader
+	void pop(size_type reader, reference val);
+
+	// Pops up to num_vals elements and returns the number popped.
+	size_type try_pop(size_type reader, pointer vals, size_type num_vals);
+
+	// Returns the number of elements the reader has yet to see
+	size_type size(size_type reader) const;
+
+	// Returns true if the reader has seen every element pushed
+	bool empty(size_type reader) const { return size(reader) == 0; }
+
+private:
+	struct oALIGNAS(oCACHE_LINE_SIZE) cursor
+	{
+		std::atomic<size_type> read;
+		size_type cached_write; // only touched by the reader
+	};
+
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<size_type> write;
+	size_type cached_min_read; // only touched by the producer
+	oALIGNAS(oCACHE_LINE_SIZE) cursor* cursors;
+	value_type* slots;
+	size_type mask;
+	size_type nreaders;
+	allocator alloc;
+
+	broadcast_queue(const broadcast_queue&); /* = delete; */
+	const broadcast_queue& operator=(const broadcast_queue&); /* = delete; */
+
+	void internal_initialize(void* memory, size_type capacity, size_type num_readers);
+
+	// returns the number of slots the producer can fill without lapping a reader
+	size_type room(size_type w);
+
+	// returns the number of elements available to the reader, checking the
+	// producer's position only if fewer than wanted are known to be available
+	size_type available(cursor& c, size_type r, size_type wanted);
+};
+
+template<typename T>
+typename broadcast_queue<T>::size_type broadcast_queue<T>::calc_size(size_type capacity, size_type num_readers)
+{
+	const size_type cursors_size = sizeof(cursor) * num_readers;
+	const size_type slots_offset = (cursors_size + oALIGNOF(T) - 1) & ~size_type(oALIGNOF(T) - 1);
+	return slots_offset + sizeof(T) * capacity;
+}
+
+template<typename T>
+broadcast_queue<T>::broadcast_queue()
+	: cached_min_read(0)
+	, cursors(nullptr)
+	, slots(nullptr)
+	, mask(0)
+	, nreaders(0)
+	, alloc(noop_allocator)
+{
+	write = 0;
+}
+
+template<typename T>
+broadcast_queue<T>::broadcast_queue(size_type capacity, size_type num_readers, const char* label, const allocator& a)
+	: cached_min_read(0)
+	, cursors(nullptr)
+	, slots(nullptr)
+	, mask(0)
+	, nreaders(0)
+	, alloc(noop_allocator)
+{
+	write = 0;
+	initialize(capacity, num_readers, label, a);
+}
+
+template<typename T>
+broadcast_queue<T>::~broadcast_queue()
+{
+	deinitialize();
+}
+
+template<typename T>
+void broadcast_queue<T>::initialize(size_type capacity, size_type num_readers, const char* label, const allocator& a)
+{
+	if (!capacity || (capacity & (capacity-1)))
+		throw std::invalid_argument("capacity must be a power of two");
+	if (!num_readers || num_readers > max_readers)
+		throw std::invalid_argument("invalid number of readers");
+	void* mem = a.allocate(calc_size(capacity, num_readers), memory_alignment::cacheline, label);
+	if (!mem)
+		throw std::bad_alloc();
+	internal_initialize(mem, capacity, num_readers);
+	alloc = a;
+}
+
+template<typename T>
+void broadcast_queue<T>::initialize(void* memory, size_type capacity, size_type num_readers)
+{
+	if (!capacity || (capacity & (capacity-1)))
+		throw std::invalid_argument("capacity must be a power of two");
+	if (!num_readers || num_readers > max_readers)
+		throw std::invalid_argument("invalid number of readers");
+	internal_initialize(memory, capacity, num_readers);
+	alloc = noop_allocator;
+}
+
+template<typename T>
+void broadcast_queue<T>::internal_initialize(void* memory, size_type capacity, size_type num_readers)
+{
+	cursors = (cursor*)memory;
+	for (size_type i = 0; i < num_readers; i++)
+	{
+		cursors[i].read.store(0, std::memory_order_relaxed);
+		cursors[i].cached_write = 0;
+	}
+
+	slots = (value_type*)((char*)memory + calc_size(0, num_readers));
+	for (size_type i = 0; i < capacity; i++)
+		new (slots + i) value_type();
+
+	mask = capacity - 1;
+	nreaders = num_readers;
+	cached_min_read = 0;
+	write.store(0, std::memory_order_relaxed);
+}
+
+template<typename T>
+void* broadcast_queue<T>::deinitialize()
+{
+	if (!cursors)
+		return nullptr;
+
+	for (size_type i = 0; i < capacity(); i++)
+		slots[i].~value_type();
+
+	void* mem = cursors;
+	alloc.deallocate(mem);
+	mem = alloc == noop_allocator ? mem : nullptr;
+	cursors = nullptr;
+	slots = nullptr;
+	mask = 0;
+	nreaders = 0;
+	alloc = noop_allocator;
+	return mem;
+}
+
+template<typename T>
+typename broadcast_queue<T>::size_type broadcast_queue<T>::room(size_type w)
+{
+	size_type n = capacity() - (w - cached_min_read);
+	if (n)
+		return n;
+
+	size_type min_read = cursors[0].read.load(std::memory_order_acquire);
+	for (size_type i = 1; i < nreaders; i++)
+	{
+		const size_type r = cursors[i].read.load(std::memory_order_acquire);
+		if (int32_t(r - min_read) < 0)
+			min_read = r;
+	}
+
+	cached_min_read = min_read;
+	return capacity() - (w - min_read);
+}
+
+template<typename T>
+bool broadcast_queue<T>::try_push(const_reference val)
+{
+	const size_type w = write.load(std::memory_order_relaxed);
+	if (!room(w))
+		return false;
+	slots[w & mask] = val;
+	write.store(w + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T>
+void broadcast_queue<T>::push(const_reference val)
+{
+	backoff bo;
+	while (!try_push(val))
+		bo.pause();
+}
+
+template<typename T>
+typename broadcast_queue<T>::size_type broadcast_queue<T>::try_push(const_pointer vals, size_type num_vals)
+{
+	const size_type w = write.load(std::memory_order_relaxed);
+	size_type n = room(w);
+	n = num_vals < n ? num_vals : n;
+	for (size_type i = 0; i < n; i++)
+		slots[(w + i) & mask] = vals[i];
+	write.store(w + n, std::memory_order_release);
+	return n;
+}
+
+template<typename T>
+typename broadcast_queue<T>::size_type broadcast_queue<T>::available(cursor& c, size_type r, size_type wanted)
+{
+	size_type n = c.cached_write - r;
+	if (n < wanted)
+	{
+		c.cached_write = write.load(std::memory_order_acquire);
+		n = c.cached_write - r;
+	}
+	return n;
+}
+
+template<typename T>
+bool broadcast_queue<T>::try_pop(size_type reader, reference val)
+{
+	cursor& c = cursors[reader];
+	const size_type r = c.read.load(std::memory_order_relaxed);
+	if (!available(c, r, 1))
+		return false;
+	val = slots[r & mask];
+	c.read.store(r + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T>
+void broadcast_queue<T>::pop(size_type reader, reference val)
+{
+	backoff bo;
+	while (!try_pop(reader, val))
+		bo.pause();
+}
+
+template<typename T>
+typename broadcast_queue<T>::size_type broadcast_queue<T>::try_pop(size_type reader, pointer vals, size_type num_vals)
+{
+	cursor& c = cursors[reader];
+	const size_type r = c.read.load(std::memory_order_relaxed);
+	size_type n = available(c, r, num_vals);
+	n = num_vals < n ? num_vals : n;
+	for (size_type i = 0; i < n; i++)
+		vals[i] = slots[(r + i) & mask];
+	c.read.store(r + n, std::memory_order_release);
+	return n;
+}
+
+template<typename T>
+typename broadcast_queue<T>::size_type broadcast_queue<T>::size(size_type reader) const
+{
+	return write.load(std::memory_order_acquire) - cursors[reader].read.load(std::memory_order_acquire);
+}
+
+}
@@ -57,10 +57,25 @@ void ensure_scheduler_initialized();
 // threadpool.
 void dispatch(const std::function<void()>& task);
 
+// Implements the parallel for pattern over sub-ranges: task is called with 
+// [begin,end) sub-ranges that together cover the full range exactly once and
+// should loop over its sub-range itself. The range is split recursively with a
+// grain size derived from the number of workers, so there is one task per 
+// chunk rather than one per index.
+void parallel_for_range(size_t begin, size_t end, const std::function<void(size_t begin, size_t end)>& task);
+
 // Implements the parallel for pattern, executing the specified task with the index
 // from begin to end.
 void parallel_for(size_t begin, size_t end, const std::function<void(size_t index)>& task);
 
+// Same as above, but the functor is called directly from each sub-range's loop
+// so there's no type-erased call or allocation per index.
+template<typename Body>
+void parallel_for(size_t begin, size_t end, const Body& body)
+{
+	parallel_for_range(begin, end, [&](size_t b, size_t e) { for (; b < e; b++) body(b); });
+}
+
 // For debugging
 inline void serial_for(size_t begin, size_t end, const std::function<void(size_t index)>& task)
 {
@@ -0,0 +1,387 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Bounded multi-producer, multi-consumer FIFO queue over a fixed ring of cells
+// based on:
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Each cell carries a sequence number that tells a producer whether the cell is
+// free for its lap and a consumer whether it has been filled, so a push or pop
+// is one CAS on a shared position plus uncontended access to its own cell.
+// Unlike concurrent_queue nothing is allocated per push, but the queue can
+// fill: try_push fails and push spins until a consumer makes room. Cells are
+// padded to a cache line so neighboring producers and consumers don't
+// false-share.
+
+#pragma once
+#include <oCompiler.h>
+#include <oConcurrency/backoff.h>
+#include <oMemory/allocate.h>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ouro {
+
+template<typename T>
+class concurrent_bounded_queue
+{
+public:
+	typedef uint32_t size_type;
+	typedef T value_type;
+	typedef value_type& reference;
+	typedef const value_type& const_reference;
+	typedef value_type* pointer;
+	typedef const value_type* const_pointer;
+
+	static const size_type default_capacity = 65536;
+
+	// returns the number of bytes required to pass as memory to initialize().
+	static size_type calc_size(size_type capacity);
+
+
+	// non-concurrent api
+
+	// capacity must be a power of two.
+	concurrent_bounded_queue(size_type capacity = default_capacity, const char* label = "concurrent_bounded_queue", const allocator& a = default_allocator);
+	~concurrent_bounded_queue();
+
+	// capacity must be a power of two.
+	void initialize(size_type capacity, const char* label = "concurrent_bounded_queue", const allocator& a = default_allocator);
+
+	// capacity must be a power of two. memory must be cache-line aligned; use
+	// calc_size() to determine its size.
+	void initialize(void* memory, size_type capacity);
+
+	// deinitializes the queue and returns the memory passed to initialize()
+	void* deinitialize();
+
+	// Returns the number of elements in the queue. This is only a snapshot and
+	// should be used only for debugging.
+	size_type size() const;
+
+	// Returns the max number of elements that can be stored
+	size_type capacity() const { return mask ? (mask + 1) : 0; }
+
+
+	// concurrent api
+
+	// Returns false if the queue is full
+	bool try_push(const_reference val);
+	bool try_push(value_type&& val);
+
+	// Spins until there is room in the queue
+	void push(const_reference val);
+	void push(value_type&& val);
+
+	// Pushes as many of the specified values as fit in one contiguous claim and
+	// returns the number pushed. Values are pushed in order.
+	size_type try_push(const_pointer vals, size_type num_vals);
+
+	// Returns false if the queue is empty
+	bool try_pop(reference val);
+
+	// Spins until an element can be popped from the queue
+	void pop(reference val);
+
+	// Pops up to num_vals elements in one claim and returns the number popped.
+	size_type try_pop(pointer vals, size_type num_vals);
+
+	// Spins until the queue is empty
+	void clear();
+
+	// Returns true if no elements are in the queue
+	bool empty() const;
+
+private:
+	struct oALIGNAS(oCACHE_LINE_SIZE) cell
+	{
+		std::atomic<size_type> sequence;
+		typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+
+		T* value() { return (T*)&storage; }
+	};
+
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<size_type> enqueue_pos;
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<size_type> dequeue_pos;
+	oALIGNAS(oCACHE_LINE_SIZE) cell* cells;
+	size_type mask;
+	allocator alloc;
+
+	concurrent_bounded_queue(const concurrent_bounded_queue&); /* = delete; */
+	const concurrent_bounded_queue& operator=(const concurrent_bounded_queue&); /* = delete; */
+
+	void internal_initialize(void* memory, size_type capacity);
+
+	// returns the cell claimed for a push or nullptr if the queue is full
+	cell* claim_push();
+
+	// returns the cell claimed for a pop or nullptr if the queue is empty
+	cell* claim_pop();
+
+	// claims up to num cells for a push or pop and returns the first position or
+	// sets num to zero
+	size_type claim_range(std::atomic<size_type>& pos, size_type lap_offset, size_type& num);
+};
+
+template<typename T>
+typename concurrent_bounded_queue<T>::size_type concurrent_bounded_queue<T>::calc_size(size_type capacity)
+{
+	return sizeof(cell) * capacity;
+}
+
+template<typename T>
+concurrent_bounded_queue<T>::concurrent_bounded_queue(size_type capacity, const char* label, const allocator& a)
+	: cells(nullptr)
+	, mask(0)
+	, alloc(noop_allocator)
+{
+	enqueue_pos = 0;
+	dequeue_pos = 0;
+	if (capacity)
+		initialize(capacity, label, a);
+}
+
+template<typename T>
+concurrent_bounded_queue<T>::~concurrent_bounded_queue()
+{
+	deinitialize();
+}
+
+template<typename T>
+void concurrent_bounded_queue<T>::initialize(size_type capacity, const char* label, const allocator& a)
+{
+	if (!capacity || (capacity & (capacity-1)))
+		throw std::invalid_argument("capacity must be a power of two");
+	void* mem = a.allocate(calc_size(capacity), memory_alignment::cacheline, label);
+	if (!mem)
+		throw std::bad_alloc();
+	internal_initialize(mem, capacity);
+	alloc = a;
+}
+
+template<typename T>
+void concurrent_bounded_queue<T>::initialize(void* memory, size_type capacity)
+{
+	if (!capacity || (capacity & (capacity-1)))
+		throw std::invalid_argument("capacity must be a power of two");
+	internal_initialize(memory, capacity);
+	alloc = noop_allocator;
+}
+
+template<typename T>
+void concurrent_bounded_queue<T>::internal_initialize(void* memory, size_type capacity)
+{
+	cells = (cell*)memory;
+	mask = capacity - 1;
+	for (size_type i = 0; i < capacity; i++)
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	enqueue_pos.store(0, std::memory_order_relaxed);
+	dequeue_pos.store(0, std::memory_order_relaxed);
+}
+
+template<typename T>
+void* concurrent_bounded_queue<T>::deinitialize()
+{
+	if (!cells)
+		return nullptr;
+	if (!empty())
+		throw std::length_error("container not empty");
+	void* mem = cells;
+	alloc.deallocate(mem);
+	mem = alloc == noop_allocator ? mem : nullptr;
+	cells = nullptr;
+	mask = 0;
+	alloc = noop_allocator;
+	return mem;
+}
+
+template<typename T>
+typename concurrent_bounded_queue<T>::size_type concurrent_bounded_queue<T>::size() const
+{
+	return enqueue_pos.load(std::memory_order_relaxed) - dequeue_pos.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+typename concurrent_bounded_queue<T>::cell* concurrent_bounded_queue<T>::claim_push()
+{
+	size_type pos = enqueue_pos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		cell* c = &cells[pos & mask];
+		const int32_t dif = int32_t(c->sequence.load(std::memory_order_acquire) - pos);
+		if (dif == 0)
+		{
+			if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				return c;
+		}
+
+		else if (dif < 0)
+			return nullptr;
+		else
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+	}
+}
+
+template<typename T>
+typename concurrent_bounded_queue<T>::cell* concurrent_bounded_queue<T>::claim_pop()
+{
+	size_type pos = dequeue_pos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		cell* c = &cells[pos & mask];
+		const int32_t dif = int32_t(c->sequence.load(std::memory_order_acquire) - (pos + 1));
+		if (dif == 0)
+		{
+			if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				return c;
+		}
+
+		else if (dif < 0)
+			return nullptr;
+		else
+			pos = dequeue_pos.load(std::memory_order_relaxed);
+	}
+}
+
+template<typename T>
+typename concurrent_bounded_queue<T>::size_type concurrent_bounded_queue<T>::claim_range(std::atomic<size_type>& position, size_type lap_offset, size_type& num)
+{
+	// a cell whose sequence matches its position is ready for this lap, so claim
+	// the run of ready cells up to num, all in one CAS. Only the claimer touches
+	// those cells until it republishes their sequences.
+	const size_type max_num = num < capacity() ? num : capacity();
+	size_type pos = position.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		size_type n = 0;
+		while (n < max_num && cells[(pos + n) & mask].sequence.load(std::memory_order_acquire) == pos + n + lap_offset)
+			n++;
+
+		if (!n)
+		{
+			const int32_t dif = int32_t(cells[pos & mask].sequence.load(std::memory_order_acquire) - (pos + lap_offset));
+			if (dif < 0)
+			{
+				num = 0;
+				return pos;
+			}
+
+			pos = position.load(std::memory_order_relaxed);
+			continue;
+		}
+
+		if (position.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+		{
+			num = n;
+			return pos;
+		}
+	}
+}
+
+template<typename T>
+bool concurrent_bounded_queue<T>::try_push(const_reference val)
+{
+	cell* c = claim_push();
+	if (!c)
+		return false;
+	const size_type pos = c->sequence.load(std::memory_order_relaxed);
+	new (c->value()) T(val);
+	c->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T>
+bool concurrent_bounded_queue<T>::try_push(value_type&& val)
+{
+	cell* c = claim_push();
+	if (!c)
+		return false;
+	const size_type pos = c->sequence.load(std::memory_order_relaxed);
+	new (c->value()) T(std::move(val));
+	c->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T>
+void concurrent_bounded_queue<T>::push(const_reference val)
+{
+	backoff bo;
+	while (!try_push(val))
+		bo.pause();
+}
+
+template<typename T>
+void concurrent_bounded_queue<T>::push(value_type&& val)
+{
+	backoff bo;
+	while (!try_push(std::move(val)))
+		bo.pause();
+}
+
+template<typename T>
+typename concurrent_bounded_queue<T>::size_type concurrent_bounded_queue<T>::try_push(const_pointer vals, size_type num_vals)
+{
+	size_type n = num_vals;
+	const size_type pos = claim_range(enqueue_pos, 0, n);
+	for (size_type i = 0; i < n; i++)
+	{
+		cell& c = cells[(pos + i) & mask];
+		new (c.value()) T(vals[i]);
+		c.sequence.store(pos + i + 1, std::memory_order_release);
+	}
+	return n;
+}
+
+template<typename T>
+bool concurrent_bounded_queue<T>::try_pop(reference val)
+{
+	cell* c = claim_pop();
+	if (!c)
+		return false;
+	const size_type pos = c->sequence.load(std::memory_order_relaxed) - 1;
+	T* v = c->value();
+	val = std::move(*v);
+	v->~T();
+	c->sequence.store(pos + mask + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T>
+void concurrent_bounded_queue<T>::pop(reference val)
+{
+	backoff bo;
+	while (!try_pop(val))
+		bo.pause();
+}
+
+template<typename T>
+typename concurrent_bounded_queue<T>::size_type concurrent_bounded_queue<T>::try_pop(pointer vals, size_type num_vals)
+{
+	size_type n = num_vals;
+	const size_type pos = claim_range(dequeue_pos, 1, n);
+	for (size_type i = 0; i < n; i++)
+	{
+		cell& c = cells[(pos + i) & mask];
+		T* v = c.value();
+		vals[i] = std::move(*v);
+		v->~T();
+		c.sequence.store(pos + i + mask + 1, std::memory_order_release);
+	}
+	return n;
+}
+
+template<typename T>
+void concurrent_bounded_queue<T>::clear()
+{
+	value_type e;
+	while (try_pop(e));
+}
+
+template<typename T>
+bool concurrent_bounded_queue<T>::empty() const
+{
+	return enqueue_pos.load(std::memory_order_acquire) == dequeue_pos.load(std::memory_order_acquire);
+}
+
+}
@@ -0,0 +1,505 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// A concurrent hash map that grows. Like concurrent_hash_map this is open-
+// addressed with linear probing, but keys and values may be any integral type
+// up to 64 bits and the table never fills: once enough slots hold keys, live
+// or removed, a new table sized for the live entries is allocated and every
+// thread that touches a moved entry or tries to add one helps move the table
+// over a chunk at a time. Removed entries are not moved, so tombstones are
+// reclaimed by migration rather than a stop-the-world reclaim(). A retired
+// table is freed once every operation that could still be reading it has
+// finished.
+
+// Reads never wait: an entry is copied to the next table before it's flagged
+// as moved, so a reader that finds it moved reads on in the next table. Writes
+// that need the next table help move it and then wait for chunks other 
+// threads are still moving, so writes are not lock-free during a migration.
+
+// Rules:
+// A key of nullkey is not allowed - it is used to flag empty slots
+// A value of nullvalue is not allowed - it is used to flag removed entries
+// A value of movedvalue is not allowed - it is used to flag migrated entries
+
+#pragma once
+#include <oConcurrency/backoff.h>
+#include <oMemory/allocate.h>
+#include <oMemory/bit.h>
+#include <oMemory/wang_hash.h>
+#include <oCompiler.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+namespace ouro {
+
+template<typename KeyT, typename ValueT>
+class concurrent_growable_hash_map
+{
+	static_assert(std::is_integral<KeyT>::value && sizeof(KeyT) <= 8, "keys must be integral");
+	static_assert(std::is_integral<ValueT>::value && sizeof(ValueT) <= 8, "values must be integral");
+
+public:
+	typedef KeyT key_type;
+	typedef ValueT value_type;
+	typedef uint32_t size_type;
+
+	static const key_type nullkey = key_type(-1);
+	static const value_type nullvalue = value_type(-1);
+	static const value_type movedvalue = value_type(-2);
+
+	// entries are moved in chunks of this many slots
+	static const size_type migration_chunk_size = 1024;
+
+
+	// non-concurrent api
+
+	// constructs an empty hash map
+	concurrent_growable_hash_map()
+		: alloc(noop_allocator)
+		, label("")
+		, retired(nullptr)
+	{
+		current.store(nullptr);
+		migrations.store(0);
+		has_retired.store(false);
+		retire_lock.clear();
+		for (auto& s : stripes)
+			s.active.store(0);
+	}
+
+	// ctor creates as a valid hash map that can hold capacity entries before it
+	// first grows
+	concurrent_growable_hash_map(size_type capacity, const char* alloc_label = "concurrent_growable_hash_map", const allocator& a = default_allocator)
+		: alloc(noop_allocator)
+		, label("")
+		, retired(nullptr)
+	{
+		current.store(nullptr);
+		migrations.store(0);
+		has_retired.store(false);
+		retire_lock.clear();
+		for (auto& s : stripes)
+			s.active.store(0);
+		initialize(capacity, alloc_label, a);
+	}
+
+	// dtor
+	~concurrent_growable_hash_map() { deinitialize(); }
+
+	// initializes the hash map with memory allocated from allocator as needed
+	void initialize(size_type capacity, const char* alloc_label = "concurrent_growable_hash_map", const allocator& a = default_allocator)
+	{
+		deinitialize();
+		alloc = a;
+		label = alloc_label;
+		current.store(new_table(std::max<size_type>(8, nextpow2(capacity + capacity / 3 + 1))));
+	}
+
+	// frees all memory
+	void deinitialize()
+	{
+		free_retired();
+		if (table* t = current.load())
+			alloc.deallocate(t);
+		current.store(nullptr);
+		alloc = noop_allocator;
+	}
+
+	// returns the hash map to an empty state at its current capacity
+	void clear()
+	{
+		free_retired();
+		table* t = current.load();
+		for (size_type i = 0; i <= t->mask; i++)
+		{
+			t->cells[i].key.store(nullkey, std::memory_order_relaxed);
+			t->cells[i].value.store(nullvalue, std::memory_order_relaxed);
+		}
+		t->num_keys.store(0);
+	}
+
+	// returns the number of entries in the hash map
+	size_type size() const
+	{
+		size_type n = 0;
+		visit([&](const key_type&, const value_type&) { n++; });
+		return n;
+	}
+
+	// returns true if there are no entries
+	inline bool empty() const { return size() == 0; }
+
+	// returns the number of keys, live or removed, the current table can hold
+	// before it migrates
+	size_type capacity() const { return current.load()->max_keys; }
+
+	// returns the number of times the map has moved to a new table
+	size_type num_migrations() const { return migrations.load(); }
+
+	// visit every entry with a function: void visit(const key_type& k, const value_type& v)
+	template<typename visitor_t>
+	void visit(visitor_t visitor) const
+	{
+		const table* t = current.load();
+		for (size_type i = 0; i <= t->mask; i++)
+		{
+			const key_type k = t->cells[i].key.load(std::memory_order_relaxed);
+			const value_type v = t->cells[i].value.load(std::memory_order_relaxed);
+			if (k != nullkey && v != nullvalue)
+				visitor(k, v);
+		}
+	}
+
+
+	// concurrent api
+
+	// sets the specified key to the specified value and returns the prior value.
+	// nullvalue implies this was a first add.
+	value_type set(const key_type& key, const value_type& value)
+	{
+		if (key == nullkey || value == movedvalue)
+			throw std::invalid_argument("reserved key or value");
+
+		scoped_operation op(*this);
+		table* t = current.load();
+		value_type prior;
+		while (!insert(t, key, value, prior))
+			t = migrate(t);
+		return prior;
+	}
+
+	// flags the key as no longer in use and returns the prior value
+	inline value_type remove(const key_type& key) { return set(key, nullvalue); }
+
+	// returns the value associated with the key or nullvalue if the key was not
+	// found
+	value_type get(const key_type& key) const
+	{
+		if (key == nullkey)
+			throw std::invalid_argument("reserved key");
+
+		scoped_operation op(*this);
+		const table* t = current.load();
+		while (t)
+		{
+			const table* next = nullptr;
+			size_type i = hash(key) & t->mask;
+			for (size_type n = 0; n <= t->mask; n++, i = (i + 1) & t->mask)
+			{
+				const key_type k = t->cells[i].key.load();
+				if (k != key && k != nullkey)
+					continue;
+
+				// A moved entry, or an empty slot in a table that's been moved, is
+				// stale but the next table already has whatever was here.
+				const value_type v = t->cells[i].value.load();
+				if (v != movedvalue)
+					return k == key ? v : nullvalue;
+
+				next = t->next.load();
+				break;
+			}
+
+			t = next;
+		}
+
+		return nullvalue;
+	}
+
+private:
+	struct cell
+	{
+		std::atomic<key_type> key;
+		std::atomic<value_type> value;
+	};
+
+	struct table
+	{
+		size_type mask;
+		size_type max_keys;
+		std::atomic<size_type> num_keys; // slots claimed, live or removed
+		std::atomic<table*> next; // the table being migrated to
+		std::atomic<size_type> next_chunk;
+		std::atomic<size_type> num_chunks_done;
+		table* next_retired;
+		uint32_t idle_stripes; // stripes seen idle since retirement
+		cell cells[1];
+	};
+
+	// Operations register in a stripe chosen by thread so the count of
+	// operations in flight doesn't bounce one cache line between all threads.
+	static const size_type num_stripes = 16;
+	struct stripe
+	{
+		std::atomic<uint32_t> active;
+		uint8_t pad[oCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+	};
+
+	struct scoped_operation
+	{
+		scoped_operation(const concurrent_growable_hash_map& m)
+			: map(m)
+			, s(m.stripes[wang_hash(uint64_t(std::hash<std::thread::id>()(std::this_thread::get_id()))) % num_stripes])
+		{ s.active.fetch_add(1); }
+
+		~scoped_operation()
+		{
+			s.active.fetch_sub(1);
+			if (map.has_retired.load(std::memory_order_relaxed))
+				map.free_idle_retired();
+		}
+
+		const concurrent_growable_hash_map& map;
+		stripe& s;
+
+	private:
+		scoped_operation& operator=(const scoped_operation&);
+	};
+
+	mutable std::atomic<table*> current;
+	allocator alloc;
+	const char* label;
+	mutable std::atomic<size_type> migrations;
+	mutable stripe stripes[num_stripes];
+	mutable table* retired;
+	mutable std::atomic<bool> has_retired;
+	mutable std::atomic_flag retire_lock;
+
+	concurrent_growable_hash_map(const concurrent_growable_hash_map&); /* = delete */
+	const concurrent_growable_hash_map& operator=(const concurrent_growable_hash_map&); /* = delete */
+
+	static size_type hash(const key_type& key) { return size_type(wang_hash(uint64_t(key))); }
+
+	// table::next while one thread sizes and allocates the next table
+	static table* sizing() { return (table*)uintptr_t(1); }
+
+	table* new_table(size_type num_cells) const
+	{
+		table* t = (table*)alloc.allocate(sizeof(table) + sizeof(cell) * (num_cells - 1), memory_alignment::cacheline, label);
+		if (!t)
+			throw allocate_error(allocate_errc::out_of_memory);
+		t->mask = num_cells - 1;
+		t->max_keys = num_cells - num_cells / 4;
+		t->num_keys.store(0);
+		t->next.store(nullptr);
+		t->next_chunk.store(0);
+		t->num_chunks_done.store(0);
+		t->next_retired = nullptr;
+		t->idle_stripes = 0;
+		for (size_type i = 0; i < num_cells; i++)
+		{
+			t->cells[i].key.store(nullkey, std::memory_order_relaxed);
+			t->cells[i].value.store(nullvalue, std::memory_order_relaxed);
+		}
+		return t;
+	}
+
+	// returns false if the entry has moved or the table is full, in which case
+	// the caller should migrate and try again on the next table
+	static bool insert(table* t, const key_type& key, const value_type& value, value_type& out_prior)
+	{
+		size_type i = hash(key) & t->mask;
+		for (size_type n = 0; n <= t->mask; n++, i = (i + 1) & t->mask)
+		{
+			cell& c = t->cells[i];
+			key_type k = c.key.load();
+			if (k != key)
+			{
+				if (k != nullkey)
+					continue;
+
+				// removing an absent key is a no-op
+				if (value == nullvalue)
+				{
+					out_prior = nullvalue;
+					return c.value.load() != movedvalue;
+				}
+
+				if (t->num_keys.load(std::memory_order_relaxed) >= t->max_keys || t->next.load())
+					return false;
+
+				if (c.key.compare_exchange_strong(k, key))
+					t->num_keys.fetch_add(1, std::memory_order_relaxed);
+				else if (k != key)
+					continue;
+			}
+
+			value_type v = c.value.load();
+			do
+			{
+				if (v == movedvalue)
+					return false;
+			} while (!c.value.compare_exchange_weak(v, value));
+
+			out_prior = v;
+			return true;
+		}
+
+		return false;
+	}
+
+	// moves entries from t to its next table until all are moved and returns
+	// the next table
+	table* migrate(table* t) const
+	{
+		table* next = t->next.load();
+		if (!next && t->next.compare_exchange_strong(next, sizing()))
+		{
+			// size for the live entries: grow if at least half full, otherwise
+			// the tombstones are just dropped
+			size_type live = 0;
+			for (size_type i = 0; i <= t->mask; i++)
+			{
+				const value_type v = t->cells[i].value.load(std::memory_order_relaxed);
+				live += (v != nullvalue && v != movedvalue) ? 1 : 0;
+			}
+
+			try { next = new_table(std::max<size_type>(t->mask + 1, nextpow2(live * 2 + 1))); }
+			catch (...)
+			{
+				t->next.store(nullptr);
+				throw;
+			}
+			t->next.store(next);
+		}
+
+		else if (next == sizing())
+		{
+			backoff bo;
+			while ((next = t->next.load()) == sizing())
+				bo.pause();
+			if (!next)
+				throw allocate_error(allocate_errc::out_of_memory);
+		}
+
+		const size_type num_chunks = (t->mask + migration_chunk_size) / migration_chunk_size;
+		for (;;)
+		{
+			const size_type chunk = t->next_chunk.fetch_add(1);
+			if (chunk >= num_chunks)
+				break;
+
+			// Copy then flag each entry so a reader that sees it moved finds it in
+			// next. Until it's flagged, writers of the key still write here, so
+			// copy again if one got in between.
+			const size_type end = std::min<size_type>(t->mask + 1, (chunk + 1) * migration_chunk_size);
+			for (size_type i = chunk * migration_chunk_size; i < end; i++)
+			{
+				cell& c = t->cells[i];
+				value_type v = c.value.load();
+				bool copied = false;
+				do
+				{
+					if (v != nullvalue || copied)
+					{
+						copy(next, c.key.load(), v);
+						copied = true;
+					}
+				} while (!c.value.compare_exchange_strong(v, movedvalue));
+			}
+
+			if (t->num_chunks_done.fetch_add(1) + 1 == num_chunks)
+			{
+				// the migration is complete
+				migrations.fetch_add(1);
+				current.store(next);
+				retire(t);
+				return next;
+			}
+		}
+
+		// wait on chunks other threads are moving
+		backoff bo;
+		while (current.load() == t)
+			bo.pause();
+		return next;
+	}
+
+	// sets an entry in a table known to have room. Only the migrating thread
+	// writes a key that's still unmoved in the old table, so this can overwrite.
+	static void copy(table* t, const key_type& key, const value_type& value)
+	{
+		for (size_type i = hash(key) & t->mask;; i = (i + 1) & t->mask)
+		{
+			cell& c = t->cells[i];
+			key_type k = c.key.load();
+			if (k == nullkey && c.key.compare_exchange_strong(k, key))
+			{
+				t->num_keys.fetch_add(1, std::memory_order_relaxed);
+				k = key;
+			}
+
+			if (k == key)
+			{
+				c.value.store(value);
+				return;
+			}
+		}
+	}
+
+	void lock_retired() const
+	{
+		backoff bo;
+		while (retire_lock.test_and_set(std::memory_order_acquire))
+			bo.pause();
+	}
+
+	void retire(table* t) const
+	{
+		lock_retired();
+		t->next_retired = retired;
+		retired = t;
+		has_retired.store(true);
+		retire_lock.clear(std::memory_order_release);
+	}
+
+	// Any operation that could have seen a retired table began before it was
+	// retired, so once each stripe has been seen idle since then the table can
+	// be freed.
+	void free_idle_retired() const
+	{
+		if (retire_lock.test_and_set(std::memory_order_acquire))
+			return;
+
+		const uint32_t all_idle = (1u << num_stripes) - 1;
+		table** pp = &retired;
+		while (table* t = *pp)
+		{
+			for (size_type i = 0; i < num_stripes; i++)
+				if (!stripes[i].active.load())
+					t->idle_stripes |= 1u << i;
+
+			if (t->idle_stripes == all_idle)
+			{
+				*pp = t->next_retired;
+				alloc.deallocate(t);
+			}
+			else
+				pp = &t->next_retired;
+		}
+
+		has_retired.store(retired != nullptr);
+		retire_lock.clear(std::memory_order_release);
+	}
+
+	void free_retired()
+	{
+		while (retired)
+		{
+			table* t = retired;
+			retired = t->next_retired;
+			alloc.deallocate(t);
+		}
+		has_retired.store(false);
+	}
+};
+
+template<typename KeyT, typename ValueT> const KeyT concurrent_growable_hash_map<KeyT, ValueT>::nullkey;
+template<typename KeyT, typename ValueT> const ValueT concurrent_growable_hash_map<KeyT, ValueT>::nullvalue;
+template<typename KeyT, typename ValueT> const ValueT concurrent_growable_hash_map<KeyT, ValueT>::movedvalue;
+
+}
@@ -2,12 +2,23 @@
 
 // Fine-grained concurrent FIFO queue based on:
 // http://www.cs.rochester.edu/research/synchronization/pseudocode/queues.html
-// Use a concurrent fixed block allocator for best performance. This also 
-// ensures concurrency of non-trivial destructors.
+// Popped nodes are retired through epoch reclamation and return to the node
+// pool only once no other thread can still be reading them, so the algorithm
+// needs no ABA tags and non-trivial destructors run exactly once, by the
+// thread that popped the value.
+//
+// Because popped nodes come back late, capacity is the size of the node pool,
+// not the maximum number of elements: one node is the sentinel and some may be
+// awaiting reclamation. When a push finds the pool exhausted it takes an
+// overflow node from the allocator, which goes back to the allocator once
+// reclaimed, so a burst grows the queue only for as long as it lasts. A queue
+// initialized over user memory has no allocator and instead waits on
+// epoch::synchronize() (unless the pushing thread is inside an epoch::guard),
+// throwing std::bad_alloc only if the pool really is full of live elements.
 
 #pragma once
 #include <oCompiler.h>
-#include <oConcurrency/tagged_pointer.h>
+#include <oConcurrency/epoch.h>
 #include <oMemory/allocate.h>
 #include <oMemory/concurrent_object_pool.h>
 #include <atomic>
@@ -18,42 +29,19 @@
 
 namespace ouro {
 
-template<typename T, bool has_trivial_dtor = std::is_trivially_destructible<T>::value>
-struct concurrent_queue_node {};
-
 template<typename T>
-struct concurrent_queue_node<T, true>
+struct concurrent_queue_node
 {
   typedef T value_type;
-  typedef tagged_pointer<concurrent_queue_node<value_type, true>> pointer_type;
-  
-  concurrent_queue_node(const value_type& v) : next(nullptr, 0), value(v) {}
-  concurrent_queue_node(value_type&& v) : next(nullptr, 0), value(std::move(v)) {}
 
-  pointer_type next;
-  value_type value;
-};
+  concurrent_queue_node(const value_type& v) : value(v) { next.store(nullptr, std::memory_order_relaxed); }
+  concurrent_queue_node(value_type&& v) : value(std::move(v)) { next.store(nullptr, std::memory_order_relaxed); }
 
-template<typename T>
-struct concurrent_queue_node<T, false>
-{
-  typedef T value_type;
-  typedef tagged_pointer<concurrent_queue_node<value_type, false>> pointer_type;
-  
-  concurrent_queue_node(const value_type& v) : next(nullptr, 0), value(v) { flag.clear(); }
-  concurrent_queue_node(value_type&& v) : next(nullptr, 0), value(std::move(v)) { flag.clear(); }
+  std::atomic<concurrent_queue_node*> next;
 
-  pointer_type next;
+  // destroyed in place by the thread that pops it, so the node itself is only
+  // ever deallocated, never destroyed
   value_type value;
-  
-	// A two-step trivial ref count. In try_pop, the race condition described in 
-	// the original paper for non-trivial destructors is addressed by flagging 
-	// which of the two conditions/code paths should be allowed to free the 
-	// memory, so calling this query is destructive (thus the non-constness).
-	bool should_deallocate() { return flag.test_and_set(); }
-
-private:
-	std::atomic_flag flag;
 };
 
 template<typename T>
@@ -67,7 +55,6 @@ public:
 	typedef value_type* pointer;
 	typedef const value_type* const_pointer;
   typedef concurrent_queue_node<T> node_type;
-  typedef typename node_type::pointer_type pointer_type;
 
 	static const size_type default_capacity = 65536;
 
@@ -85,7 +72,9 @@ public:
 	// use calc_size() to determine memory size
 	void initialize(void* memory, size_type capacity);
 
-	// deinitializes the queue and returns the memory passed to initialize()
+	// deinitializes the queue and returns the memory passed to initialize(). This
+	// waits for popped nodes still awaiting reclamation to return to the pool or
+	// allocator.
 	void* deinitialize();
 
 	// Walks the nodes in a non-concurrent manner and returns the count (not 
@@ -112,21 +101,18 @@ public:
 	bool empty() const;
 
 private:
-	// alignment is required so that pointers to node_type's are at least 8-bytes.
-	// This allows tagged_pointer to use the bottom 3-bits for its tag.
-	
-	oALIGNAS(oCACHE_LINE_SIZE) pointer_type head;
-	oALIGNAS(oCACHE_LINE_SIZE) pointer_type tail;
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<node_type*> head;
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<node_type*> tail;
 	concurrent_object_pool<node_type> pool;
 	allocator alloc;
 
-	node_type* internal_construct_sentinel(std::false_type);
-	node_type* internal_construct_sentinel(std::true_type);
+	static void reclaim_node(void* node, void* queue);
 
+	bool in_pool(void* node) const;
+	void* internal_allocate();
+	void internal_deallocate(void* node);
+	void internal_initialize();
 	void internal_push(node_type* n);
-
-	bool internal_try_pop(reference val, std::false_type);
-	bool internal_try_pop(reference val, std::true_type);
 };
 
 template<typename T>
@@ -136,17 +122,68 @@ typename concurrent_queue<T>::size_type concurrent_queue<T>::calc_size(size_type
 }
 
 template<typename T>
-typename concurrent_queue<T>::node_type* concurrent_queue<T>::internal_construct_sentinel(std::false_type)
+void concurrent_queue<T>::reclaim_node(void* node, void* queue)
 {
-	node_type* n = pool.create(value_type());
-	n->should_deallocate(); // mark for immediate since this won't be popped
-	return n;
+	// the value was destroyed when the node was popped
+	((concurrent_queue*)queue)->internal_deallocate(node);
 }
 
 template<typename T>
-typename concurrent_queue<T>::node_type* concurrent_queue<T>::internal_construct_sentinel(std::true_type)
+bool concurrent_queue<T>::in_pool(void* node) const
 {
-	return pool.create(value_type());
+	// concurrent_pool::owns() wraps for pointers far outside the pool, so check
+	// the range explicitly
+	const uint8_t* first = (const uint8_t*)pool.pointer(0);
+	const uint8_t* last = (const uint8_t*)pool.pointer(pool.capacity() - 1);
+	return (const uint8_t*)node >= first && (const uint8_t*)node <= last;
+}
+
+template<typename T>
+void* concurrent_queue<T>::internal_allocate()
+{
+	void* p = pool.allocate();
+
+	// after a burst of pops most of the pool may be retired nodes waiting on
+	// the epoch, so give reclamation a chance to catch up
+	for (int i = 0; !p && i < 3; i++)
+	{
+		epoch::update();
+		p = pool.allocate();
+	}
+
+	// then grow past the pool for the rest of the burst
+	if (!p && !(alloc == noop_allocator))
+		p = alloc.allocate(sizeof(node_type), memory_alignment::cacheline, "concurrent_queue overflow node");
+
+	// with nowhere else to get a node, wait out every reader
+	if (!p && !epoch::guarded())
+	{
+		epoch::synchronize();
+		p = pool.allocate();
+	}
+
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+template<typename T>
+void concurrent_queue<T>::internal_deallocate(void* node)
+{
+	if (in_pool(node))
+		pool.deallocate(node);
+	else
+		alloc.deallocate(node);
+}
+
+template<typename T>
+void concurrent_queue<T>::internal_initialize()
+{
+	// the sentinel's value is never popped, so treat it as already destroyed
+	node_type* n = new (internal_allocate()) node_type(value_type());
+	n->value.~T();
+	head.store(n, std::memory_order_relaxed);
+	tail.store(n, std::memory_order_relaxed);
 }
 
 template<typename T>
@@ -167,8 +204,7 @@ void concurrent_queue<T>::initialize(size_type capacity, const char* label, cons
 	alloc = a;
 	void* mem = alloc.allocate(calc_size(capacity), memory_alignment::cacheline, label);
 	pool.initialize(mem, capacity);
-	node_type* n = internal_construct_sentinel(std::is_trivially_destructible<T>());
-	head = tail = pointer_type(n, 0);
+	internal_initialize();
 }
 
 template<typename T>
@@ -176,8 +212,7 @@ void concurrent_queue<T>::initialize(void* memory, size_type capacity)
 {
 	alloc = noop_allocator;
 	pool.initialize(memory, capacity);
-	node_type* n = internal_construct_sentinel(std::is_trivially_destructible<T>());
-	head = tail = pointer_type(n, 0);
+	internal_initialize();
 }
 
 template<typename T>
@@ -185,9 +220,14 @@ void* concurrent_queue<T>::deinitialize()
 {
 	if (!empty())
 		throw std::length_error("container not empty");
-	node_type* n = head.ptr();
-	head = tail = pointer_type(nullptr, 0);
-	pool.destroy(n); // sentinel already destroyed, so deallocate directly here
+	node_type* n = head.load();
+	head.store(nullptr);
+	tail.store(nullptr);
+	internal_deallocate(n); // sentinel value already destroyed
+
+	// retired nodes point into the pool's memory and reclaim through this queue
+	epoch::synchronize();
+
 	void* mem = pool.deinitialize();
 	alloc.deallocate(mem);
 	mem = alloc == noop_allocator ? nullptr : mem;
@@ -199,11 +239,11 @@ template<typename T>
 typename concurrent_queue<T>::size_type concurrent_queue<T>::size() const
 {
 	size_type n = 0;
-	auto p = head.ptr()->next.ptr();
+	auto p = head.load()->next.load();
 	while (p)
 	{
 		n++;
-		p = p->next.ptr();
+		p = p->next.load();
 	}
 	return n;
 }
@@ -211,124 +251,76 @@ typename concurrent_queue<T>::size_type concurrent_queue<T>::size() const
 template<typename T>
 void concurrent_queue<T>::internal_push(node_type* n)
 {
-	if (!n)
-		throw std::bad_alloc();
-	pointer_type t, next;
+	epoch::guard g;
+	node_type* t = nullptr;
 	for (;;)
 	{
-		t = tail;
-		next = t.ptr()->next;
-		if (t == tail)
+		t = tail.load();
+		node_type* next = t->next.load();
+		if (t == tail.load())
 		{
-			if (!next.ptr())
+			if (!next)
 			{
-				if (tail.ptr()->next.cas(next, pointer_type(n, next.tag()+1)))
+				if (t->next.compare_exchange_strong(next, n))
 					break;
 			}
 
 			else
-				tail.cas(t, pointer_type(next.ptr(), t.tag()+1));
+				tail.compare_exchange_strong(t, next);
 		}
 	}
 
-	tail.cas(t, pointer_type(n, t.tag()+1));
+	tail.compare_exchange_strong(t, n);
 }
 
 template<typename T>
 void concurrent_queue<T>::push(const_reference val)
 {
-	internal_push(pool.create(val));
+	internal_push(new (internal_allocate()) node_type(val));
 }
 
 template<typename T>
 void concurrent_queue<T>::push(value_type&& val)
 {
-	internal_push(pool.create(std::move(val)));
+	internal_push(new (internal_allocate()) node_type(std::move(val)));
 }
 
 template<typename T>
-bool concurrent_queue<T>::internal_try_pop(reference val, std::false_type)
+bool concurrent_queue<T>::try_pop(reference val)
 {
-	pointer_type h, t, next;
-	for (;;)
+	node_type* h = nullptr;
 	{
-		h = head;
-		t = tail;
-		next = h.ptr()->next;
-		auto nptr = next.ptr();
-		if (h == head)
+		epoch::guard g;
+		for (;;)
 		{
-			if (h.ptr() == t.ptr())
+			h = head.load();
+			node_type* t = tail.load();
+			node_type* next = h->next.load();
+			if (h == head.load())
 			{
-				if (!nptr) return false;
-				tail.cas(t, pointer_type(nptr, t.tag()+1));
-			}
-
-			else
-			{
-				if (head.cas(h, pointer_type(nptr, h.tag()+1)))
+				if (h == t)
 				{
-					// Yes, the paper says the assignment should be outside the CAS,
-					// but we've worked around that so we can also call the destructor
-					// here protected by the above CAS by flagging when the destructor
-					// is done and the memory can truly be reclaimed, so the 
-					// should_deallocate() calls have been added to either clean up the
-					// memory immediately now that the CAS has made next the dummy head,
-					// or clean it up lazily later at the bottom. Either way, do it only 
-					// once.
-					val = std::move(nptr->value);
-					nptr->value.~T();
-					if (nptr->should_deallocate())
-						pool.destroy(nptr);
-					break;
+					if (!next) return false;
+					tail.compare_exchange_strong(t, next);
 				}
-			}
-		}
-	}
-
-	auto p = h.ptr();
-	if (p->should_deallocate())
-		pool.destroy(p); // dtor called explicitly above so just deallocate
-	
-	return true;
-}
 
-template<typename T>
-bool concurrent_queue<T>::internal_try_pop(reference val, std::true_type)
-{
-	pointer_type h, t, next;
-	for (;;)
-	{
-		h = head;
-		t = tail;
-		next = h.ptr()->next;
-		auto nptr = next.ptr();
-		if (h == head)
-		{
-			if (h.ptr() == t.ptr())
-			{
-				if (!nptr) return false;
-				tail.cas(t, pointer_type(nptr, t.tag()+1));
-			}
-
-			else
-			{
-				val = std::move(nptr->value);
-				if (head.cas(h, pointer_type(nptr, h.tag()+1)))
+				else if (head.compare_exchange_strong(h, next))
+				{
+					// next is the new sentinel and only this thread won it, so the value
+					// can be moved out after the CAS rather than speculatively before.
+					// Another pop may retire next right away, but not reclaim it while
+					// this thread is guarded.
+					val = std::move(next->value);
+					next->value.~T();
 					break;
+				}
 			}
 		}
 	}
 
-	pool.destroy(h.ptr()); // dtor called explicitly above so just deallocate
+	epoch::retire(h, reclaim_node, this);
 	return true;
 }
-
-template<typename T>
-bool concurrent_queue<T>::try_pop(reference val)
-{
-	return internal_try_pop(val, std::is_trivially_destructible<T>());
-}
 	
 template<typename T>
 void concurrent_queue<T>::pop(reference val)
@@ -346,7 +338,7 @@ void concurrent_queue<T>::clear()
 template<typename T>
 bool concurrent_queue<T>::empty() const
 {
-	return head == tail;
+	return head.load() == tail.load();
 }
 
 }
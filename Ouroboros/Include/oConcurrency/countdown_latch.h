@@ -3,12 +3,16 @@
 // Synchronization object often described as a reverse semaphore. This object
 // gets initialized with a count and gives the system API to decrement the 
 // count. When the count reaches 0, this object becomes unblocked. This object
-// must be manually reset to a new count in order to be reused.
+// must be manually reset to a new count in order to be reused. The count is
+// itself the futex word waiters park on, so releases that don't reach zero
+// never make a syscall.
 
 #pragma once
+#include <oConcurrency/futex.h>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
-#include <mutex>
+#include <cstdint>
 #include <stdexcept>
 
 namespace ouro {
@@ -70,106 +74,113 @@ public:
 
 	// Block the calling thread for a time or until the number of outstanding 
 	// items reaches zero.
+	typedef decltype(std::cv_status::timeout) cv_status_type;
 	template<typename Rep, typename Period>
-	std::cv_status::cv_status wait_for(const std::chrono::duration<Rep, Period>& relative_time);
+	cv_status_type wait_for(const std::chrono::duration<Rep, Period>& relative_time);
 
 private:
-	std::condition_variable zero_references;
-	std::mutex mtx;
-	int num_outstanding;
+	std::atomic<uint32_t> num_outstanding; // signed count stored as the futex word
+
+	int count() const { return int(num_outstanding.load()); }
+	void store(int n);
 
 	countdown_latch(const countdown_latch&); /* = delete */
 	const countdown_latch& operator=(const countdown_latch&); /* = delete */
 };
 
 inline countdown_latch::countdown_latch()
-	: num_outstanding(0)
 {
+	num_outstanding = 0;
 }
 
 inline countdown_latch::countdown_latch(int initial_count)
-	: num_outstanding(initial_count)
 {
-	// to centralize code, have all operations on num_outstanding go through 
-	// release, so add one first so this all ends up being a noop
-	num_outstanding++;
-	release();
+	num_outstanding = 0;
+	store(initial_count);
 }
 
 inline countdown_latch::countdown_latch(countdown_latch&& that)
-	: num_outstanding(that.num_outstanding)
 {
-	std::lock_guard<std::mutex> Lock(that.mtx);
-	that.num_outstanding = 0;
-	that.zero_references.notify_all();
+	num_outstanding = 0;
+	store(int(that.num_outstanding.exchange(0)));
+	futex_wake_all(&that.num_outstanding);
 }
 
 inline countdown_latch& countdown_latch::operator=(countdown_latch&& that)
 {
 	if (this != &that)
 	{
-		std::lock_guard<std::mutex> Lock1(mtx);
-		std::lock_guard<std::mutex> Lock2(that.mtx);
-
-		num_outstanding = that.num_outstanding; that.num_outstanding = 0;
-		if (--num_outstanding <= 0)
-			zero_references.notify_all();
-
-		that.zero_references.notify_all();
+		store(int(that.num_outstanding.exchange(0)));
+		futex_wake_all(&that.num_outstanding);
 	}
 	return *this;
 }
 
+inline void countdown_latch::store(int n)
+{
+	num_outstanding.store(uint32_t(n));
+	if (n <= 0)
+		futex_wake_all(&num_outstanding);
+}
+
 inline int countdown_latch::outstanding() const
 {
-	return num_outstanding;
+	return count();
 }
 
 inline void countdown_latch::reset(int initial_count)
 {
-	mtx.lock();
-	num_outstanding = initial_count + 1;
-	mtx.unlock();
-	release();
+	store(initial_count);
 }
 
 inline void countdown_latch::reference()
 {
-	std::lock_guard<std::mutex> Lock(mtx);
-	if (num_outstanding <= 0)
-		throw std::runtime_error(
-		"countdown_latch::reference() called too late to keep any waiting threads "
-		"blocked. This is a race condition in client code because references are "
-		"being added after the countdown had finished. If possible, use reset or the "
-		"ctor to set an initial count beforehand and do not use reference() at all. "
-		"A classic semaphore does not have API to reference after initialization for "
-		"this very reason, but there are cases where careful coding can allow for "
-		"reference() calls to be appropriate.");
-	num_outstanding++;
+	uint32_t n = num_outstanding.load();
+	do
+	{
+		if (int(n) <= 0)
+			throw std::runtime_error(
+			"countdown_latch::reference() called too late to keep any waiting threads "
+			"blocked. This is a race condition in client code because references are "
+			"being added after the countdown had finished. If possible, use reset or the "
+			"ctor to set an initial count beforehand and do not use reference() at all. "
+			"A classic semaphore does not have API to reference after initialization for "
+			"this very reason, but there are cases where careful coding can allow for "
+			"reference() calls to be appropriate.");
+	} while (!num_outstanding.compare_exchange_weak(n, n + 1));
 }
 
 inline void countdown_latch::release()
 {
-	std::lock_guard<std::mutex> Lock(mtx);
-	if (--num_outstanding <= 0)
-		zero_references.notify_all();
+	if (int(num_outstanding.fetch_sub(1)) <= 1)
+		futex_wake_all(&num_outstanding);
 }
 
 inline void countdown_latch::wait()
 {
-	std::unique_lock<std::mutex> Lock(mtx);
-	while (num_outstanding > 0) // Guarded Suspension
-		zero_references.wait(Lock);
+	uint32_t n = num_outstanding.load();
+	while (int(n) > 0) // Guarded Suspension
+	{
+		futex_wait(&num_outstanding, n);
+		n = num_outstanding.load();
+	}
 }
 
 template<typename Rep, typename Period>
-std::cv_status::cv_status countdown_latch::wait_for(const std::chrono::duration<Rep, Period>& relative_time)
+countdown_latch::cv_status_type countdown_latch::wait_for(const std::chrono::duration<Rep, Period>& relative_time)
 {
-	std::cv_status::cv_status status = std::cv_status::no_timeout;
-	std::unique_lock<std::mutex> Lock(mtx);
-	while (std::cv_status::no_timeout == status && num_outstanding > 0) // Guarded Suspension
-		status = zero_references.wait_for(Lock, relative_time);
-	return status;
+	const std::chrono::high_resolution_clock::time_point deadline = std::chrono::high_resolution_clock::now()
+		+ std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(relative_time);
+	uint32_t n = num_outstanding.load();
+	while (int(n) > 0) // Guarded Suspension
+	{
+		const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::high_resolution_clock::now()).count();
+		if (ms <= 0)
+			return std::cv_status::timeout;
+		futex_wait_for(&num_outstanding, n, uint32_t(ms < 0x7fffffff ? ms : 0x7fffffff));
+		n = num_outstanding.load();
+	}
+	return std::cv_status::no_timeout;
 }
 
 }
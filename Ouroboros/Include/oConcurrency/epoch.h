@@ -0,0 +1,85 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Epoch-based memory reclamation for lock-free containers. A thread that may
+// dereference shared nodes holds an epoch::guard for the duration of the
+// access. A thread that unlinks a node retires it rather than freeing it, and
+// the node's reclaim function runs only once every thread that was inside a
+// guard at that time has left it. Since a retired node can't be reused while
+// anyone could still be looking at it, containers built on this need neither
+// ABA tags nor deferred-destruction flags, and nodes can go back to their
+// allocator (or the OS) as soon as it is safe.
+//
+// Retired nodes collect in a per-thread batch that is sealed with the current
+// epoch when it fills or when update() is called. The global epoch advances
+// when every guarded thread has observed it, and a sealed batch is reclaimed
+// two advances later. Threadpool workers call update() after each task through
+// update_thread() so reclamation keeps pace with the work; when nothing is
+// retired or nothing is safe yet update() returns without taking a lock.
+//
+// Reclamation returns nodes to whatever they came from. It doesn't shrink a
+// fixed node pool; a container that wants its memory to shrink after a burst
+// must take the overflow from an allocator (see concurrent_queue).
+
+#pragma once
+#include <cstdint>
+
+namespace ouro { namespace epoch {
+
+typedef void (*reclaim_fn)(void* pointer, void* context);
+
+// Marks the calling thread as possibly holding pointers to shared nodes. These
+// nest and must be balanced on the same thread. Prefer guard below.
+void enter();
+void exit();
+
+class guard
+{
+public:
+	guard() { enter(); }
+	~guard() { exit(); }
+
+private:
+	guard(const guard&); /* = delete */
+	const guard& operator=(const guard&); /* = delete */
+};
+
+// Schedules reclaim(pointer, context) to run on some thread once no thread can
+// still be holding pointer. The node must already be unreachable from the
+// shared structure. This can be called inside or outside a guard. reclaim
+// must not throw.
+void retire(void* pointer, reclaim_fn reclaim, void* context = nullptr);
+
+// Convenience for nodes allocated with new.
+namespace detail { template<typename T> void reclaim_delete(void* pointer, void*) { delete (T*)pointer; } }
+template<typename T> void retire(T* pointer) { retire(pointer, detail::reclaim_delete<T>); }
+
+// Seals the calling thread's retired nodes, tries to advance the epoch and runs
+// the reclaim functions of any nodes that have become safe. This never blocks.
+void update();
+
+// Returns true if the calling thread is inside a guard, where synchronize()
+// would deadlock.
+bool guarded();
+
+// Blocks until every node retired by any thread before this call has been
+// reclaimed. Call this before freeing memory that retired nodes point into,
+// such as a container's node pool. This must not be called inside a guard.
+void synchronize();
+
+// For deferring work that must happen on a specific thread: take a ticket
+// after unlinking a node and poll expired() until it returns true, at which
+// point no guarded thread can still hold the node. expired() also tries to
+// advance the epoch so polling makes progress.
+uint32_t ticket();
+bool expired(uint32_t ticket);
+
+// Hands the calling thread's bookkeeping back for reuse by a future thread.
+// Call this as a thread exits; it is not needed for correctness but otherwise
+// the record is never reused.
+void release_thread();
+
+// Returns the number of retired nodes not yet reclaimed. This is only a
+// snapshot and should be used for reporting and tests.
+uint32_t num_pending();
+
+}}
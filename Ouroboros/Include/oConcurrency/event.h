@@ -1,17 +1,19 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 
-// A cross-platform event built on condition_variable, which is basically how 
-// the Window's event is implemented. This supports the "WaitMultiple" concept 
-// by storing a 32-bit mask of bools, rather than just one bool like the Windows 
-// event API suggests. Event flags can be defined then tested as appropriate. 
-// The wait_any() APIs are more like WaitSingle. In more complex cases use 
-// condition_variables directly. Using this implementation as a reference but 
-// quite often an event is enough. NOTE: For a trivial bool-like event, just use 
-// default parameters.
+// A cross-platform event in the manner of the Windows event. This supports the
+// "WaitMultiple" concept by storing a 32-bit mask of bools, rather than just
+// one bool like the Windows event API suggests. Event flags can be defined then
+// tested as appropriate. The wait_any() APIs are more like WaitSingle. In more
+// complex cases use condition_variables directly. Using this implementation as
+// a reference but quite often an event is enough. NOTE: For a trivial bool-like
+// event, just use default parameters. Waiters park on a futex that every set()
+// bumps, so set() makes no syscall when no one is waiting.
 
 #pragma once
-#include <condition_variable>
-#include <mutex>
+#include <oConcurrency/futex.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
 namespace ouro {
 
@@ -75,109 +77,154 @@ public:
 	bool is_any_set(int mask = 1) const;
 
 private:
-	std::mutex mtx;
-	std::condition_variable cv;
-	int set_mask;
+	std::atomic<uint32_t> set_mask;
+	std::atomic<uint32_t> pulse_mask; // the mask of the last set() of an autoreset event
+	std::atomic<uint32_t> seq; // futex word bumped by set()
+	std::atomic<uint32_t> num_waiters;
 	bool do_auto_reset;
+
+	static const uint32_t infinite = ~0u;
+
+	// Blocks until the mask is satisfied or timeout_ms elapses. Returns false on
+	// timeout, otherwise out_mask is the event mask that satisfied the wait.
+	bool wait_ms(int mask, bool any, uint32_t timeout_ms, int& out_mask);
+
+	template <typename Rep, typename Period>
+	static uint32_t to_ms(const std::chrono::duration<Rep, Period>& relative_time)
+	{
+		const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(relative_time).count();
+		return ms <= 0 ? 0 : (ms >= infinite ? (infinite - 1) : uint32_t(ms));
+	}
+
+	event(const event&); /* = delete */
+	const event& operator=(const event&); /* = delete */
 };
 
 inline event::event()
-	: set_mask(0)
-	, do_auto_reset(false)
-{}
+	: do_auto_reset(false)
+{
+	set_mask = 0;
+	pulse_mask = 0;
+	seq = 0;
+	num_waiters = 0;
+}
 
 inline event::event(autoreset_t auto_reset)
-	: set_mask(0)
-	, do_auto_reset(true)
-{}
+	: do_auto_reset(true)
+{
+	set_mask = 0;
+	pulse_mask = 0;
+	seq = 0;
+	num_waiters = 0;
+}
 
 inline void event::set(int mask)
 {
-	if (!is_set(mask))
+	if (do_auto_reset)
+		pulse_mask.store(uint32_t(mask));
+	else
 	{
-		if (do_auto_reset)
-			cv.notify_one();
-		else
-		{
-			mtx.lock();
-			set_mask |= mask;
-			mtx.unlock();
-			cv.notify_all();
-		}
+		const uint32_t old = set_mask.fetch_or(uint32_t(mask));
+		if ((old & uint32_t(mask)) == uint32_t(mask))
+			return;
 	}
+
+	// a waiter counts itself before reading the mask, so either it sees this
+	// set() or this sees it waiting
+	seq.fetch_add(1);
+	if (num_waiters.load())
+		futex_wake_all(&seq);
 }
 
 inline void event::reset(int mask)
 {
-	std::lock_guard<std::mutex> lock(mtx);
-	set_mask &=~ mask;
+	set_mask.fetch_and(~uint32_t(mask));
+}
+
+inline bool event::wait_ms(int mask, bool any, uint32_t timeout_ms, int& out_mask)
+{
+	const std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	num_waiters.fetch_add(1);
+	const uint32_t start_seq = seq.load();
+	uint32_t s = start_seq;
+	bool satisfied = false;
+	for (;;)
+	{
+		// an autoreset event is only ever set by a pulse during the wait
+		const int m = do_auto_reset ? (s != start_seq ? int(pulse_mask.load()) : 0) : int(set_mask.load());
+		if (any ? !!(m & mask) : ((m & mask) == mask))
+		{
+			out_mask = m;
+			satisfied = true;
+			break;
+		}
+
+		if (timeout_ms == infinite)
+			futex_wait(&seq, s);
+		else
+		{
+			const uint32_t elapsed = to_ms(std::chrono::high_resolution_clock::now() - start);
+			if (elapsed >= timeout_ms)
+				break;
+			futex_wait_for(&seq, s, timeout_ms - elapsed);
+		}
+		s = seq.load();
+	}
+	num_waiters.fetch_sub(1);
+	return satisfied;
 }
 
 inline void event::wait(int mask)
 {
-	std::unique_lock<std::mutex> lock(mtx);
-	while (!is_set(mask))
-		cv.wait(lock);
+	int m;
+	wait_ms(mask, false, infinite, m);
 }
 
 inline int event::wait_any(int mask)
 {
-	std::unique_lock<std::mutex> lock(mtx);
-	while (!is_any_set(mask))
-		cv.wait(lock);
-	return set_mask;
+	int m = 0;
+	wait_ms(mask, true, infinite, m);
+	return m;
 }
 
 template <typename Clock, typename Duration>
 inline bool event::wait_until(
 	const std::chrono::time_point<Clock, Duration>& absolute_time, int mask)
 {
-	std::unique_lock<std::mutex> lock(mtx);
-	while (!is_set(mask))
-		if (ouro::cv_status::timeout == cv.wait_until(lock, absolute_time))
-			return false;
-	return true;
+	int m;
+	return wait_ms(mask, false, to_ms(absolute_time - Clock::now()), m);
 }
 
 template <typename Clock, typename Duration>
 inline int event::wait_until_any(
 	const std::chrono::time_point<Clock, Duration>& absolute_time, int mask)
 {
-	std::unique_lock<std::mutex> lock(mtx);
-	while (!is_any_set(mask))
-		if (ouro::cv_status::timeout == cv.wait_until(lock, absolute_time))
-			return 0;
-	return set_mask;
+	int m = 0;
+	return wait_ms(mask, true, to_ms(absolute_time - Clock::now()), m) ? m : 0;
 }
 
 template <typename Rep, typename Period>
 inline bool event::wait_for(const std::chrono::duration<Rep, Period>& relative_time, int mask)
 {
-	std::unique_lock<std::mutex> lock(mtx);
-	while (!is_set(mask))
-		if (std::cv_status::timeout == cv.wait_for(lock, relative_time))
-			return false;
-	return true;
+	int m;
+	return wait_ms(mask, false, to_ms(relative_time), m);
 }
 
 template <typename Rep, typename Period>
 inline int event::wait_for_any(const std::chrono::duration<Rep, Period>& relative_time, int mask)
 {
-	std::unique_lock<std::mutex> lock(mtx);
-	while (!is_any_set(mask))
-		if (ouro::cv_status::timeout == cv.wait_for(lock, relative_time))
-			return 0;
-	return set_mask;
+	int m = 0;
+	return wait_ms(mask, true, to_ms(relative_time), m) ? m : 0;
 }
 
 inline bool event::is_set(int mask) const
 {
-	return (set_mask & mask) == mask;
+	return (int(set_mask.load()) & mask) == mask;
 }
 
 inline bool event::is_any_set(int mask) const
 {
-	return !!(set_mask & mask);
+	return !!(int(set_mask.load()) & mask);
 }
 
 }
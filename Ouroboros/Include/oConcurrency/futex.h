@@ -0,0 +1,30 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Wait-on-address primitives: a thread parks on a 32-bit atomic as long as it
+// holds an expected value and another thread wakes it after changing the
+// value. This is the slow path under mutex, shared_mutex, event and
+// countdown_latch; the fast paths are plain atomics. On Linux this is the
+// futex syscall. Elsewhere waiters park on one of a fixed set of mutex and
+// condition_variable buckets hashed by address.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace ouro {
+
+// Blocks the calling thread while *addr == expected. This can return
+// spuriously, so callers must recheck their condition.
+void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected);
+
+// Like futex_wait, but gives up after timeout_ms milliseconds. Returns false
+// if the timeout elapsed.
+bool futex_wait_for(std::atomic<uint32_t>* addr, uint32_t expected, uint32_t timeout_ms);
+
+// Wakes at most one thread waiting on addr.
+void futex_wake_one(std::atomic<uint32_t>* addr);
+
+// Wakes every thread waiting on addr.
+void futex_wake_all(std::atomic<uint32_t>* addr);
+
+}
@@ -11,12 +11,16 @@
 #include <oConcurrency/concurrency.h>
 #include <oMemory/std_allocator.h>
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <exception>
+#include <iterator>
 #include <memory>
 #include <mutex>
 #include <system_error>
+#include <type_traits>
+#include <vector>
 
 // Vardiatic templates replaces this, but until they're available use callable
 // macros even though it pokes back into oBase.
@@ -42,8 +46,18 @@ public:
 template<typename T> class future;
 template<typename T> class promise;
 
+// The result of when_any: the index of the first future to become ready and 
+// all the futures passed to when_any, in order.
+template<typename SequenceT> struct when_any_result
+{
+	size_t index;
+	SequenceT futures;
+};
+
 namespace future_detail {
 
+	struct future_access;
+
 	template<typename T> struct commitment_allocator
 	{
 		oDEFINE_STD_ALLOCATOR_BOILERPLATE(commitment_allocator)
@@ -126,7 +140,7 @@ namespace future_detail {
 			ex = e;
 			state.except = true;
 			state.except_at_thread_exit = true;
-			state.ready = true;
+			make_ready(lock);
 		}
 
 		void set_exception_at_thread_exit(std::exception_ptr e)
@@ -144,6 +158,26 @@ namespace future_detail {
 			task->run(t);
 		}
 
+		// Runs t once this commitment is ready: right away if it already is,
+		// otherwise from the thread that makes it ready. Unless run_inline is 
+		// true t is dispatched to the scheduler rather than called directly so
+		// long continuation chains never block or deepen the stack of the 
+		// thread that fulfilled the promise.
+		void add_continuation(const std::function<void()>& t, bool run_inline = false)
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			if (!is_ready())
+			{
+				continuation c;
+				c.task = t;
+				c.run_inline = run_inline;
+				continuations.push_back(c);
+				return;
+			}
+			lock.unlock();
+			run_continuation(t, run_inline);
+		}
+
 		void set_future_attached()
 		{
 			std::unique_lock<std::mutex> lock(mtx);
@@ -170,11 +204,8 @@ namespace future_detail {
 
 		void set_void_value()
 		{
-			//std::unique_lock<std::mutex> lock(mtx); // no lock required for this trivial case
-			state.ready = true;
-			//lock.unlock();
-			if (!task)
-				CV.notify_all();
+			std::unique_lock<std::mutex> lock(mtx);
+			make_ready(lock);
 		}
 
 		template<typename T, typename U> void internal_set_value_ref(void* out_mem, const U& val)
@@ -186,10 +217,7 @@ namespace future_detail {
 				throw future_error(future_errc::no_implementation);
 			*(T**)out_mem = &const_cast<U&>(val);
 			state.value = true;
-			state.ready = true;
-			lock.unlock();
-			if (!task)
-				CV.notify_all();
+			make_ready(lock);
 		}
 
 		template<typename T, typename U> void internal_set_value(void* out_mem, const U& val)
@@ -201,7 +229,7 @@ namespace future_detail {
 				throw future_error(future_errc::no_implementation);
 			::new(out_mem) T(val);
 			state.value = true;
-			state.ready = true;
+			make_ready(lock);
 		}
 
 		template<typename T, typename U> void internal_set_value(void* out_mem, U&& val)
@@ -213,7 +241,7 @@ namespace future_detail {
 				throw future_error(future_errc::no_implementation);
 			::new(out_mem) T(std::forward<U>(val));
 			state.value = true;
-			state.ready = true;
+			make_ready(lock);
 		}
 		
 		template <typename T, typename U> void set_value_at_thread_exit(void* out_mem, U&& val)
@@ -257,11 +285,42 @@ protected:
 			bool ready:1;
 		};
 
+		struct continuation
+		{
+			std::function<void()> task;
+			bool run_inline;
+		};
+
+		typedef std::vector<continuation, commitment_allocator<continuation>> continuation_list;
+
 		task_group* task;
 		mutable std::mutex mtx;
 		std::condition_variable CV;
 		state_t state;
 		std::exception_ptr ex;
+		continuation_list continuations;
+
+		static void run_continuation(const std::function<void()>& t, bool run_inline)
+		{
+			if (run_inline)
+				t();
+			else
+				ouro::dispatch(t);
+		}
+
+		// Flags the commitment as ready, releases the lock, wakes any waiters and
+		// runs any continuations. The lock must be held by the caller.
+		void make_ready(std::unique_lock<std::mutex>& lock)
+		{
+			state.ready = true;
+			continuation_list ready_continuations;
+			ready_continuations.swap(continuations);
+			lock.unlock();
+			if (!task)
+				CV.notify_all();
+			for (auto it = ready_continuations.begin(); it != ready_continuations.end(); ++it)
+				run_continuation(it->task, it->run_inline);
+		}
 	};
 
 	template<typename T> class commitment_t : public commitment_base<commitment_t<T>>
@@ -353,6 +412,13 @@ protected:
 				- chrono::high_resolution_clock::now();
 			return wait_for(duration);
 		}
+
+		// Schedules continuation to run with this future once it is ready and 
+		// returns a future for the continuation's result. The continuation 
+		// receives this (now ready) future by value so get() will not block and 
+		// rethrows any exception. This future is no longer valid after the call.
+		template<typename F>
+		future<typename std::result_of<F(DerivedT)>::type> then(const F& continuation);
 		
 	private:
 		DerivedT* This() { return static_cast<DerivedT*>(this); }
@@ -379,6 +445,7 @@ protected:
 	// interfaces need direct access to the commitment, or act as a factor for a 
 	// future, so centralize this access here between the template types for future.
 	#define oFUTURE_COMMON(commitment_type) public: future() {} ~future() {} oFUTURE_MOVE_CTOR(future) \
+		typedef std::shared_ptr<future_detail::commitment_t<commitment_type>> commitment_pointer; \
 		future(const std::shared_ptr<future_detail::commitment_t<commitment_type>>& c) : commitment(c) \
 		{	if (commitment->has_future()) \
 				throw future_error(future_errc::future_already_retrieved); \
@@ -386,6 +453,7 @@ protected:
 		} \
 		protected: std::shared_ptr<future_detail::commitment_t<commitment_type>> commitment; \
 		template <typename> friend class future_detail::future_base; \
+		friend struct future_detail::future_access; \
 		template <typename> friend class promise; \
 		template <typename> friend class shared_future; \
 		template <typename> friend class packaged_task; \
@@ -471,7 +539,168 @@ namespace future_detail {
 	inline void fulfill_promise_helper(promise<result_type>& p, std::function<result_type(void)>& f) { p.set_value(f()); }
 	template<> 
 	inline void fulfill_promise_helper<void>(promise<void>& p, std::function<void(void)>& f) { f(); p.set_value(); }
-};
+
+	// Allows continuations to move commitments in and out of futures without
+	// going through the once-only get_future() checks.
+	struct future_access
+	{
+		template<typename FutureT> static FutureT adopt(const typename FutureT::commitment_pointer& c) { FutureT f; f.commitment = c; return f; }
+		template<typename FutureT> static typename FutureT::commitment_pointer release(FutureT& f) { return std::move(f.commitment); }
+	};
+
+	template<typename result_type> struct continuation_helper
+	{
+		template<typename F, typename FutureT> static void fulfill(promise<result_type>& p, F& f, FutureT& ready) { p.set_value(f(std::move(ready))); }
+	};
+
+	template<> struct continuation_helper<void>
+	{
+		template<typename F, typename FutureT> static void fulfill(promise<void>& p, F& f, FutureT& ready) { f(std::move(ready)); p.set_value(); }
+	};
+
+	template<typename DerivedT>
+	template<typename F>
+	future<typename std::result_of<F(DerivedT)>::type> future_base<DerivedT>::then(const F& continuation)
+	{
+		oFUTURE_VALIDATE();
+		typedef typename std::result_of<F(DerivedT)>::type result_type;
+		typedef commitment_t<result_type> next_commitment_type;
+
+		auto c = future_access::release(*This());
+		std::shared_ptr<next_commitment_type> next = std::allocate_shared<next_commitment_type>(commitment_allocator<next_commitment_type>());
+		future<result_type> next_future(next);
+
+		F f(continuation);
+		c->add_continuation([=]() mutable
+		{
+			promise<result_type> p(next);
+			try
+			{
+				DerivedT ready = future_access::adopt<DerivedT>(c);
+				continuation_helper<result_type>::fulfill(p, f, ready);
+			}
+			catch (...) { p.set_exception(std::current_exception()); }
+		});
+
+		return next_future;
+	}
+
+	template<typename FutureT> struct when_all_state
+	{
+		typedef typename FutureT::commitment_pointer commitment_ptr;
+		typedef std::vector<FutureT> sequence_type;
+		typedef commitment_t<sequence_type> result_commitment_type;
+
+		std::vector<commitment_ptr, commitment_allocator<commitment_ptr>> commitments;
+		std::atomic<size_t> remaining;
+		std::shared_ptr<result_commitment_type> result;
+
+		void fulfill()
+		{
+			sequence_type futures;
+			futures.reserve(commitments.size());
+			for (auto it = commitments.begin(); it != commitments.end(); ++it)
+				futures.push_back(future_access::adopt<FutureT>(*it));
+			commitments.clear();
+			promise<sequence_type>(result).set_value(std::move(futures));
+		}
+	};
+
+	template<typename FutureT> struct when_any_state
+	{
+		typedef typename FutureT::commitment_pointer commitment_ptr;
+		typedef when_any_result<std::vector<FutureT>> result_type;
+		typedef commitment_t<result_type> result_commitment_type;
+
+		std::vector<commitment_ptr, commitment_allocator<commitment_ptr>> commitments;
+		std::atomic_flag done;
+		std::shared_ptr<result_commitment_type> result;
+
+		void fulfill(size_t index)
+		{
+			result_type r;
+			r.index = index;
+			r.futures.reserve(commitments.size());
+			for (auto it = commitments.begin(); it != commitments.end(); ++it)
+				r.futures.push_back(future_access::adopt<FutureT>(*it));
+			commitments.clear();
+			promise<result_type>(result).set_value(std::move(r));
+		}
+	};
+
+} // namespace future_detail
+
+// Returns a future that becomes ready once all futures in [first,last) are 
+// ready. Its value is those futures, in order and ready, so their values and 
+// exceptions can be retrieved without blocking. The futures in the range are
+// moved from and thus no longer valid.
+template<typename InputIt>
+future<std::vector<typename std::iterator_traits<InputIt>::value_type>> when_all(InputIt first, InputIt last)
+{
+	typedef typename std::iterator_traits<InputIt>::value_type future_type;
+	typedef future_detail::when_all_state<future_type> state_type;
+	typedef typename state_type::result_commitment_type result_commitment_type;
+
+	std::shared_ptr<state_type> state = std::allocate_shared<state_type>(future_detail::commitment_allocator<state_type>());
+	state->result = std::allocate_shared<result_commitment_type>(future_detail::commitment_allocator<result_commitment_type>());
+	future<typename state_type::sequence_type> result(state->result);
+
+	for (; first != last; ++first)
+	{
+		if (!first->valid())
+			throw future_error(future_errc::no_state);
+		state->commitments.push_back(future_detail::future_access::release(*first));
+	}
+
+	// one extra count so nothing can complete before all continuations are added
+	state->remaining = state->commitments.size() + 1;
+	for (auto it = state->commitments.begin(); it != state->commitments.end(); ++it)
+		(*it)->add_continuation([=] { if (--state->remaining == 0) state->fulfill(); }, true);
+
+	if (--state->remaining == 0)
+		state->fulfill();
+
+	return result;
+}
+
+// Returns a future that becomes ready once any future in [first,last) is 
+// ready. Its value is the index of that future and all of the futures, in 
+// order. The futures in the range are moved from and thus no longer valid.
+template<typename InputIt>
+future<when_any_result<std::vector<typename std::iterator_traits<InputIt>::value_type>>> when_any(InputIt first, InputIt last)
+{
+	typedef typename std::iterator_traits<InputIt>::value_type future_type;
+	typedef future_detail::when_any_state<future_type> state_type;
+	typedef typename state_type::result_commitment_type result_commitment_type;
+
+	std::shared_ptr<state_type> state = std::allocate_shared<state_type>(future_detail::commitment_allocator<state_type>());
+	state->done.clear();
+	state->result = std::allocate_shared<result_commitment_type>(future_detail::commitment_allocator<result_commitment_type>());
+	future<typename state_type::result_type> result(state->result);
+
+	for (; first != last; ++first)
+	{
+		if (!first->valid())
+			throw future_error(future_errc::no_state);
+		state->commitments.push_back(future_detail::future_access::release(*first));
+	}
+
+	// an empty range is never satisfied by a future, so it's ready immediately
+	if (state->commitments.empty())
+	{
+		if (!state->done.test_and_set())
+			state->fulfill(size_t(-1));
+		return result;
+	}
+
+	// hold a copy of the commitments: the first continuation to fire clears the
+	// state's list into the result's futures.
+	std::vector<typename state_type::commitment_ptr> commitments(state->commitments.begin(), state->commitments.end());
+	for (size_t i = 0; i < commitments.size(); i++)
+		commitments[i]->add_continuation([=] { if (!state->done.test_and_set()) state->fulfill(i); }, true);
+
+	return result;
+}
 
 #ifdef oHAS_VARIADIC_TEMPLATES
 	#error reimplement packaged_task using variadic templates
@@ -518,7 +747,7 @@ namespace future_detail {
 		Callable func; \
 		\
 		static void fulfill_promise(promise<result_type> p, std::function<result_type(void)> f) \
-		{ try { future_detail::fulfill_promise_helper(p, f); } catch (std::exception&) { p.set_exception(std::current_exception()); } } \
+		{ try { future_detail::fulfill_promise_helper(p, f); } catch (...) { p.set_exception(std::current_exception()); } } \
 	};
 	oCALLABLE_PROPAGATE(oPACKAGEDTASK)
 #endif
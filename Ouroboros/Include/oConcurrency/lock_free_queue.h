@@ -70,8 +70,8 @@ public:
 private:
 	value_type* elements;
 	size_type wrap_mask;
-	volatile size_type read;
-	volatile size_type write;
+	std::atomic<size_type> read;
+	std::atomic<size_type> write;
 	allocator alloc;
 };
 
@@ -113,7 +113,7 @@ void lock_free_queue<T>::initialize(size_type capacity, const char* label, const
 	if (capacity & (capacity-1))
 		throw std::invalid_argument("capacity must be a power of two");
 	alloc = a;
-	elements = alloc.allocate(calc_size(capacity), memory_alignment::align_default, label);
+	elements = (value_type*)alloc.allocate(calc_size(capacity), memory_alignment::align_default, label);
 	read = write = 0;	
 	wrap_mask = capacity - 1;
 }
@@ -123,7 +123,7 @@ void lock_free_queue<T>::initialize(void* memory, size_type capacity)
 {
 	if (capacity & (capacity-1))
 		throw std::invalid_argument("capacity must be a power of two");
-	elements = memory;
+	elements = (value_type*)memory;
 	read = write = 0;	
 	wrap_mask = capacity - 1;
 	alloc = noop_allocator;
@@ -144,21 +144,19 @@ void* lock_free_queue<T>::deinitialize()
 template<typename T>
 typename lock_free_queue<T>::size_type lock_free_queue<T>::size() const
 {
-	return ((write + wrap_mask) - read) & wrap_mask;
+	return (write - read) & wrap_mask;
 }
 
 template<typename T>
 void lock_free_queue<T>::push(const_reference val)
 {
-	size_type r = read;
-	size_type w = write;
+	size_type r = read.load(std::memory_order_acquire);
+	size_type w = write.load(std::memory_order_relaxed);
 
 	if (((w+1) & wrap_mask) != r)
 	{
-		std::atomic_thread_fence(std::memory_order_seq_cst);
 		elements[w++] = val;
-		std::atomic_thread_fence(std::memory_order_seq_cst);
-		write = w & wrap_mask;
+		write.store(w & wrap_mask, std::memory_order_release);
 	}
 
 	else
@@ -169,16 +167,14 @@ template<typename T>
 bool lock_free_queue<T>::try_pop(reference val)
 {
 	bool popped = false;
-	size_type r = read;
-	size_type w = write;
+	size_type r = read.load(std::memory_order_relaxed);
+	size_type w = write.load(std::memory_order_acquire);
 
 	if (r != w)
 	{
-		std::atomic_thread_fence(std::memory_order_seq_cst);
 		val = elements[r];
 		elements[r++].~value_type();
-		std::atomic_thread_fence(std::memory_order_seq_cst);
-		read = r & wrap_mask;
+		read.store(r & wrap_mask, std::memory_order_release);
 		popped = true;
 	}
 
@@ -1,10 +1,18 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 
-// Approximation of the upcoming C++1x std::mutex objects.
+// Approximation of the upcoming C++1x std::mutex objects. On Windows these wrap
+// the native slim reader/writer lock, critical section and init-once objects.
+// On Linux they are built on futex: an uncontended lock or unlock is one atomic
+// operation and a contended lock spins briefly before parking the thread.
 
 #pragma once
+#include <oCompiler.h>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
 #include <thread>
 
 // To keep the main classes neat, collect all the platform-specific forward
@@ -28,6 +36,8 @@ namespace ouro {
 	protected:
 		#if defined(_WIN32) || defined(_WIN64)
 			void* footprint;
+		#elif defined(__linux__)
+			std::atomic<uint32_t> state; // 0 unlocked, 1 locked, 2 locked and contended
 		#else
 			#error unsupported platform (mutex)
 		#endif
@@ -40,16 +50,44 @@ namespace ouro {
 		mutex& operator=(const mutex&); /* = delete */
 	};
 
-	class shared_mutex : public mutex
+	// A writer-preferring reader/writer lock. Readers count themselves on one of
+	// several cache-line sized stripes picked per thread, so concurrent readers
+	// don't write to the same cache line and only read the writer flag. A writer
+	// raises the flag, which turns new readers away, then waits for the stripes
+	// to drain. Writers are serialized by a mutex.
+	class shared_mutex
 	{
 	public:
-		shared_mutex() {}
+		shared_mutex();
+		~shared_mutex();
+
+		void lock();
+		bool try_lock();
+		void unlock();
 
 		void lock_shared();
 		bool try_lock_shared();
 		void unlock_shared();
 
 	private:
+		static const uint32_t num_stripes = 8;
+
+		struct stripe
+		{
+			std::atomic<uint32_t> readers;
+			char pad[oCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+		};
+
+		stripe stripes[num_stripes];
+		std::atomic<uint32_t> writer; // 0 none, 1 a writer holds or waits for the lock, 2 and readers are parked
+		char pad[oCACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+		std::atomic<uint32_t> departures; // bumped by readers leaving while a writer waits
+		mutex writers;
+
+		uint32_t num_readers() const;
+		void wait_for_readers();
+		void reader_departed();
+
 		shared_mutex(const shared_mutex&); /* = delete */
 		shared_mutex& operator=(const shared_mutex&); /* = delete */
 	};
@@ -72,6 +110,10 @@ namespace ouro {
 			mutable unsigned long long footprint[5]; // RTL_CRITICAL_SECTION
 		#elif defined(_WIN32)
 			mutable unsigned int footprint[6];
+		#elif defined(__linux__)
+			mutex mtx;
+			std::atomic<const void*> owner;
+			uint32_t count;
 		#else
 			#error unsupported platform (recursive_mutex)
 		#endif
@@ -99,9 +141,7 @@ namespace ouro {
 		template<typename Clock, typename Duration>
 		bool try_lock_until(std::chrono::time_point<Clock,Duration> const& absolute_time)
 		{
-			auto duration = time_point_cast<std::chrono::high_resolution_clock::time_point>(absolute_time) - 
-				std::chrono::high_resolution_clock::now();
-			return try_lock_until(duration);
+			return try_lock_for(absolute_time - Clock::now());
 		}
 
 	private:
@@ -283,6 +323,9 @@ namespace ouro {
 	private:
 		#if defined(_WIN32) || defined(_WIN64)
 			void* footprint;
+		#elif defined(__linux__)
+			std::atomic<uint32_t> state; // 0 not run, 1 running, 2 done
+			friend void call_once(once_flag& flag, const std::function<void()>& fn);
 		#else
 			#error unsupported platform (once_flag)
 		#endif
@@ -290,5 +333,5 @@ namespace ouro {
 		once_flag& operator=(const once_flag&);
 	};
 
-	void call_once(once_flag& flag, const std::function<void>& fn);
+	void call_once(once_flag& flag, const std::function<void()>& fn);
 }
@@ -0,0 +1,119 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// A directed acyclic graph of tasks that is built once and then run many times
+// (i.e. once per frame or per batch) on ouro::dispatch. Each node runs only
+// after all its predecessors have completed. Nodes are prioritized by the
+// length of the critical path from them to the end of the graph: when a node
+// completes, the thread that ran it continues directly with its most critical
+// ready successor and dispatches the rest in ascending priority, so a
+// scheduler that pops its own thread's tasks LIFO runs the more critical ones
+// first. Path lengths start from user-supplied cost estimates and are updated
+// with the measured duration of each node after every run.
+
+#pragma once
+#include <oConcurrency/countdown_latch.h>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ouro {
+
+class task_graph
+{
+public:
+	typedef unsigned int node_id;
+	static const node_id invalid_node = ~0u;
+
+	typedef std::function<void(const std::function<void()>& task)> dispatcher_type;
+
+	// Times are in seconds relative to the start of the last run().
+	struct node_timing
+	{
+		node_timing() : start(0.0), end(0.0) {}
+		double start;
+		double end;
+	};
+
+
+	// non-concurrent api
+
+	// Nodes are run with dispatcher, or ouro::dispatch if it is empty.
+	explicit task_graph(const dispatcher_type& dispatcher = dispatcher_type());
+	~task_graph();
+
+	// Adds a node that will execute task. cost_estimate is only relative to
+	// other nodes' estimates and is used to prioritize the first run;
+	// subsequent runs use measured durations.
+	node_id add(const char* name, const std::function<void()>& task, double cost_estimate = 1.0);
+
+	// Declares that after can only run once before has completed.
+	void precede(node_id before, node_id after);
+
+	// Validates the graph and prepares it for running. This is called by run()
+	// if the graph has changed since the last call. Throws if the graph has a
+	// cycle.
+	void finalize();
+
+	// Executes all nodes and blocks until they have completed. If any node
+	// throws, nodes that have not yet started are skipped and the first
+	// exception is rethrown here.
+	void run();
+
+	// Returns the number of nodes in the graph.
+	size_t size() const { return nodes.size(); }
+
+	// Returns the name the node was added with.
+	const char* name(node_id node) const;
+
+	// Returns the start and end of the node during the last run().
+	const node_timing& timing(node_id node) const;
+
+	// Returns the length of the critical path of the last run() based on
+	// measured node durations.
+	double critical_path_seconds() const;
+
+	// Returns the wall-clock duration of the last run().
+	double last_run_seconds() const { return last_run; }
+
+private:
+	struct node
+	{
+		std::string name;
+		std::function<void()> task;
+		std::vector<node_id> successors; // sorted by descending priority
+		unsigned int num_predecessors;
+		double cost;
+		double priority; // cost of the longest path from this node to the end
+		node_timing timing;
+	};
+
+	std::vector<node> nodes;
+	std::vector<node_id> roots; // sorted by descending priority
+	std::vector<node_id> topological_order;
+	dispatcher_type dispatcher;
+	std::unique_ptr<std::atomic<unsigned int>[]> pending;
+	std::atomic<size_t> remaining;
+	std::atomic<bool> failed;
+	std::mutex exception_mtx;
+	std::exception_ptr first_exception;
+	countdown_latch done;
+	std::atomic<bool> released; // set after done.release() returns
+	std::chrono::high_resolution_clock::time_point run_start;
+	double last_run;
+	bool finalized;
+
+	double seconds_since_start() const;
+	void prioritize();
+	void dispatch(node_id n);
+	void execute(node_id n);
+
+	task_graph(const task_graph&); /* = delete */
+	const task_graph& operator=(const task_graph&); /* = delete */
+};
+
+}
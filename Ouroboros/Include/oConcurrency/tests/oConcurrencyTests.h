@@ -7,8 +7,12 @@
 
 namespace ouro { class test_services; namespace tests {
 
+void TESTbroadcast_queue(test_services& services);
+void TESTconcurrent_bounded_queue(test_services& services);
+void TESTconcurrent_growable_hash_map(test_services& services);
 void TESTconcurrent_hash_map(test_services& services);
 void TESTconcurrent_queue(test_services& services);
+void TESTconcurrent_queue_comparison(test_services& services);
 void TESTconcurrent_queue_concrt(test_services& services);
 void TESTconcurrent_queue_opt(test_services& services);
 void TESTconcurrent_queue_tbb(test_services& services);
@@ -16,8 +20,13 @@ void TESTconcurrent_stack(test_services& services);
 void TESTcoroutine(test_services& services);
 void TESTcountdown_latch(test_services& services);
 void TESTdate(test_services& services);
+void TESTepoch(test_services& services);
+void TESTevent(test_services& services);
 void TESTfuture(test_services& services);
+void TESTmutex(test_services& services);
 void TESTparallel_for(test_services& services);
+void TESTshared_mutex(test_services& services);
+void TESTtask_graph(test_services& services);
 void TESTtask_group(test_services& services);
 void TESTthreadpool(test_services& services);
 void TESTthreadpool_perf(test_services& services);
@@ -6,6 +6,8 @@
 #pragma once
 #include <oConcurrency/backoff.h>
 #include <oConcurrency/countdown_latch.h>
+#include <oConcurrency/epoch.h>
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <deque>
@@ -24,10 +26,10 @@ struct threadpool_default_traits
 
 	// called after each call to a dispatched user task()
 	// (intended for RCU callouts)
-	static void update_thread() {}
+	static void update_thread() { epoch::update(); }
 
 	// called once after worker thread main loop exits
-	static void end_thread() {}
+	static void end_thread() { epoch::release_thread(); }
 };
 
 namespace detail { template<typename Traits, typename Alloc = std::allocator<std::function<void()>>> class task_group; }
@@ -55,6 +57,9 @@ public:
 	// Blocks until all workers are joined.
 	void join();
 
+	// Returns the number of worker threads.
+	size_t num_workers() const { return workers.size(); }
+
 protected:
 	template<typename, typename> friend class detail::task_group;
 	std::vector<std::thread> workers;
@@ -319,7 +324,7 @@ template<typename Traits, typename Alloc>
 inline void thread_local_parallel_for(task_group<Traits, Alloc>& group, size_t begin, size_t end, const std::function<void(size_t index)>& task)
 {
 	for (; begin < end; begin++)
-		group.run(std::bind(task, begin));
+		task(begin);
 }
 
 template<size_t WorkChunkSize /* = 16*/, typename Traits, typename Alloc>
@@ -334,5 +339,48 @@ inline void parallel_for(threadpool<Traits, Alloc>& pool, size_t begin, size_t e
 	g.wait();
 }
 
+// Returns a grain size that results in a few chunks per worker so there's 
+// slack for load balancing without a task per index.
+inline size_t calc_grain_size(size_t range, size_t num_workers)
+{
+	static const size_t kChunksPerWorker = 4;
+	return std::max(size_t(1), range / (std::max(size_t(1), num_workers) * kChunksPerWorker));
+}
+
+// Recursively splits [begin,end) in half, running the upper half as a new task
+// until the range is no larger than grain_size, then runs task on what's left.
+// When a range executes on a thread other than the one that split it, it was 
+// picked up by an idle worker so it's allowed to split finer, up to 
+// extra_splits times (similar to TBB's auto_partitioner).
+template<typename TaskGroupT>
+void parallel_for_range_split(TaskGroupT& group, size_t begin, size_t end, size_t grain_size, unsigned int extra_splits, std::thread::id splitter, const std::function<void(size_t begin, size_t end)>& task)
+{
+	const std::thread::id self = std::this_thread::get_id();
+	if (splitter != self && extra_splits && grain_size > 1)
+	{
+		grain_size /= 2;
+		extra_splits--;
+	}
+
+	while ((end - begin) > grain_size)
+	{
+		const size_t mid = begin + (end - begin) / 2;
+		group.run([=,&group,&task] { parallel_for_range_split(group, mid, end, grain_size, extra_splits, self, task); });
+		end = mid;
+	}
+
+	task(begin, end);
+}
+
+template<typename Traits, typename Alloc>
+inline void parallel_for_range(threadpool<Traits, Alloc>& pool, size_t begin, size_t end, const std::function<void(size_t begin, size_t end)>& task)
+{
+	if (begin >= end)
+		return;
+	task_group<Traits, Alloc> g(pool);
+	parallel_for_range_split(g, begin, end, calc_grain_size(end - begin, pool.num_workers()), 2, std::this_thread::get_id(), task);
+	g.wait();
+}
+
 	}
 }
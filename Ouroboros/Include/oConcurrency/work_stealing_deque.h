@@ -0,0 +1,216 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Single-owner, multi-thief deque based on:
+// Chase, Lev. "Dynamic Circular Work-Stealing Deque" (SPAA 2005) with the
+// memory ordering of Le, Pop, Cohen, Zappa Nardelli. "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (PPoPP 2013).
+// The owning thread pushes and pops at the bottom (LIFO) without any atomic
+// read-modify-write except when racing a thief for the last element. Any
+// thread can steal from the top (FIFO). T must be trivially copyable, such
+// as a pointer to a task. The buffer grows as needed and retired buffers are
+// kept until the deque is destroyed since a thief might still be reading one.
+
+#pragma once
+#include <oCompiler.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+namespace ouro {
+
+template<typename T, typename Alloc = std::allocator<T>>
+class work_stealing_deque
+{
+public:
+	typedef ptrdiff_t index_type;
+	typedef T value_type;
+	typedef value_type& reference;
+	typedef const value_type& const_reference;
+	typedef Alloc allocator_type;
+
+	static const index_type default_capacity = 256;
+
+
+	// non-concurrent api
+
+	// capacity must be a power of two.
+	work_stealing_deque(index_type capacity = default_capacity, const allocator_type& alloc = allocator_type());
+	~work_stealing_deque();
+
+
+	// owner-thread api
+
+	// Push an element onto the bottom of the deque.
+	void push(const_reference val);
+
+	// Returns false if the deque is empty, otherwise val is the most recently
+	// pushed element.
+	bool try_pop(reference val);
+
+
+	// concurrent api
+
+	// Returns false if the deque is empty or if the steal lost a race with the
+	// owner or another thief, otherwise val is the oldest element.
+	bool try_steal(reference val);
+
+	// Returns true if no elements are in the deque. This is only a hint when
+	// called from a thread other than the owner.
+	bool empty() const;
+
+	// Returns the number of elements in the deque. This is only a hint when
+	// called from a thread other than the owner.
+	index_type size() const;
+
+private:
+	struct buffer
+	{
+		index_type mask;
+		buffer* retired;
+		std::atomic<value_type>* elements() { return (std::atomic<value_type>*)(this + 1); }
+		value_type get(index_type i) { return elements()[i & mask].load(std::memory_order_relaxed); }
+		void put(index_type i, value_type v) { elements()[i & mask].store(v, std::memory_order_relaxed); }
+	};
+
+	typedef typename allocator_type::template rebind<char>::other byte_allocator_type;
+
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<index_type> top;
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<index_type> bottom;
+	std::atomic<buffer*> array;
+	byte_allocator_type alloc;
+
+	buffer* new_buffer(index_type capacity);
+	void delete_buffer(buffer* b);
+	buffer* grow(buffer* b, index_type bottom, index_type top);
+
+	work_stealing_deque(const work_stealing_deque&); /* = delete */
+	const work_stealing_deque& operator=(const work_stealing_deque&); /* = delete */
+};
+
+template<typename T, typename Alloc>
+work_stealing_deque<T, Alloc>::work_stealing_deque(index_type capacity, const allocator_type& a)
+	: alloc(a)
+{
+	if (capacity <= 0 || (capacity & (capacity-1)))
+		throw std::invalid_argument("capacity must be a power of two");
+	top.store(0, std::memory_order_relaxed);
+	bottom.store(0, std::memory_order_relaxed);
+	array.store(new_buffer(capacity), std::memory_order_relaxed);
+}
+
+template<typename T, typename Alloc>
+work_stealing_deque<T, Alloc>::~work_stealing_deque()
+{
+	buffer* b = array.load(std::memory_order_relaxed);
+	while (b)
+	{
+		buffer* r = b->retired;
+		delete_buffer(b);
+		b = r;
+	}
+}
+
+template<typename T, typename Alloc>
+typename work_stealing_deque<T, Alloc>::buffer* work_stealing_deque<T, Alloc>::new_buffer(index_type capacity)
+{
+	const size_t bytes = sizeof(buffer) + sizeof(std::atomic<value_type>) * capacity;
+	buffer* b = (buffer*)alloc.allocate(bytes);
+	b->mask = capacity - 1;
+	b->retired = nullptr;
+	std::atomic<value_type>* e = b->elements();
+	for (index_type i = 0; i < capacity; i++)
+		new (e + i) std::atomic<value_type>();
+	return b;
+}
+
+template<typename T, typename Alloc>
+void work_stealing_deque<T, Alloc>::delete_buffer(buffer* b)
+{
+	alloc.deallocate((char*)b, sizeof(buffer) + sizeof(std::atomic<value_type>) * (b->mask + 1));
+}
+
+template<typename T, typename Alloc>
+typename work_stealing_deque<T, Alloc>::buffer* work_stealing_deque<T, Alloc>::grow(buffer* b, index_type bot, index_type tp)
+{
+	buffer* nb = new_buffer((b->mask + 1) * 2);
+	for (index_type i = tp; i < bot; i++)
+		nb->put(i, b->get(i));
+	nb->retired = b; // thieves may still be reading b
+	array.store(nb, std::memory_order_release);
+	return nb;
+}
+
+template<typename T, typename Alloc>
+void work_stealing_deque<T, Alloc>::push(const_reference val)
+{
+	index_type b = bottom.load(std::memory_order_relaxed);
+	index_type t = top.load(std::memory_order_acquire);
+	buffer* a = array.load(std::memory_order_relaxed);
+	if ((b - t) > a->mask)
+		a = grow(a, b, t);
+	a->put(b, val);
+	bottom.store(b + 1, std::memory_order_release);
+}
+
+template<typename T, typename Alloc>
+bool work_stealing_deque<T, Alloc>::try_pop(reference val)
+{
+	index_type b = bottom.load(std::memory_order_relaxed) - 1;
+	buffer* a = array.load(std::memory_order_relaxed);
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	index_type t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	val = a->get(b);
+	if (t == b)
+	{
+		// last element: race any thieves for it
+		bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+
+	return true;
+}
+
+template<typename T, typename Alloc>
+bool work_stealing_deque<T, Alloc>::try_steal(reference val)
+{
+	index_type t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	index_type b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return false;
+
+	buffer* a = array.load(std::memory_order_acquire);
+	value_type v = a->get(t);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return false;
+	val = v;
+	return true;
+}
+
+template<typename T, typename Alloc>
+bool work_stealing_deque<T, Alloc>::empty() const
+{
+	return size() <= 0;
+}
+
+template<typename T, typename Alloc>
+typename work_stealing_deque<T, Alloc>::index_type work_stealing_deque<T, Alloc>::size() const
+{
+	index_type b = bottom.load(std::memory_order_relaxed);
+	index_type t = top.load(std::memory_order_relaxed);
+	return b > t ? (b - t) : 0;
+}
+
+}
@@ -0,0 +1,525 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// A thread pool where each worker owns a work_stealing_deque. A task
+// dispatched from a worker goes to the bottom of that worker's deque and is
+// popped LIFO by the same worker, so nested dispatches stay cache-hot and touch
+// no shared state. An idle worker steals the oldest task from a randomly chosen
+// victim. Tasks dispatched from non-worker threads are spread round-robin over
+// small per-worker inboxes so there is no single global lock. Idle workers spin
+// with backoff, then park; dispatch only takes the parking lock if a worker is
+// actually parked. Like threadpool there are no order-of-execution guarantees.
+
+#pragma once
+#include <oCompiler.h>
+#include <oConcurrency/backoff.h>
+#include <oConcurrency/countdown_latch.h>
+#include <oConcurrency/threadpool.h>
+#include <oConcurrency/work_stealing_deque.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace ouro {
+
+	namespace detail {
+
+// identifies the pool and worker slot the calling thread belongs to, if any
+struct work_stealing_worker_id
+{
+	const void* pool;
+	size_t index;
+};
+
+inline work_stealing_worker_id& this_work_stealing_worker()
+{
+	static oTHREAD_LOCAL work_stealing_worker_id id;
+	return id;
+}
+
+template<typename Traits, typename Alloc> class work_stealing_task_group;
+
+	} // namespace detail
+
+template<typename Traits, typename Alloc = std::allocator<std::function<void()>>>
+class work_stealing_threadpool
+{
+public:
+	typedef std::function<void()> task_type;
+	typedef Alloc allocator_type;
+
+	// Pass 0 to allocate a worker thread for each hardware process found.
+	work_stealing_threadpool(size_t num_workers = 0, const allocator_type& alloc = allocator_type());
+
+	// Calls std::terminate() if join() wasn't explicitly called in client code,
+	// the same as the behavior of std::thread.
+	~work_stealing_threadpool();
+
+	// The task will execute on any given worker thread. There is no order-of-
+	// execution guarantee.
+	void dispatch(const task_type& task);
+
+	// Block until all dispatched tasks have completed.
+	void flush();
+
+	// Returns true if the thread pool can still be joined.
+	bool joinable() const;
+
+	// Blocks until all workers are joined.
+	void join();
+
+	// Returns the number of worker threads.
+	size_t num_workers() const { return nworkers; }
+
+	// Finds and executes one pending task on the calling thread. Returns false
+	// if no task could be found. This is how waiting threads help rather than
+	// block.
+	bool run_one();
+
+private:
+	template<typename, typename> friend class detail::work_stealing_task_group;
+
+	typedef typename allocator_type::template rebind<task_type>::other task_allocator_type;
+	typedef typename allocator_type::template rebind<task_type*>::other task_pointer_allocator_type;
+	typedef work_stealing_deque<task_type*, task_pointer_allocator_type> deque_type;
+	static const size_t npos = size_t(-1);
+
+	struct worker
+	{
+		worker(const task_pointer_allocator_type& a) : local(deque_type::default_capacity, a), inbox(a), rand_state(0) { inbox_size = 0; num_dispatched = num_inbox_dispatched = num_completed = 0; }
+
+		// only the owning worker pushes or pops here, anyone may steal
+		deque_type local;
+
+		// tasks dispatched from threads outside the pool
+		std::mutex inbox_mtx;
+		std::deque<task_type*, task_pointer_allocator_type> inbox;
+		std::atomic<size_t> inbox_size;
+
+		// single-writer counters used by flush(): num_dispatched and num_completed
+		// are only written by the owning worker, num_inbox_dispatched only under
+		// inbox_mtx.
+		std::atomic<size_t> num_dispatched;
+		std::atomic<size_t> num_inbox_dispatched;
+		std::atomic<size_t> num_completed;
+
+		unsigned int rand_state;
+		std::thread thread;
+	};
+
+	typedef typename allocator_type::template rebind<worker>::other worker_allocator_type;
+
+	worker* workers;
+	size_t nworkers;
+	task_allocator_type task_alloc;
+	worker_allocator_type worker_alloc;
+
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<size_t> next_inbox;
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<size_t> num_external_completed;
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<size_t> num_parked;
+	std::atomic<bool> running;
+	std::mutex park_mtx;
+	std::condition_variable work_available;
+
+	size_t calc_num_workers(size_t num_workers_requested) const;
+	size_t this_worker() const;
+	task_type* new_task(const task_type& task);
+	void execute(task_type* task, size_t worker_index);
+	bool try_pop_inbox(worker& w, task_type** out_task);
+	task_type* find_task(size_t worker_index, unsigned int& rand_state);
+	bool any_queued() const;
+	void wake_one();
+	void work(size_t worker_index);
+
+	work_stealing_threadpool(const work_stealing_threadpool&); /* = delete */
+	const work_stealing_threadpool& operator=(const work_stealing_threadpool&); /* = delete */
+
+	work_stealing_threadpool(work_stealing_threadpool&&); /* = delete */
+	work_stealing_threadpool& operator=(work_stealing_threadpool&&); /* = delete */
+};
+
+template<typename Traits, typename Alloc>
+size_t work_stealing_threadpool<Traits, Alloc>::calc_num_workers(size_t num_workers_requested) const
+{
+	return num_workers_requested ? num_workers_requested : std::thread::hardware_concurrency();
+}
+
+template<typename Traits, typename Alloc>
+work_stealing_threadpool<Traits, Alloc>::work_stealing_threadpool(size_t num_workers, const allocator_type& alloc)
+	: workers(nullptr)
+	, nworkers(calc_num_workers(num_workers))
+	, task_alloc(alloc)
+	, worker_alloc(alloc)
+{
+	next_inbox = 0;
+	num_external_completed = 0;
+	num_parked = 0;
+	running = true;
+
+	task_pointer_allocator_type a(alloc);
+	workers = worker_alloc.allocate(nworkers);
+	for (size_t i = 0; i < nworkers; i++)
+	{
+		new (workers + i) worker(a);
+		workers[i].rand_state = static_cast<unsigned int>(i * 2654435761u + 1);
+	}
+
+	// all deques must exist before any worker tries to steal from them
+	for (size_t i = 0; i < nworkers; i++)
+		workers[i].thread = std::thread(std::bind(&work_stealing_threadpool::work, this, i));
+}
+
+template<typename Traits, typename Alloc>
+work_stealing_threadpool<Traits, Alloc>::~work_stealing_threadpool()
+{
+	if (joinable())
+		std::terminate();
+
+	for (size_t i = 0; i < nworkers; i++)
+		workers[i].~worker();
+	worker_alloc.deallocate(workers, nworkers);
+}
+
+template<typename Traits, typename Alloc>
+size_t work_stealing_threadpool<Traits, Alloc>::this_worker() const
+{
+	const detail::work_stealing_worker_id& id = detail::this_work_stealing_worker();
+	return id.pool == this ? id.index : npos;
+}
+
+template<typename Traits, typename Alloc>
+typename work_stealing_threadpool<Traits, Alloc>::task_type* work_stealing_threadpool<Traits, Alloc>::new_task(const task_type& task)
+{
+	task_type* t = task_alloc.allocate(1);
+	task_alloc.construct(t, task);
+	return t;
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_threadpool<Traits, Alloc>::execute(task_type* task, size_t worker_index)
+{
+	(*task)();
+	task_alloc.destroy(task);
+	task_alloc.deallocate(task, 1);
+
+	if (worker_index == npos)
+		num_external_completed++;
+	else
+	{
+		std::atomic<size_t>& c = workers[worker_index].num_completed;
+		c.store(c.load(std::memory_order_relaxed) + 1);
+	}
+}
+
+template<typename Traits, typename Alloc>
+bool work_stealing_threadpool<Traits, Alloc>::try_pop_inbox(worker& w, task_type** out_task)
+{
+	if (!w.inbox_size.load(std::memory_order_relaxed))
+		return false;
+
+	std::unique_lock<std::mutex> lock(w.inbox_mtx, std::try_to_lock);
+	if (!lock.owns_lock() || w.inbox.empty())
+		return false;
+
+	*out_task = w.inbox.front();
+	w.inbox.pop_front();
+	w.inbox_size.store(w.inbox.size(), std::memory_order_relaxed);
+	return true;
+}
+
+template<typename Traits, typename Alloc>
+typename work_stealing_threadpool<Traits, Alloc>::task_type* work_stealing_threadpool<Traits, Alloc>::find_task(size_t worker_index, unsigned int& rand_state)
+{
+	task_type* t = nullptr;
+
+	if (worker_index != npos)
+	{
+		worker& self = workers[worker_index];
+		if (self.local.try_pop(t) || try_pop_inbox(self, &t))
+			return t;
+	}
+
+	// xorshift to pick a random victim, then sweep all others from there
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	const size_t first = rand_state % nworkers;
+	for (size_t i = 0; i < nworkers; i++)
+	{
+		size_t v = (first + i) % nworkers;
+		if (v == worker_index)
+			continue;
+		worker& victim = workers[v];
+		if (victim.local.try_steal(t) || try_pop_inbox(victim, &t))
+			return t;
+	}
+
+	return nullptr;
+}
+
+template<typename Traits, typename Alloc>
+bool work_stealing_threadpool<Traits, Alloc>::any_queued() const
+{
+	for (size_t i = 0; i < nworkers; i++)
+		if (!workers[i].local.empty() || workers[i].inbox_size.load())
+			return true;
+	return false;
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_threadpool<Traits, Alloc>::wake_one()
+{
+	// pairs with the increment of num_parked in work(): either the parking
+	// worker sees the new task when it rechecks, or it's seen as parked here.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (num_parked.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock(park_mtx);
+		work_available.notify_one();
+	}
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_threadpool<Traits, Alloc>::dispatch(const task_type& task)
+{
+	if (!running)
+		throw std::invalid_argument("dispatch called after join");
+
+	task_type* t = new_task(task);
+	const size_t wi = this_worker();
+	if (wi != npos)
+	{
+		worker& self = workers[wi];
+		self.num_dispatched.store(self.num_dispatched.load(std::memory_order_relaxed) + 1);
+		self.local.push(t);
+	}
+
+	else
+	{
+		worker& w = workers[next_inbox.fetch_add(1, std::memory_order_relaxed) % nworkers];
+		std::lock_guard<std::mutex> lock(w.inbox_mtx);
+		w.num_inbox_dispatched.store(w.num_inbox_dispatched.load(std::memory_order_relaxed) + 1);
+		w.inbox.push_back(t);
+		w.inbox_size.store(w.inbox.size(), std::memory_order_relaxed);
+	}
+
+	wake_one();
+}
+
+template<typename Traits, typename Alloc>
+bool work_stealing_threadpool<Traits, Alloc>::run_one()
+{
+	const size_t wi = this_worker();
+	unsigned int seed = static_cast<unsigned int>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+	unsigned int& rand_state = wi == npos ? seed : workers[wi].rand_state;
+	task_type* t = find_task(wi, rand_state);
+	if (!t)
+		return false;
+	execute(t, wi);
+	return true;
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_threadpool<Traits, Alloc>::flush()
+{
+	// Completions are read before dispatches. Both only grow and a task can
+	// only be dispatched before its parent completes, so if the sums match then
+	// there was a moment in between where nothing was outstanding.
+	ouro::backoff bo;
+	while (running)
+	{
+		size_t completed = num_external_completed.load();
+		for (size_t i = 0; i < nworkers; i++)
+			completed += workers[i].num_completed.load();
+
+		size_t dispatched = 0;
+		for (size_t i = 0; i < nworkers; i++)
+			dispatched += workers[i].num_dispatched.load() + workers[i].num_inbox_dispatched.load();
+
+		if (completed == dispatched)
+			break;
+		bo.pause();
+	}
+}
+
+template<typename Traits, typename Alloc>
+bool work_stealing_threadpool<Traits, Alloc>::joinable() const
+{
+	return running && nworkers && workers[0].thread.joinable();
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_threadpool<Traits, Alloc>::join()
+{
+	std::unique_lock<std::mutex> lock(park_mtx);
+	running = false;
+	work_available.notify_all();
+	lock.unlock();
+	for (size_t i = 0; i < nworkers; i++)
+		workers[i].thread.join();
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_threadpool<Traits, Alloc>::work(size_t worker_index)
+{
+	Traits::begin_thread("work_stealing_threadpool Worker");
+	detail::work_stealing_worker_id& id = detail::this_work_stealing_worker();
+	id.pool = this;
+	id.index = worker_index;
+
+	worker& self = workers[worker_index];
+	ouro::backoff bo;
+	while (true)
+	{
+		task_type* t = find_task(worker_index, self.rand_state);
+		if (t)
+		{
+			execute(t, worker_index);
+			Traits::update_thread();
+			bo.reset();
+			continue;
+		}
+
+		if (!running)
+			break;
+
+		if (bo.try_pause())
+			continue;
+
+		std::unique_lock<std::mutex> lock(park_mtx);
+		num_parked++;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (running && !any_queued())
+			work_available.wait(lock);
+		num_parked--;
+		bo.reset();
+	}
+
+	id.pool = nullptr;
+	Traits::end_thread();
+}
+
+	namespace detail {
+
+// Same as task_group but waiting threads execute any available task from the
+// pool rather than blocking.
+template<typename Traits, typename Alloc>
+class work_stealing_task_group
+{
+public:
+	typedef Alloc allocator_type;
+	typedef work_stealing_threadpool<Traits, Alloc> threadpool_type;
+	work_stealing_task_group(threadpool_type& pool);
+	~work_stealing_task_group();
+
+	// Run a task as part of this task group
+	void run(const std::function<void()>& task);
+
+	// blocks until all tasks associated with this task group are finished. While
+	// waiting, this work steals.
+	void wait();
+
+	// Cancels executing of all pending tasks in this group. If a task has already
+	// executed, then it will be complete.
+	void cancel();
+
+	// Returns true if in the canceling state. The state is set on a call to cancel()
+	// and is reset at the end of a wait.
+	bool is_canceling();
+
+private:
+	threadpool_type& tp;
+	ouro::countdown_latch latch;
+	std::atomic_bool canceling;
+};
+
+template<typename Traits, typename Alloc>
+work_stealing_task_group<Traits, Alloc>::work_stealing_task_group(threadpool_type& pool)
+	: tp(pool)
+	, latch(1)
+{ canceling = false; }
+
+template<typename Traits, typename Alloc>
+work_stealing_task_group<Traits, Alloc>::~work_stealing_task_group()
+{
+	wait();
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_task_group<Traits, Alloc>::run(const std::function<void()>& task)
+{
+	if (!canceling)
+	{
+		latch.reference();
+		tp.dispatch([&,this,task] { if (!this->canceling) { task(); } latch.release(); });
+	}
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_task_group<Traits, Alloc>::wait()
+{
+	latch.release();
+
+	// A worker must never park here: run_one can come up empty while work is
+	// still queued (a contended inbox or a lost steal), and if that work is on
+	// this worker's own deque then nothing else would run it. Only threads
+	// outside the pool block on the latch.
+	const bool is_worker = tp.this_worker() != threadpool_type::npos;
+	ouro::backoff bo;
+	while (latch.outstanding())
+	{
+		if (!tp.running)
+			throw std::invalid_argument("threadpool shut down before task group could complete");
+
+		if (tp.run_one())
+			bo.reset();
+		else if (is_worker)
+			bo.pause();
+		else if (!bo.try_pause())
+			latch.wait();
+	}
+
+	latch.wait(); // synchronize with the final release() before reuse
+	latch.reset(1); // allow task group to be reused
+	canceling.store(false);
+}
+
+template<typename Traits, typename Alloc>
+void work_stealing_task_group<Traits, Alloc>::cancel()
+{
+	canceling.store(true);
+}
+
+template<typename Traits, typename Alloc>
+bool work_stealing_task_group<Traits, Alloc>::is_canceling()
+{
+	return canceling;
+}
+
+template<size_t WorkChunkSize /* = 16*/, typename Traits, typename Alloc>
+inline void parallel_for(work_stealing_threadpool<Traits, Alloc>& pool, size_t begin, size_t end, const std::function<void(size_t index)>& task)
+{
+	work_stealing_task_group<Traits, Alloc> g(pool);
+	const size_t kNumSteps = (end - begin) / WorkChunkSize;
+	for (size_t i = 0; i < kNumSteps; i++, begin += WorkChunkSize)
+		g.run([=] { for (size_t j = begin; j < begin + WorkChunkSize; j++) task(j); });
+	if (begin < end)
+		g.run([=] { for (size_t j = begin; j < end; j++) task(j); });
+	g.wait();
+}
+
+template<typename Traits, typename Alloc>
+inline void parallel_for_range(work_stealing_threadpool<Traits, Alloc>& pool, size_t begin, size_t end, const std::function<void(size_t begin, size_t end)>& task)
+{
+	if (begin >= end)
+		return;
+	work_stealing_task_group<Traits, Alloc> g(pool);
+	parallel_for_range_split(g, begin, end, calc_grain_size(end - begin, pool.num_workers()), 2, std::this_thread::get_id(), task);
+	g.wait();
+}
+
+	}
+}
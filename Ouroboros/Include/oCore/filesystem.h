@@ -110,6 +110,7 @@ const std::error_category& filesystem_category();
 
 	binary_read,
 	binary_write,
+	binary_copy_on_write, // writable, but changes are private and never reach the file
 
 };}
 
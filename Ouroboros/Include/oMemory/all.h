@@ -6,6 +6,7 @@
 #pragma once
 #include <oMemory/bit.h>
 #include <oMemory/byte.h>
+#include <oMemory/concurrent_heap.h>
 #include <oMemory/concurrent_linear_allocator.h>
 #include <oMemory/concurrent_pool.h>
 #include <oMemory/concurrent_object_pool.h>
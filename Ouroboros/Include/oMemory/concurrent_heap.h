@@ -0,0 +1,103 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// General-purpose concurrent heap: a thread-caching front end over a shared
+// tlsf_allocator arena. Requests up to max_small_size are rounded to one of
+// num_size_classes sizes and served from spans owned by the calling thread, so
+// the common allocate/deallocate touches no shared state. A thread takes a
+// whole span from the arena at a time and returns it once all its blocks come
+// back. Blocks freed by a thread other than the span's owner go onto that
+// span's lock-free remote list and the owner reclaims them in a batch when it
+// runs dry. Larger or over-aligned requests go straight to the arena under a
+// lock.
+
+#pragma once
+#include <oMemory/allocate.h>
+#include <oMemory/tlsf_allocator.h>
+#include <atomic>
+#include <cstdint>
+
+namespace ouro {
+
+class concurrent_heap
+{
+public:
+	static const size_t span_size = 64 * 1024;
+	static const size_t max_small_size = 4096;
+	static const uint32_t num_size_classes = 28;
+
+	// the number of heaps that can be bound by get_allocator() at once
+	static const uint32_t max_num_allocators = 4;
+
+	// ctor creates as empty
+	concurrent_heap();
+
+	// ctor creates as a valid heap over the specified arena
+	concurrent_heap(void* memory, size_t bytes);
+
+	// dtor. Unlike deinitialize() this doesn't throw if allocations are 
+	// outstanding: it asserts and abandons them with the arena.
+	~concurrent_heap();
+
+	// creates a heap for the specified 16-byte aligned arena
+	void initialize(void* memory, size_t bytes);
+
+	// invalidates the heap and returns the memory passed to initialize. No other
+	// thread may be using the heap. Throws if any allocations are outstanding.
+	void* deinitialize();
+
+	// thread-safe api
+
+	void* allocate(size_t bytes, const char* label = "?", const allocate_options& options = allocate_options());
+	void deallocate(void* ptr);
+
+	// returns the usable size of an allocation
+	size_t size(void* ptr) const;
+
+	bool owns(void* ptr) const { return arena.owns(ptr); }
+
+	// Returns the calling thread's empty spans to the arena and releases its
+	// cache so another thread can adopt the spans still in use. Call this before
+	// a thread that allocated from the heap exits.
+	void release_thread_cache();
+
+	// Binds this heap to one of max_num_allocators global slots so it can be
+	// passed where an ouro::allocator is expected. The binding is released by
+	// deinitialize().
+	allocator get_allocator();
+
+private:
+	struct span;
+	struct thread_cache;
+
+	tlsf_allocator arena;
+	std::atomic_flag arena_lock;
+	std::atomic<uint8_t>* span_map; // per span_size slot of the arena, 1 if it holds a span
+	uintptr_t span_base;
+	size_t num_slots;
+	std::atomic<thread_cache*> caches;
+	uint32_t id;
+
+	concurrent_heap(const concurrent_heap&); /* = delete; */
+	const concurrent_heap& operator=(const concurrent_heap&); /* = delete; */
+
+	void lock();
+	void unlock() { arena_lock.clear(std::memory_order_release); }
+	void* arena_allocate(size_t bytes, const char* label, const allocate_options& options);
+	void arena_deallocate(void* ptr);
+
+	span* find_span(void* ptr) const;
+	thread_cache* find_thread_cache(bool create);
+	span* refill(thread_cache* c, uint32_t size_class);
+	void release_span(span* s);
+	void free_local(thread_cache* c, span* s, void* ptr);
+
+	// Returns the number of blocks and arena allocations not yet freed, moving
+	// remote frees to their spans on the way. No other thread may be using the
+	// heap.
+	size_t num_outstanding();
+
+	// returns all spans, caches and the span map to the arena and unbinds
+	void release_all();
+};
+
+}
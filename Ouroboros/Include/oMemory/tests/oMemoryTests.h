@@ -6,6 +6,7 @@
 
 namespace ouro { class test_services; namespace tests {
 
+void TESTconcurrent_heap(test_services& services);
 void TESTconcurrent_linear_allocator(test_services& services);
 void TESTconcurrent_pool(test_services& services);
 void TESTpool(test_services& services);
@@ -4,7 +4,14 @@
 // this to be lazy when including headers in .cpp files. Be explicit.
 
 #pragma once
+#include <oMesh/bvh.h>
+#include <oMesh/cleanup.h>
 #include <oMesh/mesh.h>
+#include <oMesh/meshlet.h>
 #include <oMesh/model.h>
+#include <oMesh/model_cache.h>
 #include <oMesh/obj.h>
+#include <oMesh/optimize.h>
 #include <oMesh/primitive.h>
+#include <oMesh/quantize.h>
+#include <oMesh/simplify.h>
@@ -0,0 +1,110 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Bounding volume hierarchy over an indexed triangle mesh for picking,
+// occlusion and baking queries. The tree is built with binned SAH (Wald, "On
+// fast Construction of SAH-based Bounding Volume Hierarchies", 2007). Large
+// nodes are binned concurrently and each level of smaller nodes is split
+// concurrently. Nodes are stored flat, 32 bytes each, with siblings adjacent.
+//
+// The BVH copies the triangles it needs so the source mesh can go away.
+
+#pragma once
+#include <oMesh/mesh.h>
+#include <oCompute/oFrustum.h>
+#include <cfloat>
+#include <vector>
+
+namespace ouro { namespace mesh {
+
+struct bvh_node
+{
+	float3 box_min;
+	uint offset; // leaf: first entry in triangles(), inner: first of two adjacent children
+	float3 box_max;
+	uint count; // leaf: number of triangles, inner: 0
+};
+static_assert(sizeof(bvh_node) == 32, "size mismatch");
+
+// stored in leaf order for intersection
+struct bvh_triangle
+{
+	float3 v0;
+	float3 edge1; // v1 - v0
+	float3 edge2; // v2 - v0
+	uint triangle; // index into the source mesh's triangles
+};
+
+struct ray
+{
+	ray() {}
+	ray(const float3& _origin, const float3& _direction, float _t_max = FLT_MAX) : origin(_origin), t_min(0.0f), direction(_direction), t_max(_t_max) {}
+
+	float3 origin;
+	float t_min;
+	float3 direction; // need not be normalized, t is in its units
+	float t_max;
+};
+
+struct ray_hit
+{
+	ray_hit() : triangle(invalid), t(FLT_MAX), u(0.0f), v(0.0f) {}
+
+	uint triangle; // invalid if nothing was hit
+	float t;
+	float u; // barycentrics: the hit is v0 * (1 - u - v) + v1 * u + v2 * v
+	float v;
+};
+
+struct bvh_options
+{
+	bvh_options()
+		: max_leaf_size(4)
+		, num_bins(16)
+		, traversal_cost(1.0f)
+	{}
+
+	uint max_leaf_size; // nodes this size or smaller may become leaves
+	uint num_bins; // per axis, <= 32
+	float traversal_cost; // relative to one triangle test
+};
+
+class bvh
+{
+public:
+	bvh() {}
+	bvh(const uint* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, const bvh_options& options = bvh_options()) { build(indices, num_indices, positions, position_stride, num_vertices, options); }
+	bvh(const ushort* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, const bvh_options& options = bvh_options()) { build(indices, num_indices, positions, position_stride, num_vertices, options); }
+
+	void build(const uint* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, const bvh_options& options = bvh_options());
+	void build(const ushort* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, const bvh_options& options = bvh_options());
+
+	// the root is node 0
+	const bvh_node* nodes() const { return node_storage.data(); }
+	uint num_nodes() const { return uint(node_storage.size()); }
+	const bvh_triangle* triangles() const { return triangle_storage.data(); }
+	uint num_triangles() const { return uint(triangle_storage.size()); }
+
+	// returns the closest hit in [r.t_min, r.t_max]
+	ray_hit intersect(const ray& r) const;
+
+	// returns true if anything is hit in [r.t_min, r.t_max], which is cheaper
+	// than intersect() for shadow and occlusion rays
+	bool occluded(const ray& r) const;
+
+	// Traces rays 4 at a time with SSE and splits the batch across threads.
+	// Coherent rays, like those of a pixel quad or a hemisphere sample set,
+	// benefit most.
+	void intersect(const ray* rays, uint num_rays, ray_hit* out_hits) const;
+	void occluded(const ray* rays, uint num_rays, bool* out_occluded) const;
+
+	// Appends the triangles whose bounds overlap the box or the frustum to
+	// out_triangles. The frustum test is conservative.
+	void query(const float3& box_min, const float3& box_max, std::vector<uint>& out_triangles) const;
+	void query(const oFrustumf& f, std::vector<uint>& out_triangles) const;
+
+private:
+	std::vector<bvh_node> node_storage;
+	std::vector<bvh_triangle> triangle_storage;
+};
+
+}}
@@ -0,0 +1,49 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Index buffer cleanup and connectivity for large meshes. Everything here is
+// linear or sort-based and splits work across cores so it scales to inputs of
+// hundreds of millions of triangles.
+
+#pragma once
+#include <oMesh/mesh.h>
+
+namespace ouro { namespace mesh {
+
+// Merges each vertex into the lowest-numbered vertex within tolerance of it, 
+// found by radix sorting hashed cells and searching each vertex's neighboring
+// cells. Merges are followed, so out_remap receives for each vertex the 
+// lowest-numbered vertex it ends up merged with (itself if first of its kind).
+// Returns the number of distinct vertices. A tolerance of 0 merges exact 
+// duplicates only.
+// Only positions are compared, so weld before adding attributes that differ
+// across seams or remap attribute streams accordingly.
+uint weld_vertices(uint* out_remap, const float3* positions, uint position_stride, uint num_vertices, float tolerance);
+
+// indices[i] = remap[indices[i]]
+void remap_indices(uint* indices, uint num_indices, const uint* remap);
+void remap_indices(ushort* indices, uint num_indices, const uint* remap);
+
+// Removes triangles that use the same vertex more than once, as happens after
+// welding, in a single pass. Returns the new number of indices.
+uint remove_collapsed_triangles(uint* indices, uint num_indices);
+uint remove_collapsed_triangles(ushort* indices, uint num_indices);
+
+struct edge
+{
+	uint vertex[2]; // vertex[0] < vertex[1]
+	uint triangle[2]; // the first two triangles using the edge, invalid if fewer
+};
+
+// Fills out_edges with the unique edges of a triangle list sorted by vertex.
+// out_edges must hold num_indices edges. Returns the number of edges.
+uint calc_edges(const uint* indices, uint num_indices, edge* out_edges);
+uint calc_edges(const ushort* indices, uint num_indices, edge* out_edges);
+
+// For each edge of each triangle (indices[i], indices[i+1 within the
+// triangle]) out_adjacency[i] receives the other triangle that shares it or
+// invalid if it's a border or is shared by more than 2 triangles. out_adjacency
+// must hold num_indices.
+void calc_adjacency(const uint* indices, uint num_indices, uint* out_adjacency);
+void calc_adjacency(const ushort* indices, uint num_indices, uint* out_adjacency);
+
+}}
@@ -270,6 +270,7 @@ void calc_texcoords(const aaboxf& bound, const ushort* indices, uint num_indices
 // _ppEdges: a pointer to receive an allocation and be filled with index pairs 
 //           describing an edge. Use oFreeEdgeList() to free memory the edge 
 //           list allocation. So every two uints in *_ppEdges represents an edge.
+//           Every edge is listed once, border edges included, sorted by vertex.
 // out_num_edges: a pointer to receive the number of edge pairs returned
 void calc_edges(uint num_vertices, const uint* indices, uint num_indices, uint** _ppEdges, uint* out_num_edges);
 
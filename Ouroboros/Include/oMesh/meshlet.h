@@ -0,0 +1,138 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Splits subsets into meshlets: small clusters of triangles that index a few
+// vertices through a local table. Each meshlet has bounds so whole clusters
+// can be frustum and backface culled on the CPU before any of their triangles
+// are touched.
+//
+// Meshlets are built by scanning triangles in order, so run optimize() first
+// to give them good locality.
+
+#pragma once
+#include <oMesh/mesh.h>
+#include <oMesh/model.h>
+#include <oCompute/oFrustum.h>
+#include <memory>
+
+namespace ouro { namespace mesh {
+
+static const uint max_meshlet_vertices = 64;
+static const uint max_meshlet_triangles = 124;
+
+struct meshlet
+{
+	uint vertex_offset; // into vertices(), num_vertices model vertex indices
+	uint triangle_offset; // into triangles(), num_triangles * 3 local indices
+	uchar num_vertices;
+	uchar num_triangles;
+	ushort padA;
+};
+static_assert(sizeof(meshlet) == 12, "size mismatch");
+
+struct meshlet_bounds
+{
+	spheref sphere;
+	float3 box_min;
+	float3 box_max;
+
+	// All triangles face away from any eye for which
+	// dot(normalize(cone_apex - eye), cone_axis) >= cone_cutoff.
+	// cone_cutoff is 1 if the triangles face too many ways to ever cull.
+	float3 cone_apex;
+	float3 cone_axis;
+	float cone_cutoff;
+};
+static_assert(sizeof(meshlet_bounds) == 68, "size mismatch");
+
+struct meshlet_range
+{
+	uint start_meshlet;
+	uint num_meshlets;
+};
+
+struct meshlet_options
+{
+	meshlet_options()
+		: max_vertices(max_meshlet_vertices)
+		, max_triangles(max_meshlet_triangles)
+		, ccw(false)
+	{}
+
+	uint max_vertices; // <= 255
+	uint max_triangles; // <= 255
+	bool ccw; // as in calc_face_normals
+};
+
+// Returns an upper bound on the number of meshlets build_meshlets() produces.
+uint calc_max_meshlets(uint num_indices, uint max_vertices, uint max_triangles);
+
+// Fills out_meshlets, out_vertices and out_triangles from a triangle list and
+// returns the number of meshlets. out_meshlets must hold calc_max_meshlets()
+// entries, out_vertices and out_triangles num_indices entries. vertex_offset
+// and triangle_offset start at 0.
+uint build_meshlets(meshlet* out_meshlets, uint* out_vertices, uchar* out_triangles, const uint* indices, uint num_indices, uint num_vertices, uint max_vertices = max_meshlet_vertices, uint max_triangles = max_meshlet_triangles);
+uint build_meshlets(meshlet* out_meshlets, uint* out_vertices, uchar* out_triangles, const ushort* indices, uint num_indices, uint num_vertices, uint max_vertices = max_meshlet_vertices, uint max_triangles = max_meshlet_triangles);
+
+meshlet_bounds calc_meshlet_bounds(const meshlet& m, const uint* vertices, const uchar* triangles, const float3* positions, uint position_stride, bool ccw = false);
+
+// Culling tests in the space of the positions. The frustum is expected to be
+// extracted from a WVP matrix so its planes are in model space.
+bool outside(const oFrustumf& f, const meshlet_bounds& b);
+bool backfacing(const float3& eye, const meshlet_bounds& b);
+
+struct meshlet_set_info
+{
+	meshlet_set_info() : num_meshlets(0), num_vertices(0), num_triangles(0), num_subsets(0) {}
+
+	uint num_meshlets;
+	uint num_vertices; // entries in vertices()
+	uint num_triangles; // triangles in triangles()
+	uint num_subsets;
+};
+
+class meshlet_set
+{
+public:
+	meshlet_set() : data(nullptr), ranges_offset(0), meshlets_offset(0), bounds_offset(0), vertices_offset(0), triangles_offset(0) {}
+
+	void initialize(const meshlet_set_info& i, const allocator& a = default_allocator);
+	void deinitialize();
+
+	meshlet_set_info get_info() const { return info; }
+
+	// indexed by model subset
+	const meshlet_range* ranges() const { return (const meshlet_range*)(data + ranges_offset); }
+	meshlet_range* ranges() { return (meshlet_range*)(data + ranges_offset); }
+
+	// meshlets and their bounds are parallel arrays
+	const meshlet* meshlets() const { return (const meshlet*)(data + meshlets_offset); }
+	meshlet* meshlets() { return (meshlet*)(data + meshlets_offset); }
+	const meshlet_bounds* bounds() const { return (const meshlet_bounds*)(data + bounds_offset); }
+	meshlet_bounds* bounds() { return (meshlet_bounds*)(data + bounds_offset); }
+
+	// model vertex indices
+	const uint* vertices() const { return (const uint*)(data + vertices_offset); }
+	uint* vertices() { return (uint*)(data + vertices_offset); }
+
+	// 3 indices into a meshlet's vertices per triangle
+	const uchar* triangles() const { return data + triangles_offset; }
+	uchar* triangles() { return data + triangles_offset; }
+
+private:
+	meshlet_set_info info;
+	scoped_allocation alloc;
+	uchar* data;
+	uint ranges_offset;
+	uint meshlets_offset;
+	uint bounds_offset;
+	uint vertices_offset;
+	uint triangles_offset;
+
+	meshlet_set(const meshlet_set&);/* = delete; */
+	const meshlet_set& operator=(const meshlet_set&);/* = delete; */
+};
+
+// Builds meshlets for every subset of m. Positions must be float3.
+std::shared_ptr<meshlet_set> make_meshlets(const model& m, const meshlet_options& options = meshlet_options(), const allocator& a = default_allocator);
+
+}}
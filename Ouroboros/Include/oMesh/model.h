@@ -3,7 +3,9 @@
 // Runtime representation of vertex and index information
 
 #pragma once
+#include <oBase/fourcc.h>
 #include <oMemory/allocate.h>
+#include <oMemory/uint128.h>
 #include <oMesh/mesh.h>
 
 namespace ouro { namespace mesh {
@@ -85,6 +87,58 @@ struct model_info
 };
 static_assert(sizeof(model_info) == (64 + sizeof(element_array) + 3*sizeof(model_lod)), "size mismatch");
 
+// A model file is a model_file_header, the model object and then its data 
+// blob split into sections. Each section is stored either as-is or compressed.
+// If nothing is compressed the stored sections are the data blob exactly and 
+// the model can be used where it lies in the file.
+
+static const uint model_file_fourcc = oFOURCC('O','M','D','L');
+static const ushort model_file_version = 1;
+
+enum class model_compression : uchar
+{
+	none,
+	snappy,
+
+	count,
+};
+
+/* enum class */ namespace model_section
+{ enum value {
+
+	subsets, // subsets and runtime pointer tables
+	vertices, // vertex slot offsets and vertex data
+	material_hashes,
+	indices,
+	material_names,
+
+	count,
+
+};}
+
+struct model_file_section
+{
+	uint offset; // into the data blob
+	uint size;
+	uint stored_size; // size in the file
+	model_compression compression;
+	uchar padA;
+	ushort padB;
+};
+static_assert(sizeof(model_file_section) == 16, "size mismatch");
+
+struct model_file_header
+{
+	uint fourcc;
+	ushort version;
+	ushort num_sections;
+	uint sizeof_model;
+	uint data_size;
+	uint128 source_hash; // identifies what the model was built from
+	model_file_section sections[model_section::count];
+};
+static_assert((sizeof(model_file_header) % 16) == 0, "model and data must remain aligned");
+
 class model
 {
 public:
@@ -92,7 +146,8 @@ public:
 	model();
 	~model();
 
-	// call when the memory for this object is directly loaded from disk
+	// call when the memory for this object is directly loaded from disk. This
+	// resolves the runtime pointer tables in place.
 	void initialize_placement();
 
 	void initialize(const model_info& i, const char** material_names, const allocator& a = default_allocator);
@@ -100,6 +155,20 @@ public:
 
 	model_info get_info() const { return info; }
 
+	// size of the data blob
+	uint data_size() const;
+
+	// Serializes to the model file format. Vertex and index sections are 
+	// compressed if that makes them smaller.
+	scoped_allocation save(const uint128& source_hash, const model_compression& compression = model_compression::none, const allocator& a = default_allocator) const;
+
+	// Validates a buffer written by save() and returns the model in it. If no 
+	// section is compressed the model is placed in file without copying and is 
+	// valid for as long as file is. file must be writable, so map it copy-on-
+	// write. Otherwise the model is decompressed into out_decompressed. This 
+	// throws if file is not a model file or was not built from source_hash. 
+	static model* load(void* file, size_t file_size, const uint128& source_hash, scoped_allocation* out_decompressed, const allocator& a = default_allocator);
+
 
 	// these are set up at initialize time so there is no mutator
 	ullong material_hash(uint subset_index) const { return ((const ullong*)(data+material_hashes_offset))[subset_index]; }
@@ -119,9 +188,11 @@ public:
 	template<typename T> T** rt_vertices() { return ((T**)(data+rt_vertex_slots_offset)); }
 
 
-	// direct access to indices
+	// direct access to indices, which are 32-bit if !has_16bit_indices(num_vertices)
 	const ushort* indices() const { return (const ushort*)(data+indices_offset); }
 	ushort* indices() { return (ushort*)(data+indices_offset); }
+	const uint* indices32() const { return (const uint*)(data+indices_offset); }
+	uint* indices32() { return (uint*)(data+indices_offset); }
 	
 	template<typename T> T* rt_indices() const { return (T*)(data+rt_indices_offset); }
 	template<typename T> T* rt_indices() { return (T*)(data+rt_indices_offset); }
@@ -148,6 +219,28 @@ private:
 	uint material_names_offset; // one for each subset
 
 	ullong dealloc;
+
+	void section_offsets(uint offsets[model_section::count + 1]) const;
 };
+static_assert((sizeof(model) % 16) == 0, "data must remain aligned when placed after the model");
+
+// Returns the model's r32g32b32_float positions and the byte stride between 
+// them, or null if it has no such element.
+const float3* find_positions(const model& m, uint* out_stride);
+
+// The vertices a run of indices references. Passes that work a subset at a 
+// time size per-vertex scratch to num_vertices and index it by v - base_vertex
+// so each subset pays for its own vertices rather than the whole buffer.
+struct vertex_range
+{
+	vertex_range() : base_vertex(0), num_vertices(0) {}
+
+	uint base_vertex;
+	uint num_vertices;
+};
+
+// Returns an empty range if num_indices is 0.
+vertex_range calc_vertex_range(const uint* indices, uint num_indices);
+vertex_range calc_vertex_range(const ushort* indices, uint num_indices);
 
 }}
@@ -0,0 +1,42 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Builds models from OBJ files and keeps the result on disk in the model file
+// format keyed by a hash of the source so later loads skip parsing. Cached 
+// files are memory-mapped and used in place unless they were compressed. A 
+// small stamp file per source path, size and write time records that source's
+// hash so an unchanged file isn't read at all; the text is only hashed when 
+// the stamp is missing or stale.
+
+#pragma once
+#include <oMesh/model.h>
+#include <oMesh/obj.h>
+#include <memory>
+
+namespace ouro { namespace mesh {
+
+// Positions go in slot 0 and any normals and texcoords in slot 1 so position-
+// only passes touch the least memory. There is one subset per OBJ group.
+std::shared_ptr<model> make_model(const obj::info& obj, const allocator& a = default_allocator);
+
+// The cache key: a hash of the OBJ text and the init options that change the
+// resulting model.
+uint128 calc_source_hash(const void* obj_string, size_t obj_size, const obj::init& init);
+
+class model_cache
+{
+public:
+	model_cache(const path& cache_dir, const model_compression& compression = model_compression::none);
+
+	// Returns the model for the OBJ file at obj_path, building and saving it to
+	// the cache if there isn't a valid cached copy for the same source.
+	std::shared_ptr<model> load_obj(const path& obj_path, const obj::init& init = obj::init(), bool* out_from_cache = nullptr) const;
+
+	path cache_path(const uint128& source_hash) const;
+	path stamp_path(const uint128& stamp_hash) const;
+
+private:
+	path dir;
+	model_compression compression;
+};
+
+}}
@@ -91,6 +91,7 @@ struct init
 		, counter_clockwide_faces(true)
 		, calc_normals_on_error(true)
 		, calc_texcoords_on_error(false)
+		, parse_chunk_size(4 * 1024 * 1024)
 	{}
 
 	// Estimates are used to pre-allocate memory in order to minimize reallocs
@@ -100,6 +101,10 @@ struct init
 	bool counter_clockwide_faces;
 	bool calc_normals_on_error; // either for no loaded normals or degenerates
 	bool calc_texcoords_on_error; // uses LCSM if no texcoords in source
+
+	// Text is split at line boundaries into chunks of about this many bytes that
+	// are parsed concurrently.
+	uint parse_chunk_size;
 };
 
 class mesh
@@ -108,6 +113,10 @@ public:
 	// given the path and the loaded-to-memory string contents of the file, parse into 3D data
 	static std::shared_ptr<mesh> make(const init& _Init, const path& _OBJPath, const char* _OBJString);
 
+	// _OBJString need not be nul-terminated, so a memory-mapped file can be parsed
+	// in place.
+	static std::shared_ptr<mesh> make(const init& _Init, const path& _OBJPath, const char* _OBJString, size_t _OBJSize);
+
 	virtual info get_info() const = 0;
 };
 
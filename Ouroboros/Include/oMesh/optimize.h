@@ -0,0 +1,82 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Reorders triangle lists and vertex buffers for the GPU: triangles for post-
+// transform vertex cache reuse, then clusters of triangles to reduce overdraw
+// and finally vertices into the order they're first fetched. All of these keep
+// the same set of triangles with the same winding.
+
+#pragma once
+#include <oMesh/mesh.h>
+#include <oMesh/model.h>
+
+namespace ouro { namespace mesh {
+
+static const uint default_vertex_cache_size = 16;
+
+struct vertex_cache_stats
+{
+	vertex_cache_stats() : num_transforms(0), acmr(0.0f), atvr(0.0f) {}
+
+	uint num_transforms; // vertices shaded
+	float acmr; // average cache miss ratio: transforms per triangle, [0.5,3] lower is better
+	float atvr; // average transform to vertex ratio: transforms per vertex, 1 is ideal
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries
+vertex_cache_stats calc_vertex_cache_stats(const uint* indices, uint num_indices, uint num_vertices, uint cache_size = default_vertex_cache_size);
+vertex_cache_stats calc_vertex_cache_stats(const ushort* indices, uint num_indices, uint num_vertices, uint cache_size = default_vertex_cache_size);
+
+// Reorders triangles in place to maximize vertex reuse using Forsyth's linear-
+// speed greedy scoring ("Linear-Speed Vertex Cache Optimisation", 2006). The
+// result is good for any cache size since it doesn't tune to one.
+void optimize_vertex_cache(uint* indices, uint num_indices, uint num_vertices);
+void optimize_vertex_cache(ushort* indices, uint num_indices, uint num_vertices);
+
+// Reorders clusters of cache-optimized triangles so that those facing out from
+// the mesh's center draw first (Sander et al., "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw", 2007). Clusters start where the cache
+// is cold, and where threshold allows: a threshold of 1.05 lets the ACMR get up
+// to 5% worse in exchange for more, smaller clusters. Call this after
+// optimize_vertex_cache().
+void optimize_overdraw(uint* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, float threshold = 1.05f);
+void optimize_overdraw(ushort* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, float threshold = 1.05f);
+
+// Renumbers vertices in the order the indices first use them and rewrites the
+// indices to match. out_remap receives the new index of each old vertex or
+// invalid if unreferenced. Returns the number of referenced vertices. Use
+// remap_vertices() to reorder each vertex stream.
+uint optimize_vertex_fetch(uint* indices, uint num_indices, uint num_vertices, uint* out_remap);
+uint optimize_vertex_fetch(ushort* indices, uint num_indices, uint num_vertices, uint* out_remap);
+
+// dst[remap[i]] = src[i] for each referenced vertex. dst and src may not overlap.
+void remap_vertices(void* oRESTRICT dst, const void* oRESTRICT src, uint vertex_stride, uint num_vertices, const uint* oRESTRICT remap);
+
+struct optimize_options
+{
+	optimize_options()
+		: vertex_cache(true)
+		, overdraw(true)
+		, vertex_fetch(true)
+		, overdraw_threshold(1.05f)
+		, cache_size(default_vertex_cache_size)
+	{}
+
+	bool vertex_cache;
+	bool overdraw; // requires a float3 vertex_position element
+	bool vertex_fetch;
+	float overdraw_threshold;
+	uint cache_size; // for stats only
+};
+
+struct optimize_stats
+{
+	vertex_cache_stats before;
+	vertex_cache_stats after;
+};
+
+// Optimizes each of the model's subsets independently. Vertex fetch order is
+// shared across subsets, so vertices are renumbered in subset order and each
+// subset's vertex range is recalculated.
+optimize_stats optimize(model& m, const optimize_options& options = optimize_options());
+
+}}
@@ -0,0 +1,68 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Packs float vertex attributes into smaller formats. Each attribute gets the
+// smallest format whose round-trip error over every vertex is within budget:
+//
+// positions: r16g16b16a16_snorm relative to the bounding box. Decode as
+//            bounding_sphere.xyz + snorm.xyz * extents.
+// normals:   r16g16_snorm octahedral (Cigolle et al., "A Survey of Efficient
+//            Representations for Independent Unit Vectors", 2014).
+// tangents:  r10g10b10a2_unorm as xyz * 0.5 + 0.5 with handedness in w (0 is
+//            -1, 3 is +1), then r16g16b16a16_snorm.
+// texcoords: r16g16_unorm if all are in [0,1], otherwise r16g16_float. Only
+//            r32g32_float texcoords are packed; wider ones are kept as-is
+//            rather than dropping z and w.
+//
+// Attributes that fit no format, or that aren't float to begin with, are kept
+// as-is. Every packed format is 4-byte aligned so elements stay aligned.
+
+#pragma once
+#include <oMesh/mesh.h>
+#include <oMesh/model.h>
+#include <memory>
+
+namespace ouro { namespace mesh {
+
+float2 encode_octahedral(const float3& normal);
+float3 decode_octahedral(const float2& encoded);
+
+struct quantize_options
+{
+	quantize_options()
+		: position_error(0.0001f)
+		, normal_error(0.5f)
+		, texcoord_error(1.0f / 1024.0f)
+	{}
+
+	float position_error; // relative to the largest bounding box dimension
+	float normal_error; // degrees, for normals and tangents
+	float texcoord_error; // in texcoord units
+};
+
+struct quantize_stats
+{
+	quantize_stats() : vertex_size_before(0), vertex_size_after(0), position_error(0.0f), normal_error(0.0f), texcoord_error(0.0f) {}
+
+	uint vertex_size_before; // summed across slots
+	uint vertex_size_after;
+
+	// largest measured error of the chosen formats in quantize_options' units
+	float position_error;
+	float normal_error;
+	float texcoord_error;
+};
+
+// Returns the elements quantize() would use for m. out_stats is optional.
+element_array calc_quantized_elements(const model& m, const quantize_options& options = quantize_options(), quantize_stats* out_stats = nullptr);
+
+// Returns a copy of m with its vertices packed as described above. The
+// bounding sphere and extents are recalculated from the positions since
+// they're needed to decode. Extents are the true half-sizes, so an axis on
+// which the model is flat has an extent of 0.
+std::shared_ptr<model> quantize(const model& m, const quantize_options& options = quantize_options(), quantize_stats* out_stats = nullptr, const allocator& a = default_allocator);
+
+// Returns a copy of m with any formats written by quantize() unpacked to
+// float.
+std::shared_ptr<model> dequantize(const model& m, const allocator& a = default_allocator);
+
+}}
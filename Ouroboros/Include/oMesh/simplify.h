@@ -0,0 +1,51 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Reduces triangle lists by collapsing edges, scored with quadric error metrics
+// (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics",
+// 1997). Each vertex collapses onto a neighbor rather than to a new position so
+// the reduced indices can reuse the original vertex buffer as-is.
+
+#pragma once
+#include <oMesh/mesh.h>
+#include <oMesh/model.h>
+#include <memory>
+
+namespace ouro { namespace mesh {
+
+// Writes a simplified copy of indices to dst, which must hold num_indices, and
+// returns the number of indices written. Edges are collapsed cheapest first
+// until there are target_num_indices or fewer or the next collapse would cost
+// more than target_error. A collapse's error is the area-weighted RMS distance
+// from the kept vertex to the planes of the triangles merged into it, relative
+// to the size of the mesh, so 0.01 allows about 1% deviation. out_error 
+// receives the largest error accepted.
+// Vertices that share a position but not attributes (UV or normal seams) are
+// never moved and nothing is collapsed across them. Open borders only collapse
+// along the border. Collapses that would flip a triangle are rejected.
+uint simplify(uint* dst, const uint* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, uint target_num_indices, float target_error, float* out_error = nullptr);
+uint simplify(ushort* dst, const ushort* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, uint target_num_indices, float target_error, float* out_error = nullptr);
+
+struct lod_options
+{
+	lod_options()
+	{
+		target_ratio[0] = 0.5f; target_ratio[1] = 0.25f;
+		target_error[0] = 0.01f; target_error[1] = 0.02f;
+	}
+
+	// For lods[1] and lods[2]: the fraction of each subset's triangles to keep
+	// and the most error to allow getting there.
+	float target_ratio[2];
+	float target_error[2];
+};
+
+// Returns a copy of m with subsets for 3 LODs, each simplified from the one
+// before and sharing m's vertex buffer. All of m's subsets are treated as LOD 0.
+// Each LOD's subsets are ordered opaque, alpha-tested then blended and
+// model_info::lods ranges are filled accordingly. Subsets are simplified
+// concurrently, so vertices used by more than one subset are kept to avoid
+// cracks between them. out_errors receives the largest error in each LOD. m
+// must have float3 vertex positions.
+std::shared_ptr<model> make_lods(const model& m, const lod_options& options = lod_options(), float out_errors[3] = nullptr, const allocator& a = default_allocator);
+
+}}
@@ -10,7 +10,15 @@ namespace ouro {
 
 	namespace tests {
 
+		void TESTbvh(test_services& _Services);
+		void TESTcleanup(test_services& _Services);
+		void TESTmeshlet(test_services& _Services);
+		void TESTmodel_cache(test_services& _Services);
+		void TESTnormals(test_services& _Services);
 		void TESTobj(test_services& _Services);
+		void TESToptimize(test_services& _Services);
+		void TESTquantize(test_services& _Services);
+		void TESTsimplify(test_services& _Services);
 
 	}
 }
@@ -2,7 +2,8 @@
 
 // Parses a string as an INI document by replacing certain delimiters inline 
 // with null terminators and caching indices into the Buffers where values
-// begin for very fast access to contents.
+// begin for very fast access to contents. Pass index_names for O(1) by-name
+// lookups.
 
 #pragma once
 #include <oString/stringize.h>
@@ -25,22 +26,22 @@ public:
 	typedef struct key__ {}* key;
 
 	ini() : size_(0) {}
-	ini(const char* _uri, char* data, deallocate_fn deallocate, size_t est_num_sections = 10, size_t est_num_keys = 100)
+	ini(const char* _uri, char* data, deallocate_fn deallocate, size_t est_num_sections = 10, size_t est_num_keys = 100, bool index_names = false)
 		: buffer(_uri, data, deallocate)
 	{
 		size_ = sizeof(*this) + strlen(buffer.data) + 1;
 		entries.reserve(est_num_sections + est_num_keys);
-		index_buffer();
-		size_ += entries.capacity() * sizeof(index_type);
+		index_buffer(index_names);
+		size_ += entries.capacity() * sizeof(index_type) + names.size();
 	}
 
-	ini(const char* _uri, const char* data, const allocator& alloc = default_allocator, size_t est_num_sections = 10, size_t est_num_keys = 100)
+	ini(const char* _uri, const char* data, const allocator& alloc = default_allocator, size_t est_num_sections = 10, size_t est_num_keys = 100, bool index_names = false)
 		: buffer(_uri, data, alloc, "ini doc")
 	{
 		size_ = sizeof(*this) + strlen(buffer.data) + 1;
 		entries.reserve(est_num_sections + est_num_keys);
-		index_buffer();
-		size_ += entries.capacity() * sizeof(index_type);
+		index_buffer(index_names);
+		size_ += entries.capacity() * sizeof(index_type) + names.size();
 	}
 
 	ini(ini&& _That) { operator=(std::move(_That)); }
@@ -50,6 +51,7 @@ public:
 		{
 			buffer = std::move(_That.buffer);
 			entries = std::move(_That.entries);
+			names = std::move(_That.names);
 			size_ = std::move(_That.size_);
 		}
 		return *this;
@@ -69,6 +71,14 @@ public:
 	inline section find_section(const char* _Name) const
 	{
 		section s = 0;
+		if (_Name && !names.empty())
+		{
+			// sections are keyed under the null entry
+			s = section(names.find(0, _Name));
+			if (!s || !_stricmp(_Name, section_name(s)))
+				return s;
+			// else a hash collision, so fall back to a scan
+		}
 		if (_Name) for (s = first_section(); s && _stricmp(_Name, section_name(s)); s = next_section(s)) {}
 		return s;
 	}
@@ -76,6 +86,12 @@ public:
 	inline key find_key(section s, const char* _KeyName) const
 	{
 		key k = 0;
+		if (s && _KeyName && !names.empty())
+		{
+			k = key(names.find((detail::name_index::index_type)(size_t)s, _KeyName));
+			if (!k || !_stricmp(_KeyName, name(k)))
+				return k;
+		}
 		if (s && _KeyName) for (k = first_key(s); k && _stricmp(_KeyName, name(k)); k = next_key(k)) {}
 		return k;
 	}
@@ -113,12 +129,16 @@ private:
 	entries_t entries;
 	size_t size_;
 
+	// optional name lookup of sections and of keys within a section
+	detail::name_index names;
+
 	inline const entry_t& entry(key k) const { return entries[(size_t)k]; }
 	inline const entry_t& entry(section s) const { return entries[(size_t)s]; }
-	inline void index_buffer();
+	inline void index_buffer(bool index_names);
+	inline void build_name_index();
 };
 
-void ini::index_buffer()
+void ini::index_buffer(bool index_names)
 {
 	char* c = buffer.data;
 	index_type lastSectionIndex = 0;
@@ -179,6 +199,19 @@ void ini::index_buffer()
 		}
 	}
 	*buffer.data = '\0'; // have all empty name/values point to 0 offset and now that offset will be the empty string
+	if (index_names) build_name_index();
+}
+
+void ini::build_name_index()
+{
+	// only the first of any duplicate names is found, same as the scan
+	names.reserve(entries.size());
+	for (section s = first_section(); s; s = next_section(s))
+	{
+		names.insert(0, section_name(s), (detail::name_index::index_type)(size_t)s);
+		for (key k = first_key(s); k; k = next_key(k))
+			names.insert((detail::name_index::index_type)(size_t)s, name(k), (detail::name_index::index_type)(size_t)k);
+	}
 }
 
 }
@@ -2,7 +2,8 @@
 
 // Parses a string as a JSON document by replacing certain delimiters inline 
 // with null terminators and caching indices into the buffers where values
-// begin for very fast access to contents.
+// begin for very fast access to contents. Pass index_names for O(1) by-name
+// lookups.
 
 #pragma once
 #include <oString/text_document.h>
@@ -23,22 +24,24 @@ public:
 	typedef struct node__ {}* node;
 
 	json() : size_(0) {}
-	json(const char* uri, char* data, deallocate_fn deallocate, size_t est_num_nodes = 100)
+	json(const char* uri, char* data, deallocate_fn deallocate, size_t est_num_nodes = 100, bool index_names = false)
 		: buffer(uri, data, deallocate)
 	{
 		size_ = sizeof(*this) + strlen(buffer.data) + 1;
 		nodes.reserve(est_num_nodes);
-		index_buffer();
+		index_buffer(index_names);
 		size_ += nodes.capacity() * sizeof(index_type) * 7;
+		size_ += names.size() + next_named.capacity() * sizeof(index_type);
 	}
 
-	json(const char* uri, const char* data, const allocator& alloc = default_allocator, size_t est_num_nodes = 100)
+	json(const char* uri, const char* data, const allocator& alloc = default_allocator, size_t est_num_nodes = 100, bool index_names = false)
 		: buffer(uri, data, alloc, "json doc")
 	{
 		size_ = sizeof(*this) + strlen(buffer.data) + 1;
 		nodes.reserve(est_num_nodes);
-		index_buffer();
+		index_buffer(index_names);
 		size_ += nodes.capacity() * sizeof(index_type) * 7;
+		size_ += names.size() + next_named.capacity() * sizeof(index_type);
 	}
 
 	json(json&& that) { operator=(std::move(that)); }
@@ -48,6 +51,8 @@ public:
 		{
 			buffer = std::move(that.buffer);
 			nodes = std::move(that.nodes);
+			names = std::move(that.names);
+			next_named = std::move(that.next_named);
 			size_ = std::move(that.size_);
 		}
 		return *this;
@@ -69,6 +74,8 @@ public:
 	// Convenience functions that use the above API
 	inline node first_child(node parent_node, const char* name) const
 	{
+		if (!names.empty())
+			return next_named_from(node(names.find((index_type)parent_node, name)), name);
 		node n = first_child(parent_node);
 		while (n && _stricmp(node_name(n), name))
 			n = next_sibling(n);
@@ -77,6 +84,8 @@ public:
 
 	inline node next_sibling(node prior_sibling, const char* name) const
 	{
+		if (!names.empty() && !_stricmp(node_name(prior_sibling), name))
+			return next_named_from(node(next_named[(size_t)prior_sibling]), name);
 		node n = next_sibling(prior_sibling);
 		while (n && _stricmp(node_name(n), name))
 			n = next_sibling(n);
@@ -99,12 +108,26 @@ private:
 	nodes_t nodes;
 	size_t size_;
 
+	// optional name lookup: the first child by name and a chain through each
+	// node's later siblings whose names hash the same
+	detail::name_index names;
+	std::vector<index_type> next_named;
+
 	inline const node_t& Node(node n) const { return nodes[(size_t)n]; }
 
 	inline node_t& Node(node n) { return nodes[(size_t)n]; }
 
+	// skips hash collisions along a next_named chain
+	inline node next_named_from(node n, const char* name) const
+	{
+		while (n && _stricmp(node_name(n), name))
+			n = node(next_named[(size_t)n]);
+		return n;
+	}
+
 	// Parsing functions
-	inline void index_buffer();
+	inline void index_buffer(bool index_names);
+	inline void build_name_index();
 	inline node make_next_node(char*& json_buffer, node parent, node previous, bool is_array, int& open_tag_count, int& close_tag_count);
 };
 
@@ -131,7 +154,7 @@ private:
 	} // namespace detail
 
 
-void json::index_buffer()
+void json::index_buffer(bool index_names)
 {
 	nodes.push_back(node_t()); // use up slot 0 so it can be used as a null handle
 	nodes.push_back(node_t()); // add root node
@@ -143,6 +166,19 @@ void json::index_buffer()
 	int OpenTagCount = 0, CloseTagCount = 0; // these should be equal by the end
 	make_next_node(start, root(), 0, isArray, OpenTagCount, CloseTagCount); // start recursing
 	if (OpenTagCount != CloseTagCount) throw text_document_error(text_document_errc::unclosed_scope); // if not equal, something went wrong
+	if (index_names) build_name_index();
+}
+
+void json::build_name_index()
+{
+	names.reserve(nodes.size());
+	next_named.assign(nodes.size(), 0);
+	for (index_type p = 1; p < nodes.size(); p++)
+		for (index_type c = nodes[p].down; c; c = nodes[c].next)
+		{
+			index_type prior = names.insert(p, buffer.data + nodes[c].name, c);
+			if (prior) next_named[prior] = c;
+		}
 }
 
 json::node json::make_next_node(char*& json_buffer, node parent, node previous, bool is_array, int& open_tag_count, int& close_tag_count)
@@ -9,7 +9,10 @@
 #pragma once
 #include <system_error>
 #include <oMemory/allocate.h>
+#include <oMemory/fnv1a.h>
 #include <oString/fixed_string.h>
+#include <cstdint>
+#include <vector>
 
 namespace ouro {
 
@@ -105,5 +108,102 @@ public:
 				}
 			}
 		};
+
+		class name_index
+		{
+			// An open-addressed hash of (parent, case-insensitive name) to the first
+			// item with that name under that parent. Text documents reserve index 0
+			// as the null handle, so 0 marks an empty slot. Keys compare by hash
+			// only, so callers must confirm the name and fall back to a scan on the
+			// rare collision.
+
+		public:
+			typedef uint32_t index_type;
+
+			name_index() : mask(0) {}
+			name_index(name_index&& that) : slots(std::move(that.slots)), mask(that.mask) { that.mask = 0; }
+			name_index& operator=(name_index&& that)
+			{
+				if (this != &that)
+				{
+					slots = std::move(that.slots);
+					mask = that.mask; that.mask = 0;
+				}
+				return *this;
+			}
+
+			// Clears and sizes the table to hold up to max_names entries. The table
+			// keeps at least twice as many 16-byte slots as entries, rounded up to a
+			// power of two, so it costs 32-64 bytes per entry. Documents that chain
+			// same-named siblings add 4 bytes per item for that.
+			void reserve(size_t max_names)
+			{
+				size_t n = 16;
+				while (n < max_names * 2)
+					n <<= 1;
+				slots.assign(n, slot());
+				mask = static_cast<index_type>(n - 1);
+			}
+
+			void clear() { slots.clear(); slots.shrink_to_fit(); }
+			bool empty() const { return slots.empty(); }
+
+			// returns the memory used in bytes
+			size_t size() const { return slots.capacity() * sizeof(slot); }
+
+			// Records item as named name under parent. Items must be inserted in
+			// document order. Returns the item most recently inserted under the 
+			// same key so the caller can chain same-named siblings, or 0 if this is 
+			// the first.
+			index_type insert(index_type parent, const char* name, index_type item)
+			{
+				const index_type h = fnv1ai<unsigned int>(name);
+				for (index_type i = home(parent, h);; i = (i + 1) & mask)
+				{
+					slot& s = slots[i];
+					if (!s.first)
+					{
+						s.parent = parent;
+						s.hash = h;
+						s.first = s.last = item;
+						return 0;
+					}
+
+					if (s.parent == parent && s.hash == h)
+					{
+						index_type prior = s.last;
+						s.last = item;
+						return prior;
+					}
+				}
+			}
+
+			// Returns the first item inserted under parent with a name that hashes
+			// the same as name, or 0 if there is none.
+			index_type find(index_type parent, const char* name) const
+			{
+				const index_type h = fnv1ai<unsigned int>(name);
+				for (index_type i = home(parent, h);; i = (i + 1) & mask)
+				{
+					const slot& s = slots[i];
+					if (!s.first)
+						return 0;
+					if (s.parent == parent && s.hash == h)
+						return s.first;
+				}
+			}
+
+		private:
+			struct slot
+			{
+				slot() : parent(0), hash(0), first(0), last(0) {}
+				index_type parent, hash, first, last;
+			};
+
+			std::vector<slot> slots;
+			index_type mask;
+
+			index_type home(index_type parent, index_type hash) const { return (hash ^ (parent * 0x9e3779b1u)) & mask; }
+		};
 	}
 }
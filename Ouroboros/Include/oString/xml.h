@@ -2,7 +2,8 @@
 
 // Parses a string as an XML document by replacing certain delimiters inline 
 // with null terminators and caching indices into the buffers where values
-// begin for very fast access to contents.
+// begin for very fast access to contents. Pass index_names for O(1) by-name
+// lookups.
 
 // todo: add separate support for <?> and <!> nodes. Right now the parser skips
 // over all <! nodes as comments and skips over all <?> nodes before the first
@@ -53,24 +54,26 @@ public:
 	};
 
 	xml() : Size(0) {}
-	xml(const char_type* uri, char_type* data, deallocate_fn deallocate, size_t est_num_nodes = 100, size_t est_num_attrs = 500)
+	xml(const char_type* uri, char_type* data, deallocate_fn deallocate, size_t est_num_nodes = 100, size_t est_num_attrs = 500, bool index_names = false)
 		: Buffer(uri, data, deallocate)
 	{
 		Size = sizeof(*this) + strlen(Buffer.data) + 1;
 		Nodes.reserve(est_num_nodes);
 		Attrs.reserve(est_num_attrs);
-		index_buffer();
+		index_buffer(index_names);
 		Size += Nodes.capacity() * sizeof(index_type) + Attrs.capacity() * sizeof(index_type);
+		Size += NodeNames.size() + NextNamed.capacity() * sizeof(index_type) + AttrNames.size();
 	}
 
-	xml(const char_type* uri, const char_type* data, const allocator& alloc = default_allocator, size_t est_num_nodes = 100, size_t est_num_attrs = 500)
+	xml(const char_type* uri, const char_type* data, const allocator& alloc = default_allocator, size_t est_num_nodes = 100, size_t est_num_attrs = 500, bool index_names = false)
 		: Buffer(uri, data, alloc, "xml doc")
 	{
 		Size = sizeof(*this) + strlen(Buffer.data) + 1;
 		Nodes.reserve(est_num_nodes);
 		Attrs.reserve(est_num_attrs);
-		index_buffer();
+		index_buffer(index_names);
 		Size += Nodes.capacity() * sizeof(index_type) + Attrs.capacity() * sizeof(index_type);
+		Size += NodeNames.size() + NextNamed.capacity() * sizeof(index_type) + AttrNames.size();
 	}
 
 	xml(xml&& that) { operator=(std::move(that)); }
@@ -81,6 +84,9 @@ public:
 			Buffer = std::move(that.Buffer);
 			Attrs = std::move(that.Attrs);
 			Nodes = std::move(that.Nodes);
+			NodeNames = std::move(that.NodeNames);
+			NextNamed = std::move(that.NextNamed);
+			AttrNames = std::move(that.AttrNames);
 			Size = std::move(that.Size);
 		}
 		return *this;
@@ -107,6 +113,8 @@ public:
 	// Convenience functions that use the above API
 	inline node first_child(node parent_node, const char_type* _node_name) const
 	{
+		if (!NodeNames.empty())
+			return next_named_from(node(NodeNames.find((index_type)parent_node, _node_name)), _node_name);
 		node n = first_child(parent_node);
 		while (n && _stricmp(node_name(n), _node_name))
 			n = next_sibling(n);
@@ -115,6 +123,8 @@ public:
 
 	inline node next_sibling(node prior_sibling, const char_type* _node_name) const
 	{
+		if (!NodeNames.empty() && !_stricmp(node_name(prior_sibling), _node_name))
+			return next_named_from(node(NextNamed[(size_t)prior_sibling]), _node_name);
 		node n = next_sibling(prior_sibling);
 		while (n && _stricmp(node_name(n), _node_name))
 			n = next_sibling(n);
@@ -123,6 +133,14 @@ public:
 
 	inline attr find_attr(node n, const char_type* _attr_name) const
 	{
+		if (!AttrNames.empty())
+		{
+			attr a = attr(AttrNames.find((index_type)n, _attr_name));
+			if (!a || !_stricmp(attr_name(a), _attr_name))
+				return a;
+			// else a hash collision, so fall back to a scan
+		}
+
 		for (attr a = first_attr(n); a; a = next_attr(a))
 			if (!_stricmp(attr_name(a), _attr_name))
 				return a;
@@ -290,15 +308,30 @@ private:
 	nodes_t Nodes;
 	size_t Size;
 
+	// optional name lookup: the first child or attr by name and a chain through
+	// each node's later siblings whose names hash the same
+	detail::name_index NodeNames;
+	detail::name_index AttrNames;
+	std::vector<index_type> NextNamed;
+
 	inline const ATTR& Attr(attr a) const { return Attrs[(size_t)a]; }
 	inline const NODE& Node(node n) const { return Nodes[(size_t)n]; }
 
 	inline ATTR& Attr(attr a) { return Attrs[(size_t)a]; }
 	inline NODE& Node(node n) { return Nodes[(size_t)n]; }
 
+	// skips hash collisions along a NextNamed chain
+	inline node next_named_from(node n, const char_type* _node_name) const
+	{
+		while (n && _stricmp(node_name(n), _node_name))
+			n = node(NextNamed[(size_t)n]);
+		return n;
+	}
+
 	// Parsing functions
 	static inline ATTR make_attr(char_type* xml_start, char_type*& xml_current, bool& at_end);
-	inline void index_buffer();
+	inline void index_buffer(bool index_names);
+	inline void build_name_index();
 	inline void make_node_attrs(char_type* xml_start, char_type*& _xml, NODE& n);
 	inline node make_next_node(char_type*& _xml, node parent_node, node previous, int& open_tag_count, int& close_tag_count);
 	inline void make_next_node_children(char_type*& _xml, node parent_node, int& open_tag_count, int& close_tag_count);
@@ -480,7 +513,7 @@ private:
 		}
 	} // namespace detail
 
-void xml::index_buffer()
+void xml::index_buffer(bool index_names)
 {
 	char_type* start = Buffer.data + strcspn(Buffer.data, "<"); // find first opening tag
 	// offsets of 0 must point to the empty string, so assign first byte as empty
@@ -494,6 +527,25 @@ void xml::index_buffer()
 	make_next_node_children(start, root(), OpenTagCount, CloseTagCount); // start recursing
 	*Buffer.data = 0; // make the first char_type nul so 0 offsets are the empty string
 	if (OpenTagCount != CloseTagCount) throw text_document_error(text_document_errc::unclosed_scope); // if not equal, something went wrong
+	if (index_names) build_name_index();
+}
+
+void xml::build_name_index()
+{
+	// nodes are stored in document order, so same-named siblings chain in order
+	NodeNames.reserve(Nodes.size());
+	NextNamed.assign(Nodes.size(), 0);
+	for (index_type n = 2; n < Nodes.size(); n++)
+	{
+		index_type prior = NodeNames.insert(Nodes[n].up, Buffer.data + Nodes[n].name, n);
+		if (prior) NextNamed[prior] = n;
+	}
+
+	// only the first of any duplicate attr names is found, same as the scan
+	AttrNames.reserve(Attrs.size());
+	for (index_type n = 2; n < Nodes.size(); n++)
+		for (index_type a = Nodes[n].Attr; a && Attrs[a].name; a++)
+			AttrNames.insert(n, Buffer.data + Attrs[a].name, a);
 }
 
 // This expects xml_current to be pointing after a node name and before an
@@ -5,6 +5,7 @@
 
 #pragma once
 #include <oSurface/codec.h>
+#include <oSurface/codec_batch.h>
 #include <oSurface/convert.h>
 #include <oSurface/fill.h>
 #include <oSurface/resize.h>
@@ -5,6 +5,7 @@
 #pragma once
 #include <oSurface/image.h>
 #include <oSurface/surface.h>
+#include <functional>
 
 namespace ouro { namespace surface {
 
@@ -76,4 +77,27 @@ inline image decode(const scoped_allocation& buffer
 	, const format& desired_format
 	, const mip_layout& layout = mip_layout::none) { return decode(buffer, buffer.size(), default_allocator, default_allocator, desired_format, layout); }
 
+// Copies up to size bytes of an encoded file into dst and returns the number of
+// bytes copied. Returning fewer than size means the end of the file.
+typedef std::function<size_t(void* dst, size_t size)> stream_reader;
+
+// Receives a region of decoded texels. tile.position and tile.dimensions are in
+// texels of the full image with dimensions clipped at the image's right and 
+// bottom edges (use the unclipped tile size with calc_tile_id()). mapped is only
+// valid during the call.
+typedef std::function<void(const tile_info& tile, const const_mapped_subresource& mapped)> tile_consumer;
+
+// Decodes a file pulled through read and passes it to consume in tiles of 
+// tile_dimensions texels, left-to-right then top-to-bottom as calc_tile_id() 
+// counts them. A tile width of ~0u gives full-width scanline bands. 
+// Non-interlaced PNG and all JPEG files are decoded incrementally so memory use 
+// is one row of tiles plus decoder state regardless of image or file size; 
+// other formats are read fully into temp_alloc first. Returns the info of the 
+// whole image in the delivered format.
+info decode_tiles(const stream_reader& read
+	, const uint2& tile_dimensions
+	, const tile_consumer& consume
+	, const allocator& temp_alloc = default_allocator
+	, const format& desired_format = format::unknown);
+
 }}
@@ -0,0 +1,114 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+
+// Decodes or encodes many images concurrently on the scheduler. Each
+// concurrently-running task borrows a scratch arena for the batch so per-image
+// temporaries, codec state and file reads are bump allocations that are reset
+// between images rather than a malloc/free per image.
+
+#pragma once
+#include <oSurface/codec.h>
+#include <functional>
+
+namespace ouro { namespace surface {
+
+struct batch_stats
+{
+	batch_stats()
+		: num_images(0)
+		, num_failed(0)
+		, read_bytes(0)
+		, encoded_bytes(0)
+		, decoded_bytes(0)
+		, read_seconds(0.0)
+		, decode_seconds(0.0)
+		, encode_seconds(0.0)
+		, wall_seconds(0.0)
+		, num_arenas(0)
+		, arena_overflows(0)
+	{}
+
+	uint num_images;
+	uint num_failed;
+	ullong read_bytes; // bytes loaded from paths
+	ullong encoded_bytes; // file-format bytes consumed by decode or produced by encode
+	ullong decoded_bytes; // texel bytes produced by decode or consumed by encode
+
+	// stage times are summed over all threads, so they measure cost per stage
+	// rather than elapsed time. wall_seconds is the elapsed time of the batch.
+	double read_seconds;
+	double decode_seconds;
+	double encode_seconds;
+	double wall_seconds;
+
+	uint num_arenas; // number of scratch arenas the batch needed
+	uint arena_overflows; // allocations that didn't fit and went to default_allocator
+
+	// throughput of the whole batch
+	double images_per_second() const { return wall_seconds > 0.0 ? (num_images - num_failed) / wall_seconds : 0.0; }
+	double encoded_mb_per_second() const { return wall_seconds > 0.0 ? encoded_bytes / (1024.0 * 1024.0 * wall_seconds) : 0.0; }
+	double decoded_mb_per_second() const { return wall_seconds > 0.0 ? decoded_bytes / (1024.0 * 1024.0 * wall_seconds) : 0.0; }
+
+	// throughput of a single thread in each stage
+	double read_mb_per_second() const { return read_seconds > 0.0 ? read_bytes / (1024.0 * 1024.0 * read_seconds) : 0.0; }
+	double decode_mb_per_second() const { return decode_seconds > 0.0 ? encoded_bytes / (1024.0 * 1024.0 * decode_seconds) : 0.0; }
+	double encode_mb_per_second() const { return encode_seconds > 0.0 ? decoded_bytes / (1024.0 * 1024.0 * encode_seconds) : 0.0; }
+};
+
+struct batch_options
+{
+	batch_options()
+		: desired_format(format::unknown)
+		, layout(mip_layout::none)
+		, compression_level(compression::low)
+		, arena_size(32 * 1024 * 1024)
+	{}
+
+	format desired_format;
+	mip_layout layout; // decode only
+	compression compression_level; // encode only
+
+	// Each concurrent task gets one arena of this size. Allocations that don't
+	// fit fall through to default_allocator.
+	size_t arena_size;
+};
+
+// Receives an image as it completes. These are called from worker threads in
+// no particular order, so they must be thread-safe. decoded may be moved from.
+typedef std::function<void(size_t index, image& decoded)> batch_decoded;
+
+// encoded is allocated from file_alloc and may be moved from.
+typedef std::function<void(size_t index, scoped_allocation& encoded)> batch_encoded;
+
+// Receives the reason an item failed. The rest of the batch continues. If this
+// is null failures are only counted.
+typedef std::function<void(size_t index, const char* error)> batch_failed;
+
+// Decodes num_buffers in-memory files. Decoded images are allocated from
+// texel_alloc.
+batch_stats decode_batch(const void* const* buffers
+	, const size_t* sizes
+	, size_t num_buffers
+	, const batch_decoded& decoded
+	, const batch_options& options = batch_options()
+	, const batch_failed& failed = nullptr
+	, const allocator& texel_alloc = default_allocator);
+
+// Same as above, loading each file into the scratch arena first.
+batch_stats decode_batch(const char* const* paths
+	, size_t num_paths
+	, const batch_decoded& decoded
+	, const batch_options& options = batch_options()
+	, const batch_failed& failed = nullptr
+	, const allocator& texel_alloc = default_allocator);
+
+// Encodes num_images to fmt. Each file is encoded into the scratch arena and
+// then copied to an exact-size allocation from file_alloc.
+batch_stats encode_batch(const image* const* images
+	, size_t num_images
+	, const file_format& fmt
+	, const batch_encoded& encoded
+	, const batch_options& options = batch_options()
+	, const batch_failed& failed = nullptr
+	, const allocator& file_alloc = default_allocator);
+
+}}
@@ -8,14 +8,44 @@
 
 namespace ouro { namespace surface {
 
+// Instruction sets for which row conversion kernels exist, in increasing order.
+enum class simd_level : uchar
+{
+	scalar,
+	sse2,
+	ssse3,
+	avx2,
+
+	count,
+};
+
+// Converts num_pixels contiguous pixels of a scanline from one format to 
+// another.
+typedef void (*row_convert)(const void* src_row, void* dst_row, uint num_pixels);
+
+// Returns the highest simd_level supported by the current CPU and OS.
+simd_level max_simd_level();
+
+// Returns the fastest row kernel for the conversion that uses no instruction 
+// set above max_level or above max_simd_level(). The scalar kernel is the 
+// reference implementation and is always available. This throws if the 
+// conversion is not supported.
+row_convert get_row_convert(const format& src_format, const format& dst_format, const simd_level& max_level = simd_level::avx2);
+
+// Returns true if get_row_convert supports the conversion.
+bool has_row_convert(const format& src_format, const format& dst_format);
+
 // Converts the specified subresource into the destination subresource. This assumes
 // all memory has been properly allocated. If a conversion is not supported this
-// throws an exception.
+// throws an exception. Large subresources are split into row bands (4x4-block 
+// rows for BC compression) that run in parallel; output does not depend on the
+// number of threads.
 void convert_subresource(const subresource_info& i
 	, const const_mapped_subresource& src
 	, format dst_format
 	, const mapped_subresource& dst
-	, const copy_option& option = copy_option::none);
+	, const copy_option& option = copy_option::none
+	, const bc_quality& quality = bc_quality::fast);
 
 // Converts the specified source into the specified destination. This assumes
 // all memory has been properly allocated. If a conversion is not supported this
@@ -24,7 +54,8 @@ void convert(const info& src_info
 	, const const_mapped_subresource& src
 	, const info& dst_info
 	, const mapped_subresource& dst
-	, const copy_option& option = copy_option::none);
+	, const copy_option& option = copy_option::none
+	, const bc_quality& quality = bc_quality::fast);
 
 // This is a conversion in-place for RGB v. BGR and similar permutations.
 void convert_swizzle(const info& i, const format& new_format, const mapped_subresource& mapped);
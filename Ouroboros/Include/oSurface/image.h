@@ -78,11 +78,11 @@ public:
 
 	// initializes a resized and reformatted copy of this buffer allocated from the same or a user-specified allocator
 	image convert(const info& dst_info) const;
-	image convert(const info& dst_info, const allocator& a) const;
+	image convert(const info& dst_info, const allocator& a, const bc_quality& quality = bc_quality::fast) const;
 
 	// initializes a reformatted copy of this buffer allocated from the same or a user-specified allocator
 	inline image convert(const format& dst_format) const { info si = get_info(); si.format = dst_format; return convert(si); }
-	inline image convert(const format& dst_format, const allocator& a) const { info si = get_info(); si.format = dst_format; return convert(si, a); }
+	inline image convert(const format& dst_format, const allocator& a, const bc_quality& quality = bc_quality::fast) const { info si = get_info(); si.format = dst_format; return convert(si, a, quality); }
 
 	// copies to a mapped subresource of the same dimension but the specified format
 	void convert_to(uint subresource, const mapped_subresource& dst, const format& dst_format, const copy_option& option = copy_option::none) const;
@@ -93,8 +93,10 @@ public:
 	// For compatible types such as RGB <-> BGR do conversion in-place
 	void convert_in_place(const format& fmt);
 
-	// Uses the top-level mip as a source and replaces all other mips with a filtered version
+	// Replaces all mips below the top level, each filtered from the level above 
+	// it. The filter-only version does not filter gamma-correctly.
 	void generate_mips(const filter& f = filter::lanczos2);
+	void generate_mips(const mip_options& options);
 
 private:
 	void* bits;
@@ -181,6 +183,19 @@ inline void image::copy_from(uint subresource, const image& src, uint src_subres
 	copy_from(subresource, locked.mapped, option);
 }
 
+// Returns a block-compressed copy of the top-level mips of src with a full mip
+// chain. Each level is filtered from the level above it and compressed as soon
+// as it's produced so the uncompressed chain never exists in full. Slices are 
+// built in parallel. Levels smaller than a block are padded by edge 
+// replication. Levels are converted to bc_format's color space, going through
+// linear float when there's no direct conversion, so an _srgb source can be 
+// compressed to a linear bc format and vice versa.
+image compress_mips(const image& src
+	, const format& bc_format
+	, const mip_options& options = mip_options()
+	, const bc_quality& quality = bc_quality::fast
+	, const allocator& a = default_allocator);
+
 // returns the root mean square of the difference between the two surfaces. If
 // the formats or sizes are different, this throws an exception. If out_diffs
 // is passed in, it will be initialized using the specified allocator. The rms
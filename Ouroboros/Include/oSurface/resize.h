@@ -6,6 +6,7 @@
 
 #pragma once
 #include <oSurface/surface.h>
+#include <functional>
 
 namespace ouro { namespace surface {
 
@@ -16,11 +17,56 @@ enum class filter : uchar
 	triangle,
 	lanczos2, // sinc filter
 	lanczos3, // sharper than lancsos2, but adds slight ringing
+	kaiser, // kaiser-windowed sinc: about as sharp as lanczos3 with less ringing
 
 	count,
 };
 
+// Filtering supports 8-bit formats of up to 4 channels, 16-bit unorm and float
+// and 32-bit float formats. Large destinations are filtered in parallel bands 
+// of rows; results do not depend on the number of threads.
 void resize(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, const filter& f = filter::lanczos3);
+
+// 8-bit results are truncated by the above, which matches older output. With 
+// round_to_nearest they are rounded instead, so filtering a result again (as 
+// a mip chain does) doesn't darken it by up to a code value each time.
+void resize(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, const filter& f, bool round_to_nearest);
+struct mip_options
+{
+	mip_options()
+		: mip_filter(filter::box)
+		, gamma_correct(true)
+		, alpha_coverage_reference(0.0f)
+	{}
+
+	// filter used to derive each level from the one above it
+	filter mip_filter;
+
+	// filter _srgb formats in linear space. This applies to the 4-byte r8g8b8 
+	// and b8g8r8 _srgb layouts; other _srgb formats are filtered as stored.
+	bool gamma_correct;
+
+	// if in (0,1], alpha is scaled on each level so the fraction of texels with 
+	// alpha >= this value matches mip0, which keeps alpha-tested geometry from 
+	// thinning out with distance.
+	float alpha_coverage_reference;
+};
+
+// Receives each level of a mip chain. The level is only valid during the call.
+// Return false to stop building the chain.
+typedef std::function<bool(uint mip, const info& level_info, const const_mapped_subresource& level)> mip_emitter;
+
+// Calls emit for mip0 and then each smaller level down to 1x1, each filtered 
+// from the level above it. Levels are in mip0's format unless gamma-correct 
+// filtering of an _srgb format was requested, in which case they are 
+// r32g32b32a32_float in linear space. Only two levels are resident at a time.
+void build_mip_chain(const info& mip0_info, const const_mapped_subresource& mip0, const mip_options& options, const mip_emitter& emit);
+
+// Replaces mips 1..n of every array slice or cube face of a surface with levels
+// built by build_mip_chain. Slices are built in parallel. Depth slices of 3D 
+// surfaces are filtered in 2D only.
+void generate_mips(const info& inf, void* surface_bytes, const mip_options& options = mip_options());
+
 void clip(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, uint2 src_offset = uint2(0, 0));
 void pad(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, uint2 dst_offset = uint2(0, 0));
 
@@ -332,6 +332,19 @@ enum class copy_option : uchar
 	flip_vertically,
 };
 
+// Speed/quality tradeoff for BC6H/BC7 compression, fastest first. This maps to
+// the ispc_texcomp profiles of the same name. BC1/BC3 ignore it.
+enum class bc_quality : uchar
+{
+	ultrafast,
+	veryfast,
+	fast,
+	basic,
+	slow,
+
+	count,
+};
+
 struct bit_size
 {
 	uchar r;
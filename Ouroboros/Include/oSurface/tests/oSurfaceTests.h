@@ -13,6 +13,8 @@ namespace ouro {
 		void TESTsurface();
 		void TESTsurface_bccodec(test_services& services);
 		void TESTsurface_codec(test_services& services);
+		void TESTsurface_codec_batch(test_services& services);
+		void TESTsurface_convert(test_services& services);
 		void TESTsurface_fill(test_services& services);
 		void TESTsurface_generate_mips(test_services& services);
 		void TESTsurface_resize(test_services& services);
@@ -2,6 +2,7 @@
 #include <oBase/concurrent_registry.h>
 #include <oBase/assert.h>
 #include <oBase/macros.h>
+#include <oConcurrency/epoch.h>
 #include <oMemory/byte.h>
 
 namespace ouro {
@@ -42,6 +43,7 @@ concurrent_registry::concurrent_registry(concurrent_registry&& _That)
 	lookup = std::move(_That.lookup);
 	makes = std::move(_That.makes);
 	unmakes = std::move(_That.unmakes);
+	retired = std::move(_That.retired);
 	lifetime = std::move(_That.lifetime);
 }
 
@@ -72,6 +74,7 @@ concurrent_registry& concurrent_registry::operator=(concurrent_registry&& _That)
 		lookup = std::move(_That.lookup);
 		makes = std::move(_That.makes);
 		unmakes = std::move(_That.unmakes);
+		retired = std::move(_That.retired);
 		lifetime = std::move(_That.lifetime);
 		oMOVE0(entries);
 		oMOVE0(missing);
@@ -159,6 +162,8 @@ void concurrent_registry::unmake_all()
 	if (remaining)
 		throw std::exception("did not flush all outstanding items");
 
+	reclaim(true);
+
 	const size_type n = capacity();
 	for (size_type i = 0; i < n; i++)
 	{
@@ -175,6 +180,8 @@ void concurrent_registry::unmake_all()
 
 concurrent_registry::size_type concurrent_registry::flush(size_type max_operations)
 {
+	reclaim(false);
+
 	size_type n = max_operations;
 	file_info* f = nullptr;
 	while (n && unmakes.pop(&f))
@@ -184,8 +191,9 @@ concurrent_registry::size_type concurrent_registry::flush(size_type max_operatio
 			continue;
 		index_type index = pool.index(f);
 		void** e = entries + index;
-		lifetime.destroy(*e);
+		void* old = *e;
 		*e = f->state == state::unmaking ? missing : failed;
+		retire(old);
 		pool.destroy(f);
 		n--;
 	}
@@ -198,9 +206,9 @@ concurrent_registry::size_type concurrent_registry::flush(size_type max_operatio
 
 		void** e = entries + index;
 		
-		// free any prior asset (should this count as an operation n--?)
-		if (*e && *e != missing && *e != failed && *e != making)
-			lifetime.destroy(*e);
+		// readers may still hold any prior asset, so retire it once replaced
+		// (should this count as an operation n--?)
+		void* old = *e;
 
 		if (!f->compiled)
 		{
@@ -224,6 +232,8 @@ concurrent_registry::size_type concurrent_registry::flush(size_type max_operatio
 			}
 			n--;
 		}
+
+		retire(old);
 	}
 
 	if (EstHashesToReclaim <= n)
@@ -232,6 +242,29 @@ concurrent_registry::size_type concurrent_registry::flush(size_type max_operatio
 	return makes.size() + unmakes.size();
 }
 
+void concurrent_registry::retire(void* asset)
+{
+	if (asset && asset != missing && asset != failed && asset != making)
+	{
+		retired_asset r;
+		r.ticket = epoch::ticket();
+		r.asset = asset;
+		retired.push_back(r);
+	}
+}
+
+void concurrent_registry::reclaim(bool all)
+{
+	if (all && !retired.empty())
+		epoch::synchronize();
+
+	// tickets are in order, so stop at the first one readers may still hold
+	size_t n = 0;
+	while (n < retired.size() && epoch::expired(retired[n].ticket))
+		lifetime.destroy(retired[n++].asset);
+	retired.erase(retired.begin(), retired.begin() + n);
+}
+
 concurrent_registry::hash_type concurrent_registry::hash(const char* name)
 {
 	return fnv1a<hash_type>(name);
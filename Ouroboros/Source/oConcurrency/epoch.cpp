@@ -0,0 +1,328 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/epoch.h>
+#include <oConcurrency/backoff.h>
+#include <oConcurrency/mutex.h>
+#include <oCompiler.h>
+#include <atomic>
+#include <stdexcept>
+
+namespace ouro { namespace epoch {
+
+// The epoch counts in twos so a thread's published value can use bit 0 to
+// mean "inside a guard". Comparisons are by unsigned difference so wrapping is
+// harmless. A batch sealed at epoch e is safe once the epoch reaches e + 4
+// (two advances): the first guarantees every thread guarded at e has left, the
+// second covers threads that had read e but not yet published it.
+
+static const uint32_t kActive = 1;
+static const uint32_t kAdvance = 2;
+static const uint32_t kSafeDistance = 2 * kAdvance;
+static const uint32_t kBatchSize = 64;
+
+struct retired
+{
+	void* pointer;
+	reclaim_fn reclaim;
+	void* context;
+};
+
+struct batch
+{
+	batch() : next(nullptr), epoch(0), count(0) {}
+	batch* next;
+	uint32_t epoch;
+	uint32_t count;
+	retired items[kBatchSize];
+};
+
+// Records are never freed so the advancing thread can walk the list without
+// protection. A thread that exits without release_thread() leaves its record
+// idle, which costs a list entry but never blocks an advance.
+struct record
+{
+	record() : next(nullptr), nesting(0) { local.store(0, std::memory_order_relaxed); in_use.store(true, std::memory_order_relaxed); open.store(nullptr, std::memory_order_relaxed); }
+
+	std::atomic<uint32_t> local;
+	std::atomic<bool> in_use;
+	record* next;
+	uint32_t nesting;
+
+	// synchronize() seals other threads' batches, so the open batch is changed
+	// only under the lock. It is atomic so seal() can skip an empty one without
+	// taking the lock.
+	mutex open_lock;
+	std::atomic<batch*> open;
+	char pad[oCACHE_LINE_SIZE];
+};
+
+static std::atomic<uint32_t> s_epoch;
+static std::atomic<record*> s_records;
+static std::atomic<uint32_t> s_num_sealed;
+static std::atomic<uint32_t> s_oldest_sealed;
+static std::atomic<uint32_t> s_num_pending;
+static std::atomic<uint32_t> s_num_reclaiming;
+static oTHREAD_LOCAL record* s_record;
+
+// sealed batches in the order they were sealed, so epochs are non-decreasing.
+// s_oldest_sealed mirrors the head's epoch so update() can tell nothing is safe
+// yet without taking the lock.
+static mutex s_sealed_lock;
+static batch* s_sealed_head;
+static batch* s_sealed_tail;
+
+static record* this_record()
+{
+	record* r = s_record;
+	if (r)
+		return r;
+
+	for (r = s_records.load(std::memory_order_acquire); r; r = r->next)
+	{
+		bool idle = false;
+		if (!r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(idle, true, std::memory_order_acquire))
+			break;
+	}
+
+	if (!r)
+	{
+		r = new record();
+		record* head = s_records.load(std::memory_order_relaxed);
+		do { r->next = head;
+		} while (!s_records.compare_exchange_weak(head, r, std::memory_order_release));
+	}
+
+	s_record = r;
+	return r;
+}
+
+static void seal(record* r)
+{
+	// most calls find nothing retired since the last seal
+	if (!r->open.load(std::memory_order_relaxed))
+		return;
+
+	batch* b = nullptr;
+	{
+		lock_guard<mutex> lock(r->open_lock);
+		b = r->open.exchange(nullptr, std::memory_order_relaxed);
+	}
+
+	if (!b)
+		return;
+
+	// the stamp is read after every node in the batch was unlinked, so it is
+	// no earlier than the epoch any of them was retired in
+	lock_guard<mutex> lock(s_sealed_lock);
+	b->epoch = s_epoch.load();
+	if (s_sealed_tail)
+		s_sealed_tail->next = b;
+	else
+	{
+		s_sealed_head = b;
+		s_oldest_sealed.store(b->epoch, std::memory_order_relaxed);
+	}
+	s_sealed_tail = b;
+	s_num_sealed++;
+}
+
+// Returns true if the epoch is past e. Advancing is a CAS from e, so a thread
+// that scanned against a stale e can't move the epoch a second time; losing the
+// race to another thread that saw the same e is as good as winning it.
+static bool try_advance(uint32_t e)
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (record* r = s_records.load(std::memory_order_acquire); r; r = r->next)
+	{
+		const uint32_t l = r->local.load(std::memory_order_acquire);
+		if ((l & kActive) && l != (e | kActive))
+			return false;
+	}
+
+	s_epoch.compare_exchange_strong(e, e + kAdvance);
+	return true;
+}
+
+static void reclaim()
+{
+	batch* safe = nullptr;
+	batch* safe_tail = nullptr;
+	{
+		lock_guard<mutex> lock(s_sealed_lock);
+		const uint32_t e = s_epoch.load();
+		while (s_sealed_head && (e - s_sealed_head->epoch) >= kSafeDistance)
+		{
+			batch* b = s_sealed_head;
+			s_sealed_head = b->next;
+			b->next = nullptr;
+			if (safe_tail)
+				safe_tail->next = b;
+			else
+				safe = b;
+			safe_tail = b;
+			s_num_sealed--;
+		}
+
+		if (s_sealed_head)
+			s_oldest_sealed.store(s_sealed_head->epoch, std::memory_order_relaxed);
+		else
+			s_sealed_tail = nullptr;
+		if (!safe)
+			return;
+		s_num_reclaiming++;
+	}
+
+	// reclaim functions may retire more nodes, so run them without any lock
+	while (safe)
+	{
+		batch* b = safe;
+		safe = b->next;
+		for (uint32_t i = 0; i < b->count; i++)
+			b->items[i].reclaim(b->items[i].pointer, b->items[i].context);
+		s_num_pending -= b->count;
+		delete b;
+	}
+
+	s_num_reclaiming--;
+}
+
+void enter()
+{
+	record* r = this_record();
+	if (r->nesting++ == 0)
+	{
+		r->local.store(s_epoch.load(std::memory_order_relaxed) | kActive, std::memory_order_relaxed);
+
+		// the published epoch must be visible before any node is read
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+}
+
+void exit()
+{
+	record* r = s_record;
+	if (!r || !r->nesting)
+		throw std::logic_error("epoch::exit without a matching enter");
+	if (--r->nesting == 0)
+		r->local.store(0, std::memory_order_release);
+}
+
+void retire(void* pointer, reclaim_fn reclaim, void* context)
+{
+	record* r = this_record();
+	s_num_pending++;
+	bool full = false;
+	{
+		lock_guard<mutex> lock(r->open_lock);
+		batch* b = r->open.load(std::memory_order_relaxed);
+		if (!b)
+		{
+			b = new batch();
+			r->open.store(b, std::memory_order_relaxed);
+		}
+		retired& item = b->items[b->count++];
+		item.pointer = pointer;
+		item.reclaim = reclaim;
+		item.context = context;
+		full = b->count == kBatchSize;
+	}
+
+	if (full)
+		update();
+}
+
+void update()
+{
+	if (!s_num_pending.load(std::memory_order_relaxed))
+		return;
+
+	if (s_record)
+		seal(s_record);
+
+	if (!s_num_sealed.load(std::memory_order_relaxed))
+		return;
+
+	// Until the oldest sealed batch is safe there is nothing for reclaim() to
+	// take the lock for. A stale value only costs a reclaim() that finds
+	// nothing; reclaim() itself decides under the lock.
+	const uint32_t oldest = s_oldest_sealed.load(std::memory_order_relaxed);
+	if ((s_epoch.load() - oldest) < kSafeDistance)
+	{
+		try_advance(s_epoch.load());
+		if ((s_epoch.load() - oldest) < kSafeDistance)
+			return;
+	}
+
+	reclaim();
+}
+
+bool guarded()
+{
+	const record* r = s_record;
+	return r && r->nesting;
+}
+
+void synchronize()
+{
+	if (s_record && s_record->nesting)
+		throw std::logic_error("epoch::synchronize would deadlock inside an epoch::guard");
+
+	for (record* r = s_records.load(std::memory_order_acquire); r; r = r->next)
+		seal(r);
+
+	{
+		// other threads may advance too, so wait for the distance, not a value
+		const uint32_t start = s_epoch.load();
+		backoff bo;
+		for (;;)
+		{
+			const uint32_t e = s_epoch.load();
+			if ((e - start) >= kSafeDistance)
+				break;
+			if (try_advance(e))
+				bo.reset();
+			else
+				bo.pause();
+		}
+	}
+
+	reclaim();
+
+	// another thread may have taken some of the batches and still be running
+	// their reclaim functions
+	backoff bo;
+	while (s_num_reclaiming.load())
+		bo.pause();
+}
+
+uint32_t ticket()
+{
+	return s_epoch.load();
+}
+
+bool expired(uint32_t ticket)
+{
+	if ((s_epoch.load() - ticket) >= kSafeDistance)
+		return true;
+
+	try_advance(s_epoch.load());
+	return (s_epoch.load() - ticket) >= kSafeDistance;
+}
+
+void release_thread()
+{
+	record* r = s_record;
+	if (!r)
+		return;
+	if (r->nesting)
+		throw std::logic_error("epoch::release_thread inside an epoch::guard");
+	seal(r);
+	s_record = nullptr;
+	r->in_use.store(false, std::memory_order_release);
+}
+
+uint32_t num_pending()
+{
+	return s_num_pending.load();
+}
+
+}}
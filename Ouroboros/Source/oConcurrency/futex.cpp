@@ -0,0 +1,118 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/futex.h>
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ouro {
+
+static long sys_futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const struct timespec* timeout)
+{
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32-bit int");
+	return syscall(SYS_futex, (uint32_t*)addr, op, val, timeout, nullptr, 0);
+}
+
+void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected)
+{
+	sys_futex(addr, FUTEX_WAIT_PRIVATE, expected, nullptr);
+}
+
+bool futex_wait_for(std::atomic<uint32_t>* addr, uint32_t expected, uint32_t timeout_ms)
+{
+	struct timespec ts;
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+	return sys_futex(addr, FUTEX_WAIT_PRIVATE, expected, &ts) == 0 || errno != ETIMEDOUT;
+}
+
+void futex_wake_one(std::atomic<uint32_t>* addr)
+{
+	sys_futex(addr, FUTEX_WAKE_PRIVATE, 1, nullptr);
+}
+
+void futex_wake_all(std::atomic<uint32_t>* addr)
+{
+	sys_futex(addr, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+}
+
+}
+
+#else
+
+#include <oCompiler.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace ouro {
+
+// A waiter checks the value under its bucket's lock and a waker takes the same
+// lock after changing the value, so a wake can't slip in between the check and
+// the wait.
+struct futex_bucket
+{
+	std::mutex mtx;
+	std::condition_variable cv;
+	uint32_t num_waiters;
+	char pad[oCACHE_LINE_SIZE];
+
+	futex_bucket() : num_waiters(0) {}
+};
+
+static const uint32_t kNumBuckets = 64;
+
+static futex_bucket& bucket_for(std::atomic<uint32_t>* addr)
+{
+	static futex_bucket s_buckets[kNumBuckets];
+	const uintptr_t a = (uintptr_t)addr;
+	return s_buckets[((a >> 2) ^ (a >> 9)) % kNumBuckets];
+}
+
+void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected)
+{
+	futex_bucket& b = bucket_for(addr);
+	std::unique_lock<std::mutex> lock(b.mtx);
+	if (addr->load() != expected)
+		return;
+	b.num_waiters++;
+	b.cv.wait(lock);
+	b.num_waiters--;
+}
+
+bool futex_wait_for(std::atomic<uint32_t>* addr, uint32_t expected, uint32_t timeout_ms)
+{
+	futex_bucket& b = bucket_for(addr);
+	std::unique_lock<std::mutex> lock(b.mtx);
+	if (addr->load() != expected)
+		return true;
+	b.num_waiters++;
+	const bool timed_out = b.cv.wait_for(lock, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout;
+	b.num_waiters--;
+	return !timed_out;
+}
+
+// buckets are shared by unrelated addresses, so a wake must reach every waiter
+// in the bucket and let the others recheck their own values
+
+void futex_wake_one(std::atomic<uint32_t>* addr)
+{
+	futex_wake_all(addr);
+}
+
+void futex_wake_all(std::atomic<uint32_t>* addr)
+{
+	futex_bucket& b = bucket_for(addr);
+	std::lock_guard<std::mutex> lock(b.mtx);
+	if (b.num_waiters)
+		b.cv.notify_all();
+}
+
+}
+
+#endif
@@ -1,7 +1,11 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oConcurrency/mutex.h>
 #include <oConcurrency/backoff.h>
+#include <oConcurrency/futex.h>
 #include <stdexcept>
+
+#if defined(_WIN32) || defined(_WIN64)
+
 #include <Windows.h>
 
 #if NTDDI_VERSION >= NTDDI_WIN7
@@ -33,10 +37,6 @@ static_assert(sizeof(ouro::recursive_mutex) == sizeof(CRITICAL_SECTION), "size m
 
 namespace ouro {
 
-	const adopt_lock_t adopt_lock;
-	const defer_lock_t defer_lock;
-	const try_to_lock_t try_to_lock;
-
 mutex::mutex()
 {
 	InitializeSRWLock((PSRWLOCK)&footprint);
@@ -73,58 +73,235 @@ void mutex::unlock()
 	ReleaseSRWLockExclusive((PSRWLOCK)&footprint);
 }
 
-void shared_mutex::lock_shared()
+recursive_mutex::recursive_mutex()
+{
+	InitializeCriticalSection((LPCRITICAL_SECTION)footprint);
+}
+
+recursive_mutex::~recursive_mutex()
+{
+	CHECK_UNLOCKED();
+	DeleteCriticalSection((LPCRITICAL_SECTION)footprint);
+}
+
+recursive_mutex::native_handle_type recursive_mutex::native_handle()
+{
+	return (LPCRITICAL_SECTION)footprint;
+}
+
+void recursive_mutex::lock()
+{
+	EnterCriticalSection((LPCRITICAL_SECTION)footprint);
+}
+
+bool recursive_mutex::try_lock()
+{
+	return !!TryEnterCriticalSection((LPCRITICAL_SECTION)footprint);
+}
+
+void recursive_mutex::unlock()
+{
+	LeaveCriticalSection((LPCRITICAL_SECTION)footprint);
+}
+
+once_flag::once_flag()
+	: footprint(0)
+{
+	InitOnceInitialize((PINIT_ONCE)footprint);
+}
+
+BOOL CALLBACK InitOnceCallback(PINIT_ONCE InitOnce, PVOID Parameter, PVOID* Context)
+{
+	std::function<void()>* pFN = (std::function<void()>*)Parameter;
+	(*pFN)();
+	return TRUE;
+}
+
+void call_once(once_flag& flag, const std::function<void()>& fn)
+{
+	InitOnceExecuteOnce(*(PINIT_ONCE*)&flag, InitOnceCallback, (PVOID)&fn, nullptr);
+}
+
+}
+
+#elif defined(__linux__)
+
+#ifdef _DEBUG
+	#define ASSIGN_TID_CHECKED() do { if (state.load() && tid == std::this_thread::get_id()) { throw std::logic_error("non-recursive already locked on this thread"); } } while(false)
+	#define ASSIGN_TID() tid = std::this_thread::get_id()
+	#define CLEAR_TID()	tid = std::thread::id()
+	#define CHECK_UNLOCKED() if (state.load()) throw std::logic_error("mutex locked on destruction")
+#else
+	#define ASSIGN_TID_CHECKED()
+	#define ASSIGN_TID()
+	#define CLEAR_TID()
+	#define CHECK_UNLOCKED()
+#endif
+
+namespace ouro {
+
+mutex::mutex()
+{
+	state.store(0, std::memory_order_relaxed);
+}
+
+mutex::~mutex()
+{
+	CHECK_UNLOCKED();
+}
+
+mutex::native_handle_type mutex::native_handle()
+{
+	return &state;
+}
+
+void mutex::lock()
 {
 	ASSIGN_TID_CHECKED();
-	AcquireSRWLockShared((PSRWLOCK)&footprint);
+	uint32_t s = 0;
+	if (!state.compare_exchange_strong(s, 1, std::memory_order_acquire))
+	{
+		// the holder is likely running and about to release, so spin a little
+		// before paying for a syscall
+		backoff bo;
+		while (bo.try_pause())
+		{
+			s = 0;
+			if (state.load(std::memory_order_relaxed) == 0 && state.compare_exchange_strong(s, 1, std::memory_order_acquire))
+			{
+				ASSIGN_TID();
+				return;
+			}
+		}
+
+		// flag contention so unlock knows to wake a waiter
+		s = state.exchange(2, std::memory_order_acquire);
+		while (s)
+		{
+			futex_wait(&state, 2);
+			s = state.exchange(2, std::memory_order_acquire);
+		}
+	}
+	ASSIGN_TID();
 }
 
-bool shared_mutex::try_lock_shared()
+bool mutex::try_lock()
 {
-	#ifdef oHAS_SLIM_TRY_LOCK
-		return !!TryAcquireSRWLockShared((PSRWLOCK)&footprint);
-	#else
+	uint32_t s = 0;
+	if (!state.compare_exchange_strong(s, 1, std::memory_order_acquire))
 		return false;
-	#endif
+	ASSIGN_TID();
+	return true;
 }
 
-void shared_mutex::unlock_shared()
+void mutex::unlock()
 {
 	CLEAR_TID();
-	ReleaseSRWLockShared((PSRWLOCK)&footprint);
+	if (state.exchange(0, std::memory_order_release) == 2)
+		futex_wake_one(&state);
+}
+
+// the address of a thread-local is unique among running threads
+static const void* this_thread_token()
+{
+	static oTHREAD_LOCAL char s_token;
+	return &s_token;
 }
 
 recursive_mutex::recursive_mutex()
+	: count(0)
 {
-	InitializeCriticalSection((LPCRITICAL_SECTION)footprint);
+	owner.store(nullptr, std::memory_order_relaxed);
 }
 
 recursive_mutex::~recursive_mutex()
 {
-	CHECK_UNLOCKED();
-	DeleteCriticalSection((LPCRITICAL_SECTION)footprint);
+	if (count)
+		throw std::logic_error("recursive_mutex locked on destruction");
 }
 
 recursive_mutex::native_handle_type recursive_mutex::native_handle()
 {
-	return (LPCRITICAL_SECTION)footprint;
+	return mtx.native_handle();
 }
 
 void recursive_mutex::lock()
 {
-	EnterCriticalSection((LPCRITICAL_SECTION)footprint);
+	const void* token = this_thread_token();
+	if (owner.load(std::memory_order_relaxed) != token)
+	{
+		mtx.lock();
+		owner.store(token, std::memory_order_relaxed);
+	}
+	count++;
 }
 
 bool recursive_mutex::try_lock()
 {
-	return !!TryEnterCriticalSection((LPCRITICAL_SECTION)footprint);
+	const void* token = this_thread_token();
+	if (owner.load(std::memory_order_relaxed) != token)
+	{
+		if (!mtx.try_lock())
+			return false;
+		owner.store(token, std::memory_order_relaxed);
+	}
+	count++;
+	return true;
 }
 
 void recursive_mutex::unlock()
 {
-	LeaveCriticalSection((LPCRITICAL_SECTION)footprint);
+	if (--count == 0)
+	{
+		owner.store(nullptr, std::memory_order_relaxed);
+		mtx.unlock();
+	}
+}
+
+once_flag::once_flag()
+{
+	state.store(0, std::memory_order_relaxed);
+}
+
+void call_once(once_flag& flag, const std::function<void()>& fn)
+{
+	uint32_t s = flag.state.load(std::memory_order_acquire);
+	while (s != 2)
+	{
+		if (s == 0 && flag.state.compare_exchange_strong(s, 1, std::memory_order_acquire))
+		{
+			try { fn(); }
+			catch (...)
+			{
+				// let another caller try
+				flag.state.store(0, std::memory_order_release);
+				futex_wake_all(&flag.state);
+				throw;
+			}
+
+			flag.state.store(2, std::memory_order_release);
+			futex_wake_all(&flag.state);
+			return;
+		}
+
+		if (s == 1)
+			futex_wait(&flag.state, 1);
+		s = flag.state.load(std::memory_order_acquire);
+	}
 }
 
+}
+
+#else
+	#error unsupported platform (mutex)
+#endif
+
+namespace ouro {
+
+	const adopt_lock_t adopt_lock = adopt_lock_t();
+	const defer_lock_t defer_lock = defer_lock_t();
+	const try_to_lock_t try_to_lock = try_to_lock_t();
+
 bool timed_mutex::try_lock_for(unsigned int _TimeoutMS)
 {
 	// Based on:
@@ -132,7 +309,7 @@ bool timed_mutex::try_lock_for(unsigned int _TimeoutMS)
 
 	ouro::backoff bo;
 
-	do 
+	do
 	{
 		if (try_lock())
 			return true;
@@ -149,22 +326,144 @@ bool timed_mutex::try_lock_for(unsigned int _TimeoutMS)
 	return false;
 }
 
-once_flag::once_flag()
-	: footprint(0)
+// Each thread takes the next stripe the first time it reads, so threads spread
+// evenly rather than by a hash that could collide.
+static uint32_t this_thread_stripe(uint32_t num_stripes)
 {
-	InitOnceInitialize((PINIT_ONCE)footprint);
+	static std::atomic<uint32_t> s_next_stripe;
+	static oTHREAD_LOCAL uint32_t s_stripe_plus_one = 0;
+	if (!s_stripe_plus_one)
+		s_stripe_plus_one = s_next_stripe.fetch_add(1, std::memory_order_relaxed) + 1;
+	return (s_stripe_plus_one - 1) % num_stripes;
 }
 
-BOOL CALLBACK InitOnceCallback(PINIT_ONCE InitOnce, PVOID Parameter, PVOID* Context)
+shared_mutex::shared_mutex()
 {
-	std::function<void()>* pFN = (std::function<void()>*)Parameter;
-	(*pFN)();
-	return TRUE;
+	for (uint32_t i = 0; i < num_stripes; i++)
+		stripes[i].readers.store(0, std::memory_order_relaxed);
+	writer.store(0, std::memory_order_relaxed);
+	departures.store(0, std::memory_order_relaxed);
 }
 
-void call_once(once_flag& flag, const std::function<void()>& fn)
+shared_mutex::~shared_mutex()
 {
-	InitOnceExecuteOnce(*(PINIT_ONCE*)&flag, InitOnceCallback, (PVOID)&fn, nullptr);
+	if (writer.load() || num_readers())
+		throw std::logic_error("shared_mutex locked on destruction");
+}
+
+uint32_t shared_mutex::num_readers() const
+{
+	// a reader may release on a different stripe than it locked, so only the sum
+	// is meaningful
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < num_stripes; i++)
+		n += stripes[i].readers.load();
+	return n;
+}
+
+// departures counts in twos and bit 0 flags a parked writer, so readers only
+// make a syscall when there is a writer to wake
+
+void shared_mutex::wait_for_readers()
+{
+	backoff bo;
+	while (num_readers())
+	{
+		if (bo.try_pause())
+			continue;
+
+		// flag before rechecking so a departure in between changes the word and
+		// the wait returns immediately
+		const uint32_t d = departures.fetch_or(1) | 1;
+		if (num_readers())
+			futex_wait(&departures, d);
+	}
+}
+
+void shared_mutex::reader_departed()
+{
+	if (departures.fetch_add(2) & 1)
+	{
+		departures.fetch_and(~1u);
+		futex_wake_one(&departures);
+	}
+}
+
+void shared_mutex::lock()
+{
+	writers.lock();
+	writer.store(1);
+	wait_for_readers();
+}
+
+bool shared_mutex::try_lock()
+{
+	if (!writers.try_lock())
+		return false;
+
+	writer.store(1);
+	if (num_readers())
+	{
+		if (writer.exchange(0) == 2)
+			futex_wake_all(&writer);
+		writers.unlock();
+		return false;
+	}
+
+	return true;
+}
+
+void shared_mutex::unlock()
+{
+	if (writer.exchange(0, std::memory_order_release) == 2)
+		futex_wake_all(&writer);
+	writers.unlock();
+}
+
+void shared_mutex::lock_shared()
+{
+	std::atomic<uint32_t>& readers = stripes[this_thread_stripe(num_stripes)].readers;
+	for (;;)
+	{
+		readers.fetch_add(1);
+		if (!writer.load())
+			return;
+
+		// a writer is pending: step aside so it isn't starved, and wait it out
+		readers.fetch_sub(1);
+		reader_departed();
+
+		backoff bo;
+		uint32_t w = writer.load();
+		while (w)
+		{
+			if (!bo.try_pause())
+			{
+				if (w == 2 || writer.compare_exchange_strong(w, 2))
+					futex_wait(&writer, 2);
+			}
+			w = writer.load();
+		}
+	}
+}
+
+bool shared_mutex::try_lock_shared()
+{
+	std::atomic<uint32_t>& readers = stripes[this_thread_stripe(num_stripes)].readers;
+	readers.fetch_add(1);
+	if (!writer.load())
+		return true;
+	readers.fetch_sub(1);
+	reader_departed();
+	return false;
+}
+
+void shared_mutex::unlock_shared()
+{
+	std::atomic<uint32_t>& readers = stripes[this_thread_stripe(num_stripes)].readers;
+	readers.fetch_sub(1);
+	if (writer.load())
+		reader_departed();
 }
 
 }
@@ -0,0 +1,237 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/task_graph.h>
+#include <oConcurrency/backoff.h>
+#include <oConcurrency/concurrency.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ouro {
+
+task_graph::task_graph(const dispatcher_type& dispatcher)
+	: dispatcher(dispatcher)
+	, last_run(0.0)
+	, finalized(false)
+{
+	remaining = 0;
+	failed = false;
+	released = false;
+}
+
+task_graph::~task_graph()
+{
+}
+
+task_graph::node_id task_graph::add(const char* name, const std::function<void()>& task, double cost_estimate)
+{
+	if (!task)
+		throw std::invalid_argument("task_graph nodes require a task");
+
+	node n;
+	n.name = name ? name : "";
+	n.task = task;
+	n.num_predecessors = 0;
+	n.cost = std::max(cost_estimate, 0.0);
+	n.priority = 0.0;
+	nodes.push_back(n);
+	finalized = false;
+	return static_cast<node_id>(nodes.size() - 1);
+}
+
+void task_graph::precede(node_id before, node_id after)
+{
+	if (before >= nodes.size() || after >= nodes.size())
+		throw std::out_of_range("invalid task_graph node_id");
+	if (before == after)
+		throw std::invalid_argument("a task_graph node cannot precede itself");
+
+	std::vector<node_id>& s = nodes[before].successors;
+	if (std::find(s.begin(), s.end(), after) != s.end())
+		return;
+	s.push_back(after);
+	nodes[after].num_predecessors++;
+	finalized = false;
+}
+
+void task_graph::finalize()
+{
+	const size_t n = nodes.size();
+
+	// Kahn's algorithm both finds a topological order and detects cycles
+	std::vector<unsigned int> in_degree(n);
+	topological_order.clear();
+	topological_order.reserve(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		in_degree[i] = nodes[i].num_predecessors;
+		if (!in_degree[i])
+			topological_order.push_back(static_cast<node_id>(i));
+	}
+
+	for (size_t i = 0; i < topological_order.size(); i++)
+	{
+		const node& nd = nodes[topological_order[i]];
+		for (auto it = nd.successors.begin(); it != nd.successors.end(); ++it)
+			if (--in_degree[*it] == 0)
+				topological_order.push_back(*it);
+	}
+
+	if (topological_order.size() != n)
+		throw std::invalid_argument("task_graph contains a cycle");
+
+	pending.reset(n ? new std::atomic<unsigned int>[n] : nullptr);
+	prioritize();
+	finalized = true;
+}
+
+void task_graph::prioritize()
+{
+	// walk backwards so all successors' priorities are known
+	for (auto it = topological_order.rbegin(); it != topological_order.rend(); ++it)
+	{
+		node& nd = nodes[*it];
+		double longest = 0.0;
+		for (auto s = nd.successors.begin(); s != nd.successors.end(); ++s)
+			longest = std::max(longest, nodes[*s].priority);
+		nd.priority = nd.cost + longest;
+	}
+
+	auto by_priority = [&](node_id a, node_id b) { return nodes[a].priority > nodes[b].priority; };
+
+	roots.clear();
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		node& nd = nodes[i];
+		std::stable_sort(nd.successors.begin(), nd.successors.end(), by_priority);
+		if (!nd.num_predecessors)
+			roots.push_back(static_cast<node_id>(i));
+	}
+	std::stable_sort(roots.begin(), roots.end(), by_priority);
+}
+
+double task_graph::seconds_since_start() const
+{
+	return std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - run_start).count();
+}
+
+void task_graph::dispatch(node_id n)
+{
+	if (dispatcher)
+		dispatcher([=] { execute(n); });
+	else
+		ouro::dispatch([=] { execute(n); });
+}
+
+void task_graph::execute(node_id n)
+{
+	while (n != invalid_node)
+	{
+		node& nd = nodes[n];
+		nd.timing.start = seconds_since_start();
+		if (!failed)
+		{
+			try { nd.task(); }
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(exception_mtx);
+				if (!failed)
+				{
+					first_exception = std::current_exception();
+					failed = true;
+				}
+			}
+		}
+		nd.timing.end = seconds_since_start();
+
+		// continue with the most critical ready successor on this thread and
+		// hand the rest to the scheduler least critical first: a worker pops its
+		// own tasks LIFO, so the next most critical one runs next
+		node_id next = invalid_node;
+		for (auto it = nd.successors.rbegin(); it != nd.successors.rend(); ++it)
+		{
+			const node_id s = *it;
+			if (--pending[s] == 0)
+			{
+				if (next != invalid_node)
+					dispatch(next);
+				next = s;
+			}
+		}
+
+		// release() can wake run() before it returns, so run() also waits for
+		// released, and storing it is the last access to this graph
+		if (--remaining == 0)
+		{
+			done.release();
+			released.store(true, std::memory_order_release);
+			break;
+		}
+
+		n = next;
+	}
+}
+
+void task_graph::run()
+{
+	if (!finalized)
+		finalize();
+
+	if (nodes.empty())
+	{
+		last_run = 0.0;
+		return;
+	}
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		pending[i] = nodes[i].num_predecessors;
+		nodes[i].timing = node_timing();
+	}
+	remaining = nodes.size();
+	failed = false;
+	first_exception = std::exception_ptr();
+	released = false;
+	done.reset(1);
+	run_start = std::chrono::high_resolution_clock::now();
+
+	// roots are in priority order so the most critical work starts first
+	for (auto it = roots.begin(); it != roots.end(); ++it)
+		dispatch(*it);
+
+	done.wait();
+	backoff bo;
+	while (!released.load(std::memory_order_acquire))
+		bo.pause();
+	last_run = seconds_since_start();
+
+	if (failed)
+		std::rethrow_exception(first_exception);
+
+	// measured durations drive the next run's priorities
+	for (auto it = nodes.begin(); it != nodes.end(); ++it)
+		it->cost = it->timing.end - it->timing.start;
+	prioritize();
+}
+
+const char* task_graph::name(node_id node) const
+{
+	if (node >= nodes.size())
+		throw std::out_of_range("invalid task_graph node_id");
+	return nodes[node].name.c_str();
+}
+
+const task_graph::node_timing& task_graph::timing(node_id node) const
+{
+	if (node >= nodes.size())
+		throw std::out_of_range("invalid task_graph node_id");
+	return nodes[node].timing;
+}
+
+double task_graph::critical_path_seconds() const
+{
+	double longest = 0.0;
+	for (auto it = roots.begin(); it != roots.end(); ++it)
+		longest = std::max(longest, nodes[*it].priority);
+	return longest;
+}
+
+}
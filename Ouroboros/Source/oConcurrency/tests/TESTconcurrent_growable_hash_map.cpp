@@ -0,0 +1,195 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/concurrent_growable_hash_map.h>
+#include <oString/fixed_string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../../test_services.h"
+
+namespace ouro { namespace tests {
+
+typedef concurrent_growable_hash_map<uint64_t, uint32_t> map_t;
+
+static void test_growth(test_services& services)
+{
+	map_t h(8);
+	const map_t::size_type initial_capacity = h.capacity();
+
+	static const uint32_t kNumKeys = 100000;
+	for (uint32_t i = 0; i < kNumKeys; i++)
+		oTEST(h.set(i, i) == map_t::nullvalue, "key %u should be new", i);
+
+	oTEST(h.size() == kNumKeys, "expected %u entries, got %u", kNumKeys, h.size());
+	oTEST(h.capacity() >= kNumKeys && h.num_migrations() > 0, "should have grown");
+	for (uint32_t i = 0; i < kNumKeys; i++)
+		oTEST(h.get(i) == i, "get(%u) failed after growing", i);
+
+	for (uint32_t i = 0; i < kNumKeys; i += 2)
+		oTEST(h.remove(i) == i, "remove(%u) failed", i);
+	oTEST(h.size() == kNumKeys / 2, "remove failed");
+	oTEST(h.get(0) == map_t::nullvalue && h.get(1) == 1, "get after remove failed");
+
+	h.clear();
+	oTEST(h.empty(), "clear failed");
+
+	// churn through many more keys than fit: migration drops the tombstones so
+	// the table stays the same size
+	map_t churn(1000);
+	const map_t::size_type churn_capacity = churn.capacity();
+	for (uint32_t i = 0; i < kNumKeys; i++)
+	{
+		churn.set(i, i);
+		if (i >= 500)
+			churn.remove(i - 500);
+	}
+	oTEST(churn.size() == 500, "churn should leave 500 entries, got %u", churn.size());
+	oTEST(churn.capacity() == churn_capacity && churn.num_migrations() > 0, "churn should compact in place, not grow");
+	oTEST(initial_capacity < h.capacity(), "growth check failed");
+}
+
+// threads insert disjoint keys while also churning a shared range
+static void test_concurrency(test_services& services)
+{
+	map_t h(64);
+	const uint32_t nThreads = std::max(4u, std::thread::hardware_concurrency());
+	static const uint32_t kKeysPerThread = 20000;
+
+	std::vector<std::thread> threads(nThreads);
+	std::vector<uint32_t> failures(nThreads, 0);
+	for (uint32_t t = 0; t < nThreads; t++)
+		threads[t] = std::thread([&, t]
+		{
+			const uint64_t base = uint64_t(t + 1) << 32;
+			for (uint32_t i = 0; i < kKeysPerThread; i++)
+			{
+				h.set(base + i, i);
+				if (h.get(base + i) != i)
+					failures[t]++;
+				h.set(i & 255, t);
+				if (i >= 100)
+				{
+					h.remove(base + i - 100);
+					if (h.get(base + i - 100) != map_t::nullvalue)
+						failures[t]++;
+				}
+			}
+		});
+
+	for (auto& t : threads)
+		t.join();
+
+	uint32_t nFailures = 0;
+	for (uint32_t f : failures)
+		nFailures += f;
+	oTEST(nFailures == 0, "%u gets returned the wrong value", nFailures);
+
+	for (uint32_t t = 0; t < nThreads; t++)
+		for (uint32_t i = kKeysPerThread - 100; i < kKeysPerThread; i++)
+			oTEST(h.get((uint64_t(t + 1) << 32) + i) == i, "thread %u key %u lost", t, i);
+	oTEST(h.size() == nThreads * 100 + 256, "expected %u entries, got %u", nThreads * 100 + 256, h.size());
+}
+
+// readers must see keys that were set before they started while writers force
+// the table through several migrations
+static void test_reads_during_migration(test_services& services)
+{
+	static const uint32_t kNumStable = 1000;
+	static const uint32_t kKeysPerWriter = 50000;
+	map_t h(kNumStable);
+	for (uint32_t i = 0; i < kNumStable; i++)
+		h.set(i, i);
+
+	const uint32_t nWriters = 2;
+	const uint32_t nReaders = std::max(2u, std::thread::hardware_concurrency());
+	std::atomic<uint32_t> writers_done(0);
+	std::vector<uint32_t> misses(nReaders, 0);
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < nWriters; t++)
+		threads.push_back(std::thread([&, t]
+		{
+			const uint64_t base = uint64_t(t + 1) << 32;
+			for (uint32_t i = 0; i < kKeysPerWriter; i++)
+				h.set(base + i, i);
+			writers_done++;
+		}));
+
+	for (uint32_t t = 0; t < nReaders; t++)
+		threads.push_back(std::thread([&, t]
+		{
+			do
+			{
+				for (uint32_t i = 0; i < kNumStable; i++)
+					if (h.get(i) != i)
+						misses[t]++;
+			} while (writers_done.load() < nWriters);
+		}));
+
+	for (auto& t : threads)
+		t.join();
+
+	uint32_t nMisses = 0;
+	for (uint32_t m : misses)
+		nMisses += m;
+	oTEST(nMisses == 0, "%u reads missed a key during migration", nMisses);
+	oTEST(h.num_migrations() > 0, "writers should have forced a migration");
+}
+
+// 90% gets, 10% sets over a key range sized to the specified load factor of
+// the initial table
+static double benchmark(uint32_t num_threads, uint32_t load_percent)
+{
+	static const uint32_t kInitialCapacity = 1 << 16;
+	static const uint32_t kOpsPerThread = 200000;
+	map_t h(kInitialCapacity);
+	const uint32_t nKeys = kInitialCapacity * load_percent / 100;
+
+	std::vector<std::thread> threads(num_threads);
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t t = 0; t < num_threads; t++)
+		threads[t] = std::thread([&, t]
+		{
+			uint32_t seed = t + 1;
+			for (uint32_t i = 0; i < kOpsPerThread; i++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				const uint64_t key = (seed >> 8) % nKeys;
+				if ((seed >> 24) < 26)
+					h.set(key, i);
+				else
+					h.get(key);
+			}
+		});
+
+	for (auto& t : threads)
+		t.join();
+
+	const double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - start).count();
+	return (num_threads * kOpsPerThread) / seconds / 1e6;
+}
+
+static void test_throughput(test_services& services)
+{
+	static const uint32_t kLoads[] = { 25, 50, 75, 200 };
+	const uint32_t hw = std::max(1u, std::thread::hardware_concurrency());
+	const uint32_t thread_counts[] = { 1, 2, 4, hw };
+
+	for (uint32_t load : kLoads)
+	{
+		sstring line;
+		for (uint32_t n : thread_counts)
+			sncatf(line, " %ut:%.1f", n, benchmark(n, load));
+		services.report("load %u%% Mops/s%s", load, line.c_str());
+	}
+}
+
+void TESTconcurrent_growable_hash_map(test_services& services)
+{
+	test_growth(services);
+	test_concurrency(services);
+	test_reads_during_migration(services);
+	test_throughput(services);
+}
+
+}}
@@ -1,9 +1,13 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oConcurrency/concurrency.h>
+#include <oConcurrency/broadcast_queue.h>
+#include <oConcurrency/concurrent_bounded_queue.h>
 #include <oConcurrency/concurrent_queue.h>
 #include <oConcurrency/concurrent_queue_opt.h>
+#include <oConcurrency/lock_free_queue.h>
 #include <oConcurrency/threadpool.h>
 #include <oConcurrency/event.h>
+#include <algorithm>
 #include <atomic>
 #include <thread>
 #include <vector>
@@ -303,9 +307,50 @@ void TestQueueT(test_services& services, const char* queue_name)
 
 #define oTEST_QUEUET(_QueueType) TestQueueT<_QueueType<int>, _QueueType<std::shared_ptr<test_buffer>>>(services, #_QueueType)
 
+static void test_queue_overflow(test_services& services)
+{
+	static const uint32_t kCapacity = 16;
+	static const int kNumPushes = 1000;
+
+	// a burst past the pool takes overflow nodes from the allocator
+	{
+		concurrent_queue<int> q(kCapacity);
+		for (int i = 0; i < kNumPushes; i++)
+			q.push(i);
+		oTEST(q.size() == kNumPushes, "expected %d elements, got %u", kNumPushes, q.size());
+		int val = -1;
+		for (int i = 0; i < kNumPushes; i++)
+			oTEST(q.try_pop(val) && val == i, "popped %d, expected %d", val, i);
+		oTEST(q.empty(), "queue should be empty");
+	}
+
+	// without an allocator the queue waits for retired nodes instead, and only
+	// a pool full of live elements is an error
+	{
+		std::vector<char> mem(concurrent_queue<int>::calc_size(kCapacity));
+		concurrent_queue<int> q;
+		q.deinitialize();
+		q.initialize(mem.data(), kCapacity);
+		for (int i = 0; i < int(kCapacity) - 1; i++)
+			q.push(i);
+
+		bool threw = false;
+		try { q.push(-1); }
+		catch (std::bad_alloc&) { threw = true; }
+		oTEST(threw, "push into a queue full of live elements should throw");
+
+		int val = -1;
+		oTEST(q.try_pop(val) && val == 0, "popped %d, expected 0", val);
+		q.push(kCapacity);
+		q.clear();
+		oTEST(q.empty(), "queue should be empty");
+	}
+}
+
 void TESTconcurrent_queue(test_services& services)
 {
 	oTEST_QUEUET(concurrent_queue);
+	test_queue_overflow(services);
 }
 
 void TESTconcurrent_queue_opt(test_services& services)
@@ -313,6 +358,299 @@ void TESTconcurrent_queue_opt(test_services& services)
 	oTEST_QUEUET(concurrent_queue_opt);
 }
 
+static void test_bounded_queue_limits(test_services& services)
+{
+	concurrent_bounded_queue<int> q(8);
+
+	for (int i = 0; i < 8; i++)
+		oTEST(q.try_push(i), "try_push into a non-full queue failed");
+	oTEST(!q.try_push(8), "try_push into a full queue succeeded");
+	oTEST(q.size() == 8, "expected 8 elements, got %u", q.size());
+
+	int vals[16];
+	oTEST(q.try_pop(vals, 5) == 5, "batch pop failed");
+	for (int i = 0; i < 5; i++)
+		oTEST(vals[i] == i, "batch pop returned %d, expected %d", vals[i], i);
+
+	// wraps around the end of the ring and can only take what's free
+	for (int i = 0; i < 16; i++)
+		vals[i] = 100 + i;
+	oTEST(q.try_push(vals, 16) == 5, "batch push should have been clipped to the free room");
+	oTEST(q.try_pop(vals, 16) == 8, "batch pop should have emptied the queue");
+	oTEST(vals[0] == 5 && vals[2] == 7 && vals[3] == 100 && vals[7] == 104, "batch pop out of order");
+	oTEST(q.try_pop(vals, 16) == 0 && q.empty(), "queue should be empty");
+}
+
+// producers push batches tagged with their index while consumers pop batches
+// and check each producer's values arrive in order
+static void test_bounded_queue_batches(test_services& services)
+{
+	static const int kNumPerProducer = 50000;
+	static const int kBatch = 16;
+	const int nProducers = 2, nConsumers = 2;
+
+	concurrent_bounded_queue<int> q(256);
+	std::vector<std::thread> threads;
+	std::atomic<int> popped(0);
+	std::atomic<int> failures(0);
+	std::atomic<long long> sum(0);
+
+	for (int p = 0; p < nProducers; p++)
+		threads.push_back(std::thread([&, p]
+		{
+			int vals[kBatch];
+			int next = 0;
+			while (next < kNumPerProducer)
+			{
+				const int n = std::min(kBatch, kNumPerProducer - next);
+				for (int i = 0; i < n; i++)
+					vals[i] = (p << 24) | (next + i);
+				int pushed = 0;
+				backoff bo;
+				while (pushed < n)
+				{
+					const int k = q.try_push(vals + pushed, n - pushed);
+					pushed += k;
+					if (!k)
+						bo.pause();
+				}
+				next += n;
+			}
+		}));
+
+	for (int c = 0; c < nConsumers; c++)
+		threads.push_back(std::thread([&]
+		{
+			int last[2] = { -1, -1 };
+			int vals[kBatch];
+			long long local_sum = 0;
+			backoff bo;
+			while (popped < nProducers * kNumPerProducer)
+			{
+				const int n = q.try_pop(vals, kBatch);
+				if (!n)
+				{
+					bo.pause();
+					continue;
+				}
+				popped += n;
+				for (int i = 0; i < n; i++)
+				{
+					const int p = vals[i] >> 24, v = vals[i] & 0xffffff;
+					if (v <= last[p])
+						failures++;
+					last[p] = v;
+					local_sum += v;
+				}
+			}
+			sum += local_sum;
+		}));
+
+	for (auto& t : threads)
+		t.join();
+
+	const long long expected = nProducers * ((long long)kNumPerProducer * (kNumPerProducer - 1) / 2);
+	oTEST(failures == 0, "%d values were popped out of order", failures.load());
+	oTEST(sum == expected, "lost or duplicated values");
+	oTEST(q.empty(), "queue should be empty");
+}
+
+void TESTconcurrent_bounded_queue(test_services& services)
+{
+	oTEST_QUEUET(concurrent_bounded_queue);
+	test_bounded_queue_limits(services);
+	test_bounded_queue_batches(services);
+}
+
+void TESTbroadcast_queue(test_services& services)
+{
+	{
+		broadcast_queue<int> q(4, 2);
+		for (int i = 0; i < 4; i++)
+			oTEST(q.try_push(i), "try_push into a non-full queue failed");
+		oTEST(!q.try_push(4), "try_push should fail while a reader is a full ring behind");
+
+		int val = -1;
+		oTEST(q.try_pop(0, val) && val == 0, "reader 0 should see the first element");
+		oTEST(!q.try_push(4), "try_push should wait for the slowest reader");
+		oTEST(q.try_pop(1, val) && val == 0, "reader 1 should see the first element");
+		oTEST(q.try_push(4) && !q.try_push(5), "try_push should make room for exactly one element");
+
+		int vals[8];
+		oTEST(q.try_pop(0, vals, 8) == 4 && vals[0] == 1 && vals[3] == 4, "batch pop for reader 0 failed");
+		oTEST(q.empty(0) && q.size(1) == 4, "readers should be independent");
+		oTEST(q.try_pop(1, vals, 8) == 4 && vals[3] == 4 && q.empty(1), "batch pop for reader 1 failed");
+	}
+
+	// every reader must see every element in order
+	static const int kNumElements = 200000;
+	// hardware_concurrency() may be 0, so clamp rather than subtract blindly
+	const uint32_t nCores = std::thread::hardware_concurrency();
+	const uint32_t nReaders = std::min<uint32_t>(broadcast_queue<int>::max_readers, std::max(2u, nCores ? nCores - 1 : 0u));
+	broadcast_queue<int> q(1024, nReaders);
+	std::vector<uint32_t> failures(nReaders, 0);
+	std::vector<std::thread> readers(nReaders);
+	for (uint32_t r = 0; r < nReaders; r++)
+		readers[r] = std::thread([&, r]
+		{
+			int vals[32];
+			int expected = 0;
+			backoff bo;
+			while (expected < kNumElements)
+			{
+				const uint32_t n = q.try_pop(r, vals, (r & 1) ? 1 : 32);
+				if (!n)
+					bo.pause();
+				for (uint32_t i = 0; i < n; i++)
+					if (vals[i] != expected++)
+						failures[r]++;
+			}
+		});
+
+	for (int i = 0; i < kNumElements; i++)
+		q.push(i);
+
+	for (auto& t : readers)
+		t.join();
+
+	uint32_t nFailures = 0;
+	for (uint32_t f : failures)
+		nFailures += f;
+	oTEST(nFailures == 0, "%u elements were missed or seen out of order", nFailures);
+}
+
+// moves num_items ints from num_producers to num_consumers and returns the
+// millions of items moved per second
+template<typename QueueT>
+static double queue_throughput(test_services& services, uint32_t capacity, uint32_t num_producers, uint32_t num_consumers, uint32_t num_items)
+{
+	QueueT q(capacity);
+	const uint32_t num_per_producer = num_items / num_producers;
+	const uint32_t num_pushed = num_per_producer * num_producers;
+	std::atomic<uint32_t> popped(0);
+	std::vector<std::thread> threads;
+	const double start = services.now();
+
+	for (uint32_t p = 0; p < num_producers; p++)
+		threads.push_back(std::thread([&]
+		{
+			for (uint32_t i = 0; i < num_per_producer; i++)
+				q.push(int(i));
+		}));
+
+	for (uint32_t c = 0; c < num_consumers; c++)
+		threads.push_back(std::thread([&]
+		{
+			int val;
+			backoff bo;
+			while (popped.load(std::memory_order_relaxed) < num_pushed)
+			{
+				if (q.try_pop(val))
+				{
+					popped.fetch_add(1, std::memory_order_relaxed);
+					bo.reset();
+				}
+				else
+					bo.pause();
+			}
+		}));
+
+	for (auto& t : threads)
+		t.join();
+
+	return num_pushed / (services.now() - start) / 1e6;
+}
+
+// bounces a value between two threads and returns the average microseconds for
+// a round trip
+template<typename QueueT>
+static double queue_latency(test_services& services, uint32_t num_round_trips)
+{
+	QueueT ping(1024), pong(1024);
+	std::thread echo([&]
+	{
+		int val;
+		for (uint32_t i = 0; i < num_round_trips; i++)
+		{
+			backoff bo;
+			while (!ping.try_pop(val))
+				bo.pause();
+			pong.push(val);
+		}
+	});
+
+	const double start = services.now();
+	int val;
+	for (uint32_t i = 0; i < num_round_trips; i++)
+	{
+		ping.push(int(i));
+		backoff bo;
+		while (!pong.try_pop(val))
+			bo.pause();
+	}
+	const double seconds = services.now() - start;
+	echo.join();
+	return seconds / num_round_trips * 1e6;
+}
+
+static double broadcast_throughput(test_services& services, uint32_t num_readers, uint32_t num_items)
+{
+	broadcast_queue<int> q(1024, num_readers);
+	std::vector<std::thread> readers(num_readers);
+	const double start = services.now();
+	for (uint32_t r = 0; r < num_readers; r++)
+		readers[r] = std::thread([&, r]
+		{
+			int vals[64];
+			uint32_t n = 0;
+			backoff bo;
+			while (n < num_items)
+			{
+				const uint32_t k = q.try_pop(r, vals, 64);
+				n += k;
+				if (k)
+					bo.reset();
+				else
+					bo.pause();
+			}
+		});
+
+	for (uint32_t i = 0; i < num_items; i++)
+		q.push(int(i));
+
+	for (auto& t : readers)
+		t.join();
+
+	return num_items / (services.now() - start) / 1e6;
+}
+
+void TESTconcurrent_queue_comparison(test_services& services)
+{
+	static const uint32_t kNumItems = 1 << 18;
+	static const uint32_t kNumRoundTrips = 20000;
+	const uint32_t half = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+	services.report("1p1c Mops/s: concurrent_queue %.1f, concurrent_queue_opt %.1f, concurrent_bounded_queue %.1f, lock_free_queue %.1f, broadcast_queue %.1f"
+		, queue_throughput<concurrent_queue<int>>(services, kNumItems * 2, 1, 1, kNumItems)
+		, queue_throughput<concurrent_queue_opt<int>>(services, kNumItems * 2, 1, 1, kNumItems)
+		, queue_throughput<concurrent_bounded_queue<int>>(services, 1024, 1, 1, kNumItems)
+		, queue_throughput<lock_free_queue<int>>(services, kNumItems * 2, 1, 1, kNumItems)
+		, broadcast_throughput(services, 1, kNumItems));
+
+	services.report("%up%uc Mops/s: concurrent_queue %.1f, concurrent_queue_opt %.1f, concurrent_bounded_queue %.1f; broadcast_queue to %u readers %.1f"
+		, half, half
+		, queue_throughput<concurrent_queue<int>>(services, kNumItems * 2, half, half, kNumItems)
+		, queue_throughput<concurrent_queue_opt<int>>(services, kNumItems * 2, half, half, kNumItems)
+		, queue_throughput<concurrent_bounded_queue<int>>(services, 1024, half, half, kNumItems)
+		, half, broadcast_throughput(services, half, kNumItems));
+
+	services.report("round trip us: concurrent_queue %.2f, concurrent_queue_opt %.2f, concurrent_bounded_queue %.2f, lock_free_queue %.2f"
+		, queue_latency<concurrent_queue<int>>(services, kNumRoundTrips)
+		, queue_latency<concurrent_queue_opt<int>>(services, kNumRoundTrips)
+		, queue_latency<concurrent_bounded_queue<int>>(services, kNumRoundTrips)
+		, queue_latency<lock_free_queue<int>>(services, kNumRoundTrips));
+}
+
 static const int kNumTasks = 50000;
 static const int kPoppedFlag = 0x80000000;
 static const int kStolenFlag = 0x40000000;
@@ -0,0 +1,140 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/epoch.h>
+#include <oConcurrency/event.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../../test_services.h"
+
+namespace ouro { namespace tests {
+
+static void count_reclaim(void* pointer, void* context)
+{
+	(*(std::atomic<uint32_t>*)context)++;
+}
+
+// A Treiber stack with plain pointers: without epoch reclamation pop would read
+// next from a node another thread may have already freed, and a recycled node
+// could pass the CAS (ABA).
+struct untagged_stack
+{
+	struct node
+	{
+		node(uint32_t v, std::atomic<uint32_t>* num_deleted) : next(nullptr), value(v), num_deleted(num_deleted) {}
+		~node() { (*num_deleted)++; }
+		node* next;
+		uint32_t value;
+		std::atomic<uint32_t>* num_deleted;
+	};
+
+	untagged_stack() { head.store(nullptr); }
+
+	void push(node* n)
+	{
+		node* h = head.load();
+		do { n->next = h;
+		} while (!head.compare_exchange_weak(h, n));
+	}
+
+	bool pop(uint32_t& value)
+	{
+		node* h = nullptr;
+		{
+			epoch::guard g;
+			h = head.load();
+			while (h && !head.compare_exchange_weak(h, h->next));
+			if (!h)
+				return false;
+			value = h->value;
+		}
+		epoch::retire(h);
+		return true;
+	}
+
+	std::atomic<node*> head;
+};
+
+void TESTepoch(test_services& services)
+{
+	{
+		std::atomic<uint32_t> nReclaimed(0);
+		static const uint32_t kNumRetires = 1000;
+		for (uint32_t i = 0; i < kNumRetires; i++)
+			epoch::retire(nullptr, count_reclaim, &nReclaimed);
+		epoch::synchronize();
+		oTEST(nReclaimed == kNumRetires, "synchronize reclaimed %u of %u nodes", nReclaimed.load(), kNumRetires);
+		oTEST(epoch::num_pending() == 0, "%u nodes still pending after synchronize", epoch::num_pending());
+	}
+
+	// a guarded reader holds back reclamation of anything retired while it reads
+	{
+		std::atomic<uint32_t> nReclaimed(0);
+		event entered, done;
+		std::thread reader([&]
+		{
+			{
+				epoch::guard g;
+				entered.set();
+				done.wait();
+			}
+			epoch::release_thread();
+		});
+
+		entered.wait();
+		epoch::retire(nullptr, count_reclaim, &nReclaimed);
+		const uint32_t t = epoch::ticket();
+		for (int i = 0; i < 10; i++)
+			epoch::update();
+		oTEST(nReclaimed == 0 && !epoch::expired(t), "a node was reclaimed while a reader could still hold it");
+
+		done.set();
+		reader.join();
+		epoch::synchronize();
+		oTEST(nReclaimed == 1 && epoch::expired(t), "the node was not reclaimed after the reader left");
+	}
+
+	// popped nodes are freed while other threads pop and push, with no tags
+	{
+		static const uint32_t kNumNodes = 20000;
+		const uint32_t nThreads = std::max(4u, std::thread::hardware_concurrency());
+		std::atomic<uint32_t> nDeleted(0);
+		std::atomic<uint64_t> sum(0);
+		untagged_stack s;
+		for (uint32_t i = 0; i < kNumNodes; i++)
+			s.push(new untagged_stack::node(i, &nDeleted));
+
+		std::vector<std::thread> threads(nThreads);
+		const double start = services.now();
+		for (uint32_t t = 0; t < nThreads; t++)
+			threads[t] = std::thread([&, t]
+			{
+				uint64_t local_sum = 0;
+				uint32_t v = 0, n = 0;
+				while (s.pop(v))
+				{
+					local_sum += v;
+
+					// recycle some values so nodes churn through push and pop
+					if ((++n % 4) == t % 4)
+						s.push(new untagged_stack::node(0, &nDeleted));
+				}
+				sum += local_sum;
+				epoch::update();
+				epoch::release_thread();
+			});
+
+		for (auto& t : threads)
+			t.join();
+		const double elapsed = services.now() - start;
+
+		epoch::synchronize();
+		const uint64_t expected_sum = uint64_t(kNumNodes) * (kNumNodes - 1) / 2;
+		oTEST(sum == expected_sum, "popped values sum to %llu, expected %llu", sum.load(), expected_sum);
+		oTEST(nDeleted >= kNumNodes && epoch::num_pending() == 0, "retired nodes were not all reclaimed");
+		services.report("%u threads popped %u+ nodes in %.2f ms", nThreads, nDeleted.load(), elapsed * 1000.0);
+	}
+}
+
+}}
@@ -0,0 +1,79 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/event.h>
+#include <oConcurrency/countdown_latch.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../../test_services.h"
+
+namespace ouro { namespace tests {
+
+void TESTevent(test_services& services)
+{
+	{
+		event e;
+		oTEST(!e.is_set(), "event should start reset");
+		oTEST(!e.wait_for(std::chrono::milliseconds(20)), "wait_for should time out on a reset event");
+		e.set();
+		oTEST(e.is_set() && e.wait_for(std::chrono::milliseconds(20)), "wait_for should not block on a set event");
+		e.wait();
+		e.reset();
+		oTEST(!e.is_set(), "reset failed");
+	}
+
+	// waiters wake for all or any of the masks they wait on
+	{
+		event e;
+		std::atomic<int> nWoken(0);
+		std::atomic<int> any_mask(0);
+		std::thread all([&] { e.wait(0x3); nWoken++; });
+		std::thread any([&] { any_mask = e.wait_any(0x6); nWoken++; });
+
+		e.set(0x1);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		oTEST(nWoken == 0, "no waiter should have woken on 0x1");
+		e.set(0x4);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		oTEST(nWoken == 1 && (any_mask & 0x4), "wait_any should have woken on 0x4");
+		e.set(0x2);
+		all.join();
+		any.join();
+		oTEST(nWoken == 2, "wait should have woken on 0x3");
+		oTEST(e.wait_for_any(std::chrono::milliseconds(1), 0x8) == 0, "wait_for_any should time out on an unset bit");
+	}
+
+	// an autoreset set() releases the current waiters and leaves the event reset
+	{
+		event e(autoreset);
+		static const int kNumWaiters = 4;
+		std::atomic<int> nWoken(0);
+		std::vector<std::thread> waiters;
+		for (int i = 0; i < kNumWaiters; i++)
+			waiters.push_back(std::thread([&] { e.wait(); nWoken++; }));
+
+		// a waiter that hadn't started waiting would miss a pulse, so keep pulsing
+		while (nWoken < kNumWaiters)
+		{
+			e.set();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		for (auto& t : waiters)
+			t.join();
+		oTEST(nWoken == kNumWaiters, "autoreset set() should wake every waiter");
+		oTEST(!e.is_set() && !e.wait_for(std::chrono::milliseconds(10)), "autoreset event should be left reset");
+	}
+
+	{
+		countdown_latch latch(2);
+		oTEST(latch.wait_for(std::chrono::milliseconds(10)) == std::cv_status::timeout, "latch wait_for should time out");
+		latch.release();
+		latch.reference();
+		latch.release();
+		std::thread([&] { latch.release(); }).join();
+		oTEST(latch.wait_for(std::chrono::milliseconds(10)) == std::cv_status::no_timeout && latch.outstanding() == 0, "latch should be released");
+	}
+}
+
+}}
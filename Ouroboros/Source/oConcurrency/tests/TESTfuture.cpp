@@ -2,6 +2,7 @@
 #include <oConcurrency/concurrency.h>
 #include <oConcurrency/future.h>
 #include <thread>
+#include <vector>
 
 #include "../../test_services.h"
 #include <oCore/windows/win_crt_leak_tracker.h>
@@ -42,6 +43,70 @@ static bool fail_and_report()
 	return false;
 }
 
+static void test_continuations(ouro::test_services& services)
+{
+	// then() chain
+	{
+		ouro::promise<int> p;
+		ouro::future<int> f = p.get_future();
+		ouro::future<int> doubled = f.then([](ouro::future<int> r) { return r.get() * 2; });
+		oTEST(!f.valid(), "then() should invalidate the source future");
+		ouro::future<void> done = doubled.then([](ouro::future<int> r) { if (r.get() != 42) throw std::invalid_argument("bad continuation value"); });
+		p.set_value(21);
+		done.get();
+	}
+
+	// then() on an already-ready future, and exception propagation
+	{
+		ouro::future<int> f = ouro::async([] { return 1; });
+		f.wait();
+		oTEST(f.then([](ouro::future<int> r) { return r.get() + 1; }).get() == 2, "then() on a ready future failed");
+
+		ouro::promise<int> p;
+		ouro::future<int> f2 = p.get_future().then([](ouro::future<int> r) { return r.get() + 1; });
+		p.set_exception(std::make_exception_ptr(std::invalid_argument("expected")));
+		bool threw = false;
+		try { f2.get(); }
+		catch (std::invalid_argument&) { threw = true; }
+		oTEST(threw, "exception did not propagate through then()");
+	}
+
+	// when_all over a wide graph: nothing should block a worker
+	{
+		static const int kNumFutures = 256;
+		std::vector<ouro::future<int>> futures;
+		for (int i = 0; i < kNumFutures; i++)
+			futures.push_back(ouro::async([=] { return i; }).then([](ouro::future<int> r) { return r.get() * 2; }));
+
+		ouro::future<int> sum = ouro::when_all(futures.begin(), futures.end()).then([](ouro::future<std::vector<ouro::future<int>>> r)
+		{
+			std::vector<ouro::future<int>> all = r.get();
+			int s = 0;
+			for (auto it = all.begin(); it != all.end(); ++it)
+				s += it->get();
+			return s;
+		});
+
+		oTEST(sum.get() == kNumFutures * (kNumFutures-1), "when_all produced the wrong result");
+	}
+
+	// when_any
+	{
+		ouro::promise<int> p[3];
+		std::vector<ouro::future<int>> futures;
+		for (int i = 0; i < 3; i++)
+			futures.push_back(p[i].get_future());
+
+		auto any = ouro::when_any(futures.begin(), futures.end());
+		oTEST(!any.is_ready(), "when_any should not be ready before any future is");
+		p[1].set_value(7);
+		auto r = any.get();
+		oTEST(r.index == 1 && r.futures[1].get() == 7, "when_any reported the wrong future");
+		p[0].set_value(0);
+		p[2].set_value(0);
+	}
+}
+
 static void test_workstealing(ouro::test_services& services)
 {
 	float CPUavg = 0.0f, CPUpeak = 0.0f;
@@ -166,6 +231,8 @@ void TESTfuture(ouro::test_services& services)
 		services.report("Testing graceful failure - done.");
 	}
 
+	test_continuations(services);
+
 	test_workstealing(services);
 };
 
@@ -0,0 +1,217 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/mutex.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// MSVC reports __cplusplus as 199711L unless /Zc:__cplusplus is set, so ask
+// _MSVC_LANG there. Either way std::shared_mutex is only compared against if
+// the library says it has one.
+#if defined(_MSVC_LANG)
+	#define oTEST_CPLUSPLUS _MSVC_LANG
+#else
+	#define oTEST_CPLUSPLUS __cplusplus
+#endif
+#if oTEST_CPLUSPLUS >= 201703L
+	#include <shared_mutex>
+#endif
+#if defined(__cpp_lib_shared_mutex) || (defined(_MSC_VER) && oTEST_CPLUSPLUS >= 201703L)
+	#define oTEST_HAS_STD_SHARED_MUTEX 1
+#else
+	#define oTEST_HAS_STD_SHARED_MUTEX 0
+#endif
+
+#include "../../test_services.h"
+
+namespace ouro { namespace tests {
+
+static uint32_t num_test_threads()
+{
+	return std::max(4u, std::thread::hardware_concurrency());
+}
+
+// runs fn(thread_index) on num_threads threads and returns the seconds it took
+template<typename FnT>
+static double run_threads(test_services& services, uint32_t num_threads, FnT fn)
+{
+	std::vector<std::thread> threads(num_threads);
+	const double start = services.now();
+	for (uint32_t t = 0; t < num_threads; t++)
+		threads[t] = std::thread(fn, t);
+	for (auto& t : threads)
+		t.join();
+	return services.now() - start;
+}
+
+template<typename MutexT>
+static double bench_exclusive(test_services& services, uint32_t num_threads, uint32_t num_ops)
+{
+	MutexT m;
+	uint32_t counter = 0;
+	return run_threads(services, num_threads, [&](uint32_t)
+	{
+		for (uint32_t i = 0; i < num_ops; i++)
+		{
+			m.lock();
+			counter++;
+			m.unlock();
+		}
+	}) * 1e9 / (num_threads * num_ops);
+}
+
+void TESTmutex(test_services& services)
+{
+	static const uint32_t kNumOps = 50000;
+	const uint32_t nThreads = num_test_threads();
+
+	{
+		mutex m;
+		oTEST(m.try_lock(), "try_lock on an unlocked mutex failed");
+		oTEST(!m.try_lock(), "try_lock on a locked mutex succeeded");
+		m.unlock();
+
+		uint32_t counter = 0;
+		run_threads(services, nThreads, [&](uint32_t)
+		{
+			for (uint32_t i = 0; i < kNumOps; i++)
+			{
+				lock_guard<mutex> lock(m);
+				counter++;
+			}
+		});
+		oTEST(counter == nThreads * kNumOps, "mutex failed to exclude: counted %u, expected %u", counter, nThreads * kNumOps);
+	}
+
+	{
+		recursive_mutex m;
+		m.lock();
+		oTEST(m.try_lock(), "recursive_mutex should relock on the owning thread");
+		bool other_locked = true;
+		std::thread([&] { other_locked = m.try_lock(); if (other_locked) m.unlock(); }).join();
+		oTEST(!other_locked, "recursive_mutex locked from another thread while owned");
+		m.unlock();
+		m.unlock();
+		std::thread([&] { other_locked = m.try_lock(); if (other_locked) m.unlock(); }).join();
+		oTEST(other_locked, "recursive_mutex not released by the last unlock");
+	}
+
+	{
+		once_flag flag;
+		std::atomic<uint32_t> num_calls(0);
+		run_threads(services, nThreads, [&](uint32_t)
+		{
+			call_once(flag, [&] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); num_calls++; });
+		});
+		oTEST(num_calls == 1, "call_once ran %u times", num_calls.load());
+	}
+
+	services.report("%u threads ns/lock: ouro::mutex %.1f, std::mutex %.1f"
+		, nThreads
+		, bench_exclusive<mutex>(services, nThreads, kNumOps)
+		, bench_exclusive<std::mutex>(services, nThreads, kNumOps));
+}
+
+// 1 in kWriteEvery operations is a write
+static const uint32_t kWriteEvery = 16;
+
+template<typename SharedMutexT>
+static double bench_shared(test_services& services, uint32_t num_threads, uint32_t num_ops)
+{
+	SharedMutexT m;
+	uint32_t a = 0, b = 0;
+	std::atomic<uint32_t> sink(0);
+	return run_threads(services, num_threads, [&](uint32_t t)
+	{
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < num_ops; i++)
+		{
+			if (((i + t) % kWriteEvery) == 0)
+			{
+				m.lock();
+				a++; b++;
+				m.unlock();
+			}
+			else
+			{
+				m.lock_shared();
+				sum += a + b;
+				m.unlock_shared();
+			}
+		}
+		sink += sum;
+	}) * 1e9 / (num_threads * num_ops);
+}
+
+// std::mutex in shared_mutex clothing for compilers without std::shared_mutex
+struct exclusive_only_mutex : std::mutex
+{
+	void lock_shared() { lock(); }
+	void unlock_shared() { unlock(); }
+};
+
+void TESTshared_mutex(test_services& services)
+{
+	static const uint32_t kNumOps = 50000;
+	const uint32_t nThreads = num_test_threads();
+
+	{
+		shared_mutex m;
+		oTEST(m.try_lock_shared() && m.try_lock_shared(), "readers should share the lock");
+		oTEST(!m.try_lock(), "a writer locked while readers hold the lock");
+		m.unlock_shared();
+		m.unlock_shared();
+		oTEST(m.try_lock(), "a writer could not lock an unlocked shared_mutex");
+		oTEST(!m.try_lock_shared(), "a reader locked while a writer holds the lock");
+		m.unlock();
+	}
+
+	// writers keep a and b equal and readers must never see them differ
+	{
+		shared_mutex m;
+		uint32_t a = 0, b = 0;
+		std::atomic<uint32_t> nTorn(0);
+		run_threads(services, nThreads, [&](uint32_t t)
+		{
+			for (uint32_t i = 0; i < kNumOps; i++)
+			{
+				if (((i + t) % kWriteEvery) == 0)
+				{
+					lock_guard<shared_mutex> lock(m);
+					a++;
+					std::this_thread::yield();
+					b++;
+				}
+				else
+				{
+					shared_lock<shared_mutex> lock(m);
+					if (a != b)
+						nTorn++;
+				}
+			}
+		});
+
+		uint32_t nWrites = 0;
+		for (uint32_t t = 0; t < nThreads; t++)
+			for (uint32_t i = 0; i < kNumOps; i++)
+				nWrites += ((i + t) % kWriteEvery) == 0;
+		oTEST(nTorn == 0, "readers saw %u torn writes", nTorn.load());
+		oTEST(a == nWrites && b == nWrites, "writes were lost");
+	}
+
+	#if oTEST_HAS_STD_SHARED_MUTEX
+		typedef std::shared_mutex std_shared_mutex;
+		const char* std_name = "std::shared_mutex";
+	#else
+		typedef exclusive_only_mutex std_shared_mutex;
+		const char* std_name = "std::mutex";
+	#endif
+
+	services.report("%u threads ns/op (1/%u writes): ouro::shared_mutex %.1f, %s %.1f"
+		, nThreads, kWriteEvery
+		, bench_shared<shared_mutex>(services, nThreads, kNumOps)
+		, std_name, bench_shared<std_shared_mutex>(services, nThreads, kNumOps));
+}
+
+}}
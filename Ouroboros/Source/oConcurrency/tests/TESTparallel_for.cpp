@@ -1,5 +1,7 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oConcurrency/concurrency.h>
+#include <atomic>
+#include <vector>
 #include "../../test_services.h"
 
 namespace ouro { namespace tests {
@@ -56,6 +58,32 @@ void TESTparallel_for(test_services& services)
 		, "ouro::parallel_for failed to compute singlethreaded result");
 
 	parallel_for(0, mArraySize, std::bind(test_ab, std::placeholders::_1, &mTestArrayB[0], 2));
+
+	// Test range body: each index should be visited exactly once and there 
+	// should be far fewer chunks than indices.
+	{
+		static const size_t kRange = 1000000;
+		std::vector<unsigned char> visited(kRange, 0);
+		std::atomic<size_t> num_chunks(0);
+		parallel_for_range(3, kRange, [&](size_t begin, size_t end)
+		{
+			num_chunks++;
+			for (; begin < end; begin++)
+				visited[begin]++;
+		});
+
+		for (size_t i = 0; i < kRange; i++)
+			oTEST(visited[i] == (i < 3 ? 0 : 1), "ouro::parallel_for_range visited index %u %u times", (unsigned int)i, (unsigned int)visited[i]);
+
+		oTEST(num_chunks < kRange / 16, "ouro::parallel_for_range split %u indices into %u chunks", (unsigned int)kRange, (unsigned int)num_chunks.load());
+	}
+
+	// Test templated functor
+	{
+		std::atomic<int> sum(0);
+		parallel_for(0, mArraySize, [&](size_t i) { sum += (int)i; });
+		oTEST(sum == (mArraySize * (mArraySize-1)) / 2, "ouro::parallel_for with a functor body failed");
+	}
 };
 
 }}
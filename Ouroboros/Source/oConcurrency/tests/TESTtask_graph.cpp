@@ -0,0 +1,106 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oConcurrency/task_graph.h>
+#include <oConcurrency/threadpool.h>
+#include <oConcurrency/work_stealing_threadpool.h>
+#include <oConcurrency/tests/oConcurrencyTests.h>
+#include <atomic>
+#include <cstring>
+#include "../../test_services.h"
+
+namespace ouro { namespace tests {
+
+void TESTtask_graph(test_services& services)
+{
+	// diamond: A before B and C, both before D
+	{
+		task_graph g;
+		std::atomic<int> sequence(0);
+		int order[4];
+		task_graph::node_id A = g.add("A", [&] { order[0] = sequence++; });
+		task_graph::node_id B = g.add("B", [&] { order[1] = sequence++; });
+		task_graph::node_id C = g.add("C", [&] { order[2] = sequence++; }, 10.0);
+		task_graph::node_id D = g.add("D", [&] { order[3] = sequence++; });
+		g.precede(A, B);
+		g.precede(A, C);
+		g.precede(B, D);
+		g.precede(C, D);
+
+		// the graph should be reusable
+		for (int i = 0; i < 100; i++)
+		{
+			sequence = 0;
+			g.run();
+			oTEST(order[0] == 0, "A did not run first (run %d)", i);
+			oTEST(order[3] == 3, "D did not run last (run %d)", i);
+			oTEST(g.timing(A).end <= g.timing(B).start && g.timing(A).end <= g.timing(C).start, "timing shows B or C starting before A ended");
+			oTEST(g.timing(B).end <= g.timing(D).start && g.timing(C).end <= g.timing(D).start, "timing shows D starting before B or C ended");
+		}
+
+		oTEST(!strcmp(g.name(C), "C"), "node name was not retained");
+		oTEST(g.critical_path_seconds() <= g.last_run_seconds(), "critical path is longer than the run");
+
+		g.precede(D, A);
+		bool threw = false;
+		try { g.run(); }
+		catch (std::invalid_argument&) { threw = true; }
+		oTEST(threw, "a cycle was not detected");
+	}
+
+	// wide fan-out/fan-in
+	{
+		static const int kWidth = 1000;
+		task_graph g;
+		std::atomic<int> count(0);
+		int result = 0;
+		task_graph::node_id root = g.add("root", [&] { count = 0; });
+		task_graph::node_id sink = g.add("sink", [&] { result = count; });
+		for (int i = 0; i < kWidth; i++)
+		{
+			task_graph::node_id n = g.add("leaf", [&] { count++; });
+			g.precede(root, n);
+			g.precede(n, sink);
+		}
+
+		g.run();
+		oTEST(result == kWidth, "sink ran before all leaves completed (%d of %d)", result, kWidth);
+	}
+
+	// on a single worker, ready successors run in descending priority: the most
+	// critical continues on the thread and the rest are popped LIFO
+	{
+		static const int kNumSuccessors = 4;
+		work_stealing_threadpool<threadpool_default_traits> pool(1);
+		task_graph g([&](const std::function<void()>& task) { pool.dispatch(task); });
+		std::atomic<int> sequence(0);
+		int order[kNumSuccessors + 1];
+		task_graph::node_id root = g.add("root", [&] { order[0] = sequence++; });
+		for (int i = 1; i <= kNumSuccessors; i++)
+		{
+			// successor i is the i-th most critical
+			task_graph::node_id n = g.add("successor", [&, i] { order[i] = sequence++; }, double(kNumSuccessors + 1 - i));
+			g.precede(root, n);
+		}
+
+		g.run();
+		pool.join();
+		for (int i = 0; i <= kNumSuccessors; i++)
+			oTEST(order[i] == i, "the node with priority rank %d ran at position %d", i, order[i]);
+	}
+
+	// an exception is rethrown from run() and later nodes are skipped
+	{
+		task_graph g;
+		bool ran_after = false;
+		task_graph::node_id a = g.add("throws", [&] { throw std::range_error("expected"); });
+		task_graph::node_id b = g.add("after", [&] { ran_after = true; });
+		g.precede(a, b);
+
+		bool threw = false;
+		try { g.run(); }
+		catch (std::range_error&) { threw = true; }
+		oTEST(threw, "exception was not propagated out of run()");
+		oTEST(!ran_after, "a node ran after its predecessor threw");
+	}
+}
+
+}}
@@ -1,11 +1,14 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oConcurrency/concurrency.h>
 #include <oConcurrency/threadpool.h>
+#include <oConcurrency/work_stealing_threadpool.h>
 #include <oConcurrency/tests/oConcurrencyTests.h>
 #include <oMemory/byte.h>
 #include <oString/fixed_string.h>
 #include <oCore/thread_traits.h>
+#include <algorithm>
 #include <atomic>
+#include <thread>
 #include "../../test_services.h"
 
 namespace ouro { namespace tests {
@@ -77,6 +80,11 @@ template<typename ThreadpoolT> static void test_parallel_for(test_services& serv
 
 	for (size_t i = kFullRange-10; i < kFullRange; i++)
 		oTEST(Results[i] == 0, "wrote out of range at end");
+
+	memset(Results, 0, kFullRange * sizeof(size_t));
+	ouro::detail::parallel_for_range(thdpool, 10, kFullRange - 10, [&](size_t begin, size_t end) { for (; begin < end; begin++) Results[begin]++; });
+	for (size_t i = 0; i < kFullRange; i++)
+		oTEST(Results[i] == ((i < 10 || i >= kFullRange-10) ? 0 : 1), "parallel_for_range visited index %u %u times", (unsigned int)i, (unsigned int)Results[i]);
 }
 
 template<typename ThreadpoolT> static void TestT(test_services& services)
@@ -92,17 +100,44 @@ template<typename ThreadpoolT> static void TestT(test_services& services)
 void TESTthreadpool(test_services& services)
 {
 	TestT<threadpool<core_thread_traits>>(services);
+	TestT<work_stealing_threadpool<core_thread_traits>>(services);
 }
 
 void TESTtask_group(test_services& services)
 {
-	threadpool<core_thread_traits> t;
-	test_services::finally OSE([&] { if (t.joinable()) t.join(); });
+	{
+		threadpool<core_thread_traits> t;
+		test_services::finally OSE([&] { if (t.joinable()) t.join(); });
 
-	detail::task_group<core_thread_traits> g(t);
-	test_task_group(services, g);
+		detail::task_group<core_thread_traits> g(t);
+		test_task_group(services, g);
 	
-	test_parallel_for(services, t);
+		test_parallel_for(services, t);
+	}
+
+	{
+		work_stealing_threadpool<core_thread_traits> t;
+		test_services::finally OSE([&] { if (t.joinable()) t.join(); });
+
+		detail::work_stealing_task_group<core_thread_traits> g(t);
+		test_task_group(services, g);
+	
+		test_parallel_for(services, t);
+
+		// workers waiting on nested groups must keep running work rather than park
+		static const int kFanOut = 16;
+		std::atomic<int> nLeaves(0);
+		for (int i = 0; i < kFanOut; i++)
+			g.run([&]
+			{
+				detail::work_stealing_task_group<core_thread_traits> inner(t);
+				for (int j = 0; j < kFanOut; j++)
+					inner.run([&] { nLeaves++; });
+				inner.wait();
+			});
+		g.wait();
+		oTEST(nLeaves == kFanOut * kFanOut, "nested task groups ran %d of %d tasks", nLeaves.load(), kFanOut * kFanOut);
+	}
 }
 
 namespace RatcliffJobSwarm {
@@ -228,6 +263,7 @@ void TESTthreadpool_performance(ouro::test_services& services, test_threadpool&
 struct threadpool_impl : test_threadpool
 {
 	threadpool<threadpool_default_traits> t;
+	threadpool_impl(size_t num_workers) : t(num_workers) {}
 	~threadpool_impl() { if (t.joinable()) t.join(); }
 	const char* name() const override { return "threadpool"; }
 	void dispatch(const std::function<void()>& _Task) override { return t.dispatch(_Task); }
@@ -241,14 +277,42 @@ struct threadpool_impl : test_threadpool
 	void release() override { if (t.joinable()) t.join(); }
 };
 
+struct work_stealing_threadpool_impl : test_threadpool
+{
+	work_stealing_threadpool<threadpool_default_traits> t;
+	work_stealing_threadpool_impl(size_t num_workers) : t(num_workers) {}
+	~work_stealing_threadpool_impl() { if (t.joinable()) t.join(); }
+	const char* name() const override { return "work_stealing_threadpool"; }
+	void dispatch(const std::function<void()>& _Task) override { return t.dispatch(_Task); }
+	bool parallel_for(size_t _Begin, size_t _End, const std::function<void(size_t _Index)>& _Task) override
+	{
+		ouro::detail::parallel_for<16>(t, _Begin, _End, _Task);
+		return true;
+	}
+
+	void flush() override { t.flush(); }
+	void release() override { if (t.joinable()) t.join(); }
+};
+
 namespace {
 	// Implement this inside a TESTMyThreadpool() function.
-	template<typename test_threadpool_impl_t> void TESTthreadpool_performance_impl1(test_services& services)
+	template<typename test_threadpool_impl_t> void TESTthreadpool_performance_impl1(test_services& services, size_t num_workers)
 	{
-		test_threadpool_impl_t tp;
+		test_threadpool_impl_t tp(num_workers);
 		test_services::finally Release([&] { tp.release(); });
+		services.report("%u workers", static_cast<unsigned int>(num_workers));
 		TESTthreadpool_performance(services, tp);
 	}
+
+	// Runs the benchmark with 1, 2, 4... workers up to the number of hardware 
+	// threads to show how well the pool scales.
+	template<typename test_threadpool_impl_t> void TESTthreadpool_scaling(test_services& services)
+	{
+		const size_t kMaxWorkers = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t n = 1; n < kMaxWorkers; n *= 2)
+			TESTthreadpool_performance_impl1<test_threadpool_impl_t>(services, n);
+		TESTthreadpool_performance_impl1<test_threadpool_impl_t>(services, kMaxWorkers);
+	}
 }
 
 void TESTthreadpool_perf(test_services& services)
@@ -256,7 +320,8 @@ void TESTthreadpool_perf(test_services& services)
 	#ifdef _DEBUG
 		services.skip("This is slow in debug, and pointless as a benchmark.");
 	#else
-		TESTthreadpool_performance_impl1<threadpool_impl>(services);
+		TESTthreadpool_scaling<threadpool_impl>(services);
+		TESTthreadpool_scaling<work_stealing_threadpool_impl>(services);
 	#endif
 }
 
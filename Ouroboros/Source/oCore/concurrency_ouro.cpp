@@ -1,26 +1,35 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oConcurrency/concurrency.h>
 #include <oConcurrency/threadpool.h>
+#include <oConcurrency/work_stealing_threadpool.h>
 #include <oBase/throw.h>
 #include <oCore/process_heap.h>
 #include <oCore/thread_traits.h>
 #include <oMemory/allocate.h>
 
+// Set to 0 to fall back to the single-queue threadpool.
+#define oOURO_WORK_STEALING 1
+
 namespace ouro {
 
 class ouro_context
 {
 public:
 	typedef process_heap::std_allocator<std::function<void()>> allocator_type;
+#if oOURO_WORK_STEALING
+	typedef work_stealing_threadpool<core_thread_traits, allocator_type> threadpool_type;
+	typedef detail::work_stealing_task_group<core_thread_traits, allocator_type> task_group_type;
+#else
 	typedef threadpool<core_thread_traits, allocator_type> threadpool_type;
 	typedef detail::task_group<core_thread_traits, allocator_type> task_group_type;
+#endif
 
 	static ouro_context& singleton();
 	ouro_context() {}
 	~ouro_context() { tp.join(); }
 	inline threadpool_type& get_threadpool() { return tp; }
 	inline void dispatch(const std::function<void()>& _Task) { tp.dispatch(_Task); }
-	inline void parallel_for(size_t _Begin, size_t _End, const std::function<void(size_t _Index)>& _Task) { ouro::detail::parallel_for<16>(tp, _Begin, _End, _Task); }
+	inline void parallel_for_range(size_t _Begin, size_t _End, const std::function<void(size_t _Begin, size_t _End)>& _Task) { ouro::detail::parallel_for_range(tp, _Begin, _End, _Task); }
 private:
 	threadpool_type tp;
 };
@@ -89,9 +98,14 @@ void dispatch(const std::function<void()>& _Task)
 	ouro_context::singleton().dispatch(_Task);
 }
 
+void parallel_for_range(size_t _Begin, size_t _End, const std::function<void(size_t _Begin, size_t _End)>& _Task)
+{
+	ouro_context::singleton().parallel_for_range(_Begin, _End, _Task);
+}
+
 void parallel_for(size_t _Begin, size_t _End, const std::function<void(size_t _Index)>& _Task)
 {
-	ouro_context::singleton().parallel_for(_Begin, _End, _Task);
+	ouro_context::singleton().parallel_for_range(_Begin, _End, [&](size_t b, size_t e) { for (; b < e; b++) _Task(b); });
 }
 
 void at_thread_exit(const std::function<void()>& _Task)
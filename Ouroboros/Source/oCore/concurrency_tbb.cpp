@@ -140,9 +140,14 @@ void dispatch(const std::function<void()>& _Task)
 	tbb_context::singleton().dispatch(_Task);
 }
 
+void parallel_for_range(size_t _Begin, size_t _End, const std::function<void(size_t _Begin, size_t _End)>& _Task)
+{
+	::tbb::parallel_for(::tbb::blocked_range<size_t>(_Begin, _End), [&](const ::tbb::blocked_range<size_t>& r) { _Task(r.begin(), r.end()); });
+}
+
 void parallel_for(size_t _Begin, size_t _End, const std::function<void(size_t _Index)>& _Task)
 {
-	::tbb::parallel_for(_Begin, _End, _Task);
+	::tbb::parallel_for(::tbb::blocked_range<size_t>(_Begin, _End), [&](const ::tbb::blocked_range<size_t>& r) { for (size_t i = r.begin(); i < r.end(); i++) _Task(i); });
 }
 
 void at_thread_exit(const std::function<void()>& _Task)
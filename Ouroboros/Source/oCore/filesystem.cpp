@@ -582,7 +582,7 @@ void* map(const path& _Path
 	, unsigned long long _Offset
 	, unsigned long long _Size)
 {
-	HANDLE hFile = CreateFileA(_Path, _MapOption == map_option::binary_read ? GENERIC_READ : (GENERIC_READ|GENERIC_WRITE), 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	HANDLE hFile = CreateFileA(_Path, _MapOption == map_option::binary_write ? (GENERIC_READ|GENERIC_WRITE) : GENERIC_READ, _MapOption == map_option::binary_write ? 0 : FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
 	if (hFile == INVALID_HANDLE_VALUE)
 		oFSTHROWLAST();
 	finally CloseFile([&] { CloseHandle(hFile); });
@@ -594,13 +594,21 @@ void* map(const path& _Path
 	unsigned long long offsetPadding = _Offset - alignedOffset.as_ullong;
 	unsigned long long alignedSize = _Size + offsetPadding;
 
-	DWORD fProtect = _MapOption == map_option::binary_read ? PAGE_READONLY : PAGE_READWRITE;
+	DWORD fProtect = PAGE_READWRITE;
+	DWORD fAccess = FILE_MAP_WRITE;
+	switch (_MapOption)
+	{
+		case map_option::binary_read: fProtect = PAGE_READONLY; fAccess = FILE_MAP_READ; break;
+		case map_option::binary_copy_on_write: fProtect = PAGE_WRITECOPY; fAccess = FILE_MAP_COPY; break;
+		default: break;
+	}
+
 	HANDLE hMapped = CreateFileMapping(hFile, nullptr, fProtect, 0, 0, nullptr);
 	if (!hMapped)
 		oFSTHROWLAST();
 	finally CloseMapped([&] { CloseHandle(hMapped); });
 
-	void* p = MapViewOfFile(hMapped, fProtect == PAGE_READONLY ? FILE_MAP_READ : FILE_MAP_WRITE, alignedOffset.as_uint[1], alignedOffset.as_uint[0], as_type<SIZE_T>(alignedSize));
+	void* p = MapViewOfFile(hMapped, fAccess, alignedOffset.as_uint[1], alignedOffset.as_uint[0], as_type<SIZE_T>(alignedSize));
 	if (!p)
 		oFSTHROWLAST();
 
@@ -3,6 +3,7 @@
 #include <oCore/debugger.h>
 #include <oCore/process_heap.h>
 #include <oBase/throw.h>
+#include <oConcurrency/epoch.h>
 
 namespace ouro {
 
@@ -13,10 +14,12 @@ void core_thread_traits::begin_thread(const char* _ThreadName)
 
 void core_thread_traits::update_thread()
 {
+	epoch::update();
 }
 
 void core_thread_traits::end_thread()
 {
+	epoch::release_thread();
 	process_heap::exit_thread();
 }
 
@@ -0,0 +1,532 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMemory/concurrent_heap.h>
+#include <oMemory/byte.h>
+#include <oBase/assert.h>
+#include <oCompiler.h>
+#include <cstring>
+#include <new>
+#include <thread>
+
+namespace ouro {
+
+// Spans are requested a little short of span_size so consecutive spans pack
+// into consecutive slots despite tlsf's block headers and allocation label.
+static const size_t kSpanBytes = concurrent_heap::span_size - 256;
+
+// Owner fields and the remote list live on separate cache lines so frees from
+// other threads don't contend with the owner's allocations.
+static const size_t kSpanHeaderSize = 2 * oCACHE_LINE_SIZE;
+
+// 16-byte steps to 128, then 4 steps per power of two to max_small_size
+static const uint16_t kClassSizes[concurrent_heap::num_size_classes] =
+{
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256,
+	320, 384, 448, 512,
+	640, 768, 896, 1024,
+	1280, 1536, 1792, 2048,
+	2560, 3072, 3584, 4096,
+};
+
+static uint32_t size_class(size_t bytes)
+{
+	if (bytes <= 128)
+		return bytes ? uint32_t((bytes - 1) >> 4) : 0;
+
+	const size_t last = bytes - 1;
+	uint32_t bit = 7;
+	while (last >> (bit + 1))
+		bit++;
+	return 8 + (bit - 7) * 4 + uint32_t((last >> (bit - 2)) & 3);
+}
+
+struct concurrent_heap::span
+{
+	span* prev;
+	span* next;
+	thread_cache* owner;
+	void* free; // blocks freed by the owner
+	uint8_t* bump; // first never-allocated block
+	uint8_t* end;
+	uint32_t block_size;
+	uint32_t num_used; // includes blocks on the remote list
+	uint16_t size_class;
+	bool full;
+
+	// blocks freed by other threads
+	oALIGNAS(oCACHE_LINE_SIZE) std::atomic<void*> remote;
+
+	// moves the remote list to the free list and returns true if there was any
+	bool collect()
+	{
+		void* r = remote.exchange(nullptr, std::memory_order_acquire);
+		if (!r)
+			return false;
+		void* last = r;
+		uint32_t n = 1;
+		while (*(void**)last)
+		{
+			last = *(void**)last;
+			n++;
+		}
+		*(void**)last = free;
+		free = r;
+		num_used -= n;
+		return true;
+	}
+
+	void* pop()
+	{
+		void* p = free;
+		if (p)
+			free = *(void**)p;
+		else if (bump + block_size <= end)
+		{
+			p = bump;
+			bump += block_size;
+		}
+		else if (collect())
+		{
+			p = free;
+			free = *(void**)p;
+		}
+		else
+			return nullptr;
+		num_used++;
+		return p;
+	}
+
+	static void unlink(span*& head, span* s)
+	{
+		if (s->prev)
+			s->prev->next = s->next;
+		else
+			head = s->next;
+		if (s->next)
+			s->next->prev = s->prev;
+		s->prev = s->next = nullptr;
+	}
+
+	static void push_front(span*& head, span* s)
+	{
+		s->prev = nullptr;
+		s->next = head;
+		if (head)
+			head->prev = s;
+		head = s;
+	}
+
+	void push_remote(void* ptr)
+	{
+		void* head = remote.load(std::memory_order_relaxed);
+		do { *(void**)ptr = head;
+		} while (!remote.compare_exchange_weak(head, ptr, std::memory_order_release, std::memory_order_relaxed));
+	}
+};
+
+struct concurrent_heap::thread_cache
+{
+	struct size_class_t
+	{
+		span* partial; // the first is allocated from
+		span* full; // no free blocks the last time the owner looked
+	};
+
+	thread_cache* next;
+	std::atomic<uintptr_t> thread; // token of the owning thread, 0 if released
+	size_class_t classes[num_size_classes];
+};
+
+// the address of a thread-local is unique among live threads
+static oTHREAD_LOCAL char tl_token;
+static inline uintptr_t thread_token() { return (uintptr_t)&tl_token; }
+
+// the calling thread's cache for the heap it used last
+static oTHREAD_LOCAL uint32_t tl_heap_id;
+static oTHREAD_LOCAL void* tl_cache;
+
+static std::atomic<uint32_t> s_next_id(1);
+
+// allocator has no context pointer, so each bindable slot gets its own pair of
+// functions.
+static std::atomic<concurrent_heap*> s_bound[concurrent_heap::max_num_allocators];
+
+template<int slot> static void* bound_allocate(size_t num_bytes, const allocate_options& options, const char* label)
+{
+	return s_bound[slot].load()->allocate(num_bytes, label, options);
+}
+
+template<int slot> static void bound_deallocate(const void* pointer)
+{
+	s_bound[slot].load()->deallocate((void*)pointer);
+}
+
+static const allocator s_allocators[concurrent_heap::max_num_allocators] =
+{
+	allocator(bound_allocate<0>, bound_deallocate<0>),
+	allocator(bound_allocate<1>, bound_deallocate<1>),
+	allocator(bound_allocate<2>, bound_deallocate<2>),
+	allocator(bound_allocate<3>, bound_deallocate<3>),
+};
+
+concurrent_heap::concurrent_heap()
+	: span_map(nullptr)
+	, span_base(0)
+	, num_slots(0)
+	, id(0)
+{
+	arena_lock.clear();
+	caches.store(nullptr);
+}
+
+concurrent_heap::concurrent_heap(void* memory, size_t bytes)
+	: span_map(nullptr)
+	, span_base(0)
+	, num_slots(0)
+	, id(0)
+{
+	arena_lock.clear();
+	caches.store(nullptr);
+	initialize(memory, bytes);
+}
+
+concurrent_heap::~concurrent_heap()
+{
+	if (!span_map)
+		return;
+
+	// Destructors mustn't throw, so a leak is asserted rather than thrown and
+	// the leaked memory is abandoned with the arena. Resetting the arena also
+	// keeps its own destructor from throwing over the abandoned blocks.
+	if (num_outstanding())
+		oASSERT(false, "concurrent_heap destroyed with allocations outstanding");
+	release_all();
+	arena.reset();
+	arena.deinitialize();
+}
+
+void concurrent_heap::initialize(void* memory, size_t bytes)
+{
+	arena.initialize(memory, bytes);
+	span_base = (uintptr_t)memory & ~uintptr_t(span_size - 1);
+	num_slots = ((uintptr_t)memory + bytes - span_base + span_size - 1) / span_size;
+	span_map = (std::atomic<uint8_t>*)arena.allocate(num_slots, "concurrent_heap span map");
+	if (!span_map)
+		throw allocate_error(allocate_errc::out_of_memory);
+	for (size_t i = 0; i < num_slots; i++)
+		span_map[i].store(0, std::memory_order_relaxed);
+	id = s_next_id++;
+}
+
+void* concurrent_heap::deinitialize()
+{
+	if (!span_map)
+		return nullptr;
+
+	if (num_outstanding())
+		throw allocate_error(allocate_errc::outstanding_allocations);
+
+	release_all();
+	return arena.deinitialize();
+}
+
+size_t concurrent_heap::num_outstanding()
+{
+	size_t n = 0;
+	size_t nBookkeeping = 1; // the span map
+	for (thread_cache* c = caches.load(); c; c = c->next)
+	{
+		nBookkeeping++;
+		for (auto& sc : c->classes)
+		{
+			span* lists[2] = { sc.partial, sc.full };
+			for (span* s : lists)
+				for (; s; s = s->next)
+				{
+					s->collect();
+					n += s->num_used;
+					nBookkeeping++;
+				}
+		}
+	}
+
+	// whatever else the arena holds went straight to it from allocate()
+	const size_t nArena = arena.get_stats().num_allocations;
+	return n + (nArena > nBookkeeping ? nArena - nBookkeeping : 0);
+}
+
+void concurrent_heap::release_all()
+{
+	thread_cache* c = caches.load();
+	while (c)
+	{
+		for (auto& sc : c->classes)
+		{
+			span* lists[2] = { sc.partial, sc.full };
+			for (span* s : lists)
+				while (s)
+				{
+					span* next = s->next;
+					release_span(s);
+					s = next;
+				}
+		}
+
+		thread_cache* next = c->next;
+		arena.deallocate(c);
+		c = next;
+	}
+	caches.store(nullptr);
+
+	for (auto& b : s_bound)
+	{
+		concurrent_heap* self = this;
+		b.compare_exchange_strong(self, nullptr);
+	}
+
+	arena.deallocate(span_map);
+	span_map = nullptr;
+	num_slots = 0;
+	id = 0;
+}
+
+void concurrent_heap::lock()
+{
+	while (arena_lock.test_and_set(std::memory_order_acquire))
+		std::this_thread::yield();
+}
+
+void* concurrent_heap::arena_allocate(size_t bytes, const char* label, const allocate_options& options)
+{
+	lock();
+	void* p = arena.allocate(bytes, label, options);
+	unlock();
+	return p;
+}
+
+void concurrent_heap::arena_deallocate(void* ptr)
+{
+	lock();
+	arena.deallocate(ptr);
+	unlock();
+}
+
+// A slot's map entry only changes while nothing in it is allocated, and the
+// tail of a slot past kSpanBytes may belong to a neighboring tlsf block, so no
+// span header needs to be read to tell a span's block from an arena block.
+concurrent_heap::span* concurrent_heap::find_span(void* ptr) const
+{
+	const uintptr_t offset = (uintptr_t)ptr - span_base;
+	const size_t slot = offset / span_size;
+	if (slot >= num_slots || (offset % span_size) >= kSpanBytes || !span_map[slot].load(std::memory_order_relaxed))
+		return nullptr;
+	return (span*)(span_base + slot * span_size);
+}
+
+concurrent_heap::thread_cache* concurrent_heap::find_thread_cache(bool create)
+{
+	if (tl_heap_id == id)
+		return (thread_cache*)tl_cache;
+
+	const uintptr_t me = thread_token();
+	thread_cache* c = nullptr;
+	for (thread_cache* t = caches.load(); t && !c; t = t->next)
+		if (t->thread.load(std::memory_order_relaxed) == me)
+			c = t;
+
+	if (!c && !create)
+		return nullptr;
+
+	// adopt a released cache, spans and all
+	for (thread_cache* t = caches.load(); t && !c; t = t->next)
+	{
+		uintptr_t none = 0;
+		if (t->thread.compare_exchange_strong(none, me))
+			c = t;
+	}
+
+	if (!c)
+	{
+		lock();
+		c = (thread_cache*)arena.allocate(sizeof(thread_cache), "concurrent_heap thread cache", memory_alignment::cacheline);
+		if (c)
+		{
+			memset(c, 0, sizeof(thread_cache));
+			c->thread.store(me);
+			c->next = caches.load();
+			caches.store(c);
+		}
+		unlock();
+		if (!c)
+			return nullptr;
+	}
+
+	tl_heap_id = id;
+	tl_cache = c;
+	return c;
+}
+
+concurrent_heap::span* concurrent_heap::refill(thread_cache* c, uint32_t size_class)
+{
+	// other threads may have returned blocks to full spans
+	thread_cache::size_class_t& sc = c->classes[size_class];
+	for (span* s = sc.full; s;)
+	{
+		span* next = s->next;
+		if (s->collect())
+		{
+			span::unlink(sc.full, s);
+			s->full = false;
+			span::push_front(sc.partial, s);
+		}
+		s = next;
+	}
+
+	if (sc.partial)
+		return sc.partial;
+
+	static_assert(sizeof(span) <= kSpanHeaderSize, "span header too large");
+	lock();
+	span* s = (span*)arena.allocate(kSpanBytes, "concurrent_heap span", memory_alignment::align64k);
+	if (s)
+		span_map[((uintptr_t)s - span_base) / span_size].store(1, std::memory_order_relaxed);
+	unlock();
+	if (!s)
+		return nullptr;
+
+	s->prev = s->next = nullptr;
+	s->owner = c;
+	s->free = nullptr;
+	s->bump = (uint8_t*)s + kSpanHeaderSize;
+	s->block_size = kClassSizes[size_class];
+	s->end = s->bump + ((kSpanBytes - kSpanHeaderSize) / s->block_size) * s->block_size;
+	s->num_used = 0;
+	s->size_class = uint16_t(size_class);
+	s->full = false;
+	new (&s->remote) std::atomic<void*>(nullptr);
+	span::push_front(sc.partial, s);
+	return s;
+}
+
+void concurrent_heap::release_span(span* s)
+{
+	lock();
+	span_map[((uintptr_t)s - span_base) / span_size].store(0, std::memory_order_relaxed);
+	arena.deallocate(s);
+	unlock();
+}
+
+void concurrent_heap::free_local(thread_cache* c, span* s, void* ptr)
+{
+	*(void**)ptr = s->free;
+	s->free = ptr;
+	s->num_used--;
+
+	thread_cache::size_class_t& sc = c->classes[s->size_class];
+	if (s->full)
+	{
+		span::unlink(sc.full, s);
+		s->full = false;
+		span::push_front(sc.partial, s);
+	}
+
+	// keep the last span of a class to avoid thrashing the arena
+	else if (!s->num_used && (s->prev || s->next))
+	{
+		span::unlink(sc.partial, s);
+		release_span(s);
+	}
+}
+
+void* concurrent_heap::allocate(size_t bytes, const char* label, const allocate_options& options)
+{
+	if (bytes > max_small_size || options.get_alignment() > 16)
+		return arena_allocate(bytes, label, options);
+
+	thread_cache* c = find_thread_cache(true);
+	if (!c)
+		return nullptr;
+
+	const uint32_t sclass = size_class(bytes);
+	thread_cache::size_class_t& sc = c->classes[sclass];
+	for (;;)
+	{
+		span* s = sc.partial;
+		if (!s && !(s = refill(c, sclass)))
+			return nullptr;
+
+		if (void* p = s->pop())
+			return p;
+
+		span::unlink(sc.partial, s);
+		s->full = true;
+		span::push_front(sc.full, s);
+	}
+}
+
+void concurrent_heap::deallocate(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	span* s = find_span(ptr);
+	if (!s)
+		arena_deallocate(ptr);
+	else if (s->owner->thread.load(std::memory_order_relaxed) == thread_token())
+		free_local(s->owner, s, ptr);
+	else
+		s->push_remote(ptr);
+}
+
+size_t concurrent_heap::size(void* ptr) const
+{
+	const span* s = find_span(ptr);
+	return s ? s->block_size : arena.size(ptr);
+}
+
+void concurrent_heap::release_thread_cache()
+{
+	thread_cache* c = find_thread_cache(false);
+	if (!c)
+		return;
+
+	for (auto& sc : c->classes)
+	{
+		for (span* s = sc.full; s; s = s->next)
+			s->collect();
+
+		for (span* s = sc.partial; s;)
+		{
+			span* next = s->next;
+			s->collect();
+			if (!s->num_used)
+			{
+				span::unlink(sc.partial, s);
+				release_span(s);
+			}
+			s = next;
+		}
+	}
+
+	tl_heap_id = 0;
+	tl_cache = nullptr;
+	c->thread.store(0);
+}
+
+allocator concurrent_heap::get_allocator()
+{
+	for (uint32_t i = 0; i < max_num_allocators; i++)
+		if (s_bound[i].load() == this)
+			return s_allocators[i];
+
+	for (uint32_t i = 0; i < max_num_allocators; i++)
+	{
+		concurrent_heap* none = nullptr;
+		if (s_bound[i].compare_exchange_strong(none, this))
+			return s_allocators[i];
+	}
+
+	throw allocate_error(allocate_errc::invalid);
+}
+
+}
@@ -0,0 +1,170 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMemory/concurrent_heap.h>
+#include <oMemory/byte.h>
+#include <oConcurrency/concurrency.h>
+#include <oConcurrency/mutex.h>
+#include <oBase/macros.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../../test_services.h"
+
+namespace ouro {
+	namespace tests {
+
+static const size_t kNumTasks = 64;
+static const size_t kNumOps = 20000;
+
+static void test_basics(test_services& services, concurrent_heap& h)
+{
+	static const size_t kSizes[] = { 0, 1, 16, 17, 128, 129, 256, 257, 4095, 4096, 4097, oKB(100) };
+	for (size_t s : kSizes)
+	{
+		void* p = h.allocate(s);
+		oTEST(p && h.owns(p), "allocate(%u) failed", s);
+		oTEST(h.size(p) >= s, "allocate(%u) returned only %u bytes", s, h.size(p));
+		memset(p, 0xab, s);
+		h.deallocate(p);
+	}
+
+	void* p = h.allocate(100, "aligned", memory_alignment::align64);
+	oTEST(byte_aligned(p, 64), "alignment not respected");
+	h.deallocate(p);
+
+	allocator a = h.get_allocator();
+	oTEST(a == h.get_allocator(), "a heap should bind to one allocator");
+	scoped_allocation s = a.scoped_allocate(300);
+	oTEST(s && h.owns(s), "allocating through the allocator failed");
+}
+
+// each task keeps a window of allocations it fills and verifies before freeing,
+// then leaves some for another task to free
+static void test_concurrency(test_services& services, concurrent_heap& h)
+{
+	std::vector<std::vector<void*>> leftovers(kNumTasks);
+	std::vector<uint32_t> failures(kNumTasks, 0);
+
+	parallel_for(0, kNumTasks, [&](size_t task)
+	{
+		uint32_t seed = uint32_t(task) * 2654435761u + 1;
+		void* window[64] = {};
+		size_t sizes[64] = {};
+		for (size_t i = 0; i < kNumOps; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			const size_t slot = (seed >> 8) & 63;
+			if (window[slot])
+			{
+				const uint8_t* p = (const uint8_t*)window[slot];
+				for (size_t j = 0; j < sizes[slot]; j++)
+					if (p[j] != uint8_t(sizes[slot]))
+					{
+						failures[task]++;
+						break;
+					}
+				h.deallocate(window[slot]);
+			}
+
+			const size_t size = (seed >> 16) % ((seed & 0xf) ? 600 : 9000);
+			window[slot] = h.allocate(size);
+			sizes[slot] = size;
+			if (window[slot])
+				memset(window[slot], uint8_t(size), size);
+			else
+				failures[task]++;
+		}
+
+		for (void* p : window)
+			if (p)
+				leftovers[task].push_back(p);
+	});
+
+	parallel_for(0, kNumTasks, [&](size_t task)
+	{
+		for (void* p : leftovers[kNumTasks - 1 - task])
+			h.deallocate(p);
+	});
+
+	uint32_t nFailures = 0;
+	for (uint32_t f : failures)
+		nFailures += f;
+	oTEST(nFailures == 0, "%u allocations failed or were stomped", nFailures);
+}
+
+struct heap_ops
+{
+	heap_ops(concurrent_heap& h) : h(h) {}
+	void* allocate(size_t size) { return h.allocate(size); }
+	void deallocate(void* p) { h.deallocate(p); }
+	concurrent_heap& h;
+};
+
+struct locked_tlsf_ops
+{
+	locked_tlsf_ops(tlsf_allocator& t) : t(t) {}
+	void* allocate(size_t size) { lock_guard<mutex> lock(m); return t.allocate(size); }
+	void deallocate(void* p) { lock_guard<mutex> lock(m); t.deallocate(p); }
+	tlsf_allocator& t;
+	mutex m;
+};
+
+struct malloc_ops
+{
+	void* allocate(size_t size) { return malloc(size); }
+	void deallocate(void* p) { free(p); }
+};
+
+template<typename OpsT>
+static double benchmark(test_services& services, OpsT& ops)
+{
+	const double start = services.now();
+	parallel_for(0, kNumTasks, [&](size_t task)
+	{
+		uint32_t seed = uint32_t(task) + 1;
+		void* ring[256] = {};
+		for (size_t i = 0; i < kNumOps; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			void*& p = ring[i & 255];
+			if (p)
+				ops.deallocate(p);
+			p = ops.allocate(16 + (seed >> 16) % 500);
+		}
+
+		for (void* p : ring)
+			ops.deallocate(p);
+	});
+	return services.now() - start;
+}
+
+void TESTconcurrent_heap(test_services& services)
+{
+	const size_t ArenaSize = oMB(64);
+	std::vector<char> arena(ArenaSize);
+
+	double heap_seconds = 0.0;
+	{
+		concurrent_heap h(arena.data(), arena.size());
+		test_basics(services, h);
+		test_concurrency(services, h);
+		heap_ops ops(h);
+		heap_seconds = benchmark(services, ops);
+		oTEST(h.deinitialize() == arena.data(), "deinitialize should return the arena");
+	}
+
+	double tlsf_seconds = 0.0;
+	{
+		tlsf_allocator t(arena.data(), arena.size());
+		locked_tlsf_ops ops(t);
+		tlsf_seconds = benchmark(services, ops);
+	}
+
+	malloc_ops ops;
+	const double malloc_seconds = benchmark(services, ops);
+
+	services.report("%u allocs: concurrent_heap %.1f ms, tlsf+mutex %.1f ms, malloc %.1f ms"
+		, kNumTasks * kNumOps, heap_seconds * 1000.0, tlsf_seconds * 1000.0, malloc_seconds * 1000.0);
+}
+
+	}
+}
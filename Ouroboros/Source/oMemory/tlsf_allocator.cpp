@@ -42,6 +42,9 @@ void tlsf_allocator::initialize(void* arena, size_t bytes)
 
 void* tlsf_allocator::deinitialize()
 {
+	if (!heap)
+		return nullptr;
+
 	#if USE_ALLOCATOR_STATS
 		if (stats.num_allocations)
 			throw allocate_error(allocate_errc::outstanding_allocations);
@@ -0,0 +1,746 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/bvh.h>
+#include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+#include <algorithm>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+namespace ouro { namespace mesh {
+
+// _____________________________________________________________________________
+// Build
+
+static const uint kMaxBins = 32;
+static const uint kParallelNodeSize = 64 * 1024; // nodes this big bin across threads
+static const uint kMaxSAHDepth = 48; // deeper nodes split at the median to bound the depth
+static const uint kStackSize = 128;
+
+struct build_triangle
+{
+	float3 box_min;
+	float3 box_max;
+	float3 centroid;
+};
+
+struct bin
+{
+	bin() : box_min(FLT_MAX), box_max(-FLT_MAX), count(0) {}
+
+	void add(const float3& mn, const float3& mx) { box_min = min(box_min, mn); box_max = max(box_max, mx); }
+	void add(const bin& that) { add(that.box_min, that.box_max); count += that.count; }
+
+	float3 box_min;
+	float3 box_max;
+	uint count;
+};
+
+static float half_area(const float3& mn, const float3& mx)
+{
+	const float3 d = mx - mn;
+	return (d.x < 0.0f) ? 0.0f : (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// everything needed to split one node
+struct node_bins
+{
+	bin bounds; // of the triangles
+	bin centroids; // of the centroids
+	bin bins[3][kMaxBins];
+};
+
+struct pending_node
+{
+	uint node;
+	uint begin;
+	uint end;
+	uint depth;
+};
+
+class bvh_builder
+{
+public:
+	bvh_builder(const bvh_options& _options, std::vector<build_triangle>& _triangles, std::vector<uint>& _order, std::vector<bvh_node>& _nodes)
+		: options(_options)
+		, triangles(_triangles)
+		, order(_order)
+		, nodes(_nodes)
+		, num_bins(clamp(_options.num_bins, 2u, kMaxBins))
+	{}
+
+	void build()
+	{
+		nodes.clear();
+		nodes.reserve(order.size() * 2);
+		nodes.resize(1);
+
+		std::vector<pending_node> level(1), next;
+		level[0].node = 0;
+		level[0].begin = 0;
+		level[0].end = uint(order.size());
+		level[0].depth = 0;
+
+		std::vector<uint> split(level.size());
+		while (!level.empty())
+		{
+			// big nodes parallelize internally, small ones are split side by side
+			split.resize(level.size());
+			for (size_t i = 0; i < level.size(); i++)
+				if ((level[i].end - level[i].begin) >= kParallelNodeSize)
+					split[i] = split_node(level[i], true);
+
+			parallel_for(0, level.size(), [&](size_t i)
+			{
+				if ((level[i].end - level[i].begin) < kParallelNodeSize)
+					split[i] = split_node(level[i], false);
+			});
+
+			next.clear();
+			for (size_t i = 0; i < level.size(); i++)
+			{
+				const pending_node& p = level[i];
+				bvh_node& n = nodes[p.node];
+				if (split[i] == invalid)
+				{
+					n.offset = p.begin;
+					n.count = p.end - p.begin;
+					continue;
+				}
+
+				const uint child = uint(nodes.size());
+				n.offset = child;
+				n.count = 0;
+				nodes.resize(nodes.size() + 2);
+
+				pending_node left = { child, p.begin, split[i], p.depth + 1 };
+				pending_node right = { child + 1, split[i], p.end, p.depth + 1 };
+				next.push_back(left);
+				next.push_back(right);
+			}
+
+			level.swap(next);
+		}
+	}
+
+private:
+	const bvh_options& options;
+	std::vector<build_triangle>& triangles;
+	std::vector<uint>& order;
+	std::vector<bvh_node>& nodes;
+	uint num_bins;
+
+	uint bin_index(const float3& centroid, uint axis, const float3& cmin, const float3& scale) const
+	{
+		return min(num_bins - 1, uint((centroid[axis] - cmin[axis]) * scale[axis]));
+	}
+
+	void bin_range(node_bins& b, uint begin, uint end, const float3& cmin, const float3& scale) const
+	{
+		for (uint i = begin; i < end; i++)
+		{
+			const build_triangle& t = triangles[order[i]];
+			for (uint axis = 0; axis < 3; axis++)
+			{
+				if (scale[axis] == 0.0f)
+					continue;
+				bin& dst = b.bins[axis][bin_index(t.centroid, axis, cmin, scale)];
+				dst.add(t.box_min, t.box_max);
+				dst.count++;
+			}
+		}
+	}
+
+	void bound_range(node_bins& b, uint begin, uint end) const
+	{
+		for (uint i = begin; i < end; i++)
+		{
+			const build_triangle& t = triangles[order[i]];
+			b.bounds.add(t.box_min, t.box_max);
+			b.centroids.add(t.centroid, t.centroid);
+		}
+	}
+
+	// runs fn over [begin,end) in chunks, each with its own node_bins, then
+	// merges them into out
+	template<typename FnT>
+	void reduce(node_bins& out, uint begin, uint end, bool concurrent, FnT fn) const
+	{
+		if (!concurrent)
+		{
+			fn(out, begin, end);
+			return;
+		}
+
+		static const uint kNumChunks = 32;
+		std::vector<node_bins> partial(kNumChunks);
+		const uint n = end - begin;
+		parallel_for(0, kNumChunks, [&](size_t chunk)
+		{
+			fn(partial[chunk], begin + uint((ullong(n) * chunk) / kNumChunks), begin + uint((ullong(n) * (chunk + 1)) / kNumChunks));
+		});
+
+		for (const node_bins& p : partial)
+		{
+			out.bounds.add(p.bounds);
+			out.centroids.add(p.centroids);
+			for (uint axis = 0; axis < 3; axis++)
+				for (uint i = 0; i < num_bins; i++)
+					out.bins[axis][i].add(p.bins[axis][i]);
+		}
+	}
+
+	// Sets the node's bounds and partitions its triangles. Returns the start of
+	// the right child's triangles or invalid if the node should be a leaf.
+	uint split_node(const pending_node& p, bool concurrent)
+	{
+		node_bins b;
+		reduce(b, p.begin, p.end, concurrent, [&](node_bins& dst, uint begin, uint end) { bound_range(dst, begin, end); });
+
+		bvh_node& n = nodes[p.node];
+		n.box_min = b.bounds.box_min;
+		n.box_max = b.bounds.box_max;
+
+		const uint count = p.end - p.begin;
+		if (count <= 1)
+			return invalid;
+
+		const float3 cmin = b.centroids.box_min;
+		const float3 extent = b.centroids.box_max - cmin;
+		if (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f)
+			return count <= options.max_leaf_size ? invalid : median_split(p, extent);
+
+		if (p.depth >= kMaxSAHDepth)
+			return median_split(p, extent);
+
+		const float3 scale(extent.x > 0.0f ? num_bins / extent.x : 0.0f, extent.y > 0.0f ? num_bins / extent.y : 0.0f, extent.z > 0.0f ? num_bins / extent.z : 0.0f);
+		reduce(b, p.begin, p.end, concurrent, [&](node_bins& dst, uint begin, uint end) { bin_range(dst, begin, end, cmin, scale); });
+
+		// sweep from both sides to find the cheapest plane
+		const float parent_area = half_area(n.box_min, n.box_max);
+		float best_cost = FLT_MAX;
+		uint best_axis = 0, best_bin = 0;
+		for (uint axis = 0; axis < 3; axis++)
+		{
+			if (scale[axis] == 0.0f)
+				continue;
+
+			float right_cost[kMaxBins];
+			bin acc;
+			for (uint i = num_bins - 1; i > 0; i--)
+			{
+				acc.add(b.bins[axis][i]);
+				right_cost[i] = half_area(acc.box_min, acc.box_max) * acc.count;
+			}
+
+			acc = bin();
+			for (uint i = 1; i < num_bins; i++)
+			{
+				acc.add(b.bins[axis][i-1]);
+				const float cost = half_area(acc.box_min, acc.box_max) * acc.count + right_cost[i];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_bin = i;
+				}
+			}
+		}
+
+		best_cost = options.traversal_cost + (parent_area > 0.0f ? best_cost / parent_area : 0.0f);
+		if (count <= options.max_leaf_size && best_cost >= float(count))
+			return invalid;
+
+		auto mid = std::partition(order.begin() + p.begin, order.begin() + p.end, [&](uint t)
+		{
+			return bin_index(triangles[t].centroid, best_axis, cmin, scale) < best_bin;
+		});
+
+		const uint split = uint(mid - order.begin());
+		return (split == p.begin || split == p.end) ? median_split(p, extent) : split;
+	}
+
+	uint median_split(const pending_node& p, const float3& extent)
+	{
+		const uint axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+		const uint mid = p.begin + (p.end - p.begin) / 2;
+		std::nth_element(order.begin() + p.begin, order.begin() + mid, order.begin() + p.end, [&](uint a, uint b)
+		{
+			return triangles[a].centroid[axis] < triangles[b].centroid[axis];
+		});
+		return mid;
+	}
+};
+
+template<typename IndexT>
+static void build_t(std::vector<bvh_node>& nodes, std::vector<bvh_triangle>& tris, const IndexT* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, const bvh_options& options)
+{
+	if ((num_indices % 3) != 0)
+		oTHROW_INVARG("num_indices must be a multiple of 3");
+
+	const uint nTriangles = num_indices / 3;
+	std::vector<build_triangle> build(nTriangles);
+	std::vector<uint> order(nTriangles);
+	bool success = true;
+	parallel_for_range(0, nTriangles, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			const IndexT* tri = indices + t * 3;
+			if (tri[0] >= num_vertices || tri[1] >= num_vertices || tri[2] >= num_vertices)
+			{
+				success = false;
+				return;
+			}
+
+			const float3& a = *byte_add(positions, position_stride, tri[0]);
+			const float3& b = *byte_add(positions, position_stride, tri[1]);
+			const float3& c = *byte_add(positions, position_stride, tri[2]);
+			build_triangle& bt = build[t];
+			bt.box_min = min(a, min(b, c));
+			bt.box_max = max(a, max(b, c));
+			bt.centroid = (bt.box_min + bt.box_max) * 0.5f;
+			order[t] = uint(t);
+		}
+	});
+
+	if (!success)
+		oTHROW_INVARG("an index value indexes outside the range of vertices specified");
+
+	nodes.clear();
+	tris.clear();
+	if (!nTriangles)
+		return;
+
+	bvh_builder(options, build, order, nodes).build();
+
+	tris.resize(nTriangles);
+	parallel_for_range(0, nTriangles, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const uint t = order[i];
+			const IndexT* tri = indices + t * 3;
+			const float3& a = *byte_add(positions, position_stride, tri[0]);
+			bvh_triangle& bt = tris[i];
+			bt.v0 = a;
+			bt.edge1 = *byte_add(positions, position_stride, tri[1]) - a;
+			bt.edge2 = *byte_add(positions, position_stride, tri[2]) - a;
+			bt.triangle = t;
+		}
+	});
+}
+
+void bvh::build(const uint* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, const bvh_options& options)
+{
+	build_t(node_storage, triangle_storage, indices, num_indices, positions, position_stride, num_vertices, options);
+}
+
+void bvh::build(const ushort* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, const bvh_options& options)
+{
+	build_t(node_storage, triangle_storage, indices, num_indices, positions, position_stride, num_vertices, options);
+}
+
+// _____________________________________________________________________________
+// Single rays
+
+static bool intersect_box(const bvh_node& n, const float3& origin, const float3& inv_dir, float t_min, float t_max, float* out_t)
+{
+	const float3 t0 = (n.box_min - origin) * inv_dir;
+	const float3 t1 = (n.box_max - origin) * inv_dir;
+	const float3 tn = min(t0, t1);
+	const float3 tf = max(t0, t1);
+	const float enter = max(max(tn.x, tn.y), max(tn.z, t_min));
+	const float exit = min(min(tf.x, tf.y), min(tf.z, t_max));
+	*out_t = enter;
+	return enter <= exit;
+}
+
+// Möller-Trumbore
+static bool intersect_triangle(const bvh_triangle& tri, const ray& r, float t_max, ray_hit& hit)
+{
+	const float3 p = cross(r.direction, tri.edge2);
+	const float det = dot(tri.edge1, p);
+	if (det == 0.0f)
+		return false;
+
+	const float inv_det = 1.0f / det;
+	const float3 s = r.origin - tri.v0;
+	const float u = dot(s, p) * inv_det;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	const float3 q = cross(s, tri.edge1);
+	const float v = dot(r.direction, q) * inv_det;
+	if (v < 0.0f || (u + v) > 1.0f)
+		return false;
+
+	const float t = dot(tri.edge2, q) * inv_det;
+	if (t < r.t_min || t > t_max)
+		return false;
+
+	hit.triangle = tri.triangle;
+	hit.t = t;
+	hit.u = u;
+	hit.v = v;
+	return true;
+}
+
+template<bool AnyHit>
+static ray_hit trace(const bvh_node* nodes, const bvh_triangle* tris, const ray& r)
+{
+	ray_hit hit;
+	if (!nodes)
+		return hit;
+
+	const float3 inv_dir(1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z);
+	float t_max = r.t_max;
+
+	uint stack[kStackSize];
+	uint top = 0;
+	float t;
+	if (!intersect_box(nodes[0], r.origin, inv_dir, r.t_min, t_max, &t))
+		return hit;
+	stack[top++] = 0;
+
+	while (top)
+	{
+		const bvh_node& n = nodes[stack[--top]];
+		if (n.count)
+		{
+			for (uint i = n.offset; i < n.offset + n.count; i++)
+				if (intersect_triangle(tris[i], r, t_max, hit))
+				{
+					if (AnyHit)
+						return hit;
+					t_max = hit.t;
+				}
+			continue;
+		}
+
+		float tl, tr;
+		const bool l = intersect_box(nodes[n.offset], r.origin, inv_dir, r.t_min, t_max, &tl);
+		const bool rr = intersect_box(nodes[n.offset + 1], r.origin, inv_dir, r.t_min, t_max, &tr);
+
+		// push the far child first so the near one is visited first
+		if (l && rr)
+		{
+			stack[top++] = tl < tr ? n.offset + 1 : n.offset;
+			stack[top++] = tl < tr ? n.offset : n.offset + 1;
+		}
+		else if (l)
+			stack[top++] = n.offset;
+		else if (rr)
+			stack[top++] = n.offset + 1;
+	}
+
+	return hit;
+}
+
+ray_hit bvh::intersect(const ray& r) const
+{
+	return trace<false>(nodes(), triangles(), r);
+}
+
+bool bvh::occluded(const ray& r) const
+{
+	return trace<true>(nodes(), triangles(), r).triangle != invalid;
+}
+
+// _____________________________________________________________________________
+// Packets of 4 rays
+
+struct ray_packet
+{
+	__m128 ox, oy, oz;
+	__m128 dx, dy, dz;
+	__m128 ix, iy, iz; // 1 / direction
+	__m128 t_min, t_max;
+
+	// hits
+	__m128 t, u, v;
+	__m128i triangle;
+};
+
+static void load_packet(ray_packet& p, const ray* rays, uint n)
+{
+	float f[11][4];
+	for (uint i = 0; i < 4; i++)
+	{
+		// pad with rays that can't hit anything
+		const ray& r = rays[min(i, n - 1)];
+		f[0][i] = r.origin.x; f[1][i] = r.origin.y; f[2][i] = r.origin.z;
+		f[3][i] = r.direction.x; f[4][i] = r.direction.y; f[5][i] = r.direction.z;
+		f[6][i] = 1.0f / r.direction.x; f[7][i] = 1.0f / r.direction.y; f[8][i] = 1.0f / r.direction.z;
+		f[9][i] = i < n ? r.t_min : 1.0f;
+		f[10][i] = i < n ? r.t_max : -1.0f;
+	}
+
+	p.ox = _mm_loadu_ps(f[0]); p.oy = _mm_loadu_ps(f[1]); p.oz = _mm_loadu_ps(f[2]);
+	p.dx = _mm_loadu_ps(f[3]); p.dy = _mm_loadu_ps(f[4]); p.dz = _mm_loadu_ps(f[5]);
+	p.ix = _mm_loadu_ps(f[6]); p.iy = _mm_loadu_ps(f[7]); p.iz = _mm_loadu_ps(f[8]);
+	p.t_min = _mm_loadu_ps(f[9]); p.t_max = _mm_loadu_ps(f[10]);
+	p.t = _mm_set1_ps(FLT_MAX);
+	p.u = _mm_setzero_ps();
+	p.v = _mm_setzero_ps();
+	p.triangle = _mm_set1_epi32(-1);
+}
+
+static __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// returns a lane mask of the rays that enter the box and the nearest entry
+static int intersect_box(const bvh_node& n, const ray_packet& p, float* out_t)
+{
+	const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.box_min.x), p.ox), p.ix);
+	const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.box_max.x), p.ox), p.ix);
+	const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.box_min.y), p.oy), p.iy);
+	const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.box_max.y), p.oy), p.iy);
+	const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.box_min.z), p.oz), p.iz);
+	const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(n.box_max.z), p.oz), p.iz);
+	const __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), p.t_min));
+	const __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), p.t_max));
+	const __m128 hit = _mm_cmple_ps(enter, exit);
+	const int mask = _mm_movemask_ps(hit);
+	if (mask)
+	{
+		float e[4];
+		_mm_storeu_ps(e, select(hit, enter, _mm_set1_ps(FLT_MAX)));
+		*out_t = min(min(e[0], e[1]), min(e[2], e[3]));
+	}
+	return mask;
+}
+
+// returns a lane mask of the rays that hit the triangle closer than before
+static int intersect_triangle(const bvh_triangle& tri, ray_packet& p)
+{
+	const __m128 e1x = _mm_set1_ps(tri.edge1.x), e1y = _mm_set1_ps(tri.edge1.y), e1z = _mm_set1_ps(tri.edge1.z);
+	const __m128 e2x = _mm_set1_ps(tri.edge2.x), e2y = _mm_set1_ps(tri.edge2.y), e2z = _mm_set1_ps(tri.edge2.z);
+
+	// p = cross(d, e2)
+	const __m128 px = _mm_sub_ps(_mm_mul_ps(p.dy, e2z), _mm_mul_ps(p.dz, e2y));
+	const __m128 py = _mm_sub_ps(_mm_mul_ps(p.dz, e2x), _mm_mul_ps(p.dx, e2z));
+	const __m128 pz = _mm_sub_ps(_mm_mul_ps(p.dx, e2y), _mm_mul_ps(p.dy, e2x));
+	const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	const __m128 sx = _mm_sub_ps(p.ox, _mm_set1_ps(tri.v0.x));
+	const __m128 sy = _mm_sub_ps(p.oy, _mm_set1_ps(tri.v0.y));
+	const __m128 sz = _mm_sub_ps(p.oz, _mm_set1_ps(tri.v0.z));
+	const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+	// q = cross(s, e1)
+	const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p.dx, qx), _mm_mul_ps(p.dy, qy)), _mm_mul_ps(p.dz, qz)), inv_det);
+	const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 hit = _mm_cmpneq_ps(det, zero);
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(t, p.t_min));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(t, p.t_max));
+	hit = _mm_and_ps(hit, _mm_cmplt_ps(t, p.t));
+
+	const int mask = _mm_movemask_ps(hit);
+	if (mask)
+	{
+		p.t = select(hit, t, p.t);
+		p.u = select(hit, u, p.u);
+		p.v = select(hit, v, p.v);
+		p.triangle = _mm_castps_si128(select(hit, _mm_castsi128_ps(_mm_set1_epi32(int(tri.triangle))), _mm_castsi128_ps(p.triangle)));
+	}
+	return mask;
+}
+
+template<bool AnyHit>
+static void trace(const bvh_node* nodes, const bvh_triangle* tris, ray_packet& p)
+{
+	uint stack[kStackSize];
+	uint top = 0;
+	float t;
+	if (!intersect_box(nodes[0], p, &t))
+		return;
+	stack[top++] = 0;
+
+	while (top)
+	{
+		const bvh_node& n = nodes[stack[--top]];
+		if (n.count)
+		{
+			for (uint i = n.offset; i < n.offset + n.count; i++)
+			{
+				const int mask = intersect_triangle(tris[i], p);
+				if (mask)
+				{
+					// occluded rays are done, closest-hit rays shorten
+					p.t_max = AnyHit ? select(_mm_castsi128_ps(_mm_cmpeq_epi32(p.triangle, _mm_set1_epi32(-1))), p.t_max, _mm_set1_ps(-1.0f)) : _mm_min_ps(p.t_max, p.t);
+					if (AnyHit && _mm_movemask_ps(_mm_cmpge_ps(p.t_max, p.t_min)) == 0)
+						return;
+				}
+			}
+			continue;
+		}
+
+		float tl, tr;
+		const int l = intersect_box(nodes[n.offset], p, &tl);
+		const int r = intersect_box(nodes[n.offset + 1], p, &tr);
+		if (l && r)
+		{
+			stack[top++] = tl < tr ? n.offset + 1 : n.offset;
+			stack[top++] = tl < tr ? n.offset : n.offset + 1;
+		}
+		else if (l)
+			stack[top++] = n.offset;
+		else if (r)
+			stack[top++] = n.offset + 1;
+	}
+}
+
+void bvh::intersect(const ray* rays, uint num_rays, ray_hit* out_hits) const
+{
+	if (node_storage.empty())
+	{
+		for (uint i = 0; i < num_rays; i++)
+			out_hits[i] = ray_hit();
+		return;
+	}
+
+	parallel_for_range(0, (num_rays + 3) / 4, [&](size_t begin, size_t end)
+	{
+		for (size_t packet = begin; packet < end; packet++)
+		{
+			const uint first = uint(packet * 4);
+			const uint n = min(4u, num_rays - first);
+			ray_packet p;
+			load_packet(p, rays + first, n);
+			trace<false>(nodes(), triangles(), p);
+
+			float t[4], u[4], v[4];
+			uint triangle[4];
+			_mm_storeu_ps(t, p.t);
+			_mm_storeu_ps(u, p.u);
+			_mm_storeu_ps(v, p.v);
+			_mm_storeu_si128((__m128i*)triangle, p.triangle);
+			for (uint i = 0; i < n; i++)
+			{
+				ray_hit& h = out_hits[first + i];
+				h = ray_hit();
+				if (triangle[i] != invalid)
+				{
+					h.triangle = triangle[i];
+					h.t = t[i];
+					h.u = u[i];
+					h.v = v[i];
+				}
+			}
+		}
+	});
+}
+
+void bvh::occluded(const ray* rays, uint num_rays, bool* out_occluded) const
+{
+	if (node_storage.empty())
+	{
+		for (uint i = 0; i < num_rays; i++)
+			out_occluded[i] = false;
+		return;
+	}
+
+	parallel_for_range(0, (num_rays + 3) / 4, [&](size_t begin, size_t end)
+	{
+		for (size_t packet = begin; packet < end; packet++)
+		{
+			const uint first = uint(packet * 4);
+			const uint n = min(4u, num_rays - first);
+			ray_packet p;
+			load_packet(p, rays + first, n);
+			trace<true>(nodes(), triangles(), p);
+
+			uint triangle[4];
+			_mm_storeu_si128((__m128i*)triangle, p.triangle);
+			for (uint i = 0; i < n; i++)
+				out_occluded[first + i] = triangle[i] != invalid;
+		}
+	});
+}
+
+// _____________________________________________________________________________
+// Volume queries
+
+template<typename NodeTestT, typename TriangleTestT>
+static void query_t(const bvh_node* nodes, const bvh_triangle* tris, NodeTestT node_test, TriangleTestT triangle_test, std::vector<uint>& out_triangles)
+{
+	if (!nodes || !node_test(nodes[0].box_min, nodes[0].box_max))
+		return;
+
+	uint stack[kStackSize];
+	uint top = 0;
+	stack[top++] = 0;
+	while (top)
+	{
+		const bvh_node& n = nodes[stack[--top]];
+		if (n.count)
+		{
+			for (uint i = n.offset; i < n.offset + n.count; i++)
+				if (triangle_test(tris[i]))
+					out_triangles.push_back(tris[i].triangle);
+			continue;
+		}
+
+		for (uint c = n.offset; c < n.offset + 2; c++)
+			if (node_test(nodes[c].box_min, nodes[c].box_max))
+				stack[top++] = c;
+	}
+}
+
+void bvh::query(const float3& box_min, const float3& box_max, std::vector<uint>& out_triangles) const
+{
+	auto overlaps = [&](const float3& mn, const float3& mx)
+	{
+		return all(mn <= box_max) && all(mx >= box_min);
+	};
+
+	query_t(nodes(), triangles(), overlaps, [&](const bvh_triangle& t)
+	{
+		const float3 v1 = t.v0 + t.edge1;
+		const float3 v2 = t.v0 + t.edge2;
+		return overlaps(min(t.v0, min(v1, v2)), max(t.v0, max(v1, v2)));
+	}, out_triangles);
+}
+
+void bvh::query(const oFrustumf& f, std::vector<uint>& out_triangles) const
+{
+	const planef* planes = &f.Left;
+
+	// planes point inward, so a box is out if its corner furthest along the
+	// normal is behind any plane
+	auto inside = [&](const float3& mn, const float3& mx)
+	{
+		const float3 center = (mn + mx) * 0.5f;
+		const float3 half_size = (mx - mn) * 0.5f;
+		for (uint i = 0; i < oFRUSTUM_PLANE_COUNT; i++)
+			if (sdistance(planes[i], center) + dot(half_size, abs(planes[i].xyz())) < 0.0f)
+				return false;
+		return true;
+	};
+
+	query_t(nodes(), triangles(), inside, [&](const bvh_triangle& t)
+	{
+		const float3 v1 = t.v0 + t.edge1;
+		const float3 v2 = t.v0 + t.edge2;
+		for (uint i = 0; i < oFRUSTUM_PLANE_COUNT; i++)
+			if (sdistance(planes[i], t.v0) < 0.0f && sdistance(planes[i], v1) < 0.0f && sdistance(planes[i], v2) < 0.0f)
+				return false;
+		return true;
+	}, out_triangles);
+}
+
+}}
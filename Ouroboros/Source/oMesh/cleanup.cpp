@@ -0,0 +1,356 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/cleanup.h>
+#include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ouro { namespace mesh {
+
+// _____________________________________________________________________________
+// Parallel sort
+
+// Sorts power-of-2 chunks concurrently then merges them pairwise, each level
+// of merges also running concurrently.
+template<typename T, typename LessT>
+static void parallel_sort(T* first, size_t n, const LessT& less)
+{
+	static const size_t kMinChunkSize = 64 * 1024;
+	static const size_t kMaxChunks = 64;
+
+	size_t nChunks = 1;
+	while (nChunks < kMaxChunks && (nChunks * 2 * kMinChunkSize) <= n)
+		nChunks *= 2;
+
+	auto chunk_begin = [&](size_t chunk) { return first + (n * chunk) / nChunks; };
+
+	parallel_for(0, nChunks, [&](size_t chunk)
+	{
+		std::sort(chunk_begin(chunk), chunk_begin(chunk + 1), less);
+	});
+
+	for (size_t width = 1; width < nChunks; width *= 2)
+	{
+		parallel_for(0, nChunks / (width * 2), [&](size_t pair)
+		{
+			const size_t lo = pair * width * 2;
+			std::inplace_merge(chunk_begin(lo), chunk_begin(lo + width), chunk_begin(lo + width * 2), less);
+		});
+	}
+}
+
+// _____________________________________________________________________________
+// Welding
+
+struct weld_key
+{
+	ullong key;
+	uint index;
+};
+
+// LSD radix sort 8 bits at a time. Each pass counts digits in chunks
+// concurrently then each chunk scatters to its own offsets, earlier chunks
+// first within each digit, so the sort is stable.
+static void parallel_radix_sort(std::vector<weld_key>& keys)
+{
+	static const uint kRadixBits = 8;
+	static const uint kRadix = 1 << kRadixBits;
+	static const size_t kMinChunkSize = 64 * 1024;
+	static const size_t kMaxChunks = 64;
+
+	const size_t n = keys.size();
+	size_t nChunks = 1;
+	while (nChunks < kMaxChunks && (nChunks * 2 * kMinChunkSize) <= n)
+		nChunks *= 2;
+
+	auto chunk_begin = [&](size_t chunk) { return (n * chunk) / nChunks; };
+
+	std::vector<weld_key> temp(n);
+	std::vector<size_t> offsets(nChunks * kRadix);
+	weld_key* src = keys.data();
+	weld_key* dst = temp.data();
+	for (uint shift = 0; shift < 64; shift += kRadixBits)
+	{
+		parallel_for(0, nChunks, [&](size_t chunk)
+		{
+			size_t* count = offsets.data() + chunk * kRadix;
+			std::fill(count, count + kRadix, size_t(0));
+			for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++)
+				count[(src[i].key >> shift) & (kRadix - 1)]++;
+		});
+
+		size_t offset = 0;
+		for (uint digit = 0; digit < kRadix; digit++)
+			for (size_t chunk = 0; chunk < nChunks; chunk++)
+			{
+				size_t& o = offsets[chunk * kRadix + digit];
+				const size_t count = o;
+				o = offset;
+				offset += count;
+			}
+
+		parallel_for(0, nChunks, [&](size_t chunk)
+		{
+			size_t* o = offsets.data() + chunk * kRadix;
+			for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++)
+				dst[o[(src[i].key >> shift) & (kRadix - 1)]++] = src[i];
+		});
+
+		std::swap(src, dst);
+	}
+
+	// an even number of passes leaves the result in keys
+}
+
+// murmur3's finalizer
+static ullong mix(ullong x)
+{
+	x ^= x >> 33; x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+// Cells are hashed rather than packed so any coordinate range works. Cells 
+// that collide are harmless since candidates are compared by distance.
+static ullong hash_cell(const llong3& c)
+{
+	return mix(mix(mix(ullong(c.x)) ^ ullong(c.y)) ^ ullong(c.z));
+}
+
+uint weld_vertices(uint* out_remap, const float3* positions, uint position_stride, uint num_vertices, float tolerance)
+{
+	if (!out_remap || !positions || tolerance < 0.0f)
+		oTHROW_INVARG("invalid argument");
+
+	// cell coordinates are independent per vertex
+	std::vector<llong3> cells(num_vertices);
+	std::vector<weld_key> keys(num_vertices);
+	const double inv = tolerance > 0.0f ? 1.0 / tolerance : 0.0;
+	parallel_for_range(0, num_vertices, [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			const float3& p = *(const float3*)byte_add(positions, position_stride, v);
+			if (tolerance > 0.0f)
+				cells[v] = llong3(llong(floor(p.x * inv)), llong(floor(p.y * inv)), llong(floor(p.z * inv)));
+			else // exact: treat the bits as the cell, normalizing -0 to 0
+				cells[v] = llong3(asuint(p.x + 0.0f), asuint(p.y + 0.0f), asuint(p.z + 0.0f));
+			keys[v].key = hash_cell(cells[v]);
+			keys[v].index = uint(v);
+		}
+	});
+
+	// The sort is stable so a run of equal keys is in vertex order.
+	parallel_radix_sort(keys);
+
+	auto same_cell = [&](uint a, uint b) { return cells[a].x == cells[b].x && cells[a].y == cells[b].y && cells[a].z == cells[b].z; };
+
+	// Each vertex searches the cells that can contain a point within tolerance
+	// for the lowest-numbered one, itself if there is none lower. Runs are in 
+	// vertex order so each stops at its first match.
+	const llong r = tolerance > 0.0f ? 1 : 0;
+	const float tolerance_sq = tolerance * tolerance;
+	parallel_for_range(0, num_vertices, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const uint v = uint(i);
+			const float3& p = *(const float3*)byte_add(positions, position_stride, v);
+			const llong3& c = cells[v];
+			uint rep = v;
+			for (llong z = c.z - r; z <= c.z + r; z++)
+				for (llong y = c.y - r; y <= c.y + r; y++)
+					for (llong x = c.x - r; x <= c.x + r; x++)
+					{
+						weld_key k;
+						k.key = hash_cell(llong3(x, y, z));
+						auto run = std::lower_bound(keys.begin(), keys.end(), k, [](const weld_key& a, const weld_key& b) { return a.key < b.key; });
+						for (; run != keys.end() && run->key == k.key && run->index < rep; ++run)
+						{
+							const uint candidate = run->index;
+							const float3 d = *(const float3*)byte_add(positions, position_stride, candidate) - p;
+							if (tolerance > 0.0f ? dot(d, d) <= tolerance_sq : same_cell(candidate, v))
+							{
+								rep = candidate;
+								break;
+							}
+						}
+					}
+
+			out_remap[v] = rep;
+		}
+	});
+
+	// Each vertex points no higher than itself, so resolving in vertex order 
+	// follows each merge to the vertex it ends at.
+	uint nUnique = 0;
+	for (uint v = 0; v < num_vertices; v++)
+	{
+		out_remap[v] = out_remap[out_remap[v]];
+		if (out_remap[v] == v)
+			nUnique++;
+	}
+
+	return nUnique;
+}
+
+template<typename IndexT>
+static void remap_indices_t(IndexT* indices, uint num_indices, const uint* remap)
+{
+	parallel_for_range(0, num_indices, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			indices[i] = IndexT(remap[indices[i]]);
+	});
+}
+
+void remap_indices(uint* indices, uint num_indices, const uint* remap) { remap_indices_t(indices, num_indices, remap); }
+void remap_indices(ushort* indices, uint num_indices, const uint* remap) { remap_indices_t(indices, num_indices, remap); }
+
+template<typename IndexT>
+static uint remove_collapsed_triangles_t(IndexT* indices, uint num_indices)
+{
+	if ((num_indices % 3) != 0)
+		oTHROW_INVARG("num_indices must be a multiple of 3");
+
+	uint n = 0;
+	for (uint i = 0; i < num_indices; i += 3)
+	{
+		const IndexT a = indices[i], b = indices[i+1], c = indices[i+2];
+		if (a == b || b == c || c == a)
+			continue;
+		indices[n++] = a;
+		indices[n++] = b;
+		indices[n++] = c;
+	}
+	return n;
+}
+
+uint remove_collapsed_triangles(uint* indices, uint num_indices) { return remove_collapsed_triangles_t(indices, num_indices); }
+uint remove_collapsed_triangles(ushort* indices, uint num_indices) { return remove_collapsed_triangles_t(indices, num_indices); }
+
+// _____________________________________________________________________________
+// Edges and adjacency
+
+// Each triangle edge is recorded with its vertices in ascending order so the
+// two sides of a shared edge sort next to each other. Ties are broken by the
+// index so the output is deterministic.
+struct half_edge
+{
+	uint a;
+	uint b;
+	uint index; // into the index buffer, so the triangle is index / 3
+
+	bool same_edge(const half_edge& that) const { return a == that.a && b == that.b; }
+	bool operator<(const half_edge& that) const
+	{
+		if (a != that.a) return a < that.a;
+		if (b != that.b) return b < that.b;
+		return index < that.index;
+	}
+};
+
+template<typename IndexT>
+static std::vector<half_edge> sorted_half_edges(const IndexT* indices, uint num_indices)
+{
+	if ((num_indices % 3) != 0)
+		oTHROW_INVARG("num_indices must be a multiple of 3");
+
+	std::vector<half_edge> edges(num_indices);
+	parallel_for_range(0, num_indices / 3, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
+			for (uint k = 0; k < 3; k++)
+			{
+				const uint i = uint(t * 3 + k);
+				const uint v0 = indices[i];
+				const uint v1 = indices[t * 3 + (k + 1) % 3];
+				half_edge& e = edges[i];
+				e.a = min(v0, v1);
+				e.b = max(v0, v1);
+				e.index = i;
+			}
+	});
+
+	parallel_sort(edges.data(), edges.size(), std::less<half_edge>());
+	return edges;
+}
+
+template<typename IndexT>
+static uint calc_edges_t(const IndexT* indices, uint num_indices, edge* out_edges)
+{
+	std::vector<half_edge> edges = sorted_half_edges(indices, num_indices);
+
+	uint nEdges = 0;
+	const uint n = uint(edges.size());
+	for (uint i = 0; i < n; )
+	{
+		const half_edge& first = edges[i];
+		uint j = i + 1;
+		while (j < n && first.same_edge(edges[j]))
+			j++;
+
+		// degenerate triangles have zero-length edges
+		if (first.a != first.b)
+		{
+			edge& e = out_edges[nEdges++];
+			e.vertex[0] = first.a;
+			e.vertex[1] = first.b;
+			e.triangle[0] = first.index / 3;
+			e.triangle[1] = (j - i) > 1 ? edges[i+1].index / 3 : invalid;
+		}
+
+		i = j;
+	}
+
+	return nEdges;
+}
+
+uint calc_edges(const uint* indices, uint num_indices, edge* out_edges) { return calc_edges_t(indices, num_indices, out_edges); }
+uint calc_edges(const ushort* indices, uint num_indices, edge* out_edges) { return calc_edges_t(indices, num_indices, out_edges); }
+
+template<typename IndexT>
+static void calc_adjacency_t(const IndexT* indices, uint num_indices, uint* out_adjacency)
+{
+	std::vector<half_edge> edges = sorted_half_edges(indices, num_indices);
+	const size_t n = edges.size();
+
+	// Each range handles the edges that start in it, so ranges skip a leading
+	// edge that continues from the previous range. Writes never overlap since
+	// each half-edge belongs to one edge.
+	parallel_for_range(0, n, [&](size_t begin, size_t end)
+	{
+		size_t i = begin;
+		while (i > 0 && i < n && edges[i].same_edge(edges[i-1]))
+			i++;
+
+		while (i < end)
+		{
+			const half_edge& first = edges[i];
+			size_t j = i + 1;
+			while (j < n && first.same_edge(edges[j]))
+				j++;
+
+			if ((j - i) == 2 && first.a != first.b)
+			{
+				out_adjacency[first.index] = edges[i+1].index / 3;
+				out_adjacency[edges[i+1].index] = first.index / 3;
+			}
+
+			else
+				for (size_t k = i; k < j; k++)
+					out_adjacency[edges[k].index] = invalid;
+
+			i = j;
+		}
+	});
+}
+
+void calc_adjacency(const uint* indices, uint num_indices, uint* out_adjacency) { calc_adjacency_t(indices, num_indices, out_adjacency); }
+void calc_adjacency(const ushort* indices, uint num_indices, uint* out_adjacency) { calc_adjacency_t(indices, num_indices, out_adjacency); }
+
+}}
@@ -1,5 +1,6 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oMesh/mesh.h>
+#include <oMesh/cleanup.h>
 #include <oMemory/memory.h>
 #include <oBase/throw.h>
 #include "mesh_template.h"
@@ -704,180 +705,28 @@ void calc_texcoords(const aaboxf& bound, const ushort* indices, uint num_indices
 	detail::calc_texcoords(bound, indices, num_indices, positions, out_texcoords, num_vertices, out_solve_time);
 }
 
-namespace TerathonEdges {
-
-	/** <citation
-	usage="Implementation" 
-	reason="tangents can be derived, and this is how to do it" 
-	author="Eric Lengyel"
-	description="http://www.terathon.com/code/edges.html"
-	license="*** Assumed Public Domain ***"
-	licenseurl="http://www.terathon.com/code/edges.html"
-	modification="Minor changes to not limit algo to 65536 indices and some fixes to get it compiling"
-	/>*/
-
-	// $(CitedCodeBegin)
-
-	// Building an Edge List for an Arbitrary Mesh
-	// The following code builds a list of edges for an arbitrary triangle 
-	// mesh and has O(n) running time in the number of triangles n in the 
-	// pGeometry-> The edgeArray parameter must point to a previously allocated 
-	// array of Edge structures large enough to hold all of the mesh's 
-	// edges, which in the worst possible case is 3 times the number of 
-	// triangles in the pGeometry->
-
-	// An edge list is useful for many geometric algorithms in computer 
-	// graphics. In particular, an edge list is necessary for stencil 
-	// shadows.
-
-	struct Edge
-	{
-		unsigned int      vertexIndex[2]; 
-		unsigned int      faceIndex[2];
-	};
-
-
-	struct Triangle
-	{
-		unsigned int      index[3];
-	};
-
-
-	long BuildEdges(long vertexCount, long triangleCount,
-		const Triangle *triangleArray, Edge *edgeArray)
-	{
-		long maxEdgeCount = triangleCount * 3;
-		unsigned int *firstEdge = new unsigned int[vertexCount + maxEdgeCount];
-		unsigned int *nextEdge = firstEdge + vertexCount;
-
-		for (long a = 0; a < vertexCount; a++) firstEdge[a] = 0xFFFFFFFF;
-
-		// First pass over all triangles. This finds all the edges satisfying the
-		// condition that the first vertex index is less than the second vertex index
-		// when the direction from the first vertex to the second vertex represents
-		// a counterclockwise winding around the triangle to which the edge belongs.
-		// For each edge found, the edge index is stored in a linked list of edges
-		// belonging to the lower-numbered vertex index i. This allows us to quickly
-		// find an edge in the second pass whose higher-numbered vertex index is i.
-
-		long edgeCount = 0;
-		const Triangle *triangle = triangleArray;
-		for (long a = 0; a < triangleCount; a++)
-		{
-			long i1 = triangle->index[2];
-			for (long b = 0; b < 3; b++)
-			{
-				long i2 = triangle->index[b];
-				if (i1 < i2)
-				{
-					Edge *edge = &edgeArray[edgeCount];
-
-					edge->vertexIndex[0] = (unsigned int) i1;
-					edge->vertexIndex[1] = (unsigned int) i2;
-					edge->faceIndex[0] = (unsigned int) a;
-					edge->faceIndex[1] = (unsigned int) a;
-
-					long edgeIndex = firstEdge[i1];
-					if (edgeIndex == 0xFFFFFFFF)
-					{
-						firstEdge[i1] = edgeCount;
-					}
-					else
-					{
-						for (;;)
-						{
-							long index = nextEdge[edgeIndex];
-							if (index == 0xFFFFFFFF)
-							{
-								nextEdge[edgeIndex] = edgeCount;
-								break;
-							}
-
-							edgeIndex = index;
-						}
-					}
-
-					nextEdge[edgeCount] = 0xFFFFFFFF;
-					edgeCount++;
-				}
-
-				i1 = i2;
-			}
-
-			triangle++;
-		}
-
-		// Second pass over all triangles. This finds all the edges satisfying the
-		// condition that the first vertex index is greater than the second vertex index
-		// when the direction from the first vertex to the second vertex represents
-		// a counterclockwise winding around the triangle to which the edge belongs.
-		// For each of these edges, the same edge should have already been found in
-		// the first pass for a different triangle. So we search the list of edges
-		// for the higher-numbered vertex index for the matching edge and fill in the
-		// second triangle index. The maximum number of comparisons in this search for
-		// any vertex is the number of edges having that vertex as an endpoint.
-
-		triangle = triangleArray;
-		for (long a = 0; a < triangleCount; a++)
-		{
-			long i1 = triangle->index[2];
-			for (long b = 0; b < 3; b++)
-			{
-				long i2 = triangle->index[b];
-				if (i1 > i2)
-				{
-					for (long edgeIndex = firstEdge[i2]; edgeIndex != 0xFFFFFFFF;
-						edgeIndex = nextEdge[edgeIndex])
-					{
-						Edge *edge = &edgeArray[edgeIndex];
-						if ((edge->vertexIndex[1] == (unsigned int)i1) &&
-							(edge->faceIndex[0] == edge->faceIndex[1]))
-						{
-							edge->faceIndex[1] = (unsigned int) a;
-							break;
-						}
-					}
-				}
-
-				i1 = i2;
-			}
-
-			triangle++;
-		}
-
-		delete[] firstEdge;
-		return (edgeCount);
-	}
-
-	// $(CitedCodeEnd)
-
-} // namespace TerathonEdges
-
 void calc_edges(uint num_vertices, const uint* indices, uint num_indices, uint** _ppEdges, uint* out_num_edges)
 {
-	const uint numTriangles = num_indices / 3;
-	if ((uint)((long)num_vertices) != num_vertices)
-		throw std::out_of_range("num_vertices is out of range");
-	
-	if ((uint)((long)numTriangles) != numTriangles)
-		throw std::out_of_range("numTriangles is out of range");
-
-	TerathonEdges::Edge* edgeArray = new TerathonEdges::Edge[3 * numTriangles];
-
-	uint numEdges = static_cast<uint>(TerathonEdges::BuildEdges(static_cast<long>(num_vertices), static_cast<long>(numTriangles), (const TerathonEdges::Triangle *)indices, edgeArray));
+	std::vector<edge> edges(num_indices);
+	const uint numEdges = calc_edges(indices, num_indices, edges.data());
 
 	// @tony: Should the allocator be exposed?
 	*_ppEdges = new uint[numEdges * 2];
 
-	for (size_t i = 0; i < numEdges; i++)
+	for (uint i = 0; i < numEdges; i++)
 	{
-		(*_ppEdges)[i*2] = edgeArray[i].vertexIndex[0];
-		(*_ppEdges)[i*2+1] = edgeArray[i].vertexIndex[1];
+		if (edges[i].vertex[1] >= num_vertices)
+		{
+			delete [] *_ppEdges;
+			*_ppEdges = nullptr;
+			throw std::out_of_range("an index value indexes outside the range of vertices specified");
+		}
+
+		(*_ppEdges)[i*2] = edges[i].vertex[0];
+		(*_ppEdges)[i*2+1] = edges[i].vertex[1];
 	}
 
 	*out_num_edges = numEdges;
-
-	delete [] edgeArray;
 }
 
 void free_edge_list(uint* edges)
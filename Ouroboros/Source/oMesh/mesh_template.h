@@ -11,6 +11,7 @@
 #include <oHLSL/oHLSLMath.h>
 #include <oHLSL/oHLSLTypes.h>
 #include <oMemory/byte.h>
+#include <atomic>
 #include <vector>
 
 namespace ouro {
@@ -80,37 +81,47 @@ template<typename T, typename IndexT> void remove_degenerates(const TVEC3<T>* oR
 	if ((num_indices % 3) != 0)
 		oTHROW_INVARG("num_indices must be a multiple of 3");
 
-	for (uint i = 0; i < num_indices / 3; i++)
+	// classify concurrently, then compact in one pass
+	enum { keep, degenerate, out_of_range };
+	const uint nTriangles = num_indices / 3;
+	std::vector<uchar> kind(nTriangles);
+	parallel_for_range(0, nTriangles, [&](size_t begin, size_t end)
 	{
-		uint I = i * 3;
-		uint J = i * 3 + 1;
-		uint K = i * 3 + 2;
-
-		if (indices[I] >= num_positions || indices[J] >= num_positions || indices[K] >= num_positions)
-			oTHROW_INVARG("an index value indexes outside the range of vertices specified");
-
-		const TVEC3<T>& a = positions[indices[I]];
-		const TVEC3<T>& b = positions[indices[J]];
-		const TVEC3<T>& c = positions[indices[K]];
-
-		if (equal(cross(a - b, a - c), TVEC3<T>(T(0), T(0), T(0))))
+		for (size_t i = begin; i < end; i++)
 		{
-			indices[I] = invalid;
-			indices[J] = invalid;
-			indices[K] = invalid;
+			const IndexT* tri = indices + i * 3;
+			if (tri[0] >= num_positions || tri[1] >= num_positions || tri[2] >= num_positions)
+			{
+				kind[i] = out_of_range;
+				continue;
+			}
+
+			const TVEC3<T>& a = positions[tri[0]];
+			const TVEC3<T>& b = positions[tri[1]];
+			const TVEC3<T>& c = positions[tri[2]];
+			kind[i] = equal(cross(a - b, a - c), TVEC3<T>(T(0), T(0), T(0))) ? degenerate : keep;
 		}
-	}
+	});
 
-	*out_new_num_indices = num_indices;
-	for (uint i = 0; i < *out_new_num_indices; i++)
+	uint n = 0;
+	for (uint i = 0; i < nTriangles; i++)
 	{
-		if (indices[i] == invalid)
+		if (kind[i] == out_of_range)
+			oTHROW_INVARG("an index value indexes outside the range of vertices specified");
+
+		if (kind[i] == keep)
 		{
-			memcpy(&indices[i], &indices[i+1], sizeof(uint) * (num_indices - i - 1));
-			i--;
-			(*out_new_num_indices)--;
+			if (n != i * 3)
+			{
+				indices[n+0] = indices[i*3+0];
+				indices[n+1] = indices[i*3+1];
+				indices[n+2] = indices[i*3+2];
+			}
+			n += 3;
 		}
 	}
+
+	*out_new_num_indices = n;
 }
 
 template<typename T, typename IndexT> void calc_face_normals_task(size_t index, TVEC3<T>* oRESTRICT face_normals, const IndexT* oRESTRICT indices, uint num_indices, const TVEC3<T>* oRESTRICT positions, uint num_positions, T ccwMultiplier, bool* oRESTRICT _pSuccess)
@@ -148,88 +159,96 @@ template<typename T, typename IndexT> void calc_face_normals(TVEC3<T>* oRESTRICT
 		oTHROW_INVARG("an index value indexes outside the range of vertices specified");
 }
 
-template<typename InnerContainerT, typename VecT> void average_face_normals(
-	const std::vector<InnerContainerT>& container, const std::vector<TVEC3<VecT>>& face_normals
-	, TVEC3<VecT>* normals, uint num_vertex_normals, bool overwrite_all)
+// Triangles scatter into the vertices they use so accumulation can run across
+// threads without per-vertex face lists. Summation order varies between runs,
+// so results may differ in the last bits.
+template<typename T> void accumulate(std::atomic<T>& a, T value)
 {
-	// Now go through the list and average the normals
-	for (uint i = 0; i < num_vertex_normals; i++)
-	{
-		// If there is length on the data already, leave it alone
-		if (!overwrite_all && equal(normals[i], TVEC3<VecT>(VecT(0), VecT(0), VecT(0))))
-			continue;
+	T old = a.load(std::memory_order_relaxed);
+	while (!a.compare_exchange_weak(old, old + value, std::memory_order_relaxed));
+}
 
-		TVEC3<VecT> N(VecT(0), VecT(0), VecT(0));
-		const InnerContainerT& TrianglesUsed = container[i];
-		for (size_t t = 0; t < TrianglesUsed.size(); t++)
-		{
-			uint faceIndex = TrianglesUsed[t];
-			if (!equal(dot(face_normals[faceIndex], face_normals[faceIndex]), VecT(0)))
-				N += face_normals[faceIndex];
-		}
+template<typename T> void accumulate(std::atomic<T>* a, const TVEC3<T>& value)
+{
+	accumulate(a[0], value.x);
+	accumulate(a[1], value.y);
+	accumulate(a[2], value.z);
+}
 
-		normals[i] = normalize(N);
-	}
+template<typename T> TVEC3<T> load3(const std::atomic<T>* a)
+{
+	return TVEC3<T>(a[0].load(std::memory_order_relaxed), a[1].load(std::memory_order_relaxed), a[2].load(std::memory_order_relaxed));
 }
 
+// returns the angle between the edges from a to b and from a to c
+template<typename T> T corner_angle(const TVEC3<T>& a, const TVEC3<T>& b, const TVEC3<T>& c)
+{
+	const TVEC3<T> ab = b - a;
+	const TVEC3<T> ac = c - a;
+	const T d = sqrt(dot(ab, ab) * dot(ac, ac));
+	return d > T(0) ? acos(clamp(dot(ab, ac) / d, T(-1), T(1))) : T(0);
+}
+
+// Each face normal is weighted by the angle it subtends at the vertex so the
+// result doesn't depend on how a surface is triangulated.
 template<typename T, typename IndexT> void calc_vertex_normals(TVEC3<T>* oRESTRICT vertex_normals, const IndexT* oRESTRICT indices, uint num_indices
 	, const TVEC3<T>* oRESTRICT positions, uint num_positions, bool ccw = false, bool overwrite_all = true)
 {
-	std::vector<TVEC3<T>> faceNormals(num_indices / 3, TVEC3<T>(T(0), T(0), T(0)));
-
-	calc_face_normals(faceNormals.data(), indices, num_indices, positions, num_positions, ccw);
-
-	const uint nFaces = as_uint(num_indices) / 3;
-	const uint REASONABLE_MAX_FACES_PER_VERTEX = 32;
-	std::vector<fixed_vector<uint, REASONABLE_MAX_FACES_PER_VERTEX>> trianglesUsedByVertexA(num_positions);
-	std::vector<std::vector<uint>> trianglesUsedByVertex;
-	bool UseVecVec = false;
+	if ((num_indices % 3) != 0)
+		oTHROW_INVARG("num_indices must be a multiple of 3");
 
-	// Try with a less-memory-intensive method first. If that overflows, fall back
-	// to the alloc-y one. This is to avoid a 5x slowdown when std::vector gets
-	// released due to secure CRT over-zealousness in this case.
-	// for each vertex, store a list of the faces to which it contributes
-	for (uint i = 0; i < nFaces; i++)
+	std::vector<std::atomic<T>> sums(num_positions * 3);
+	parallel_for_range(0, sums.size(), [&](size_t begin, size_t end)
 	{
-		fixed_vector<uint, REASONABLE_MAX_FACES_PER_VERTEX>& a = trianglesUsedByVertexA[indices[i*3]];
-		fixed_vector<uint, REASONABLE_MAX_FACES_PER_VERTEX>& b = trianglesUsedByVertexA[indices[i*3+1]];
-		fixed_vector<uint, REASONABLE_MAX_FACES_PER_VERTEX>& c = trianglesUsedByVertexA[indices[i*3+2]];
+		for (size_t i = begin; i < end; i++)
+			sums[i].store(T(0), std::memory_order_relaxed);
+	});
 
-		// maybe fixed_vector should throw? and catch it here instead of this?
-		if (a.size() == a.capacity() || b.size() == b.capacity() || c.size() == c.capacity())
+	bool success = true;
+	const T s = ccw ? T(-1) : T(1);
+	parallel_for_range(0, num_indices / 3, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
 		{
-			UseVecVec = true;
-			break;
+			const IndexT* tri = indices + t * 3;
+			if (tri[0] >= num_positions || tri[1] >= num_positions || tri[2] >= num_positions)
+			{
+				success = false;
+				return;
+			}
+
+			const TVEC3<T>& a = positions[tri[0]];
+			const TVEC3<T>& b = positions[tri[1]];
+			const TVEC3<T>& c = positions[tri[2]];
+
+			// degenerate faces contribute nothing
+			const TVEC3<T> cr = cross(a - b, a - c);
+			if (equal(cr, TVEC3<T>(T(0), T(0), T(0))))
+				continue;
+
+			const TVEC3<T> n = normalize(cr) * s;
+			accumulate(&sums[tri[0] * 3], n * corner_angle(a, b, c));
+			accumulate(&sums[tri[1] * 3], n * corner_angle(b, c, a));
+			accumulate(&sums[tri[2] * 3], n * corner_angle(c, a, b));
 		}
+	});
 
-		push_back_unique(a, i);
-		push_back_unique(b, i);
-		push_back_unique(c, i);
-	}
+	if (!success)
+		oTHROW_INVARG("an index value indexes outside the range of vertices specified");
 
-	if (UseVecVec)
+	parallel_for_range(0, num_positions, [&](size_t begin, size_t end)
 	{
-		free_memory(trianglesUsedByVertexA);
-		trianglesUsedByVertex.resize(num_positions);
-
-		for (uint i = 0; i < nFaces; i++)
+		const TVEC3<T> Zero3(T(0), T(0), T(0));
+		for (size_t v = begin; v < end; v++)
 		{
-			push_back_unique(trianglesUsedByVertex[indices[i*3]], i);
-			push_back_unique(trianglesUsedByVertex[indices[i*3+1]], i);
-			push_back_unique(trianglesUsedByVertex[indices[i*3+2]], i);
-		}
-
-		average_face_normals(trianglesUsedByVertex, faceNormals, vertex_normals, num_positions, overwrite_all);
+			// If there is length on the data already, leave it alone
+			if (!overwrite_all && !equal(vertex_normals[v], Zero3))
+				continue;
 
-		uint MaxValence = 0;
-		// print out why we ended up in this path...
-		for (uint i = 0; i < num_positions; i++)
-			MaxValence = __max(MaxValence, as_uint(trianglesUsedByVertex[i].size()));
-		oTRACE("debug-slow path in normals caused by reasonable max valence (%u) being exceeded. Actual valence: %u", REASONABLE_MAX_FACES_PER_VERTEX, MaxValence);
-	}
-
-	else
-		average_face_normals(trianglesUsedByVertexA, faceNormals, vertex_normals, num_positions, overwrite_all);
+			const TVEC3<T> N = load3(&sums[v * 3]);
+			vertex_normals[v] = equal(N, Zero3) ? Zero3 : normalize(N);
+		}
+	});
 }
 
 template<typename T, typename IndexT, typename TexCoordTupleT> void calc_vertex_tangents(TVEC4<T>* oRESTRICT tangents, const IndexT* oRESTRICT indices, uint num_indices
@@ -242,60 +261,72 @@ template<typename T, typename IndexT, typename TexCoordTupleT> void calc_vertex_
 		description="http://www.terathon.com/code/tangent.html"
 		license="*** Assumed Public Domain ***"
 		licenseurl="http://www.terathon.com/code/tangent.html"
-		modification="Changes types to oMath types"
+		modification="Changes types to oMath types, accumulates concurrently and skips faces with degenerate texcoords"
 	/>*/
 
 	// $(CitedCodeBegin)
 
-	std::vector<TVEC3<T>> tan1(num_vertices, TVEC3<T>(T(0), T(0), T(0)));
-	std::vector<TVEC3<T>> tan2(num_vertices, TVEC3<T>(T(0), T(0), T(0)));
+	// tan1 and tan2 interleaved per vertex
+	std::vector<std::atomic<T>> tan(num_vertices * 6);
+	parallel_for_range(0, tan.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			tan[i].store(T(0), std::memory_order_relaxed);
+	});
 
-	const uint count = num_indices / 3;
-	for (uint i = 0; i < count; i++)
+	parallel_for_range(0, num_indices / 3, [&](size_t begin, size_t end)
 	{
-		const uint a = indices[3*i];
-		const uint b = indices[3*i+1];
-		const uint c = indices[3*i+2];
-
-		const TVEC3<T>& Pa = positions[a];
-		const TVEC3<T>& Pb = positions[b];
-		const TVEC3<T>& Pc = positions[c];
-
-		const T x1 = Pb.x - Pa.x;
-		const T x2 = Pc.x - Pa.x;
-		const T y1 = Pb.y - Pa.y;
-		const T y2 = Pc.y - Pa.y;
-		const T z1 = Pb.z - Pa.z;
-		const T z2 = Pc.z - Pa.z;
+		for (size_t i = begin; i < end; i++)
+		{
+			const uint a = indices[3*i];
+			const uint b = indices[3*i+1];
+			const uint c = indices[3*i+2];
+
+			const TVEC3<T>& Pa = positions[a];
+			const TVEC3<T>& Pb = positions[b];
+			const TVEC3<T>& Pc = positions[c];
+
+			const T x1 = Pb.x - Pa.x;
+			const T x2 = Pc.x - Pa.x;
+			const T y1 = Pb.y - Pa.y;
+			const T y2 = Pc.y - Pa.y;
+			const T z1 = Pb.z - Pa.z;
+			const T z2 = Pc.z - Pa.z;
         
-		const auto& TCa = texcoords[a];
-		const auto& TCb = texcoords[b];
-		const auto& TCc = texcoords[c];
-
-		const T s1 = TCb.x - TCa.x;
-		const T s2 = TCc.x - TCa.x;
-		const T t1 = TCb.y - TCa.y;
-		const T t2 = TCc.y - TCa.y;
-
-		T r = T(1) / (s1 * t2 - s2 * t1);
-		TVEC3<T> s((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
-		TVEC3<T> t((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
-
-		tan1[a] += s;
-		tan1[b] += s;
-		tan1[c] += s;
-
-		tan2[a] += t;
-		tan2[b] += t;
-		tan2[c] += t;
-	}
+			const auto& TCa = texcoords[a];
+			const auto& TCb = texcoords[b];
+			const auto& TCc = texcoords[c];
+
+			const T s1 = TCb.x - TCa.x;
+			const T s2 = TCc.x - TCa.x;
+			const T t1 = TCb.y - TCa.y;
+			const T t2 = TCc.y - TCa.y;
+
+			const T det = s1 * t2 - s2 * t1;
+			if (det == T(0))
+				continue;
+
+			T r = T(1) / det;
+			TVEC3<T> s((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+			TVEC3<T> t((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
+
+			accumulate(&tan[a*6], s);
+			accumulate(&tan[b*6], s);
+			accumulate(&tan[c*6], s);
+
+			accumulate(&tan[a*6+3], t);
+			accumulate(&tan[b*6+3], t);
+			accumulate(&tan[c*6+3], t);
+		}
+	});
 
 	parallel_for(0, num_vertices, [&](size_t _Index)
 	{
 		// Gram-Schmidt orthogonalize + handedness
 		const TVEC3<T>& n = normals[_Index];
-		const TVEC3<T>& t = tan1[_Index];
-		tangents[_Index] = TVEC4<T>(normalize(t - n * dot(n, t)), (dot(cross(n, t), tan2[_Index]) < T(0)) ? T(-1) : T(1));
+		const TVEC3<T> t = load3(&tan[_Index*6]);
+		const TVEC3<T> t2 = load3(&tan[_Index*6+3]);
+		tangents[_Index] = TVEC4<T>(normalize(t - n * dot(n, t)), (dot(cross(n, t), t2) < T(0)) ? T(-1) : T(1));
 	});
 
 	// $(CitedCodeEnd)
@@ -0,0 +1,326 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/meshlet.h>
+#include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+#include <cfloat>
+#include <vector>
+
+namespace ouro { namespace mesh {
+
+uint calc_max_meshlets(uint num_indices, uint max_vertices, uint max_triangles)
+{
+	// A meshlet is only closed when the next triangle doesn't fit, so each
+	// closed one has max_triangles triangles or more than max_vertices - 3
+	// vertices. Vertex entries never exceed num_indices.
+	return (num_indices / 3) / max_triangles + num_indices / (max_vertices - 2) + 1;
+}
+
+template<typename IndexT>
+static uint build_meshlets_t(meshlet* out_meshlets, uint* out_vertices, uchar* out_triangles, const IndexT* indices, uint num_indices, uint num_vertices, uint max_vertices, uint max_triangles)
+{
+	if ((num_indices % 3) != 0)
+		oTHROW_INVARG("num_indices must be a multiple of 3");
+	if (max_vertices < 3 || max_vertices > 255 || max_triangles < 1 || max_triangles > 255)
+		oTHROW_INVARG("meshlets must have 3-255 vertices and 1-255 triangles");
+
+	if (!num_indices)
+		return 0;
+
+	const vertex_range r = calc_vertex_range(indices, num_indices);
+	if ((r.base_vertex + r.num_vertices) > num_vertices)
+		oTHROW_INVARG("an index value indexes outside the range of vertices specified");
+	const uint min_vertex = r.base_vertex;
+
+	// local index of each vertex in the current meshlet, 0xff if not in it,
+	// which is why meshlets are limited to 255 vertices
+	std::vector<uchar> local(r.num_vertices, 0xff);
+
+	uint nMeshlets = 0;
+	meshlet m;
+	m.vertex_offset = 0;
+	m.triangle_offset = 0;
+	m.num_vertices = 0;
+	m.num_triangles = 0;
+	m.padA = 0;
+
+	for (uint i = 0; i < num_indices; i += 3)
+	{
+		const uint a = indices[i], b = indices[i+1], c = indices[i+2];
+		const uint nNew = (local[a - min_vertex] == 0xff) + (local[b - min_vertex] == 0xff && b != a) + (local[c - min_vertex] == 0xff && c != a && c != b);
+		if ((m.num_vertices + nNew) > max_vertices || m.num_triangles == max_triangles)
+		{
+			for (uint v = 0; v < m.num_vertices; v++)
+				local[out_vertices[m.vertex_offset + v] - min_vertex] = 0xff;
+
+			out_meshlets[nMeshlets++] = m;
+			m.vertex_offset += m.num_vertices;
+			m.triangle_offset += m.num_triangles * 3;
+			m.num_vertices = 0;
+			m.num_triangles = 0;
+		}
+
+		uchar* tri = out_triangles + m.triangle_offset + m.num_triangles * 3;
+		const uint v[3] = { a, b, c };
+		for (uint k = 0; k < 3; k++)
+		{
+			uchar& l = local[v[k] - min_vertex];
+			if (l == 0xff)
+			{
+				l = uchar(m.num_vertices);
+				out_vertices[m.vertex_offset + m.num_vertices++] = v[k];
+			}
+			tri[k] = l;
+		}
+
+		m.num_triangles++;
+	}
+
+	if (m.num_triangles)
+		out_meshlets[nMeshlets++] = m;
+
+	return nMeshlets;
+}
+
+uint build_meshlets(meshlet* out_meshlets, uint* out_vertices, uchar* out_triangles, const uint* indices, uint num_indices, uint num_vertices, uint max_vertices, uint max_triangles)
+{
+	return build_meshlets_t(out_meshlets, out_vertices, out_triangles, indices, num_indices, num_vertices, max_vertices, max_triangles);
+}
+
+uint build_meshlets(meshlet* out_meshlets, uint* out_vertices, uchar* out_triangles, const ushort* indices, uint num_indices, uint num_vertices, uint max_vertices, uint max_triangles)
+{
+	return build_meshlets_t(out_meshlets, out_vertices, out_triangles, indices, num_indices, num_vertices, max_vertices, max_triangles);
+}
+
+meshlet_bounds calc_meshlet_bounds(const meshlet& m, const uint* vertices, const uchar* triangles, const float3* positions, uint position_stride, bool ccw)
+{
+	const uint* verts = vertices + m.vertex_offset;
+	const uchar* tris = triangles + m.triangle_offset;
+	auto position = [&](uint local) -> const float3& { return *(const float3*)byte_add(positions, position_stride, verts[local]); };
+
+	meshlet_bounds b;
+	b.box_min = float3(FLT_MAX);
+	b.box_max = float3(-FLT_MAX);
+	for (uint v = 0; v < m.num_vertices; v++)
+	{
+		b.box_min = min(b.box_min, position(v));
+		b.box_max = max(b.box_max, position(v));
+	}
+
+	const float3 center = (b.box_min + b.box_max) * 0.5f;
+	float radius_sq = 0.0f;
+	for (uint v = 0; v < m.num_vertices; v++)
+	{
+		const float3 d = position(v) - center;
+		radius_sq = max(radius_sq, dot(d, d));
+	}
+	b.sphere = spheref(center, sqrt(radius_sq));
+
+	// the cone axis averages the face normals and its spread is set by the
+	// normal furthest from it
+	float3 normals[255]; // zero for degenerate triangles
+	uint nNormals = 0;
+	float3 axis(0.0f, 0.0f, 0.0f);
+	const float s = ccw ? -1.0f : 1.0f;
+	for (uint t = 0; t < m.num_triangles; t++)
+	{
+		const float3& p0 = position(tris[t*3]);
+		const float3 n = cross(position(tris[t*3+1]) - p0, position(tris[t*3+2]) - p0);
+		const float len = length(n);
+		if (len == 0.0f)
+		{
+			normals[t] = float3(0.0f, 0.0f, 0.0f);
+			continue;
+		}
+		normals[t] = n * (s / len);
+		axis += normals[t];
+		nNormals++;
+	}
+
+	b.cone_apex = center;
+	b.cone_axis = float3(0.0f, 0.0f, 0.0f);
+	b.cone_cutoff = 1.0f;
+
+	const float axis_len = length(axis);
+	if (!nNormals || axis_len == 0.0f)
+		return b;
+
+	axis /= axis_len;
+	float min_dot = 1.0f;
+	for (uint t = 0; t < m.num_triangles; t++)
+	{
+		if (dot(normals[t], normals[t]) != 0.0f)
+			min_dot = min(min_dot, dot(axis, normals[t]));
+	}
+
+	b.cone_axis = axis;
+
+	// a cone wider than a hemisphere (with some slack) can't be culled
+	if (min_dot <= 0.1f)
+		return b;
+
+	// Move the apex back along the axis until it's behind every triangle's
+	// plane, so any eye in the cone sees every triangle's back.
+	float max_t = 0.0f;
+	for (uint t = 0; t < m.num_triangles; t++)
+	{
+		if (dot(normals[t], normals[t]) == 0.0f)
+			continue;
+		const float3& p0 = position(tris[t*3]);
+		const float dc = dot(center - p0, normals[t]);
+		const float dn = dot(axis, normals[t]);
+		max_t = max(max_t, dc / dn);
+	}
+
+	b.cone_apex = center - axis * max_t;
+	b.cone_cutoff = sqrt(1.0f - min_dot * min_dot);
+	return b;
+}
+
+bool outside(const oFrustumf& f, const meshlet_bounds& b)
+{
+	const float3 center = b.sphere.xyz();
+	const float3 half_size = (b.box_max - b.box_min) * 0.5f;
+	const float3 box_center = (b.box_max + b.box_min) * 0.5f;
+	const planef* planes = &f.Left;
+	for (uint i = 0; i < oFRUSTUM_PLANE_COUNT; i++)
+	{
+		const planef& p = planes[i];
+		if (sdistance(p, center) < -b.sphere.radius())
+			return true;
+
+		// planes point inward, so the box is out if its corner furthest along
+		// the normal is behind the plane
+		const float3 n = p.xyz();
+		if (sdistance(p, box_center) + dot(half_size, abs(n)) < 0.0f)
+			return true;
+	}
+
+	return false;
+}
+
+bool backfacing(const float3& eye, const meshlet_bounds& b)
+{
+	const float3 d = b.cone_apex - eye;
+	const float len = length(d);
+	return len > 0.0f && dot(d, b.cone_axis) >= b.cone_cutoff * len;
+}
+
+void meshlet_set::initialize(const meshlet_set_info& i, const allocator& a)
+{
+	deinitialize();
+	info = i;
+
+	// largest alignment first
+	bounds_offset = 0;
+	meshlets_offset = bounds_offset + sizeof(meshlet_bounds) * i.num_meshlets;
+	ranges_offset = meshlets_offset + sizeof(meshlet) * i.num_meshlets;
+	vertices_offset = ranges_offset + sizeof(meshlet_range) * i.num_subsets;
+	triangles_offset = vertices_offset + sizeof(uint) * i.num_vertices;
+	const uint size = triangles_offset + i.num_triangles * 3;
+
+	alloc = a.scoped_allocate(size, memory_alignment::align_default, "meshlet_set");
+	data = alloc;
+	memset(data, 0, size);
+}
+
+void meshlet_set::deinitialize()
+{
+	alloc = scoped_allocation();
+	data = nullptr;
+	info = meshlet_set_info();
+}
+
+template<typename IndexT>
+static void make_meshlets_t(meshlet_set& ms, const model& m, const IndexT* indices, const meshlet_options& options, const allocator& a)
+{
+	const model_info i = m.get_info();
+	const model_subset* subsets = m.subsets();
+
+	uint position_stride = 0;
+	const float3* positions = find_positions(m, &position_stride);
+
+	if (!positions)
+		oTHROW_INVARG("meshlets require r32g32b32_float positions");
+
+	struct subset_meshlets
+	{
+		std::vector<meshlet> meshlets;
+		std::vector<uint> vertices;
+		std::vector<uchar> triangles;
+	};
+
+	std::vector<subset_meshlets> built(i.num_subsets);
+	parallel_for(0, i.num_subsets, [&](size_t subset)
+	{
+		const model_subset& ss = subsets[subset];
+		subset_meshlets& sm = built[subset];
+		sm.meshlets.resize(calc_max_meshlets(ss.num_indices, options.max_vertices, options.max_triangles));
+		sm.vertices.resize(ss.num_indices);
+		sm.triangles.resize(ss.num_indices);
+		sm.meshlets.resize(build_meshlets(sm.meshlets.data(), sm.vertices.data(), sm.triangles.data()
+			, indices + ss.start_index, ss.num_indices, i.num_vertices, options.max_vertices, options.max_triangles));
+		if (!sm.meshlets.empty())
+		{
+			const meshlet& last = sm.meshlets.back();
+			sm.vertices.resize(last.vertex_offset + last.num_vertices);
+			sm.triangles.resize(last.triangle_offset + last.num_triangles * 3);
+		}
+	});
+
+	meshlet_set_info si;
+	si.num_subsets = i.num_subsets;
+	for (const subset_meshlets& sm : built)
+	{
+		si.num_meshlets += uint(sm.meshlets.size());
+		si.num_vertices += uint(sm.vertices.size());
+		si.num_triangles += uint(sm.triangles.size() / 3);
+	}
+
+	ms.initialize(si, a);
+
+	meshlet_range* ranges = ms.ranges();
+	meshlet* meshlets = ms.meshlets();
+	uint* vertices = ms.vertices();
+	uchar* triangles = ms.triangles();
+	uint nMeshlets = 0, nVertices = 0, nTriangleIndices = 0;
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+	{
+		const subset_meshlets& sm = built[subset];
+		ranges[subset].start_meshlet = nMeshlets;
+		ranges[subset].num_meshlets = uint(sm.meshlets.size());
+		for (meshlet ml : sm.meshlets)
+		{
+			ml.vertex_offset += nVertices;
+			ml.triangle_offset += nTriangleIndices;
+			meshlets[nMeshlets++] = ml;
+		}
+
+		if (!sm.vertices.empty())
+			memcpy(vertices + nVertices, sm.vertices.data(), sm.vertices.size() * sizeof(uint));
+		if (!sm.triangles.empty())
+			memcpy(triangles + nTriangleIndices, sm.triangles.data(), sm.triangles.size());
+		nVertices += uint(sm.vertices.size());
+		nTriangleIndices += uint(sm.triangles.size());
+	}
+
+	meshlet_bounds* bounds = ms.bounds();
+	parallel_for(0, si.num_meshlets, [&](size_t index)
+	{
+		bounds[index] = calc_meshlet_bounds(meshlets[index], vertices, triangles, positions, position_stride, options.ccw);
+	});
+}
+
+std::shared_ptr<meshlet_set> make_meshlets(const model& m, const meshlet_options& options, const allocator& a)
+{
+	std::shared_ptr<meshlet_set> ms = std::make_shared<meshlet_set>();
+	const model_info i = m.get_info();
+	if (has_16bit_indices(i.num_vertices))
+		make_meshlets_t(*ms, m, m.indices(), options, a);
+	else
+		make_meshlets_t(*ms, m, m.indices32(), options, a);
+	return ms;
+}
+
+}}
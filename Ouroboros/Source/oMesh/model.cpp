@@ -1,10 +1,17 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oMesh/model.h>
 #include <oMesh/mesh.h>
+#include <oBase/snappy.h>
+#include <oBase/throw.h>
+#include <oMemory/byte.h>
 #include <oMemory/fnv1a.h>
 
 namespace ouro { namespace mesh {
 
+// sections of the data blob start on this boundary so vertex data can be
+// streamed with aligned loads wherever the blob is placed.
+static const uint kSectionAlignment = 16;
+
 static uint calc_vertex_size(const element_array& elements, uint* out_nslots = 0)
 {
 	uint vertex_size = 0;
@@ -15,7 +22,7 @@ static uint calc_vertex_size(const element_array& elements, uint* out_nslots = 0
 		if (slot_size)
 		{
 			vertex_size += slot_size;
-			nslots++;
+			nslots = slot + 1;
 		}
 	}
 
@@ -24,20 +31,54 @@ static uint calc_vertex_size(const element_array& elements, uint* out_nslots = 0
 	return vertex_size;
 }
 
+static bool compressible(uint section)
+{
+	return section == model_section::vertices || section == model_section::indices;
+}
+
+model::model()
+	: data(nullptr)
+	, rt_vertex_slots_offset(0)
+	, rt_indices_offset(0)
+	, rt_materials_offset(0)
+	, rt_material_names_offset(0)
+	, vertex_slots_offset(0)
+	, material_hashes_offset(0)
+	, indices_offset(0)
+	, material_names_offset(0)
+	, dealloc(0)
+{}
+
+model::~model()
+{
+	deinitialize();
+}
+
 void model::initialize_placement()
 {
 	data = (uchar*)(this + 1);
-	// everything else should be already set up
+	dealloc = 0;
+
+	// runtime pointers from whatever process wrote the model are meaningless
+	memset(data+rt_vertex_slots_offset, 0, rt_material_names_offset - rt_vertex_slots_offset);
+
+	const char** rt_name = (const char**)(data+rt_material_names_offset);
+	const char* name = (const char*)(data+material_names_offset);
+	for (uint subset = 0; subset < info.num_subsets; subset++)
+	{
+		*rt_name++ = name;
+		name += strlen(name) + 1;
+	}
 }
 
 void model::initialize(const model_info& i, const char** material_names, const allocator& a)
 {
 	info = i;
 	dealloc = (ullong)a.deallocate;
-	
+
 	// sum up component sizes
 	uint nslots = 0;
-	uint sizeof_vertex = calc_vertex_size(i.elements, &nslots);
+	calc_vertex_size(i.elements, &nslots);
 
 	uint subset_data_size = sizeof(model_subset) * i.num_subsets;
 
@@ -46,45 +87,57 @@ void model::initialize(const model_info& i, const char** material_names, const a
 	uint rt_materials_size = sizeof(ullong) * i.num_subsets;
 	uint rt_names_size = sizeof(ullong) * i.num_subsets;
 
-	uint vertex_slots_size = sizeof(uint) * nslots;
-	uint vertex_data_size = sizeof_vertex * i.num_vertices;
-	uint material_hashes_size = sizeof(ullong) * i.num_subsets;
-	uint indices_data_size = sizeof(ushort) * i.num_indices;
+	uint vertex_slots_size = byte_align(sizeof(uint) * nslots, kSectionAlignment);
+	uint vertex_data_size = 0;
+	for (uint slot = 0; slot < nslots; slot++)
+		vertex_data_size += byte_align(mesh::calc_vertex_size(i.elements, slot) * i.num_vertices, kSectionAlignment);
+
+	uint material_hashes_size = byte_align(sizeof(ullong) * i.num_subsets, kSectionAlignment);
+	uint indices_data_size = byte_align(index_size(i.num_vertices) * i.num_indices, kSectionAlignment);
 
 	uint material_names_size = 0;
 	for (uint subset = 0; subset < i.num_subsets; subset++)
 		material_names_size += (uint)strlen(material_names[subset]) + 1;
 
-	uint total_bytes = subset_data_size
-		+ rt_vertex_size + rt_indices_size + rt_materials_size + rt_names_size
-		+ vertex_slots_size + vertex_data_size + material_hashes_size + indices_data_size
-		+ material_names_size;
-
-	// allocate
-	data = (uchar*)a.allocate(total_bytes, memory_alignment::align_default, "model data");
-	oASSERT(data, "failed alloc");
-
 	// setup offsets into data
 	rt_vertex_slots_offset = 0 + subset_data_size;
 	rt_indices_offset = rt_vertex_slots_offset + rt_vertex_size;
 	rt_materials_offset = rt_indices_offset + rt_indices_size;
 	rt_material_names_offset = rt_materials_offset + rt_materials_size;
-	
-	vertex_slots_offset = rt_material_names_offset + rt_names_size;
+
+	vertex_slots_offset = byte_align(rt_material_names_offset + rt_names_size, kSectionAlignment);
 	material_hashes_offset = vertex_slots_offset + vertex_slots_size + vertex_data_size;
 	indices_offset = material_hashes_offset + material_hashes_size;
 	material_names_offset = indices_offset + indices_data_size;
 
-	// set pointer memory to nullptr
-	memset(data+rt_vertex_slots_offset, 0, vertex_slots_offset - rt_vertex_slots_offset);
+	uint total_bytes = material_names_offset + material_names_size;
+
+	// allocate
+	data = (uchar*)a.allocate(total_bytes, memory_alignment::align_default, "model data");
+	oASSERT(data, "failed alloc");
+
+	// zero everything so padding is deterministic in saved files
+	memset(data, 0, material_names_offset);
+
+	// vertex data for each slot follows the table of slot offsets
+	uint* slot_offset = (uint*)(data+vertex_slots_offset);
+	uint offset = vertex_slots_offset + vertex_slots_size;
+	for (uint slot = 0; slot < nslots; slot++)
+	{
+		const uint slot_size = mesh::calc_vertex_size(i.elements, slot);
+		slot_offset[slot] = slot_size ? offset : 0;
+		offset += byte_align(slot_size * i.num_vertices, kSectionAlignment);
+	}
 
 	// assign material names
 	ullong* material_hash = (ullong*)(data+material_hashes_offset);
+	const char** rt_name = (const char**)(data+rt_material_names_offset);
 	char* name = (char*)(data+material_names_offset);
 	for (uint subset = 0; subset < i.num_subsets; subset++)
 	{
 		const char* material_name = material_names[subset];
 		*material_hash++ = fnv1a<ullong>(material_name);
+		*rt_name++ = name;
 		name += strlcpy(name, material_name, material_names_size) + 1;
 	}
 }
@@ -107,4 +160,182 @@ void model::deinitialize()
 	}
 }
 
+uint model::data_size() const
+{
+	const char* name = (const char*)(data+material_names_offset);
+	for (uint subset = 0; subset < info.num_subsets; subset++)
+		name += strlen(name) + 1;
+	return uint(name - (const char*)data);
+}
+
+void model::section_offsets(uint offsets[model_section::count + 1]) const
+{
+	offsets[model_section::subsets] = 0;
+	offsets[model_section::vertices] = vertex_slots_offset;
+	offsets[model_section::material_hashes] = material_hashes_offset;
+	offsets[model_section::indices] = indices_offset;
+	offsets[model_section::material_names] = material_names_offset;
+	offsets[model_section::count] = data_size();
+}
+
+scoped_allocation model::save(const uint128& source_hash, const model_compression& compression, const allocator& a) const
+{
+	uint offsets[model_section::count + 1];
+	section_offsets(offsets);
+
+	model_file_header h;
+	memset(&h, 0, sizeof(h));
+	h.fourcc = model_file_fourcc;
+	h.version = model_file_version;
+	h.num_sections = model_section::count;
+	h.sizeof_model = sizeof(model);
+	h.data_size = offsets[model_section::count];
+	h.source_hash = source_hash;
+
+	size_t capacity = sizeof(model_file_header) + sizeof(model);
+	for (uint section = 0; section < model_section::count; section++)
+	{
+		model_file_section& s = h.sections[section];
+		s.offset = offsets[section];
+		s.size = offsets[section+1] - offsets[section];
+		s.compression = (compression != model_compression::none && compressible(section) && s.size) ? compression : model_compression::none;
+		capacity += s.compression == model_compression::snappy ? snappy_compress(nullptr, 0, data+s.offset, s.size) : s.size;
+	}
+
+	scoped_allocation file = a.scoped_allocate(capacity, memory_alignment::align_default, "model file");
+	uchar* dst = (uchar*)file + sizeof(model_file_header) + sizeof(model);
+	const uchar* end = (uchar*)file + capacity;
+
+	for (uint section = 0; section < model_section::count; section++)
+	{
+		model_file_section& s = h.sections[section];
+		const uchar* src = data + s.offset;
+		s.stored_size = s.size;
+
+		if (s.compression == model_compression::snappy)
+		{
+			s.stored_size = (uint)snappy_compress(dst, end - dst, src, s.size);
+
+			// not worth a decompress on load
+			if (s.stored_size >= s.size)
+			{
+				s.compression = model_compression::none;
+				s.stored_size = s.size;
+			}
+		}
+
+		if (s.compression == model_compression::none)
+			memcpy(dst, src, s.size);
+
+		dst += s.stored_size;
+	}
+
+	// runtime pointers aren't saved
+	uchar* saved_data = (uchar*)file + sizeof(model_file_header) + sizeof(model);
+	memset(saved_data+rt_vertex_slots_offset, 0, vertex_slots_offset - rt_vertex_slots_offset);
+
+	model* saved = (model*)((uchar*)file + sizeof(model_file_header));
+	memcpy(saved, this, sizeof(model));
+	saved->data = nullptr;
+	saved->dealloc = 0;
+
+	memcpy(file, &h, sizeof(h));
+
+	const size_t file_size = dst - (uchar*)file;
+	return scoped_allocation(file.release(), file_size, a.deallocate);
+}
+
+model* model::load(void* file, size_t file_size, const uint128& source_hash, scoped_allocation* out_decompressed, const allocator& a)
+{
+	const model_file_header* h = (const model_file_header*)file;
+	if (file_size < (sizeof(model_file_header) + sizeof(model)) || h->fourcc != model_file_fourcc)
+		oTHROW(protocol_error, "not a model file");
+
+	if (h->version != model_file_version || h->num_sections != model_section::count || h->sizeof_model != sizeof(model))
+		oTHROW(not_supported, "model file version %u is not supported (expecting %u)", h->version, model_file_version);
+
+	if (!(h->source_hash == source_hash))
+		oTHROW(protocol_error, "model file was built from a different source");
+
+	model* m = (model*)(h + 1);
+	uint offsets[model_section::count + 1] = { 0, m->vertex_slots_offset, m->material_hashes_offset, m->indices_offset, m->material_names_offset, h->data_size };
+
+	size_t stored = sizeof(model_file_header) + sizeof(model);
+	bool compressed = false;
+	for (uint section = 0; section < model_section::count; section++)
+	{
+		const model_file_section& s = h->sections[section];
+		if (s.offset != offsets[section] || s.size != (offsets[section+1] - offsets[section]) || s.compression >= model_compression::count
+			|| (s.compression == model_compression::none && s.stored_size != s.size))
+			oTHROW(protocol_error, "model file section %u is corrupt", section);
+		compressed = compressed || s.compression != model_compression::none;
+		stored += s.stored_size;
+	}
+
+	if (stored != file_size)
+		oTHROW(protocol_error, "model file is truncated");
+
+	if (compressed)
+	{
+		*out_decompressed = a.scoped_allocate(sizeof(model) + h->data_size, memory_alignment::align_default, "model");
+		model* dm = (model*)(void*)*out_decompressed;
+		memcpy(dm, m, sizeof(model));
+
+		uchar* dst = (uchar*)(dm + 1);
+		const uchar* src = (const uchar*)(m + 1);
+		for (uint section = 0; section < model_section::count; section++)
+		{
+			const model_file_section& s = h->sections[section];
+			if (s.compression == model_compression::snappy)
+			{
+				if (snappy_decompress(nullptr, 0, src, s.stored_size) != s.size)
+					oTHROW(protocol_error, "model file section %u is corrupt", section);
+				snappy_decompress(dst + s.offset, s.size, src, s.stored_size);
+			}
+			else
+				memcpy(dst + s.offset, src, s.size);
+			src += s.stored_size;
+		}
+
+		m = dm;
+	}
+
+	m->initialize_placement();
+	return m;
+}
+
+const float3* find_positions(const model& m, uint* out_stride)
+{
+	const model_info i = m.get_info();
+	for (uint e = 0; e < max_num_elements; e++)
+	{
+		const element& el = i.elements[e];
+		if (el.semantic() == surface::semantic::vertex_position && el.format() == surface::format::r32g32b32_float)
+		{
+			*out_stride = calc_vertex_size(i.elements, el.slot());
+			return (const float3*)byte_add(m.vertices(el.slot()), calc_offset(i.elements, e));
+		}
+	}
+
+	*out_stride = 0;
+	return nullptr;
+}
+
+template<typename IndexT>
+static vertex_range calc_vertex_range_t(const IndexT* indices, uint num_indices)
+{
+	vertex_range r;
+	if (num_indices)
+	{
+		uint min_vertex = 0, max_vertex = 0;
+		calc_min_max_indices(indices, 0, num_indices, 0, &min_vertex, &max_vertex);
+		r.base_vertex = min_vertex;
+		r.num_vertices = max_vertex - min_vertex + 1;
+	}
+	return r;
+}
+
+vertex_range calc_vertex_range(const uint* indices, uint num_indices) { return calc_vertex_range_t(indices, num_indices); }
+vertex_range calc_vertex_range(const ushort* indices, uint num_indices) { return calc_vertex_range_t(indices, num_indices); }
+
 }}
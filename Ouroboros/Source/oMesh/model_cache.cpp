@@ -0,0 +1,247 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/model_cache.h>
+#include <oBase/finally.h>
+#include <oBase/throw.h>
+#include <oCore/filesystem.h>
+#include <oCore/process.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/murmur3.h>
+#include <oString/fixed_string.h>
+#include <atomic>
+#include <vector>
+
+namespace ouro { namespace mesh {
+
+std::shared_ptr<model> make_model(const obj::info& obj, const allocator& a)
+{
+	const info& mi = obj.mesh_info;
+
+	model_info i;
+	i.num_vertices = mi.num_vertices;
+	i.num_indices = mi.num_indices;
+	i.num_subsets = mi.num_ranges;
+	i.extents = mi.local_space_bound.size() / 2.0f;
+	i.bounding_sphere = spheref(mi.local_space_bound.center(), length(i.extents));
+
+	uint nElements = 0;
+	i.elements[nElements++] = element(surface::semantic::vertex_position, 0, surface::format::r32g32b32_float, 0);
+	if (obj.normals)
+		i.elements[nElements++] = element(surface::semantic::vertex_normal, 0, surface::format::r32g32b32_float, 1);
+	if (obj.texcoords)
+		i.elements[nElements++] = element(surface::semantic::vertex_texcoord, 0, surface::format::r32g32_float, 1);
+
+	std::vector<const char*> material_names(i.num_subsets);
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+		material_names[subset] = obj.groups[subset].material_name;
+
+	std::shared_ptr<model> m = std::make_shared<model>();
+	m->initialize(i, material_names.data(), a);
+
+	model_subset* subsets = m->subsets();
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+	{
+		const range& r = obj.ranges[subset];
+		model_subset& s = subsets[subset];
+		s.start_index = r.start_primitive * 3;
+		s.num_indices = r.num_primitives * 3;
+		s.start_vertex = r.num_primitives ? r.min_vertex : 0;
+		s.num_vertices = r.num_primitives ? (r.max_vertex - r.min_vertex + 1) : 0;
+		s.material_index = (ushort)subset;
+		s.flags = 0;
+	}
+
+	// Copy each element into its slot
+	const void* sources[] = { obj.positions, obj.normals, obj.texcoords };
+	static const surface::semantic kSemantics[] = { surface::semantic::vertex_position, surface::semantic::vertex_normal, surface::semantic::vertex_texcoord };
+	for (uint e = 0; e < nElements; e++)
+	{
+		const element& el = i.elements[e];
+		const void* src = nullptr;
+		for (uint s = 0; s < oCOUNTOF(kSemantics); s++)
+			if (kSemantics[s] == el.semantic())
+				src = sources[s];
+
+		copy_element(calc_offset(i.elements, e), m->vertices(el.slot()), calc_vertex_size(i.elements, el.slot())
+			, el.format(), src, sizeof(float3), surface::format::r32g32b32_float, i.num_vertices);
+	}
+
+	if (has_16bit_indices(i.num_vertices))
+		copy_indices(m->indices(), obj.indices, i.num_indices);
+	else
+		memcpy(m->indices32(), obj.indices, i.num_indices * sizeof(uint));
+
+	return m;
+}
+
+// Folds in only the options that change the model, not the parsing estimates
+static uint128 hash_options(const uint128& source, const obj::init& init)
+{
+	struct key
+	{
+		uint128 source;
+		bool flip_handedness;
+		bool counter_clockwide_faces;
+		bool calc_normals_on_error;
+		bool calc_texcoords_on_error;
+	};
+
+	key k;
+	memset(&k, 0, sizeof(k));
+	k.source = source;
+	k.flip_handedness = init.flip_handedness;
+	k.counter_clockwide_faces = init.counter_clockwide_faces;
+	k.calc_normals_on_error = init.calc_normals_on_error;
+	k.calc_texcoords_on_error = init.calc_texcoords_on_error;
+	return murmur3(&k, sizeof(k));
+}
+
+uint128 calc_source_hash(const void* obj_string, size_t obj_size, const obj::init& init)
+{
+	return hash_options(murmur3(obj_string, obj_size), init);
+}
+
+// Identifies a file by where it is and what the filesystem says about it, so
+// an unchanged file can be matched without reading it.
+static uint128 calc_stamp_hash(const path& obj_path, unsigned long long size, time_t last_write, const obj::init& init)
+{
+	struct key
+	{
+		uint128 path;
+		unsigned long long size;
+		long long last_write;
+	};
+
+	key k;
+	memset(&k, 0, sizeof(k));
+	k.path = murmur3(obj_path.c_str(), strlen(obj_path.c_str()));
+	k.size = size;
+	k.last_write = (long long)last_write;
+	return hash_options(murmur3(&k, sizeof(k)), init);
+}
+
+// Writes to a name no other process or thread will use and then renames, so
+// a partially-written file is never mistaken for a finished one and 
+// concurrent writers of the same file don't interleave.
+static void save_atomically(const path& dst, const void* data, size_t size)
+{
+	static std::atomic<uint> s_counter;
+	sstring ext;
+	snprintf(ext, ".%u.%u.tmp", this_process::get_id(), s_counter++);
+
+	path partial(dst);
+	partial.replace_extension(ext);
+	filesystem::save(partial, data, size);
+	filesystem::rename(partial, dst, filesystem::copy_option::overwrite_if_exists);
+}
+
+model_cache::model_cache(const path& cache_dir, const model_compression& _compression)
+	: dir(cache_dir)
+	, compression(_compression)
+{
+	filesystem::create_directories(dir);
+}
+
+path model_cache::cache_path(const uint128& source_hash) const
+{
+	sstring name;
+	snprintf(name, "%016llx%016llx.omdl", source_hash.hi, source_hash.lo);
+	return dir / path(name.c_str());
+}
+
+path model_cache::stamp_path(const uint128& stamp_hash) const
+{
+	sstring name;
+	snprintf(name, "%016llx%016llx.ostamp", stamp_hash.hi, stamp_hash.lo);
+	return dir / path(name.c_str());
+}
+
+// Returns the source hash recorded for a stamp or 0 if there isn't one
+static uint128 load_stamp(const path& stamp_path)
+{
+	if (filesystem::exists(stamp_path))
+	{
+		try
+		{
+			scoped_allocation stamp = filesystem::load(stamp_path);
+			if (stamp.size() == sizeof(uint128))
+				return *(const uint128*)(const void*)stamp;
+		}
+		catch (std::exception&) {}
+	}
+	return uint128(0, 0);
+}
+
+// Maps a valid cache file and returns its model or null if there isn't one
+static std::shared_ptr<model> load_cached(const path& cached_path, const uint128& source_hash)
+{
+	if (!filesystem::exists(cached_path))
+		return nullptr;
+
+	const unsigned long long size = filesystem::file_size(cached_path);
+	void* mapped = filesystem::map(cached_path, filesystem::map_option::binary_copy_on_write, 0, size);
+	finally unmap_on_error([&] { if (mapped) filesystem::unmap(mapped); });
+
+	scoped_allocation decompressed;
+	model* m = nullptr;
+	try { m = model::load(mapped, size_t(size), source_hash, &decompressed); }
+	catch (std::exception& e)
+	{
+		oTRACEA("model_cache: rebuilding %s: %s", cached_path.c_str(), e.what());
+		return nullptr;
+	}
+
+	if (decompressed)
+	{
+		// the file isn't needed once decompressed
+		deallocate_fn dealloc = decompressed.get_deallocate();
+		void* p = decompressed.release();
+		return std::shared_ptr<model>(m, [=](model*) { dealloc(p); });
+	}
+
+	void* placed = mapped;
+	mapped = nullptr;
+	return std::shared_ptr<model>(m, [=](model*) { filesystem::unmap(placed); });
+}
+
+std::shared_ptr<model> model_cache::load_obj(const path& obj_path, const obj::init& init, bool* out_from_cache) const
+{
+	const unsigned long long size = filesystem::file_size(obj_path);
+	const path stamped = stamp_path(calc_stamp_hash(obj_path, size, filesystem::last_write_time(obj_path), init));
+
+	// an unchanged file is found without reading or hashing it
+	uint128 source_hash = load_stamp(stamped);
+	std::shared_ptr<model> m;
+	if (source_hash.hi || source_hash.lo)
+		m = load_cached(cache_path(source_hash), source_hash);
+
+	if (!m)
+	{
+		const char* text = (const char*)filesystem::map(obj_path, filesystem::map_option::binary_read, 0, size);
+		finally unmap_text([&] { filesystem::unmap((void*)text); });
+
+		source_hash = calc_source_hash(text, size_t(size), init);
+		const path cached_path = cache_path(source_hash);
+		m = load_cached(cached_path, source_hash);
+
+		// a touched file whose content didn't change still hits
+		if (!m)
+		{
+			std::shared_ptr<obj::mesh> obj = obj::mesh::make(init, obj_path, text, size_t(size));
+			std::shared_ptr<model> built = make_model(obj->get_info());
+			scoped_allocation file = built->save(source_hash, compression);
+			save_atomically(cached_path, file, file.size());
+			save_atomically(stamped, &source_hash, sizeof(source_hash));
+			if (out_from_cache)
+				*out_from_cache = false;
+			return built;
+		}
+
+		save_atomically(stamped, &source_hash, sizeof(source_hash));
+	}
+
+	if (out_from_cache)
+		*out_from_cache = true;
+	return m;
+}
+
+}}
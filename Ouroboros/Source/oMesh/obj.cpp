@@ -2,15 +2,18 @@
 #include <oMesh/obj.h>
 #include <oMesh/mesh.h>
 #include <oBase/algorithm.h>
-#include <oBase/finally.h>
 #include <oBase/assert.h>
 #include <oBase/macros.h>
 #include <oBase/timer.h>
-#include <oBase/unordered_map.h>
-#include <oString/atof.h>
+#include <oConcurrency/concurrency.h>
 #include <oString/fixed_string.h>
 #include <oString/string_fast_scan.h>
-#include <oMemory/std_linear_allocator.h>
+#include <oMemory/wang_hash.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <intrin.h>
+#include <emmintrin.h>
 
 oDEFINE_WHITESPACE_PARSING();
 
@@ -56,38 +59,266 @@ bool from_string(mesh::obj::texture_type::value* _pType, const char* _StrSource)
 	namespace mesh {
 		namespace obj {
 
-// To translate from several index streams - one per vertex element stream - to 
-// a single index buffer we'll need to replicate vertices by their unique 
-// combination of all vertex elements. This basically means an index is uniquely
-// identified by a hash of the streams it indexes. We'll build the hash as well
-// parse faces but then it all can be freed at once. To prevent a length series
-// of deallocs for indices - i.e. int values - use a linear allocator and then
-// free all entries once the map goes out of scope.
-typedef unsigned long long key_t;
-typedef uint val_t;
-typedef std::pair<const key_t, val_t> pair_type;
-typedef ouro::std_linear_allocator<pair_type> allocator_type;
-typedef unordered_map<key_t, val_t, std_noop_hash<key_t>, std::equal_to<key_t>, std::less<key_t>, allocator_type> index_map_t;
-
-static inline const char* parse_string(char* _StrDestination, size_t _SizeofStrDestination, const char* _S)
-{
-	move_next_word(&_S);
-	const char* start = _S;
-	move_to_line_end(&_S);
-	size_t len = std::distance(start, _S);
-	strncpy(_StrDestination, _SizeofStrDestination, start, len);
-	return _S;
+// Large files are split at line boundaries into chunks of about 
+// init::parse_chunk_size bytes and the chunks are parsed concurrently, each into 
+// its own streams. Anything that depends on text before the chunk - negative 
+// indices and the group faces belong to - is recorded relative to the chunk 
+// and resolved once every chunk's counts are known. Unique vertices are then
+// found by partitioning face vertices into hash buckets and sorting each bucket
+// so the result is the same as a serial first-come dedup regardless of how 
+// the text was split.
+
+static const uint kMaxNumVertsPerFace = 4;
+static const uint kNumDedupBuckets = 1024;
+
+// _____________________________________________________________________________
+// Scanning. All scanning is bounded by an end pointer rather than a nul so that
+// chunks and memory-mapped files can be parsed in place.
+
+static inline uint first_set_bit(uint _Mask)
+{
+	unsigned long i;
+	_BitScanForward(&i, _Mask);
+	return i;
 }
 
-template<size_t size> static inline const char* parse_string(fixed_string<char, size>& _StrDestination, const char* r) { return parse_string(_StrDestination, _StrDestination.capacity(), r); }
+static inline bool is_digit(char c) { return uchar(c - '0') < 10; }
 
-static const uint kMaxNumVertsPerFace = 4;
+static inline void skip_line_whitespace(const char** _ppString, const char* _End)
+{
+	const char* s = *_ppString;
+	while (s < _End && is_line_whitespace((uchar)*s))
+		s++;
+	*_ppString = s;
+}
+
+static inline void skip_to_whitespace(const char** _ppString, const char* _End)
+{
+	const char* s = *_ppString;
+	while (s < _End && !is_whitespace((uchar)*s))
+		s++;
+	*_ppString = s;
+}
+
+// returns a pointer to the first '\n' or '\r' at or after s, or end
+static inline const char* find_newline(const char* s, const char* _End)
+{
+	const __m128i LF = _mm_set1_epi8('\n');
+	const __m128i CR = _mm_set1_epi8('\r');
+	while (_End - s >= 16)
+	{
+		const __m128i c = _mm_loadu_si128((const __m128i*)s);
+		const uint mask = (uint)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, LF), _mm_cmpeq_epi8(c, CR)));
+		if (mask)
+			return s + first_set_bit(mask);
+		s += 16;
+	}
+
+	while (s < _End && *s != '\n' && *s != '\r')
+		s++;
+	return s;
+}
+
+static inline const char* next_line(const char* s, const char* _End)
+{
+	s = find_newline(s, _End);
+	while (s < _End && (*s == '\n' || *s == '\r'))
+		s++;
+	return s;
+}
+
+// returns the length of the run of decimal digits at s
+static inline uint count_digits(const char* s, const char* _End)
+{
+	uint n = 0;
+	while (_End - s >= 16)
+	{
+		// bias so '0'-'9' are the 10 smallest signed values, then one compare
+		const __m128i c = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)s), _mm_set1_epi8('0' - 128));
+		const uint digits = (uint)_mm_movemask_epi8(_mm_cmplt_epi8(c, _mm_set1_epi8(-128 + 10)));
+		if (digits != 0xffff)
+			return n + first_set_bit(~digits);
+		n += 16;
+		s += 16;
+	}
+
+	while (s < _End && is_digit(*s))
+	{
+		n++;
+		s++;
+	}
+	return n;
+}
+
+// Converts 1-8 digits in one 64-bit register: digits are shifted up so the 
+// unused low bytes act as leading zeros, then pairs, quads and octets are 
+// combined with one multiply each.
+static inline uint parse_8_digits(const char* s, uint n, const char* _End)
+{
+	ullong v = 0;
+	memcpy(&v, s, (_End - s) >= 8 ? 8 : n);
+	v <<= 8 * (8 - n);
+	v &= 0x0f0f0f0f0f0f0f0full;
+	v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffull;
+	v = (v * 100 + (v >> 16)) & 0x0000ffff0000ffffull;
+	v = (v * 10000 + (v >> 32)) & 0x00000000ffffffffull;
+	return uint(v);
+}
+
+static const ullong kPow10Int[20] = { 1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull };
+static const float kPow10f[11] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+static const double kPow10[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+// exact for up to 19 digits
+static inline ullong parse_digits(const char* s, uint n, const char* _End)
+{
+	ullong v = 0;
+	for (; n > 8; n -= 8, s += 8)
+		v = v * 100000000ull + parse_8_digits(s, 8, _End);
+	return n ? v * kPow10Int[n] + parse_8_digits(s, n, _End) : v;
+}
+
+// Parses [+-]digits[.digits][(e|E)[+-]digits] after any line whitespace. When 
+// the digits are at most 2^24 and the net power of ten is within +/-10 both are
+// exact floats, so the one float multiply or divide is correctly rounded. Up to
+// 15 digits with a power within +/-22 are done the same way in double and then
+// narrowed, and anything longer goes through strtod; both of those round twice
+// so they can be an ulp off when the value is next to a float rounding 
+// boundary. On failure the pointer is not moved.
+static bool scan_float(const char** _ppString, const char* _End, float* _pValue)
+{
+	const char* s = *_ppString;
+	skip_line_whitespace(&s, _End);
+	const char* number = s;
+	bool negative = false;
+	if (s < _End && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+
+	const char* int_digits = s;
+	uint nInt = count_digits(s, _End);
+	s += nInt;
+
+	const char* frac_digits = s;
+	uint nFrac = 0;
+	if (s < _End && *s == '.')
+	{
+		frac_digits = ++s;
+		nFrac = count_digits(s, _End);
+		s += nFrac;
+	}
+
+	if (!nInt && !nFrac)
+		return false;
+
+	int exponent = 0;
+	if (s < _End && (*s == 'e' || *s == 'E'))
+	{
+		const char* e = s + 1;
+		bool negative_exponent = false;
+		if (e < _End && (*e == '-' || *e == '+'))
+			negative_exponent = *e++ == '-';
+		const uint nExp = count_digits(e, _End);
+		if (nExp)
+		{
+			exponent = nExp > 4 ? 9999 : int(parse_digits(e, nExp, _End));
+			if (negative_exponent)
+				exponent = -exponent;
+			s = e + nExp;
+		}
+	}
+
+	while (nInt && *int_digits == '0')
+	{
+		int_digits++;
+		nInt--;
+	}
+
+	const int e10 = exponent - int(nFrac);
+	if ((nInt + nFrac) > 15 || e10 < -22 || e10 > 22)
+	{
+		char buf[64];
+		const size_t len = __min(size_t(s - number), sizeof(buf) - 1);
+		memcpy(buf, number, len);
+		buf[len] = '\0';
+		char* end = nullptr;
+		const double d = strtod(buf, &end);
+		if (end == buf)
+			return false;
+		*_pValue = float(d);
+		*_ppString = number + (end - buf);
+		return true;
+	}
+
+	ullong mantissa = parse_digits(int_digits, nInt, _End);
+	if (nFrac)
+		mantissa = mantissa * kPow10Int[nFrac] + parse_digits(frac_digits, nFrac, _End);
+
+	float f;
+	if (mantissa <= (1ull << 24) && e10 >= -10 && e10 <= 10)
+	{
+		f = float(mantissa);
+		if (e10 < 0)
+			f /= kPow10f[-e10];
+		else if (e10 > 0)
+			f *= kPow10f[e10];
+	}
+
+	else
+	{
+		double d = double(mantissa);
+		if (e10 < 0)
+			d /= kPow10[-e10];
+		else if (e10 > 0)
+			d *= kPow10[e10];
+		f = float(d);
+	}
+
+	*_pValue = negative ? -f : f;
+	*_ppString = s;
+	return true;
+}
+
+static bool scan_int(const char** _ppString, const char* _End, int* _pValue)
+{
+	const char* s = *_ppString;
+	bool negative = false;
+	if (s < _End && (*s == '-' || *s == '+'))
+		negative = *s++ == '-';
+
+	const uint n = count_digits(s, _End);
+	if (!n || n > 10)
+		return false;
+
+	// 10 digits can exceed an int
+	const llong v = llong(parse_digits(s, n, _End));
+	if (v > (negative ? 2147483648ll : 2147483647ll))
+		return false;
+
+	*_pValue = int(negative ? -v : v);
+	*_ppString = s + n;
+	return true;
+}
+
+// copies the rest of the line after the keyword at s
+static const char* scan_string(char* _StrDestination, size_t _SizeofStrDestination, const char* s, const char* _End)
+{
+	skip_to_whitespace(&s, _End);
+	skip_line_whitespace(&s, _End);
+	const char* start = s;
+	s = find_newline(s, _End);
+	strncpy(_StrDestination, _SizeofStrDestination, start, __min(size_t(s - start), _SizeofStrDestination - 1));
+	return s;
+}
+
+// _____________________________________________________________________________
+// Parsing
 
 struct face
 {
 	face() 
 		: num_indices(0)
 		, group_range_index(0)
+		, relative(0)
 	{
 		for (auto& i : index)
 			i.fill(invalid);
@@ -105,325 +336,607 @@ struct face
 	std::array<std::array<uint, semantic_count>, kMaxNumVertsPerFace> index;
 	uint num_indices; // 3 for tris, 4 for quads
 	uint group_range_index; // groups and ranges are indexed with the same value
+
+	// While parsing, negative (relative) indices are stored relative to the start
+	// of the chunk with bit (vertex * semantic_count + semantic) set here, and 
+	// group_range_index is the number of group lines before the face in the 
+	// chunk. Both are resolved when chunks are merged.
+	ushort relative;
 };
 
-struct vertex_data
+// A 'g', 'usemtl' or 'mtllib' line, replayed in file order after parsing
+struct group_event
 {
-	void reserve(uint _NewVertexCount, uint _NewFaceCount)
-	{
-		positions.reserve(_NewVertexCount);
-		normals.reserve(_NewVertexCount);
-		texcoords.reserve(_NewVertexCount);
-		faces.reserve(_NewFaceCount);
-		groups.reserve(20);
-	}
+	uint face; // number of faces in the chunk before the line
+	char type; // 'g', 'u' or 'm'
+	path_string name;
+};
 
-	aaboxf bound;
+struct chunk
+{
+	chunk()
+		: begin(nullptr)
+		, end(nullptr)
+		, num_group_lines(0)
+		, num_corners(0)
+		, num_indices(0)
+		, num_degenerate_normals(0)
+		, num_degenerate_texcoords(0)
+		, first_position(0)
+		, first_normal(0)
+		, first_texcoord(0)
+		, first_corner(0)
+		, first_index(0)
+		, first_vertex(0)
+		, group_lines_before(0)
+	{}
+
+	const char* begin;
+	const char* end;
 
+	aaboxf bound;
 	std::vector<float3> positions;
 	std::vector<float3> normals;
 	std::vector<float3> texcoords;
-	
-	// these are assigned after negative indices have been handled, but are 
-	// otherwise directly-from-file values.
 	std::vector<face> faces;
-
-	std::vector<group> groups;
-	std::vector<range> ranges;
-
-	path_string mtl_path;
+	std::vector<group_event> events;
+	uint num_group_lines;
+	uint num_corners; // face vertices
+	uint num_indices; // after triangulation
+	uint num_degenerate_normals;
+	uint num_degenerate_texcoords;
+
+	// where this chunk's data begins in the merged streams
+	uint first_position;
+	uint first_normal;
+	uint first_texcoord;
+	uint first_corner;
+	uint first_index;
+	uint first_vertex;
+	uint group_lines_before;
 };
 
 // Given a string that starts with the letter 'v', parse as a line of vector
 // values and push_back into the appropriate vector.
-static const char* parse_vline(const char* _V
-	, bool _FlipHandedness
-	, std::vector<float3>& _Positions
-	, std::vector<float3>& _Normals
-	, std::vector<float3>& _Texcoords
-	, float3& _Min
-	, float3& _Max)
+static const char* parse_vline(const char* _V, const char* _End, bool _FlipHandedness, chunk* _pChunk)
 {
-	float3 temp;
+	float3 temp(0.0f, 0.0f, 0.0f);
 
 	_V++;
+	if (_V >= _End)
+		return _V;
+
 	switch (*_V)
 	{
 		case ' ':
-			atof(&_V, &temp.x);
-			atof(&_V, &temp.y);
-			atof(&_V, &temp.z); if (_FlipHandedness) temp.z = -temp.z;
-			_Positions.push_back(temp);
-			_Min = min(_Min, temp);
-			_Max = max(_Max, temp);
+		case '\t':
+			scan_float(&_V, _End, &temp.x);
+			scan_float(&_V, _End, &temp.y);
+			scan_float(&_V, _End, &temp.z); if (_FlipHandedness) temp.z = -temp.z;
+			_pChunk->positions.push_back(temp);
+			_pChunk->bound.Min = min(_pChunk->bound.Min, temp);
+			_pChunk->bound.Max = max(_pChunk->bound.Max, temp);
 			break;
 		case 't':
-			move_to_whitespace(&_V);
-			atof(&_V, &temp.x);
-			atof(&_V, &temp.y);
-			if (!atof(&_V, &temp.z)) temp.z = 0.0f;
+			_V++;
+			scan_float(&_V, _End, &temp.x);
+			scan_float(&_V, _End, &temp.y);
+			if (!scan_float(&_V, _End, &temp.z)) temp.z = 0.0f;
 			if (_FlipHandedness) temp.y = 1.0f - temp.y;
-			_Texcoords.push_back(temp);
+			_pChunk->texcoords.push_back(temp);
 			break;
 		case 'n':
-			move_to_whitespace(&_V);
-			atof(&_V, &temp.x);
-			atof(&_V, &temp.y);
-			atof(&_V, &temp.z); if (_FlipHandedness) temp.z = -temp.z;
-			_Normals.push_back(temp);
+			_V++;
+			scan_float(&_V, _End, &temp.x);
+			scan_float(&_V, _End, &temp.y);
+			scan_float(&_V, _End, &temp.z); if (_FlipHandedness) temp.z = -temp.z;
+			_pChunk->normals.push_back(temp);
+			break;
+		default:
 			break;
-		default: oASSUME(0);
 	}
 
 	return _V;
 }
 
-// Fills the specified face with data from a line in an OBJ starting with the 
-// 'f' (face) character. This returns a pointer into the string _F that is 
-// either the end of the string, or the end of the line.
-static const char* parse_fline(const char* _F
-	, uint _NumPositions
-	, uint _NumNormals
-	, uint _NumTexcoords
-	, uint _NumGroups
-	, std::vector<face>& _Faces)
-{
-	move_to_whitespace(&_F);
-	move_past_line_whitespace(&_F);
+// Fills a face with data from a line in an OBJ starting with the 'f' (face) 
+// character. This returns a pointer into the string _F that is either the end 
+// of the chunk or the end of the line.
+static const char* parse_fline(const char* _F, const char* _End, chunk* _pChunk)
+{
+	const uint NumElements[face::semantic_count] = { as_uint(_pChunk->positions.size()), as_uint(_pChunk->texcoords.size()), as_uint(_pChunk->normals.size()) };
+
+	skip_to_whitespace(&_F, _End);
+	skip_line_whitespace(&_F, _End);
 	face f;
-	f.num_indices = 0;
-	f.group_range_index = _NumGroups;
-	while (f.num_indices < 4 && *_F != '\0' && !is_newline(*_F))
+	f.group_range_index = _pChunk->num_group_lines;
+	while (f.num_indices < kMaxNumVertsPerFace && _F < _End && !is_newline((uchar)*_F))
 	{
-		bool foundSlash = false;
 		int semantic = face::position;
-		do
+		for (;;)
 		{
-			// parsing faces is relative to vertex parsing up to this point,
-			// so figure out where the data's at.
-			uint ZeroBasedIndexFromFile = 0;
-
-			// Negative indices implies the max indexable vertex OBJ will be INT_MAX, 
-			// not UINT_MAX.
-			if (*_F == '-')
+			int IndexFromFile = 0;
+			if (scan_int(&_F, _End, &IndexFromFile))
 			{
-				int NegativeIndex = atoi(_F);
-				uint NumElements = 0;
-				switch (semantic)
+				// Negative indices are relative to elements parsed so far, which 
+				// includes previous chunks, so store relative to the chunk for now.
+				if (IndexFromFile < 0)
 				{
-					case face::position: NumElements = _NumPositions; break;
-					case face::normal: NumElements = _NumNormals; break;
-					case face::texcoord: NumElements = _NumTexcoords; break;
-					default: oASSUME(0);
+					f.index[f.num_indices][semantic] = NumElements[semantic] + IndexFromFile;
+					f.relative |= 1 << (f.num_indices * face::semantic_count + semantic);
 				}
-				ZeroBasedIndexFromFile = NumElements + NegativeIndex;
+				else
+					f.index[f.num_indices][semantic] = IndexFromFile - 1;
 			}
-			else
-				ZeroBasedIndexFromFile = atoi(_F) - 1;
 
-			f.index[f.num_indices][semantic] = ZeroBasedIndexFromFile;
-
-			if (semantic == (face::semantic_count-1))
+			if (semantic == (face::semantic_count-1) || _F >= _End || *_F != '/')
 				break;
 
-			while (isdigit(*_F) || *_F == '-')
-				_F++;
-
 			// support case where the texcoord channel is empty
-			
-			if (*_F == '/')
+			while (_F < _End && *_F == '/' && semantic < (face::semantic_count-1))
 			{
-				do
-				{
-					_F++;
-					semantic++;
-					foundSlash = true;
-				} while(*_F == '/');
+				_F++;
+				semantic++;
 			}
+		}
 
-			else
-				break;
-
-			move_past_line_whitespace(&_F);
-
-		} while(foundSlash);
-
-		move_next_word(&_F);
+		skip_to_whitespace(&_F, _End);
+		skip_line_whitespace(&_F, _End);
 		f.num_indices++;
 	}
 
-	_Faces.push_back(f);
+	if (f.num_indices >= 3)
+	{
+		_pChunk->num_corners += f.num_indices;
+		_pChunk->num_indices += f.num_indices == 4 ? 6 : 3;
+		_pChunk->faces.push_back(f);
+	}
 
 	return _F;
 }
 
-// Scans an OBJ string and appends vertex element data
-static void parse_elements(const char* _OBJString, bool _FlipHandedness, vertex_data* _pElements)
+// Scans a chunk of an OBJ string and appends vertex element data to it
+static void parse_chunk(chunk* _pChunk, bool _FlipHandedness)
 {
-	uint NumGroups = 0;
-	group group;
-
-	const char* line = _OBJString;
-	while (*line)
+	const char* line = _pChunk->begin;
+	const char* end = _pChunk->end;
+	while (line < end)
 	{
-		move_past_line_whitespace(&line);
+		skip_line_whitespace(&line, end);
+		if (line >= end)
+			break;
+
 		switch (*line)
 		{
 			case 'v':
-				line = parse_vline(line, _FlipHandedness, _pElements->positions, _pElements->normals, _pElements->texcoords, _pElements->bound.Min, _pElements->bound.Max);
+				line = parse_vline(line, end, _FlipHandedness, _pChunk);
 				break;
 			case 'f':
-				line = parse_fline(line
-					, as_uint(_pElements->positions.size())
-					, as_uint(_pElements->normals.size())
-					, as_uint(_pElements->texcoords.size())
-					, as_uint(_pElements->groups.size())
-					, _pElements->faces);
+				line = parse_fline(line, end, _pChunk);
 				break;
 			case 'g':
-				// close out previous group
-				if (NumGroups)
-					_pElements->groups.push_back(group); 
-				NumGroups++;
-				parse_string(group.group_name, line);
-				break;
 			case 'u':
-				parse_string(group.material_name, line);
-				break;
 			case 'm':
-				parse_string(_pElements->mtl_path, line);
+			{
+				group_event e;
+				e.face = as_uint(_pChunk->faces.size());
+				e.type = *line;
+				const size_t capacity = e.type == 'm' ? e.name.capacity() : mstring().capacity(); // group and material names are mstrings
+				line = scan_string(e.name, capacity, line, end);
+				_pChunk->events.push_back(e);
+				if (e.type == 'g')
+					_pChunk->num_group_lines++;
 				break;
+			}
 			default:
 				break;
 		}
-		move_to_line_end(&line);
-		move_past_newline(&line);
+		line = next_line(line, end);
+	}
+}
+
+// Splits text at line boundaries into chunks of about _ChunkSize bytes
+static std::vector<chunk> split_chunks(const char* _OBJString, size_t _OBJSize, size_t _ChunkSize)
+{
+	const char* end = _OBJString + _OBJSize;
+	std::vector<chunk> chunks;
+	chunks.reserve(_OBJSize / _ChunkSize + 1);
+	for (const char* c = _OBJString; c < end;)
+	{
+		const char* e = size_t(end - c) > _ChunkSize ? next_line(c + _ChunkSize, end) : end;
+		chunks.resize(chunks.size() + 1);
+		chunks.back().begin = c;
+		chunks.back().end = e;
+		c = e;
+	}
+	return chunks;
+}
+
+// _____________________________________________________________________________
+// Merging
+
+struct vertex_data
+{
+	void reserve(uint _NewVertexCount)
+	{
+		positions.reserve(_NewVertexCount);
+		normals.reserve(_NewVertexCount);
+		texcoords.reserve(_NewVertexCount);
+		groups.reserve(20);
+	}
+
+	aaboxf bound;
+
+	std::vector<float3> positions;
+	std::vector<float3> normals;
+	std::vector<float3> texcoords;
+
+	std::vector<group> groups;
+	std::vector<range> ranges;
+
+	path_string mtl_path;
+};
+
+// Computes where each chunk's data lands in the merged streams, replays group/
+// material lines in file order and gathers the off-disk vertex elements.
+static void merge_chunks(std::vector<chunk>& _Chunks, vertex_data* _pOffDisk)
+{
+	uint NumPositions = 0, NumNormals = 0, NumTexcoords = 0, NumCorners = 0, NumIndices = 0, NumGroupLines = 0;
+	uint NumGroups = 0;
+	group group;
+
+	for (chunk& c : _Chunks)
+	{
+		c.first_position = NumPositions; NumPositions += as_uint(c.positions.size());
+		c.first_normal = NumNormals; NumNormals += as_uint(c.normals.size());
+		c.first_texcoord = NumTexcoords; NumTexcoords += as_uint(c.texcoords.size());
+		c.first_corner = NumCorners; NumCorners += c.num_corners;
+		c.first_index = NumIndices; NumIndices += c.num_indices;
+		c.group_lines_before = NumGroupLines; NumGroupLines += c.num_group_lines;
+
+		_pOffDisk->bound.Min = min(_pOffDisk->bound.Min, c.bound.Min);
+		_pOffDisk->bound.Max = max(_pOffDisk->bound.Max, c.bound.Max);
+
+		for (const group_event& e : c.events)
+		{
+			switch (e.type)
+			{
+				case 'g':
+					// close out previous group
+					if (NumGroups)
+						_pOffDisk->groups.push_back(group);
+					NumGroups++;
+					group.group_name = e.name;
+					break;
+				case 'u':
+					group.material_name = e.name;
+					break;
+				case 'm':
+					_pOffDisk->mtl_path = e.name;
+					break;
+				default:
+					break;
+			}
+		}
 	}
 
 	// close out a remaining group one last time
 	// NOTE: start prim / num prims are handled later after vertices have been reduced
 	if (NumGroups)
-		_pElements->groups.push_back(group);
+		_pOffDisk->groups.push_back(group);
 
 	else
 	{
 		group.group_name = "Default Group";
-		_pElements->groups.push_back(group);
+		_pOffDisk->groups.push_back(group);
 	}
+
+	_pOffDisk->positions.resize(NumPositions);
+	_pOffDisk->normals.resize(NumNormals);
+	_pOffDisk->texcoords.resize(NumTexcoords);
+
+	parallel_for(0, _Chunks.size(), [&](size_t index)
+	{
+		chunk& c = _Chunks[index];
+		std::copy(c.positions.begin(), c.positions.end(), _pOffDisk->positions.begin() + c.first_position);
+		std::copy(c.normals.begin(), c.normals.end(), _pOffDisk->normals.begin() + c.first_normal);
+		std::copy(c.texcoords.begin(), c.texcoords.end(), _pOffDisk->texcoords.begin() + c.first_texcoord);
+		std::vector<float3>().swap(c.positions);
+		std::vector<float3>().swap(c.normals);
+		std::vector<float3>().swap(c.texcoords);
+
+		const uint First[face::semantic_count] = { c.first_position, c.first_texcoord, c.first_normal };
+		for (face& f : c.faces)
+		{
+			for (uint v = 0; v < f.num_indices; v++)
+				for (uint s = 0; s < face::semantic_count; s++)
+					if (f.relative & (1 << (v * face::semantic_count + s)))
+						f.index[v][s] += First[s];
+			f.relative = 0;
+
+			// faces before the first group line belong to the first group
+			const uint GroupLines = c.group_lines_before + f.group_range_index;
+			f.group_range_index = GroupLines ? GroupLines - 1 : 0;
+		}
+	});
+}
+
+// _____________________________________________________________________________
+// Reduction to a single index buffer
+
+// the combination of element indices that becomes one unique vertex
+struct corner_key
+{
+	uint position;
+	uint texcoord;
+	uint normal;
+
+	bool operator==(const corner_key& that) const { return position == that.position && texcoord == that.texcoord && normal == that.normal; }
+	bool operator<(const corner_key& that) const
+	{
+		if (position != that.position) return position < that.position;
+		if (texcoord != that.texcoord) return texcoord < that.texcoord;
+		return normal < that.normal;
+	}
+};
+
+static inline uint dedup_bucket(const corner_key& k)
+{
+	const ullong x = ullong(k.position) ^ (ullong(k.texcoord) << 21) ^ (ullong(k.normal) << 42);
+	return uint(wang_hash(x)) & (kNumDedupBuckets - 1);
 }
 
-// Using config data and an index hash, reduce all duplicate/face data into 
-// unique indexed data. This must be called after ALL SourceElements have been
-// populated.
+// Using config data, reduce all duplicate/face data into unique indexed data. 
+// Vertices are numbered in order of first use just as a serial walk of the 
+// faces would number them. This must be called after merge_chunks().
 static void reduce_elements(const init& _Init
-	, index_map_t* _pIndexMap
+	, std::vector<chunk>& _Chunks
 	, const vertex_data& _SourceElements
 	, std::vector<uint>* _pIndices
 	, vertex_data* _pSinglyIndexedElements
-	, std::vector<uint>* _pDegenerateNormals
-	, std::vector<uint>* _pDegenerateTexcoords)
+	, uint* _pNumDegenerateNormals
+	, uint* _pNumDegenerateTexcoords)
 {
-	_pSinglyIndexedElements->ranges.resize(_SourceElements.groups.size());
+	const uint NumCorners = _Chunks.empty() ? 0 : _Chunks.back().first_corner + _Chunks.back().num_corners;
+	const uint NumIndices = _Chunks.empty() ? 0 : _Chunks.back().first_index + _Chunks.back().num_indices;
+	const size_t NumChunks = _Chunks.size();
 
-	uint resolvedIndices[4];
+	_pSinglyIndexedElements->ranges.resize(_SourceElements.groups.size());
 	_pSinglyIndexedElements->bound = _SourceElements.bound;
 	_pSinglyIndexedElements->groups = _SourceElements.groups;
 	_pSinglyIndexedElements->mtl_path = _SourceElements.mtl_path;
-	uint LastRangeIndex = invalid;
 
-	for (const face& f : _SourceElements.faces)
+	if (!NumCorners)
+		return;
+
+	std::vector<corner_key> keys(NumCorners);
+	std::vector<ushort> buckets(NumCorners);
+	std::vector<uint> bucket_counts(NumChunks * kNumDedupBuckets, 0);
+
+	// gather keys and count how many of each chunk's corners fall in each bucket
+	parallel_for(0, NumChunks, [&](size_t index)
 	{
-		range& Range = _pSinglyIndexedElements->ranges[f.group_range_index];
+		const chunk& c = _Chunks[index];
+		uint* counts = &bucket_counts[index * kNumDedupBuckets];
+		uint corner = c.first_corner;
+		for (const face& f : c.faces)
+		{
+			for (uint p = 0; p < f.num_indices; p++, corner++)
+			{
+				corner_key& k = keys[corner];
+				k.position = f.index[p][face::position];
+				k.texcoord = f.index[p][face::texcoord];
+				k.normal = f.index[p][face::normal];
+				const uint b = dedup_bucket(k);
+				buckets[corner] = ushort(b);
+				counts[b]++;
+			}
+		}
+	});
 
-		if (LastRangeIndex != f.group_range_index)
+	// bucket-major offsets so each bucket lists its corners in file order
+	std::vector<uint> bucket_starts(kNumDedupBuckets + 1);
+	{
+		uint offset = 0;
+		for (uint b = 0; b < kNumDedupBuckets; b++)
 		{
-			if (LastRangeIndex != invalid)
+			bucket_starts[b] = offset;
+			for (size_t c = 0; c < NumChunks; c++)
 			{
-				range& LastRange = _pSinglyIndexedElements->ranges[LastRangeIndex];
-				LastRange.num_primitives = as_uint(_pIndices->size() / 3) - LastRange.start_primitive;
-				Range.start_primitive = as_uint(_pIndices->size() / 3);
+				uint& count = bucket_counts[c * kNumDedupBuckets + b];
+				const uint n = count;
+				count = offset;
+				offset += n;
 			}
-			LastRangeIndex = f.group_range_index;
 		}
+		bucket_starts[kNumDedupBuckets] = offset;
+	}
 
-		for (uint p = 0; p < f.num_indices; p++)
+	std::vector<uint> bucketed(NumCorners);
+	parallel_for(0, NumChunks, [&](size_t index)
+	{
+		const chunk& c = _Chunks[index];
+		uint* offsets = &bucket_counts[index * kNumDedupBuckets];
+		for (uint corner = c.first_corner; corner < c.first_corner + c.num_corners; corner++)
+			bucketed[offsets[buckets[corner]]++] = corner;
+	});
+	std::vector<ushort>().swap(buckets);
+
+	// Within each bucket sort by key, then corner so the first corner of each run 
+	// is the first use of the vertex. rep maps each corner to that first corner.
+	std::vector<uint> rep(NumCorners);
+	parallel_for(0, kNumDedupBuckets, [&](size_t b)
+	{
+		uint* first = bucketed.data() + bucket_starts[b];
+		uint* last = bucketed.data() + bucket_starts[b+1];
+		std::sort(first, last, [&](uint x, uint y) { return keys[x] == keys[y] ? x < y : keys[x] < keys[y]; });
+		for (uint* run = first; run < last;)
 		{
-			const key_t hash = f.index[p][face::position] + _SourceElements.positions.size() * f.index[p][face::texcoord] + _SourceElements.positions.size() * _SourceElements.texcoords.size() * f.index[p][face::normal];
-			index_map_t::iterator it = _pIndexMap->find(hash);
+			uint* next = run + 1;
+			while (next < last && keys[*next] == keys[*run])
+				next++;
+			for (uint* r = run; r < next; r++)
+				rep[*r] = *run;
+			run = next;
+		}
+	});
+	std::vector<uint>().swap(bucketed);
 
-			if (it == _pIndexMap->end())
+	// number first uses in corner order
+	parallel_for(0, NumChunks, [&](size_t index)
+	{
+		chunk& c = _Chunks[index];
+		uint n = 0;
+		for (uint corner = c.first_corner; corner < c.first_corner + c.num_corners; corner++)
+			if (rep[corner] == corner)
+				n++;
+		c.first_vertex = n;
+	});
+
+	uint NumVertices = 0;
+	for (chunk& c : _Chunks)
+	{
+		const uint n = c.first_vertex;
+		c.first_vertex = NumVertices;
+		NumVertices += n;
+	}
+
+	const bool HasNormals = !_SourceElements.normals.empty();
+	const bool HasTexcoords = !_SourceElements.texcoords.empty();
+	_pSinglyIndexedElements->positions.resize(NumVertices);
+	if (HasNormals)
+		_pSinglyIndexedElements->normals.resize(NumVertices);
+	if (HasTexcoords)
+		_pSinglyIndexedElements->texcoords.resize(NumVertices);
+	_pIndices->resize(NumIndices);
+
+	static const uint CCWindices[6] = { 0, 2, 1, 2, 0, 3, };
+	static const uint CWindices[6] = { 0, 1, 2, 2, 3, 0, };
+	
+	bool UseCCW = _Init.counter_clockwide_faces;
+	if (_Init.flip_handedness)
+		UseCCW = !UseCCW;
+	
+	const uint* pOrder = UseCCW ? CCWindices : CWindices;
+
+	// Emit vertices at their first use. Repeat uses refer to an earlier corner 
+	// that might be in another chunk, so the index buffer is resolved in a second
+	// pass once every first use has its vertex index.
+	std::vector<uint> vertex_index(NumCorners);
+	parallel_for(0, NumChunks, [&](size_t index)
+	{
+		chunk& c = _Chunks[index];
+		uint corner = c.first_corner;
+		uint NewIndex = c.first_vertex;
+		for (const face& f : c.faces)
+		{
+			for (uint p = 0; p < f.num_indices; p++, corner++)
 			{
-				uint NewIndex = as_uint(_pSinglyIndexedElements->positions.size());
-				_pSinglyIndexedElements->positions.push_back(_SourceElements.positions[f.index[p][face::position]]);
+				if (rep[corner] != corner)
+					continue;
+
+				vertex_index[corner] = NewIndex;
+				_pSinglyIndexedElements->positions[NewIndex] = _SourceElements.positions[f.index[p][face::position]];
 			
-				if (!_SourceElements.normals.empty())
+				if (HasNormals)
 				{
 					if (f.index[p][face::normal] != invalid)
-						_pSinglyIndexedElements->normals.push_back(_SourceElements.normals[f.index[p][face::normal]]);
+						_pSinglyIndexedElements->normals[NewIndex] = _SourceElements.normals[f.index[p][face::normal]];
 					else
 					{
-						_pDegenerateNormals->push_back(NewIndex);
-						_pSinglyIndexedElements->normals.push_back(ZERO3);
+						c.num_degenerate_normals++;
+						_pSinglyIndexedElements->normals[NewIndex] = ZERO3;
 					}
 				}
 
-				if (!_SourceElements.texcoords.empty())
+				if (HasTexcoords)
 				{
-					if(f.index[p][face::texcoord] != invalid)
-						_pSinglyIndexedElements->texcoords.push_back(_SourceElements.texcoords[f.index[p][face::texcoord]]);
+					if (f.index[p][face::texcoord] != invalid)
+						_pSinglyIndexedElements->texcoords[NewIndex] = _SourceElements.texcoords[f.index[p][face::texcoord]];
 					else
 					{
-						_pDegenerateTexcoords->push_back(NewIndex);
-						_pSinglyIndexedElements->texcoords.push_back(ZERO3);
+						c.num_degenerate_texcoords++;
+						_pSinglyIndexedElements->texcoords[NewIndex] = ZERO3;
 					}
 				}
-			
-				(*_pIndexMap)[hash] = resolvedIndices[p] = NewIndex;
+
+				NewIndex++;
 			}
-		
-			else
-				resolvedIndices[p] = (*it).second;
-		} // for each face element
+		}
+	});
+
+	parallel_for(0, NumChunks, [&](size_t index)
+	{
+		const chunk& c = _Chunks[index];
+		uint corner = c.first_corner;
+		uint* pIndices = _pIndices->data() + c.first_index;
+		for (const face& f : c.faces)
+		{
+			uint resolvedIndices[kMaxNumVertsPerFace];
+			for (uint p = 0; p < f.num_indices; p++, corner++)
+				resolvedIndices[p] = vertex_index[rep[corner]];
 
-		// Now that the index has either been added or reset to a pre-existing index, 
-		// add the face definition to the index list
+			*pIndices++ = resolvedIndices[pOrder[0]];
+			*pIndices++ = resolvedIndices[pOrder[1]];
+			*pIndices++ = resolvedIndices[pOrder[2]];
 
-		static const uint CCWindices[6] = { 0, 2, 1, 2, 0, 3, };
-		static const uint CWindices[6] = { 0, 1, 2, 2, 3, 0, };
-	
-		bool UseCCW = _Init.counter_clockwide_faces;
-		if (_Init.flip_handedness)
-			UseCCW = !UseCCW;
-	
-		const uint* pOrder = UseCCW ? CCWindices : CWindices;
+			// Add another triangle for the rest of the quad
+			if (f.num_indices == 4)
+			{
+				*pIndices++ = resolvedIndices[pOrder[3]];
+				*pIndices++ = resolvedIndices[pOrder[4]];
+				*pIndices++ = resolvedIndices[pOrder[5]];
+			}
+		}
+	});
 
-		_pIndices->push_back(resolvedIndices[pOrder[0]]);
-		_pIndices->push_back(resolvedIndices[pOrder[1]]);
-		_pIndices->push_back(resolvedIndices[pOrder[2]]);
+	*_pNumDegenerateNormals = 0;
+	*_pNumDegenerateTexcoords = 0;
+	for (const chunk& c : _Chunks)
+	{
+		*_pNumDegenerateNormals += c.num_degenerate_normals;
+		*_pNumDegenerateTexcoords += c.num_degenerate_texcoords;
+	}
 
-		// Add another triangle for the rest of the quad
-		if (f.num_indices == 4)
+	// Ranges start where the face's group changes. This is one compare per face
+	// so it's left serial.
+	std::vector<range>& ranges = _pSinglyIndexedElements->ranges;
+	uint LastRangeIndex = invalid;
+	for (const chunk& c : _Chunks)
+	{
+		uint Primitive = c.first_index / 3;
+		for (const face& f : c.faces)
 		{
-			_pIndices->push_back(resolvedIndices[pOrder[3]]);
-			_pIndices->push_back(resolvedIndices[pOrder[4]]);
-			_pIndices->push_back(resolvedIndices[pOrder[5]]);
+			if (LastRangeIndex != f.group_range_index)
+			{
+				if (LastRangeIndex != invalid)
+				{
+					range& LastRange = ranges[LastRangeIndex];
+					LastRange.num_primitives = Primitive - LastRange.start_primitive;
+					ranges[f.group_range_index].start_primitive = Primitive;
+				}
+				LastRangeIndex = f.group_range_index;
+			}
+			Primitive += f.num_indices == 4 ? 2 : 1;
 		}
-	} // for each face
+	}
 
 	// close out last group
-	LastRangeIndex = _SourceElements.faces.back().group_range_index;
-	range& r = _pSinglyIndexedElements->ranges[LastRangeIndex];
-	r.num_primitives = as_uint(_pIndices->size() / 3) - r.start_primitive;
+	range& LastRange = ranges[LastRangeIndex];
+	LastRange.num_primitives = NumIndices / 3 - LastRange.start_primitive;
 
 	// Go back through ranges and calc min/max verts
-	for (range& r : _pSinglyIndexedElements->ranges)
-		calc_min_max_indices(_pIndices->data(), r.start_primitive*3, r.num_primitives*3, as_uint(_pSinglyIndexedElements->positions.size()), &r.min_vertex, &r.max_vertex);
+	parallel_for(0, ranges.size(), [&](size_t index)
+	{
+		range& r = ranges[index];
+		calc_min_max_indices(_pIndices->data(), r.start_primitive*3, r.num_primitives*3, NumVertices, &r.min_vertex, &r.max_vertex);
+	});
 }
 
 class mesh_impl : public mesh
 {
 public:
-	mesh_impl(const init& _Init, const path& _OBJPath, const char* _OBJString);
+	mesh_impl(const init& _Init, const path& _OBJPath, const char* _OBJString, size_t _OBJSize);
 	info get_info() const override;
 
 private:
@@ -432,51 +945,46 @@ private:
 	path Path;
 };
 
-mesh_impl::mesh_impl(const init& _Init, const path& _OBJPath, const char* _OBJString)
+mesh_impl::mesh_impl(const init& _Init, const path& _OBJPath, const char* _OBJString, size_t _OBJSize)
 	: Path(_OBJPath)
 {
-	const size_t kInitialReserve = _Init.est_num_indices * sizeof(uint);
-	size_t IndexMapMallocBytes = 0;
-	
-	std::vector<uint> DegenerateNormals, DegenerateTexcoords;
-	DegenerateNormals.reserve(1000);
-	DegenerateTexcoords.reserve(1000);
+	uint NumDegenerateNormals = 0, NumDegenerateTexcoords = 0;
 
 	// Scope memory usage... more might be used below when calculating normals, 
 	// etc. so free this stuff up rather than leaving it all around.
 	
 	{
-		void* pArena = malloc(kInitialReserve);
-		finally FreeArena([&] { if (pArena) free(pArena); });
-		linear_allocator Allocator(pArena, kInitialReserve);
-		index_map_t IndexMap(0, index_map_t::hasher(), index_map_t::key_equal(), std::less<key_t>()
-			, allocator_type(&Allocator, &IndexMapMallocBytes));
-
 		// OBJ files don't contain a same-sized vertex streams for each elements, 
 		// and indexing occurs uniquely between vertex elements. Eventually we will 
 		// create same-sized vertex data - even by replication of data - so that a 
 		// single index buffer can be used. That's the this->VertexElements, but 
 		// first to get the raw vertex data off disk, use this.
+		std::vector<chunk> chunks = split_chunks(_OBJString, _OBJSize, __max(size_t(_Init.parse_chunk_size), size_t(1)));
+
+		parallel_for(0, chunks.size(), [&](size_t index)
+		{
+			chunk& c = chunks[index];
+
+			// spread the estimates over the chunks
+			const double Portion = double(c.end - c.begin) / double(_OBJSize);
+			const size_t EstVertices = size_t(_Init.est_num_vertices * Portion);
+			c.positions.reserve(EstVertices);
+			c.normals.reserve(EstVertices);
+			c.texcoords.reserve(EstVertices);
+			c.faces.reserve(size_t(_Init.est_num_indices / 3 * Portion));
+
+			parse_chunk(&c, _Init.flip_handedness);
+		});
+
 		vertex_data OffDiskElements;
-		OffDiskElements.reserve(_Init.est_num_vertices, _Init.est_num_indices / 3);
-		parse_elements(_OBJString, _Init.flip_handedness, &OffDiskElements);
+		merge_chunks(chunks, &OffDiskElements);
 
 		const uint kEstMaxVertexElements = as_uint(__max(__max(OffDiskElements.positions.size(), OffDiskElements.normals.size()), OffDiskElements.texcoords.size()));
-		Data.reserve(kEstMaxVertexElements, _Init.est_num_indices / 3);
-		Indices.reserve(_Init.est_num_indices);
-
-		reduce_elements(_Init, &IndexMap, OffDiskElements, &Indices, &Data, &DegenerateNormals, &DegenerateTexcoords);
+		Data.reserve(kEstMaxVertexElements);
 
-	} // End of life for from-disk vertex elements and index hash
+		reduce_elements(_Init, chunks, OffDiskElements, &Indices, &Data, &NumDegenerateNormals, &NumDegenerateTexcoords);
 
-	#ifdef _DEBUG
-		if (IndexMapMallocBytes)
-		{
-			mstring reserved, additional;
-			const char* n = oSAFESTRN(_OBJPath); // passing the macro directly causes win32 to throw an exception
-			oTRACE("obj: %s index map allocated %s additional indices beyond the initial est_num_vertices=%s", n, format_commas(additional, as_uint(IndexMapMallocBytes / sizeof(uint))), format_commas(reserved, _Init.est_num_vertices));
-		}
-	#endif
+	} // End of life for from-disk vertex elements and chunks
 
 	if (_Init.calc_normals_on_error)
 	{
@@ -487,10 +995,10 @@ mesh_impl::mesh_impl(const init& _Init, const path& _OBJPath, const char* _OBJSt
 			CalcNormals = true;
 		}
 
-		else if (!DegenerateNormals.empty())
+		else if (NumDegenerateNormals)
 		{
 			// @tony: Is there a way to calculate only the degenerates?
-			oTRACE("oOBJ: %u degenerate normals in %s...", DegenerateNormals.size(), _OBJPath);
+			oTRACE("oOBJ: %u degenerate normals in %s...", NumDegenerateNormals, _OBJPath);
 			CalcNormals = true;
 		}
 
@@ -515,9 +1023,9 @@ mesh_impl::mesh_impl(const init& _Init, const path& _OBJPath, const char* _OBJSt
 			CalcTexcoords = true;
 		}
 
-		else if (!DegenerateTexcoords.empty())
+		else if (NumDegenerateTexcoords)
 		{
-			oTRACE("oOBJ: %u degenerate texcoords in %s...", DegenerateTexcoords.size(), oSAFESTRN(_OBJPath));
+			oTRACE("oOBJ: %u degenerate texcoords in %s...", NumDegenerateTexcoords, oSAFESTRN(_OBJPath));
 			CalcTexcoords = true;
 		}
 
@@ -542,7 +1050,12 @@ mesh_impl::mesh_impl(const init& _Init, const path& _OBJPath, const char* _OBJSt
 
 std::shared_ptr<mesh> mesh::make(const init& _Init, const path& _OBJPath, const char* _OBJString)
 {
-	return std::make_shared<mesh_impl>(_Init, _OBJPath, _OBJString);
+	return make(_Init, _OBJPath, _OBJString, strlen(_OBJString));
+}
+
+std::shared_ptr<mesh> mesh::make(const init& _Init, const path& _OBJPath, const char* _OBJString, size_t _OBJSize)
+{
+	return std::make_shared<mesh_impl>(_Init, _OBJPath, _OBJString, _OBJSize);
 }
 
 info mesh_impl::get_info() const
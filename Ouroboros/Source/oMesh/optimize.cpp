@@ -0,0 +1,491 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/optimize.h>
+#include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+#include <algorithm>
+#include <vector>
+
+namespace ouro { namespace mesh {
+
+// Per-vertex scratch below covers a subset's vertex_range and is indexed by
+// v - base_vertex.
+
+// _____________________________________________________________________________
+// Cache simulation
+
+// A FIFO cache is simulated with insertion times: a vertex is in the cache if
+// it was inserted within the last cache_size insertions.
+class fifo_cache
+{
+public:
+	fifo_cache(uint num_vertices, uint cache_size)
+		: inserted(num_vertices, 0)
+		, time(cache_size + 1)
+		, size(cache_size)
+	{}
+
+	// returns true if v had to be transformed
+	bool fetch(uint v)
+	{
+		if ((time - inserted[v]) <= size)
+			return false;
+		inserted[v] = time++;
+		return true;
+	}
+
+	// empties the cache without touching every entry
+	void flush() { time += size; }
+
+private:
+	std::vector<uint> inserted;
+	uint time;
+	uint size;
+};
+
+template<typename IndexT>
+static vertex_cache_stats calc_vertex_cache_stats_t(const IndexT* indices, uint num_indices, uint base_vertex, uint num_vertices, uint cache_size)
+{
+	vertex_cache_stats s;
+	if (!num_indices)
+		return s;
+
+	fifo_cache cache(num_vertices, cache_size);
+	std::vector<bool> referenced(num_vertices, false);
+	uint nReferenced = 0;
+	for (uint i = 0; i < num_indices; i++)
+	{
+		const uint v = indices[i] - base_vertex;
+		if (cache.fetch(v))
+			s.num_transforms++;
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			nReferenced++;
+		}
+	}
+
+	s.acmr = s.num_transforms / float(num_indices / 3);
+	s.atvr = s.num_transforms / float(nReferenced);
+	return s;
+}
+
+// _____________________________________________________________________________
+// Forsyth's vertex cache optimization
+
+static const uint kForsythCacheSize = 32;
+static const uint kForsythMaxValence = 64;
+
+struct forsyth_scores
+{
+	forsyth_scores()
+	{
+		static const float kCacheDecayPower = 1.5f;
+		static const float kLastTriScore = 0.75f;
+		static const float kValenceBoostScale = 2.0f;
+		static const float kValenceBoostPower = 0.5f;
+
+		// the last triangle's vertices get a fixed score so that the triangle
+		// just drawn isn't favored over its neighbors
+		for (uint i = 0; i < kForsythCacheSize; i++)
+			cache[i] = i < 3 ? kLastTriScore : pow(1.0f - (i - 3) / float(kForsythCacheSize - 3), kCacheDecayPower);
+
+		// vertices with few remaining triangles are boosted to finish them off
+		valence[0] = 0.0f;
+		for (uint i = 1; i < kForsythMaxValence; i++)
+			valence[i] = kValenceBoostScale * pow(float(i), -kValenceBoostPower);
+	}
+
+	float operator()(int cache_position, uint remaining) const
+	{
+		if (!remaining)
+			return -1.0f;
+		return (cache_position < 0 ? 0.0f : cache[cache_position]) + valence[min(remaining, kForsythMaxValence - 1)];
+	}
+
+	float cache[kForsythCacheSize];
+	float valence[kForsythMaxValence];
+};
+
+template<typename IndexT>
+static void optimize_vertex_cache_t(IndexT* indices, uint num_indices, uint base_vertex, uint num_vertices)
+{
+	static const forsyth_scores score;
+
+	const uint nTriangles = num_indices / 3;
+	if (nTriangles < 2)
+		return;
+
+	auto vertex = [&](uint i) { return uint(indices[i]) - base_vertex; };
+
+	// vertex -> triangle adjacency. The first remaining[v] entries of each
+	// vertex's list are the triangles not yet emitted.
+	std::vector<uint> remaining(num_vertices, 0);
+	for (uint i = 0; i < nTriangles * 3; i++)
+		remaining[vertex(i)]++;
+
+	std::vector<uint> adjacency_offset(num_vertices + 1);
+	uint offset = 0;
+	for (uint v = 0; v < num_vertices; v++)
+	{
+		adjacency_offset[v] = offset;
+		offset += remaining[v];
+	}
+	adjacency_offset[num_vertices] = offset;
+
+	std::vector<uint> adjacency(offset);
+	{
+		std::vector<uint> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+		for (uint t = 0; t < nTriangles; t++)
+			for (uint k = 0; k < 3; k++)
+				adjacency[fill[vertex(t*3+k)]++] = t;
+	}
+
+	std::vector<int> cache_position(num_vertices, -1);
+	std::vector<float> vertex_score(num_vertices);
+	for (uint v = 0; v < num_vertices; v++)
+		vertex_score[v] = score(-1, remaining[v]);
+
+	std::vector<float> triangle_score(nTriangles);
+	std::vector<bool> emitted(nTriangles, false);
+	uint best = 0;
+	for (uint t = 0; t < nTriangles; t++)
+	{
+		triangle_score[t] = vertex_score[vertex(t*3)] + vertex_score[vertex(t*3+1)] + vertex_score[vertex(t*3+2)];
+		if (triangle_score[t] > triangle_score[best])
+			best = t;
+	}
+
+	// +3 so the vertices pushed out by a new triangle can be rescored
+	uint cache[kForsythCacheSize + 3];
+	uint cache_size = 0;
+
+	std::vector<IndexT> result(nTriangles * 3);
+	uint cursor = 0; // where to look for a triangle if the cache runs dry
+	for (uint out = 0; out < nTriangles; out++)
+	{
+		if (best == invalid)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		const IndexT* tri = indices + best * 3;
+		result[out*3+0] = tri[0];
+		result[out*3+1] = tri[1];
+		result[out*3+2] = tri[2];
+		emitted[best] = true;
+
+		const uint tri_v[3] = { vertex(best*3), vertex(best*3+1), vertex(best*3+2) };
+		for (uint k = 0; k < 3; k++)
+		{
+			const uint v = tri_v[k];
+			uint* adj = adjacency.data() + adjacency_offset[v];
+			uint* adj_end = adj + remaining[v];
+			uint* found = std::find(adj, adj_end, best);
+			std::swap(*found, *(adj_end - 1));
+			remaining[v]--;
+		}
+
+		// move the triangle's vertices to the front of the LRU cache
+		uint new_cache[kForsythCacheSize + 3];
+		uint new_size = 0;
+		for (uint k = 0; k < 3; k++)
+			new_cache[new_size++] = tri_v[k];
+		for (uint i = 0; i < cache_size; i++)
+		{
+			const uint v = cache[i];
+			if (v != tri_v[0] && v != tri_v[1] && v != tri_v[2])
+				new_cache[new_size++] = v;
+		}
+
+		// rescore everything that was or is in the cache and find the best
+		// triangle adjacent to it
+		best = invalid;
+		float best_score = -1.0f;
+		for (uint i = 0; i < new_size; i++)
+		{
+			const uint v = new_cache[i];
+			const int position = i < kForsythCacheSize ? int(i) : -1;
+			cache_position[v] = position;
+			const float s = score(position, remaining[v]);
+			const float delta = s - vertex_score[v];
+			vertex_score[v] = s;
+
+			const uint* adj = adjacency.data() + adjacency_offset[v];
+			for (uint a = 0; a < remaining[v]; a++)
+			{
+				const uint t = adj[a];
+				triangle_score[t] += delta;
+				if (position >= 0 && triangle_score[t] > best_score)
+				{
+					best = t;
+					best_score = triangle_score[t];
+				}
+			}
+		}
+
+		cache_size = min(new_size, kForsythCacheSize);
+		memcpy(cache, new_cache, cache_size * sizeof(uint));
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+// _____________________________________________________________________________
+// Overdraw
+
+template<typename IndexT>
+static void optimize_overdraw_t(IndexT* indices, uint num_indices, const float3* positions, uint position_stride, uint base_vertex, uint num_vertices, float threshold)
+{
+	const uint nTriangles = num_indices / 3;
+	if (nTriangles < 2)
+		return;
+
+	auto position = [&](uint v)->const float3& { return *(const float3*)byte_add(positions, v * position_stride); };
+	auto fetch = [&](fifo_cache& cache, uint t) { return cache.fetch(indices[t*3] - base_vertex) + cache.fetch(indices[t*3+1] - base_vertex) + cache.fetch(indices[t*3+2] - base_vertex); };
+
+	// Clusters first start where a triangle misses on all its vertices: the cache
+	// optimizer has moved on to a disjoint patch so nothing is lost by drawing
+	// the patch at another time.
+	std::vector<uint> clusters;
+	std::vector<uchar> misses(nTriangles);
+	{
+		fifo_cache cache(num_vertices, default_vertex_cache_size);
+		for (uint t = 0; t < nTriangles; t++)
+		{
+			misses[t] = uchar(fetch(cache, t));
+			if (t == 0 || misses[t] == 3)
+				clusters.push_back(t);
+		}
+	}
+	clusters.push_back(nTriangles);
+
+	// Then split those further wherever the part so far is already within
+	// threshold of the whole cluster's ACMR when drawn from a cold cache.
+	std::vector<uint> split;
+	{
+		fifo_cache cache(num_vertices, default_vertex_cache_size);
+		for (size_t c = 0; c + 1 < clusters.size(); c++)
+		{
+			const uint start = clusters[c];
+			const uint end = clusters[c+1];
+
+			uint cluster_misses = 0;
+			for (uint t = start; t < end; t++)
+				cluster_misses += misses[t];
+			const float limit = threshold * cluster_misses / float(end - start);
+
+			cache.flush();
+			split.push_back(start);
+			uint part_start = start;
+			uint part_misses = 0;
+			for (uint t = start; t < end; t++)
+			{
+				part_misses += fetch(cache, t);
+				if ((t + 1) < end && (part_misses / float(t + 1 - part_start)) <= limit)
+				{
+					cache.flush();
+					split.push_back(t + 1);
+					part_start = t + 1;
+					part_misses = 0;
+				}
+			}
+		}
+	}
+	split.push_back(nTriangles);
+
+	// sort so clusters facing out from the center draw first
+	const uint nClusters = uint(split.size() - 1);
+	std::vector<float3> centroid(nClusters, float3(0.0f, 0.0f, 0.0f));
+	std::vector<float3> normal(nClusters, float3(0.0f, 0.0f, 0.0f));
+	std::vector<float> area(nClusters, 0.0f);
+	float3 mesh_centroid(0.0f, 0.0f, 0.0f);
+	float mesh_area = 0.0f;
+	for (uint c = 0; c < nClusters; c++)
+	{
+		for (uint t = split[c]; t < split[c+1]; t++)
+		{
+			const float3& a = position(indices[t*3]);
+			const float3& b = position(indices[t*3+1]);
+			const float3& d = position(indices[t*3+2]);
+			const float3 n = cross(b - a, d - a);
+			const float w = length(n);
+			centroid[c] += (a + b + d) * (w / 3.0f);
+			normal[c] += n;
+			area[c] += w;
+		}
+
+		mesh_centroid += centroid[c];
+		mesh_area += area[c];
+		if (area[c] > 0.0f)
+			centroid[c] /= area[c];
+	}
+
+	if (mesh_area > 0.0f)
+		mesh_centroid /= mesh_area;
+
+	std::vector<float> sort_key(nClusters);
+	std::vector<uint> order(nClusters);
+	for (uint c = 0; c < nClusters; c++)
+	{
+		const float l = length(normal[c]);
+		sort_key[c] = l > 0.0f ? dot(centroid[c] - mesh_centroid, normal[c] / l) : 0.0f;
+		order[c] = c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&](uint a, uint b) { return sort_key[a] > sort_key[b]; });
+
+	std::vector<IndexT> result(nTriangles * 3);
+	IndexT* dst = result.data();
+	for (uint c : order)
+	{
+		const uint count = (split[c+1] - split[c]) * 3;
+		memcpy(dst, indices + split[c] * 3, count * sizeof(IndexT));
+		dst += count;
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+// _____________________________________________________________________________
+// Vertex fetch
+
+template<typename IndexT>
+static uint optimize_vertex_fetch_t(IndexT* indices, uint num_indices, uint num_vertices, uint* out_remap)
+{
+	std::fill(out_remap, out_remap + num_vertices, invalid);
+	uint next = 0;
+	for (uint i = 0; i < num_indices; i++)
+	{
+		uint& r = out_remap[indices[i]];
+		if (r == invalid)
+			r = next++;
+		indices[i] = static_cast<IndexT>(r);
+	}
+	return next;
+}
+
+vertex_cache_stats calc_vertex_cache_stats(const uint* indices, uint num_indices, uint num_vertices, uint cache_size) { return calc_vertex_cache_stats_t(indices, num_indices, 0, num_vertices, cache_size); }
+vertex_cache_stats calc_vertex_cache_stats(const ushort* indices, uint num_indices, uint num_vertices, uint cache_size) { return calc_vertex_cache_stats_t(indices, num_indices, 0, num_vertices, cache_size); }
+void optimize_vertex_cache(uint* indices, uint num_indices, uint num_vertices) { optimize_vertex_cache_t(indices, num_indices, 0, num_vertices); }
+void optimize_vertex_cache(ushort* indices, uint num_indices, uint num_vertices) { optimize_vertex_cache_t(indices, num_indices, 0, num_vertices); }
+void optimize_overdraw(uint* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, float threshold) { optimize_overdraw_t(indices, num_indices, positions, position_stride, 0, num_vertices, threshold); }
+void optimize_overdraw(ushort* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, float threshold) { optimize_overdraw_t(indices, num_indices, positions, position_stride, 0, num_vertices, threshold); }
+uint optimize_vertex_fetch(uint* indices, uint num_indices, uint num_vertices, uint* out_remap) { return optimize_vertex_fetch_t(indices, num_indices, num_vertices, out_remap); }
+uint optimize_vertex_fetch(ushort* indices, uint num_indices, uint num_vertices, uint* out_remap) { return optimize_vertex_fetch_t(indices, num_indices, num_vertices, out_remap); }
+
+void remap_vertices(void* oRESTRICT dst, const void* oRESTRICT src, uint vertex_stride, uint num_vertices, const uint* oRESTRICT remap)
+{
+	for (uint v = 0; v < num_vertices; v++)
+		if (remap[v] != invalid)
+			memcpy(byte_add(dst, remap[v] * vertex_stride), byte_add(src, v * vertex_stride), vertex_stride);
+}
+
+// _____________________________________________________________________________
+// Models
+
+template<typename IndexT>
+static vertex_cache_stats calc_model_stats(const model& m, const IndexT* indices, uint cache_size)
+{
+	const model_info i = m.get_info();
+	const model_subset* subsets = m.subsets();
+
+	// each subset is a separate draw, so its cache starts cold
+	vertex_cache_stats s;
+	uint nTriangles = 0, nVertices = 0;
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+	{
+		const model_subset& ss = subsets[subset];
+		if (!ss.num_indices)
+			continue;
+		const vertex_range r = calc_vertex_range(indices + ss.start_index, ss.num_indices);
+		vertex_cache_stats sub = calc_vertex_cache_stats_t(indices + ss.start_index, ss.num_indices, r.base_vertex, r.num_vertices, cache_size);
+		s.num_transforms += sub.num_transforms;
+		nTriangles += ss.num_indices / 3;
+		nVertices += sub.atvr > 0.0f ? uint(sub.num_transforms / sub.atvr + 0.5f) : 0;
+	}
+
+	s.acmr = nTriangles ? s.num_transforms / float(nTriangles) : 0.0f;
+	s.atvr = nVertices ? s.num_transforms / float(nVertices) : 0.0f;
+	return s;
+}
+
+template<typename IndexT>
+static optimize_stats optimize_t(model& m, IndexT* indices, const optimize_options& options)
+{
+	const model_info i = m.get_info();
+	model_subset* subsets = m.subsets();
+
+	uint position_stride = 0;
+	const float3* positions = find_positions(m, &position_stride);
+
+	if (options.overdraw && !positions)
+		oTHROW_INVARG("overdraw optimization requires r32g32b32_float positions");
+
+	optimize_stats s;
+	s.before = calc_model_stats(m, indices, options.cache_size);
+
+	if (options.vertex_cache || options.overdraw)
+	{
+		parallel_for(0, i.num_subsets, [&](size_t subset)
+		{
+			const model_subset& ss = subsets[subset];
+			if (!ss.num_indices)
+				return;
+			IndexT* sub = indices + ss.start_index;
+			const vertex_range r = calc_vertex_range(sub, ss.num_indices);
+			if (options.vertex_cache)
+				optimize_vertex_cache_t(sub, ss.num_indices, r.base_vertex, r.num_vertices);
+			if (options.overdraw)
+				optimize_overdraw_t(sub, ss.num_indices, positions, position_stride, r.base_vertex, r.num_vertices, options.overdraw_threshold);
+		});
+	}
+
+	if (options.vertex_fetch)
+	{
+		std::vector<uint> remap(i.num_vertices);
+		uint next = optimize_vertex_fetch_t(indices, i.num_indices, i.num_vertices, remap.data());
+
+		// the model's allocation is fixed, so keep unreferenced vertices at the end
+		for (uint& r : remap)
+			if (r == invalid)
+				r = next++;
+
+		std::vector<uchar> original;
+		for (uint slot = 0; slot < max_num_slots; slot++)
+		{
+			const uint stride = calc_vertex_size(i.elements, slot);
+			if (!stride)
+				continue;
+
+			void* data = m.vertices(slot);
+			original.assign((const uchar*)data, (const uchar*)data + stride * i.num_vertices);
+			remap_vertices(data, original.data(), stride, i.num_vertices, remap.data());
+		}
+
+		for (uint subset = 0; subset < i.num_subsets; subset++)
+		{
+			model_subset& ss = subsets[subset];
+			if (!ss.num_indices)
+				continue;
+			uint min_vertex = 0, max_vertex = 0;
+			calc_min_max_indices(indices, ss.start_index, ss.num_indices, i.num_vertices, &min_vertex, &max_vertex);
+			ss.start_vertex = min_vertex;
+			ss.num_vertices = max_vertex - min_vertex + 1;
+		}
+	}
+
+	s.after = calc_model_stats(m, indices, options.cache_size);
+	return s;
+}
+
+optimize_stats optimize(model& m, const optimize_options& options)
+{
+	const model_info i = m.get_info();
+	return has_16bit_indices(i.num_vertices) ? optimize_t(m, m.indices(), options) : optimize_t(m, m.indices32(), options);
+}
+
+}}
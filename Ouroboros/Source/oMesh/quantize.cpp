@@ -0,0 +1,467 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/quantize.h>
+#include <oBase/throw.h>
+#include <oBase/types.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+#include <oMemory/memory.h>
+#include <vector>
+
+namespace ouro { namespace mesh {
+
+float2 encode_octahedral(const float3& normal)
+{
+	const float l1 = abs(normal.x) + abs(normal.y) + abs(normal.z);
+	if (l1 <= 0.0f)
+		return float2(0.0f, 0.0f);
+	float2 e(normal.x / l1, normal.y / l1);
+	if (normal.z < 0.0f)
+	{
+		// fold the lower hemisphere over the diagonals
+		const float2 folded((1.0f - abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f), (1.0f - abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+		e = folded;
+	}
+	return e;
+}
+
+float3 decode_octahedral(const float2& encoded)
+{
+	float3 n(encoded.x, encoded.y, 1.0f - abs(encoded.x) - abs(encoded.y));
+	const float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+// what's needed beyond the element to decode it
+struct quantize_context
+{
+	float3 center;
+	float3 extents; // half the bounding box size, 0 on a flat axis
+	float3 encode_extents; // extents with flat axes set to 1 so encoding can divide by them
+	float scale; // the largest bounding box dimension
+};
+
+static short f32tos16(float x) { return static_cast<short>(floor(clamp(x, -1.0f, 1.0f) * 32767.0f + 0.5f)); }
+static float s16tof32(short x) { return max(x / 32767.0f, -1.0f); }
+
+static float4 read_float(const void* src, const surface::format& f, float w)
+{
+	const float* v = (const float*)src;
+	switch (f)
+	{
+		case surface::format::r32g32_float: return float4(v[0], v[1], 0.0f, w);
+		case surface::format::r32g32b32_float: return float4(v[0], v[1], v[2], w);
+		case surface::format::r32g32b32a32_float: return float4(v[0], v[1], v[2], v[3]);
+		default: break;
+	}
+	oTHROW(not_supported, "format %u is not a float format", uint(f));
+}
+
+static bool is_float(const surface::format& f)
+{
+	return f == surface::format::r32g32_float || f == surface::format::r32g32b32_float || f == surface::format::r32g32b32a32_float;
+}
+
+static void encode(void* dst, const surface::format& f, const surface::semantic& s, const quantize_context& c, const float4& v)
+{
+	switch (f)
+	{
+		case surface::format::r16g16b16a16_snorm:
+		{
+			short* d = (short*)dst;
+			if (s == surface::semantic::vertex_position)
+			{
+				d[0] = f32tos16((v.x - c.center.x) / c.encode_extents.x);
+				d[1] = f32tos16((v.y - c.center.y) / c.encode_extents.y);
+				d[2] = f32tos16((v.z - c.center.z) / c.encode_extents.z);
+				d[3] = f32tos16(1.0f);
+			}
+			else
+			{
+				d[0] = f32tos16(v.x); d[1] = f32tos16(v.y); d[2] = f32tos16(v.z); d[3] = f32tos16(v.w);
+			}
+			break;
+		}
+
+		case surface::format::r16g16_snorm:
+		{
+			const float2 e = encode_octahedral(v.xyz());
+			short* d = (short*)dst;
+			d[0] = f32tos16(e.x);
+			d[1] = f32tos16(e.y);
+			break;
+		}
+
+		case surface::format::r10g10b10a2_unorm:
+		{
+			const float l = length(v.xyz());
+			const float3 n = l > 0.0f ? v.xyz() / l : float3(0.0f, 0.0f, 0.0f);
+			*(uint*)dst = f32ton10(sf32touf32(n.x)) | (f32ton10(sf32touf32(n.y)) << 10) | (f32ton10(sf32touf32(n.z)) << 20) | (uint(v.w < 0.0f ? 0 : 3) << 30);
+			break;
+		}
+
+		case surface::format::r16g16_unorm:
+		{
+			ushort* d = (ushort*)dst;
+			d[0] = f32ton16(saturate(v.x));
+			d[1] = f32ton16(saturate(v.y));
+			break;
+		}
+
+		case surface::format::r16g16_float:
+		{
+			half2* d = (half2*)dst;
+			d->x = v.x;
+			d->y = v.y;
+			break;
+		}
+
+		default:
+			oTHROW(not_supported, "format %u is not a quantized format", uint(f));
+	}
+}
+
+static float4 decode(const void* src, const surface::format& f, const surface::semantic& s, const quantize_context& c)
+{
+	switch (f)
+	{
+		case surface::format::r16g16b16a16_snorm:
+		{
+			const short* d = (const short*)src;
+			if (s == surface::semantic::vertex_position)
+				return float4(c.center.x + s16tof32(d[0]) * c.extents.x, c.center.y + s16tof32(d[1]) * c.extents.y, c.center.z + s16tof32(d[2]) * c.extents.z, 1.0f);
+			return float4(s16tof32(d[0]), s16tof32(d[1]), s16tof32(d[2]), s16tof32(d[3]));
+		}
+
+		case surface::format::r16g16_snorm:
+		{
+			const short* d = (const short*)src;
+			return float4(decode_octahedral(float2(s16tof32(d[0]), s16tof32(d[1]))), 0.0f);
+		}
+
+		case surface::format::r10g10b10a2_unorm:
+		{
+			const uint n = *(const uint*)src;
+			return float4(uf32tosf32(n10tof32(n & 0x3ff)), uf32tosf32(n10tof32((n >> 10) & 0x3ff)), uf32tosf32(n10tof32((n >> 20) & 0x3ff)), (n >> 30) ? 1.0f : -1.0f);
+		}
+
+		case surface::format::r16g16_unorm:
+		{
+			const ushort* d = (const ushort*)src;
+			return float4(n16tof32(d[0]), n16tof32(d[1]), 0.0f, 0.0f);
+		}
+
+		case surface::format::r16g16_float:
+		{
+			const half2* d = (const half2*)src;
+			return float4(d->x, d->y, 0.0f, 0.0f);
+		}
+
+		default:
+			break;
+	}
+	oTHROW(not_supported, "format %u is not a quantized format", uint(f));
+}
+
+// in quantize_options' units
+static float calc_error(const surface::semantic& s, const quantize_context& c, const float4& expected, const float4& actual)
+{
+	switch (s)
+	{
+		case surface::semantic::vertex_position:
+		{
+			const float3 d = abs(expected.xyz() - actual.xyz());
+			return max(d.x, max(d.y, d.z)) / c.scale;
+		}
+
+		case surface::semantic::vertex_normal:
+		case surface::semantic::vertex_tangent:
+		{
+			// there's no direction to keep
+			if (dot(expected.xyz(), expected.xyz()) <= 0.0f)
+				return 0.0f;
+
+			const float3 a = normalize(expected.xyz());
+			const float3 b = normalize(actual.xyz());
+			float error = degrees(acos(clamp(dot(a, b), -1.0f, 1.0f)));
+			if (s == surface::semantic::vertex_tangent && (expected.w < 0.0f) != (actual.w < 0.0f))
+				error = 180.0f;
+			return error;
+		}
+
+		case surface::semantic::vertex_texcoord:
+		{
+			const float2 d = abs(expected.xy() - actual.xy());
+			return max(d.x, d.y);
+		}
+
+		default:
+			break;
+	}
+	return 0.0f;
+}
+
+static float default_w(const surface::semantic& s)
+{
+	return s == surface::semantic::vertex_position || s == surface::semantic::vertex_tangent ? 1.0f : 0.0f;
+}
+
+// Returns the format for element e and its measured error, or the current
+// format if nothing fits.
+static surface::format choose_format(const model& m, uint e, const quantize_context& c, const quantize_options& o, float* out_error)
+{
+	const model_info i = m.get_info();
+	const element& el = i.elements[e];
+	*out_error = 0.0f;
+
+	if (!is_float(el.format()))
+		return el.format();
+
+	const void* src = byte_add(m.vertices(el.slot()), calc_offset(i.elements, e));
+	const uint stride = calc_vertex_size(i.elements, el.slot());
+	const float w = default_w(el.semantic());
+
+	float budget = 0.0f;
+	surface::format candidates[2] = { surface::format::unknown, surface::format::unknown };
+	switch (el.semantic())
+	{
+		case surface::semantic::vertex_position:
+			budget = o.position_error;
+			candidates[0] = surface::format::r16g16b16a16_snorm;
+			break;
+
+		case surface::semantic::vertex_normal:
+			budget = o.normal_error;
+			candidates[0] = surface::format::r16g16_snorm;
+			break;
+
+		case surface::semantic::vertex_tangent:
+			budget = o.normal_error;
+			candidates[0] = surface::format::r10g10b10a2_unorm;
+			candidates[1] = surface::format::r16g16b16a16_snorm;
+			break;
+
+		case surface::semantic::vertex_texcoord:
+		{
+			// the packed formats have no room for z or w
+			if (el.format() != surface::format::r32g32_float)
+				return el.format();
+
+			budget = o.texcoord_error;
+			bool normalized = true;
+			for (uint v = 0; v < i.num_vertices && normalized; v++)
+			{
+				const float4 t = read_float(byte_add(src, v * stride), el.format(), w);
+				normalized = t.x >= 0.0f && t.x <= 1.0f && t.y >= 0.0f && t.y <= 1.0f;
+			}
+
+			if (normalized)
+				candidates[0] = surface::format::r16g16_unorm;
+			else
+				candidates[0] = surface::format::r16g16_float;
+			break;
+		}
+
+		default:
+			return el.format();
+	}
+
+	for (const surface::format& f : candidates)
+	{
+		if (f == surface::format::unknown)
+			break;
+
+		uchar packed[16];
+		float error = 0.0f;
+		for (uint v = 0; v < i.num_vertices && error <= budget; v++)
+		{
+			const float4 expected = read_float(byte_add(src, v * stride), el.format(), w);
+			encode(packed, f, el.semantic(), c, expected);
+			error = max(error, calc_error(el.semantic(), c, expected, decode(packed, f, el.semantic(), c)));
+		}
+
+		if (error <= budget)
+		{
+			*out_error = error;
+			return f;
+		}
+	}
+
+	return el.format();
+}
+
+static quantize_context calc_context(const model& m)
+{
+	const model_info i = m.get_info();
+	quantize_context c;
+	c.center = float3(0.0f, 0.0f, 0.0f);
+	c.extents = float3(1.0f, 1.0f, 1.0f);
+	c.encode_extents = c.extents;
+	c.scale = 1.0f;
+
+	for (uint e = 0; e < max_num_elements; e++)
+	{
+		const element& el = i.elements[e];
+		if (el.semantic() == surface::semantic::vertex_position && (el.format() == surface::format::r32g32b32_float || el.format() == surface::format::r32g32b32a32_float))
+		{
+			const aaboxf bound = calc_bound((const float3*)byte_add(m.vertices(el.slot()), calc_offset(i.elements, e)), calc_vertex_size(i.elements, el.slot()), i.num_vertices);
+			c.center = bound.center();
+			c.extents = bound.size() / 2.0f;
+			c.scale = max(bound.size().x, max(bound.size().y, bound.size().z));
+			if (c.scale <= 0.0f)
+				c.scale = 1.0f;
+
+			// a flat axis encodes as 0 whatever it's divided by, and decodes back to
+			// the center since its extent is 0
+			c.encode_extents = float3(c.extents.x > 0.0f ? c.extents.x : 1.0f, c.extents.y > 0.0f ? c.extents.y : 1.0f, c.extents.z > 0.0f ? c.extents.z : 1.0f);
+			break;
+		}
+	}
+
+	return c;
+}
+
+static uint calc_total_vertex_size(const element_array& elements)
+{
+	uint size = 0;
+	for (uint slot = 0; slot < max_num_slots; slot++)
+		size += calc_vertex_size(elements, slot);
+	return size;
+}
+
+static element_array calc_quantized_elements(const model& m, const quantize_context& c, const quantize_options& o, quantize_stats* out_stats)
+{
+	const model_info i = m.get_info();
+	element_array elements = i.elements;
+	quantize_stats s;
+	for (uint e = 0; e < max_num_elements; e++)
+	{
+		if (i.elements[e].semantic() == surface::semantic::unknown)
+			continue;
+
+		float error = 0.0f;
+		elements[e].format(choose_format(m, e, c, o, &error));
+		switch (i.elements[e].semantic())
+		{
+			case surface::semantic::vertex_position: s.position_error = max(s.position_error, error); break;
+			case surface::semantic::vertex_normal:
+			case surface::semantic::vertex_tangent: s.normal_error = max(s.normal_error, error); break;
+			case surface::semantic::vertex_texcoord: s.texcoord_error = max(s.texcoord_error, error); break;
+			default: break;
+		}
+	}
+
+	if (out_stats)
+	{
+		s.vertex_size_before = calc_total_vertex_size(i.elements);
+		s.vertex_size_after = calc_total_vertex_size(elements);
+		*out_stats = s;
+	}
+
+	return elements;
+}
+
+element_array calc_quantized_elements(const model& m, const quantize_options& options, quantize_stats* out_stats)
+{
+	return calc_quantized_elements(m, calc_context(m), options, out_stats);
+}
+
+// copies m into a model with dst_elements, converting each element with convert
+template<typename ConvertFn>
+static std::shared_ptr<model> convert_model(const model& m, const model_info& dst_info, const allocator& a, ConvertFn convert)
+{
+	const model_info i = m.get_info();
+
+	std::vector<const char*> material_names(i.num_subsets);
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+		material_names[subset] = m.material_name(subset);
+
+	std::shared_ptr<model> dm = std::make_shared<model>();
+	dm->initialize(dst_info, material_names.data(), a);
+	memcpy(dm->subsets(), m.subsets(), sizeof(model_subset) * i.num_subsets);
+	memcpy(dm->indices(), m.indices(), index_size(i.num_vertices) * i.num_indices);
+
+	for (uint e = 0; e < max_num_elements; e++)
+	{
+		const element& se = i.elements[e];
+		const element& de = dst_info.elements[e];
+		if (se.semantic() == surface::semantic::unknown)
+			continue;
+
+		const void* src = byte_add(m.vertices(se.slot()), calc_offset(i.elements, e));
+		void* dst = byte_add(dm->vertices(de.slot()), calc_offset(dst_info.elements, e));
+		const uint src_stride = calc_vertex_size(i.elements, se.slot());
+		const uint dst_stride = calc_vertex_size(dst_info.elements, de.slot());
+		const uint dst_size = surface::element_size(de.format());
+		if (se.format() == de.format())
+			memcpy2d(dst, dst_stride, src, src_stride, dst_size, i.num_vertices);
+		else
+			for (uint v = 0; v < i.num_vertices; v++)
+				convert(byte_add(dst, v * dst_stride), de, byte_add(src, v * src_stride), se);
+	}
+
+	return dm;
+}
+
+std::shared_ptr<model> quantize(const model& m, const quantize_options& options, quantize_stats* out_stats, const allocator& a)
+{
+	const quantize_context c = calc_context(m);
+
+	model_info qi = m.get_info();
+	qi.elements = calc_quantized_elements(m, c, options, out_stats);
+	qi.extents = c.extents;
+	qi.bounding_sphere = spheref(c.center, length(c.extents));
+	qi.log2scale = 0;
+
+	return convert_model(m, qi, a, [&](void* dst, const element& de, const void* src, const element& se)
+	{
+		encode(dst, de.format(), de.semantic(), c, read_float(src, se.format(), default_w(se.semantic())));
+	});
+}
+
+std::shared_ptr<model> dequantize(const model& m, const allocator& a)
+{
+	const model_info i = m.get_info();
+	quantize_context c;
+	c.center = i.bounding_sphere.xyz();
+	c.extents = i.extents;
+	c.encode_extents = i.extents;
+	c.scale = 1.0f;
+
+	model_info di = i;
+	for (uint e = 0; e < max_num_elements; e++)
+	{
+		element& el = di.elements[e];
+		const surface::format f = el.format();
+		switch (el.semantic())
+		{
+			case surface::semantic::vertex_position:
+				if (f == surface::format::r16g16b16a16_snorm)
+					el.format(surface::format::r32g32b32_float);
+				break;
+			case surface::semantic::vertex_normal:
+				if (f == surface::format::r16g16_snorm)
+					el.format(surface::format::r32g32b32_float);
+				break;
+			case surface::semantic::vertex_tangent:
+				if (f == surface::format::r10g10b10a2_unorm || f == surface::format::r16g16b16a16_snorm)
+					el.format(surface::format::r32g32b32a32_float);
+				break;
+			case surface::semantic::vertex_texcoord:
+				if (f == surface::format::r16g16_unorm || f == surface::format::r16g16_float)
+					el.format(surface::format::r32g32_float);
+				break;
+			default:
+				break;
+		}
+	}
+
+	return convert_model(m, di, a, [&](void* dst, const element& de, const void* src, const element& se)
+	{
+		const float4 v = decode(src, se.format(), se.semantic(), c);
+		memcpy(dst, &v, surface::element_size(de.format()));
+	});
+}
+
+}}
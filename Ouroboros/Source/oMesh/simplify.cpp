@@ -0,0 +1,582 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/simplify.h>
+#include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+namespace ouro { namespace mesh {
+
+// border edges are weighted up so open edges keep their shape
+static const double kBorderWeight = 10.0;
+
+// don't allow a triangle's normal to turn more than ~75 degrees in a collapse
+static const float kMaxNormalCos = 0.25f;
+
+// A symmetric 4x4 error matrix for the squared distance to a set of planes.
+// The total weight is kept so error() is a weighted mean squared distance: in 
+// length^2 whatever the planes were weighted by.
+struct quadric
+{
+	quadric() : a2(0.0), b2(0.0), c2(0.0), ab(0.0), ac(0.0), bc(0.0), ad(0.0), bd(0.0), cd(0.0), d2(0.0), w(0.0) {}
+
+	// adds the plane n.p + d = 0, n normalized
+	void add_plane(const float3& n, float d, double weight)
+	{
+		a2 += weight * n.x * n.x; b2 += weight * n.y * n.y; c2 += weight * n.z * n.z;
+		ab += weight * n.x * n.y; ac += weight * n.x * n.z; bc += weight * n.y * n.z;
+		ad += weight * n.x * d; bd += weight * n.y * d; cd += weight * n.z * d;
+		d2 += weight * d * d;
+		w += weight;
+	}
+
+	quadric& operator+=(const quadric& q)
+	{
+		a2 += q.a2; b2 += q.b2; c2 += q.c2;
+		ab += q.ab; ac += q.ac; bc += q.bc;
+		ad += q.ad; bd += q.bd; cd += q.cd;
+		d2 += q.d2;
+		w += q.w;
+		return *this;
+	}
+
+	double error(const float3& p) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		const double e = a2*x*x + b2*y*y + c2*z*z + 2.0*(ab*x*y + ac*x*z + bc*y*z) + 2.0*(ad*x + bd*y + cd*z) + d2;
+		return (e > 0.0 && w > 0.0) ? e / w : 0.0;
+	}
+
+	double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2, w;
+};
+
+/* enum class */ namespace vertex_kind
+{ enum value : uchar {
+
+	interior,
+	border, // on an open edge: moves only along it
+	seam, // shares its position with another vertex: never moves or is moved to
+	locked, // never moves but can be moved to
+
+};}
+
+// Returns for each vertex the lowest-numbered vertex with the same position
+static std::vector<uint> calc_position_ids(const float3* positions, uint position_stride, uint num_vertices)
+{
+	auto position = [&](uint v)->const float3& { return *(const float3*)byte_add(positions, v * position_stride); };
+
+	std::vector<uint> order(num_vertices);
+	for (uint v = 0; v < num_vertices; v++)
+		order[v] = v;
+
+	std::sort(order.begin(), order.end(), [&](uint a, uint b)->bool
+	{
+		const int c = memcmp(&position(a), &position(b), sizeof(float3));
+		return c < 0 || (c == 0 && a < b);
+	});
+
+	std::vector<uint> ids(num_vertices);
+	for (uint i = 0; i < num_vertices; )
+	{
+		const uint id = order[i];
+		uint j = i;
+		for (; j < num_vertices && !memcmp(&position(order[j]), &position(id), sizeof(float3)); j++)
+			ids[order[j]] = id;
+		i = j;
+	}
+
+	return ids;
+}
+
+static float calc_scale(const float3* positions, uint position_stride, uint num_vertices)
+{
+	const float3 size = calc_bound(positions, position_stride, num_vertices).size();
+	const float scale = max(size.x, max(size.y, size.z));
+	return scale > 0.0f ? scale : 1.0f;
+}
+
+static ullong edge_key(uint a, uint b)
+{
+	return a < b ? ((ullong(a) << 32) | b) : ((ullong(b) << 32) | a);
+}
+
+// Vertices marked in shared are never moved, but can be collapsed onto. 
+// Scratch covers only the vertex_range of indices.
+template<typename IndexT>
+static uint simplify_t(IndexT* dst, const IndexT* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices
+	, const bool* shared, float scale, uint target_num_indices, float target_error, float* out_error)
+{
+	const uint nTriangles = num_indices / 3;
+	const uint nTargetTriangles = target_num_indices / 3;
+	if (out_error)
+		*out_error = 0.0f;
+	if (nTriangles <= nTargetTriangles)
+	{
+		memcpy(dst, indices, nTriangles * 3 * sizeof(IndexT));
+		return nTriangles * 3;
+	}
+
+	// from here on vertices are numbered from the lowest one referenced
+	const vertex_range r = calc_vertex_range(indices, nTriangles * 3);
+	const uint min_vertex = r.base_vertex;
+	positions = (const float3*)byte_add(positions, min_vertex * position_stride);
+	num_vertices = r.num_vertices;
+	if (shared)
+		shared += min_vertex;
+
+	auto position = [&](uint v)->const float3& { return *(const float3*)byte_add(positions, v * position_stride); };
+
+	// the current triangles, compacted after each pass
+	std::vector<uint> tris(nTriangles * 3);
+	for (uint i = 0; i < nTriangles * 3; i++)
+		tris[i] = indices[i] - min_vertex;
+
+	const std::vector<uint> position_ids = calc_position_ids(positions, position_stride, num_vertices);
+
+	// Classify vertices by the edges around their positions. Once positions are
+	// shared the edges of triangles on either side of a seam can be matched.
+	std::vector<uchar> kind(num_vertices, vertex_kind::interior);
+	std::vector<ullong> border_edges;
+	{
+		// how many referenced vertices share each position
+		std::vector<uint> group_size(num_vertices, 0);
+		std::vector<bool> counted(num_vertices, false);
+		for (uint t = 0; t < nTriangles * 3; t++)
+		{
+			const uint v = tris[t];
+			if (!counted[v])
+			{
+				counted[v] = true;
+				group_size[position_ids[v]]++;
+			}
+		}
+
+		// edges keyed by position, noting direction so inconsistent winding can be
+		// found
+		std::vector<std::pair<ullong, bool>> edges(nTriangles * 3);
+		for (uint t = 0; t < nTriangles; t++)
+			for (uint k = 0; k < 3; k++)
+			{
+				const uint a = position_ids[tris[t*3+k]];
+				const uint b = position_ids[tris[t*3+(k+1)%3]];
+				edges[t*3+k] = std::make_pair(edge_key(a, b), a < b);
+			}
+
+		std::sort(edges.begin(), edges.end());
+
+		std::vector<uchar> id_kind(num_vertices, vertex_kind::interior);
+		for (size_t i = 0; i < edges.size(); )
+		{
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j].first == edges[i].first)
+				j++;
+
+			const uint a = uint(edges[i].first >> 32);
+			const uint b = uint(edges[i].first & 0xffffffff);
+			uchar k = vertex_kind::interior;
+			if (a == b || (j - i) > 2 || ((j - i) == 2 && edges[i].second == edges[i+1].second))
+				k = vertex_kind::locked; // degenerate, non-manifold or flipped
+			else if ((j - i) == 1)
+			{
+				k = vertex_kind::border;
+				border_edges.push_back(edges[i].first);
+			}
+
+			id_kind[a] = max(id_kind[a], k);
+			id_kind[b] = max(id_kind[b], k);
+			i = j;
+		}
+
+		for (uint v = 0; v < num_vertices; v++)
+		{
+			const uint id = position_ids[v];
+			uchar k = id_kind[id];
+			if (group_size[id] > 1)
+				k = vertex_kind::seam;
+			else if (shared && shared[v])
+				k = max(k, uchar(vertex_kind::locked));
+			kind[v] = k;
+		}
+	}
+
+	auto is_border_edge = [&](uint a, uint b)->bool
+	{
+		return std::binary_search(border_edges.begin(), border_edges.end(), edge_key(position_ids[a], position_ids[b]));
+	};
+
+	auto can_collapse = [&](uint v, uint t)->bool
+	{
+		switch (kind[v])
+		{
+			case vertex_kind::interior: return kind[t] != vertex_kind::seam;
+			case vertex_kind::border: return kind[t] != vertex_kind::seam && is_border_edge(v, t);
+			default: return false;
+		}
+	};
+
+	// quadrics from each triangle's plane, weighted by area
+	std::vector<quadric> quadrics(num_vertices);
+	for (uint t = 0; t < nTriangles; t++)
+	{
+		const uint* tri = tris.data() + t * 3;
+		const float3& p0 = position(tri[0]);
+		const float3& p1 = position(tri[1]);
+		const float3& p2 = position(tri[2]);
+		float3 n = cross(p1 - p0, p2 - p0);
+		const float area2 = length(n);
+		if (area2 <= 0.0f)
+			continue;
+		n /= area2;
+
+		quadric q;
+		q.add_plane(n, -dot(n, p0), area2 * 0.5);
+		for (uint k = 0; k < 3; k++)
+			quadrics[tri[k]] += q;
+
+		// a plane perpendicular to the triangle keeps border vertices on the border
+		for (uint k = 0; k < 3; k++)
+		{
+			const uint a = tri[k];
+			const uint b = tri[(k+1)%3];
+			if (!is_border_edge(a, b))
+				continue;
+
+			const float3 edge = position(b) - position(a);
+			const float edge_length = length(edge);
+			if (edge_length <= 0.0f)
+				continue;
+
+			const float3 bn = normalize(cross(edge, n));
+			quadric bq;
+			bq.add_plane(bn, -dot(bn, position(a)), kBorderWeight * edge_length * edge_length);
+			quadrics[a] += bq;
+			quadrics[b] += bq;
+		}
+	}
+
+	struct collapse
+	{
+		double cost;
+		uint v;
+		uint t;
+		bool operator<(const collapse& that) const { return cost < that.cost; }
+	};
+
+	const double max_cost = double(target_error) * scale * double(target_error) * scale;
+	double max_accepted = 0.0;
+
+	std::vector<uint> remap(num_vertices);
+	for (uint v = 0; v < num_vertices; v++)
+		remap[v] = v;
+
+	std::vector<uint> adjacency_offset(num_vertices + 1);
+	std::vector<uint> adjacency;
+	std::vector<uint> touched(num_vertices, 0);
+	std::vector<collapse> collapses;
+
+	uint nCurrent = nTriangles;
+	for (uint pass = 1; nCurrent > nTargetTriangles; pass++)
+	{
+		// vertex -> triangle adjacency
+		std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+		for (uint i = 0; i < nCurrent * 3; i++)
+			adjacency_offset[tris[i] + 1]++;
+		for (uint v = 0; v < num_vertices; v++)
+			adjacency_offset[v + 1] += adjacency_offset[v];
+		adjacency.resize(nCurrent * 3);
+		{
+			std::vector<uint> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+			for (uint i = 0; i < nCurrent * 3; i++)
+				adjacency[fill[tris[i]]++] = i / 3;
+		}
+
+		// the cheaper allowed direction of each edge
+		collapses.clear();
+		for (uint i = 0; i < nCurrent * 3; i++)
+		{
+			const uint a = tris[i];
+			const uint b = tris[i - (i % 3) + (i + 1) % 3];
+			const bool ab = can_collapse(a, b);
+			const bool ba = can_collapse(b, a);
+			if (!ab && !ba)
+				continue;
+
+			quadric q = quadrics[a];
+			q += quadrics[b];
+			const double cost_ab = ab ? q.error(position(b)) : DBL_MAX;
+			const double cost_ba = ba ? q.error(position(a)) : DBL_MAX;
+			collapse c;
+			c.cost = min(cost_ab, cost_ba);
+			c.v = cost_ab <= cost_ba ? a : b;
+			c.t = cost_ab <= cost_ba ? b : a;
+			if (c.cost <= max_cost)
+				collapses.push_back(c);
+		}
+
+		std::sort(collapses.begin(), collapses.end());
+
+		// Each collapse removes about 2 triangles and each edge is listed about
+		// twice, so the collapse at nToRemove is about the last one needed. Many
+		// are skipped for overlapping, so allow some more cost than that rather
+		// than reaching far down the list in one pass.
+		const uint nToRemove = nCurrent - nTargetTriangles;
+		const double pass_cost = nToRemove < collapses.size() ? 1.5 * collapses[nToRemove].cost : DBL_MAX;
+
+		// Apply collapses that don't overlap: the 1-ring of a moved vertex is
+		// frozen for the rest of the pass so later tests see current positions.
+		uint nRemoved = 0;
+		uint nCollapses = 0;
+		for (const collapse& c : collapses)
+		{
+			if (c.cost > pass_cost)
+				break;
+
+			if (touched[c.v] == pass || touched[c.t] == pass)
+				continue;
+
+			const uint* adj = adjacency.data() + adjacency_offset[c.v];
+			const uint* adj_end = adjacency.data() + adjacency_offset[c.v + 1];
+
+			bool flips = false;
+			uint nDegenerate = 0;
+			for (const uint* a = adj; a < adj_end && !flips; a++)
+			{
+				const uint* tri = tris.data() + *a * 3;
+				if (tri[0] == c.t || tri[1] == c.t || tri[2] == c.t)
+				{
+					nDegenerate++;
+					continue;
+				}
+
+				const uint k = tri[0] == c.v ? 0 : (tri[1] == c.v ? 1 : 2);
+				const float3& p1 = position(tri[(k+1)%3]);
+				const float3& p2 = position(tri[(k+2)%3]);
+				const float3 n0 = cross(p1 - position(c.v), p2 - position(c.v));
+				const float3 n1 = cross(p1 - position(c.t), p2 - position(c.t));
+				flips = dot(n0, n1) < kMaxNormalCos * length(n0) * length(n1);
+			}
+
+			if (flips)
+				continue;
+
+			for (const uint* a = adj; a < adj_end; a++)
+			{
+				const uint* tri = tris.data() + *a * 3;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = pass;
+			}
+
+			remap[c.v] = c.t;
+			quadrics[c.t] += quadrics[c.v];
+			max_accepted = max(max_accepted, c.cost);
+			nCollapses++;
+
+			nRemoved += nDegenerate;
+			if (nRemoved >= nToRemove)
+				break;
+		}
+
+		if (!nCollapses)
+			break;
+
+		// rewrite without the triangles that collapsed
+		uint n = 0;
+		for (uint t = 0; t < nCurrent; t++)
+		{
+			const uint a = remap[tris[t*3+0]];
+			const uint b = remap[tris[t*3+1]];
+			const uint d = remap[tris[t*3+2]];
+			if (a == b || b == d || d == a)
+				continue;
+			tris[n++] = a;
+			tris[n++] = b;
+			tris[n++] = d;
+		}
+
+		for (const collapse& c : collapses)
+			remap[c.v] = c.v;
+
+		nCurrent = n / 3;
+	}
+
+	for (uint i = 0; i < nCurrent * 3; i++)
+		dst[i] = static_cast<IndexT>(tris[i] + min_vertex);
+
+	if (out_error)
+		*out_error = float(sqrt(max_accepted) / scale);
+	return nCurrent * 3;
+}
+
+template<typename IndexT>
+static uint simplify_t(IndexT* dst, const IndexT* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, uint target_num_indices, float target_error, float* out_error)
+{
+	const float scale = calc_scale(positions, position_stride, num_vertices);
+	return simplify_t(dst, indices, num_indices, positions, position_stride, num_vertices, nullptr, scale, target_num_indices, target_error, out_error);
+}
+
+uint simplify(uint* dst, const uint* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, uint target_num_indices, float target_error, float* out_error) { return simplify_t(dst, indices, num_indices, positions, position_stride, num_vertices, target_num_indices, target_error, out_error); }
+uint simplify(ushort* dst, const ushort* indices, uint num_indices, const float3* positions, uint position_stride, uint num_vertices, uint target_num_indices, float target_error, float* out_error) { return simplify_t(dst, indices, num_indices, positions, position_stride, num_vertices, target_num_indices, target_error, out_error); }
+
+// _____________________________________________________________________________
+// LODs
+
+static const uint kNumLods = 3; // model_info::lods
+
+// opaque, alpha-tested then blended
+static uint draw_category(const model_subset& s)
+{
+	if (s.flags & model_subset::blended) return 2;
+	if (s.flags & model_subset::atested) return 1;
+	return 0;
+}
+
+template<typename IndexT>
+static std::shared_ptr<model> make_lods_t(const model& m, const IndexT* indices, const lod_options& options, float out_errors[3], const allocator& a)
+{
+	const model_info i = m.get_info();
+	const model_subset* subsets = m.subsets();
+	const uint nSubsets = i.num_subsets;
+	if (nSubsets * kNumLods > 0xffff)
+		oTHROW_INVARG("too many subsets for %u lods", kNumLods);
+
+	uint position_stride = 0;
+	const float3* positions = find_positions(m, &position_stride);
+
+	if (!positions)
+		oTHROW_INVARG("simplification requires r32g32b32_float positions");
+
+	const std::vector<uint> position_ids = calc_position_ids(positions, position_stride, i.num_vertices);
+	const float scale = calc_scale(positions, position_stride, i.num_vertices);
+
+	// [lod][subset]
+	std::vector<std::vector<IndexT>> lod_indices(kNumLods * nSubsets);
+	for (uint subset = 0; subset < nSubsets; subset++)
+	{
+		const model_subset& s = subsets[subset];
+		lod_indices[subset].assign(indices + s.start_index, indices + s.start_index + s.num_indices);
+	}
+
+	if (out_errors)
+		out_errors[0] = 0.0f;
+
+	std::vector<bool> shared_ids(i.num_vertices);
+	std::vector<uint> owner(i.num_vertices);
+	std::unique_ptr<bool[]> shared(new bool[i.num_vertices]);
+	std::vector<float> errors(nSubsets);
+	for (uint lod = 1; lod < kNumLods; lod++)
+	{
+		const std::vector<IndexT>* prev = &lod_indices[(lod-1) * nSubsets];
+		std::vector<IndexT>* cur = &lod_indices[lod * nSubsets];
+
+		// lock positions used by more than one subset
+		std::fill(shared_ids.begin(), shared_ids.end(), false);
+		std::fill(owner.begin(), owner.end(), invalid);
+		for (uint subset = 0; subset < nSubsets; subset++)
+			for (IndexT v : prev[subset])
+			{
+				const uint id = position_ids[v];
+				if (owner[id] == invalid)
+					owner[id] = subset;
+				else if (owner[id] != subset)
+					shared_ids[id] = true;
+			}
+
+		for (uint v = 0; v < i.num_vertices; v++)
+			shared[v] = shared_ids[position_ids[v]];
+
+		parallel_for(0, nSubsets, [&](size_t subset)
+		{
+			const std::vector<IndexT>& src = prev[subset];
+			std::vector<IndexT>& dst = cur[subset];
+			dst.resize(src.size());
+			const uint target = uint(subsets[subset].num_indices / 3 * options.target_ratio[lod-1]) * 3;
+			const uint n = src.empty() ? 0 : simplify_t(dst.data(), src.data(), uint(src.size()), positions, position_stride, i.num_vertices
+				, shared.get(), scale, target, options.target_error[lod-1], &errors[subset]);
+			dst.resize(n);
+		});
+
+		if (out_errors)
+			out_errors[lod] = nSubsets ? *std::max_element(errors.begin(), errors.end()) : 0.0f;
+	}
+
+	// Each lod's subsets are in draw category order
+	std::vector<uint> order(nSubsets);
+	for (uint subset = 0; subset < nSubsets; subset++)
+		order[subset] = subset;
+	std::stable_sort(order.begin(), order.end(), [&](uint a, uint b) { return draw_category(subsets[a]) < draw_category(subsets[b]); });
+
+	model_info li = i;
+	li.num_subsets = ushort(nSubsets * kNumLods);
+	li.num_indices = 0;
+	for (const auto& l : lod_indices)
+		li.num_indices += uint(l.size());
+
+	std::vector<const char*> material_names(li.num_subsets);
+	for (uint lod = 0; lod < kNumLods; lod++)
+	{
+		model_lod& l = li.lods[lod];
+		model_subset_range* ranges[] = { &l.opaque_color, &l.atest_color, &l.blend_color };
+		for (model_subset_range* r : ranges)
+			*r = model_subset_range();
+		l.collision = model_subset_range();
+
+		for (uint o = 0; o < nSubsets; o++)
+		{
+			const uint dst_subset = lod * nSubsets + o;
+			material_names[dst_subset] = m.material_name(order[o]);
+
+			model_subset_range& r = *ranges[draw_category(subsets[order[o]])];
+			if (!r.num_ranges)
+				r.start_range = ushort(dst_subset);
+			r.num_ranges++;
+		}
+	}
+
+	std::shared_ptr<model> lm = std::make_shared<model>();
+	lm->initialize(li, material_names.data(), a);
+
+	for (uint slot = 0; slot < max_num_slots; slot++)
+	{
+		const uint stride = calc_vertex_size(i.elements, slot);
+		if (stride)
+			memcpy(lm->vertices(slot), m.vertices(slot), stride * i.num_vertices);
+	}
+
+	IndexT* dst_indices = has_16bit_indices(i.num_vertices) ? (IndexT*)lm->indices() : (IndexT*)lm->indices32();
+	model_subset* dst_subsets = lm->subsets();
+	uint start_index = 0;
+	for (uint lod = 0; lod < kNumLods; lod++)
+	{
+		for (uint o = 0; o < nSubsets; o++)
+		{
+			const std::vector<IndexT>& src = lod_indices[lod * nSubsets + order[o]];
+			model_subset& s = dst_subsets[lod * nSubsets + o];
+			s = subsets[order[o]];
+			s.start_index = start_index;
+			s.num_indices = uint(src.size());
+			s.start_vertex = 0;
+			s.num_vertices = 0;
+			if (!src.empty())
+			{
+				memcpy(dst_indices + start_index, src.data(), src.size() * sizeof(IndexT));
+				uint min_vertex = 0, max_vertex = 0;
+				calc_min_max_indices(dst_indices, start_index, s.num_indices, i.num_vertices, &min_vertex, &max_vertex);
+				s.start_vertex = min_vertex;
+				s.num_vertices = max_vertex - min_vertex + 1;
+			}
+			start_index += s.num_indices;
+		}
+	}
+
+	return lm;
+}
+
+std::shared_ptr<model> make_lods(const model& m, const lod_options& options, float out_errors[3], const allocator& a)
+{
+	const model_info i = m.get_info();
+	return has_16bit_indices(i.num_vertices) ? make_lods_t(m, m.indices(), options, out_errors, a) : make_lods_t(m, m.indices32(), options, out_errors, a);
+}
+
+}}
@@ -0,0 +1,131 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/bvh.h>
+#include <oMesh/obj.h>
+#include <oBase/throw.h>
+#include <oBase/timer.h>
+#include <oHLSL/oHLSLMath.h>
+#include <random>
+#include <vector>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+// returns the closest hit by testing every triangle
+static mesh::ray_hit brute_force(const mesh::ray& r, const uint* indices, uint num_indices, const float3* positions)
+{
+	mesh::ray_hit hit;
+	for (uint i = 0; i < num_indices; i += 3)
+	{
+		const float3& v0 = positions[indices[i]];
+		const float3 e1 = positions[indices[i+1]] - v0;
+		const float3 e2 = positions[indices[i+2]] - v0;
+		const float3 p = cross(r.direction, e2);
+		const float det = dot(e1, p);
+		if (det == 0.0f)
+			continue;
+		const float3 s = r.origin - v0;
+		const float u = dot(s, p) / det;
+		const float3 q = cross(s, e1);
+		const float v = dot(r.direction, q) / det;
+		const float t = dot(e2, q) / det;
+		if (u >= 0.0f && v >= 0.0f && (u + v) <= 1.0f && t >= r.t_min && t <= r.t_max && t < hit.t)
+		{
+			hit.triangle = i / 3;
+			hit.t = t;
+			hit.u = u;
+			hit.v = v;
+		}
+	}
+	return hit;
+}
+
+static bool same_hit(const mesh::ray_hit& a, const mesh::ray_hit& b)
+{
+	// coplanar neighbors can tie, so compare distance too
+	return a.triangle == b.triangle || (a.triangle != invalid && b.triangle != invalid && abs(a.t - b.t) <= 0.00001f * b.t);
+}
+
+void TESTbvh(test_services& _Services)
+{
+	static const char* kSource = "Test/Geometry/hunter.obj";
+	std::shared_ptr<mesh::obj::mesh> obj = load_test_obj(_Services, kSource);
+	const mesh::obj::info oi = obj->get_info();
+	const uint nIndices = oi.mesh_info.num_indices;
+	const uint nVertices = oi.mesh_info.num_vertices;
+
+	double start = timer::now();
+	mesh::bvh b(oi.indices, nIndices, oi.positions, sizeof(float3), nVertices);
+	const double seconds = timer::now() - start;
+
+	// every triangle is in exactly one leaf and children are inside parents
+	std::vector<uint> seen(nIndices / 3, 0);
+	for (uint i = 0; i < b.num_triangles(); i++)
+		seen[b.triangles()[i].triangle]++;
+	for (uint t = 0; t < seen.size(); t++)
+		oCHECK(seen[t] == 1, "triangle %u is in %u leaves", t, seen[t]);
+
+	const mesh::bvh_node* nodes = b.nodes();
+	for (uint i = 0; i < b.num_nodes(); i++)
+		if (!nodes[i].count)
+			for (uint c = nodes[i].offset; c < nodes[i].offset + 2; c++)
+				oCHECK(all(nodes[c].box_min >= nodes[i].box_min) && all(nodes[c].box_max <= nodes[i].box_max), "node %u isn't inside its parent %u", c, i);
+
+	// rays from around the model towards its middle
+	const float3 center = oi.mesh_info.local_space_bound.center();
+	const float radius = length(oi.mesh_info.local_space_bound.size());
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> random(-1.0f, 1.0f);
+	static const uint kNumRays = 256;
+	std::vector<mesh::ray> rays(kNumRays);
+	for (mesh::ray& r : rays)
+	{
+		const float3 origin = center + float3(random(rng), random(rng), random(rng)) * radius;
+		const float3 target = center + float3(random(rng), random(rng), random(rng)) * (radius * 0.2f);
+		r = mesh::ray(origin, target - origin);
+	}
+
+	std::vector<mesh::ray_hit> hits(kNumRays);
+	b.intersect(rays.data(), kNumRays, hits.data());
+	std::unique_ptr<bool[]> occluded(new bool[kNumRays]);
+	b.occluded(rays.data(), kNumRays, occluded.get());
+
+	uint nHits = 0;
+	for (uint i = 0; i < kNumRays; i++)
+	{
+		const mesh::ray_hit expected = brute_force(rays[i], oi.indices, nIndices, oi.positions);
+		const mesh::ray_hit single = b.intersect(rays[i]);
+		oCHECK(same_hit(single, expected), "ray %u hit triangle %u, expected %u", i, single.triangle, expected.triangle);
+		oCHECK(same_hit(hits[i], expected), "packet ray %u hit triangle %u, expected %u", i, hits[i].triangle, expected.triangle);
+		oCHECK(occluded[i] == (expected.triangle != invalid) && b.occluded(rays[i]) == occluded[i], "ray %u occlusion is wrong", i);
+		if (expected.triangle != invalid)
+			nHits++;
+	}
+
+	oCHECK(nHits > 0, "no rays hit %s", kSource);
+
+	// box query against every triangle's box
+	const float3 box_min = center - radius * 0.1f;
+	const float3 box_max = center + radius * 0.1f;
+	std::vector<uint> found;
+	b.query(box_min, box_max, found);
+	uint nExpected = 0;
+	for (uint i = 0; i < nIndices; i += 3)
+	{
+		const float3& v0 = oi.positions[oi.indices[i]];
+		const float3& v1 = oi.positions[oi.indices[i+1]];
+		const float3& v2 = oi.positions[oi.indices[i+2]];
+		if (all(min(v0, min(v1, v2)) <= box_max) && all(max(v0, max(v1, v2)) >= box_min))
+			nExpected++;
+	}
+	oCHECK(found.size() == nExpected, "box query found %u triangles, expected %u", uint(found.size()), nExpected);
+
+	sstring duration;
+	format_duration(duration, seconds, true);
+	_Services.report("%s: %u nodes over %u triangles built in %s, %u/%u rays hit", kSource, b.num_nodes(), nIndices / 3, duration.c_str(), nHits, kNumRays);
+}
+
+	}
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/cleanup.h>
+#include <oMesh/obj.h>
+#include <oBase/throw.h>
+#include <oBase/timer.h>
+#include <vector>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+static void test_degenerates()
+{
+	static const float3 kPositions[] =
+	{
+		float3(0.0f, 0.0f, 0.0f), float3(1.0f, 0.0f, 0.0f), float3(1.0f, 1.0f, 0.0f), float3(2.0f, 0.0f, 0.0f),
+	};
+
+	// a good triangle, a point, a line, a good triangle
+	ushort indices[] = { 0, 1, 2, 0, 0, 0, 0, 1, 3, 2, 1, 3, };
+	uint n = 0;
+	mesh::remove_degenerates(kPositions, oCOUNTOF(kPositions), indices, oCOUNTOF(indices), &n);
+	oCHECK(n == 6, "expected 6 indices after remove_degenerates, got %u", n);
+	oCHECK(indices[3] == 2 && indices[4] == 1 && indices[5] == 3, "remove_degenerates didn't keep triangle order");
+}
+
+// each quad of an n x n grid gets its own 4 vertices so welding should leave
+// (n+1)^2 vertices
+static void test_weld()
+{
+	static const uint kSize = 64;
+	std::vector<float3> positions;
+	std::vector<uint> indices;
+	for (uint y = 0; y < kSize; y++)
+		for (uint x = 0; x < kSize; x++)
+		{
+			const uint base = uint(positions.size());
+			const float jitter = 0.00001f * ((x + y) % 3);
+			positions.push_back(float3(x + jitter, float(y), 0.0f));
+			positions.push_back(float3(x + 1.0f, y + jitter, 0.0f));
+			positions.push_back(float3(x + 1.0f, y + 1.0f, 0.0f));
+			positions.push_back(float3(float(x), y + 1.0f, 0.0f));
+			const uint quad[] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+
+	std::vector<uint> remap(positions.size());
+	const uint nUnique = mesh::weld_vertices(remap.data(), positions.data(), sizeof(float3), uint(positions.size()), 0.001f);
+	oCHECK(nUnique == (kSize + 1) * (kSize + 1), "welding a %ux%u grid left %u vertices", kSize, kSize, nUnique);
+	for (uint v = 0; v < remap.size(); v++)
+		oCHECK(remap[v] <= v && remap[remap[v]] == remap[v], "vertex %u welded to a non-representative", v);
+
+	mesh::remap_indices(indices.data(), uint(indices.size()), remap.data());
+	const uint nIndices = mesh::remove_collapsed_triangles(indices.data(), uint(indices.size()));
+	oCHECK(nIndices == indices.size(), "welding shouldn't have collapsed any triangles");
+
+	std::vector<mesh::edge> edges(nIndices);
+	const uint nEdges = mesh::calc_edges(indices.data(), nIndices, edges.data());
+	uint nBorder = 0;
+	for (uint e = 0; e < nEdges; e++)
+		if (edges[e].triangle[1] == invalid)
+			nBorder++;
+	oCHECK(nEdges == 2 * kSize * (kSize + 1) + kSize * kSize, "welded grid has %u edges", nEdges);
+	oCHECK(nBorder == 4 * kSize, "welded grid has %u border edges", nBorder);
+}
+
+// vertices 1e-6 apart on either side of a cell boundary must still weld
+static void test_weld_across_cells()
+{
+	static const float kTolerance = 0.001f;
+	static const float kBoundaries[] = { 0.0f, kTolerance * 0.5f, kTolerance, 1.0f, -1.0f };
+	std::vector<float3> positions;
+	for (uint i = 0; i < oCOUNTOF(kBoundaries); i++)
+	{
+		const float y = 10.0f * (i + 1);
+		positions.push_back(float3(kBoundaries[i] - 0.5e-6f, y, 0.0f));
+		positions.push_back(float3(kBoundaries[i] + 0.5e-6f, y, 0.0f));
+		positions.push_back(float3(y, kBoundaries[i] + 0.5e-6f, kBoundaries[i] - 0.5e-6f));
+		positions.push_back(float3(y, kBoundaries[i] - 0.5e-6f, kBoundaries[i] + 0.5e-6f));
+	}
+
+	std::vector<uint> remap(positions.size());
+	const uint nUnique = mesh::weld_vertices(remap.data(), positions.data(), sizeof(float3), uint(positions.size()), kTolerance);
+	oCHECK(nUnique == positions.size() / 2, "welding %u pairs across cell boundaries left %u vertices", uint(positions.size() / 2), nUnique);
+	for (uint v = 0; v < remap.size(); v += 2)
+		oCHECK(remap[v] == v && remap[v + 1] == v, "vertex %u didn't weld to vertex %u across a cell boundary", v + 1, v);
+}
+
+static void test_connectivity(test_services& _Services, const char* _Path)
+{
+	std::shared_ptr<mesh::obj::mesh> obj = load_test_obj(_Services, _Path);
+	const mesh::obj::info oi = obj->get_info();
+	const uint nIndices = oi.mesh_info.num_indices;
+
+	double start = timer::now();
+	std::vector<mesh::edge> edges(nIndices);
+	const uint nEdges = mesh::calc_edges(oi.indices, nIndices, edges.data());
+	std::vector<uint> adjacency(nIndices);
+	mesh::calc_adjacency(oi.indices, nIndices, adjacency.data());
+	const double seconds = timer::now() - start;
+
+	for (uint e = 0; e < nEdges; e++)
+	{
+		const mesh::edge& edge = edges[e];
+		oCHECK(edge.vertex[0] < edge.vertex[1], "%s: edge %u isn't ordered", _Path, e);
+		oCHECK(e == 0 || edges[e-1].vertex[0] < edge.vertex[0] || (edges[e-1].vertex[0] == edge.vertex[0] && edges[e-1].vertex[1] < edge.vertex[1]), "%s: edge %u is out of order or repeated", _Path, e);
+	}
+
+	uint nBorder = 0;
+	for (uint i = 0; i < nIndices; i++)
+	{
+		const uint other = adjacency[i];
+		if (other == invalid)
+		{
+			nBorder++;
+			continue;
+		}
+
+		const uint* tri = oi.indices + other * 3;
+		const uint triangle = i / 3;
+		oCHECK(adjacency[other * 3] == triangle || adjacency[other * 3 + 1] == triangle || adjacency[other * 3 + 2] == triangle, "%s: adjacency of triangle %u isn't symmetric", _Path, triangle);
+
+		const uint a = oi.indices[i];
+		const uint b = oi.indices[triangle * 3 + (i % 3 + 1) % 3];
+		oCHECK((tri[0] == a || tri[1] == a || tri[2] == a) && (tri[0] == b || tri[1] == b || tri[2] == b), "%s: triangle %u doesn't share edge %u", _Path, other, i);
+	}
+
+	sstring duration;
+	format_duration(duration, seconds, true);
+	_Services.report("%s: %u edges, %u open, from %u triangles in %s", _Path, nEdges, nBorder, nIndices / 3, duration.c_str());
+}
+
+void TESTcleanup(test_services& _Services)
+{
+	test_degenerates();
+	test_weld();
+	test_weld_across_cells();
+	test_connectivity(_Services, "Test/Geometry/buddha.obj");
+}
+
+	}
+}
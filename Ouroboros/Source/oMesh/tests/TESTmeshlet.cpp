@@ -0,0 +1,106 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/meshlet.h>
+#include <oMesh/obj.h>
+#include <oMesh/optimize.h>
+#include <oBase/throw.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+void TESTmeshlet(test_services& _Services)
+{
+	static const char* kSource = "Test/Geometry/hunter.obj";
+	std::shared_ptr<mesh::model> m = load_test_model(_Services, kSource);
+	mesh::optimize(*m);
+
+	const mesh::model_info mi = m->get_info();
+	const mesh::model_subset* subsets = m->subsets();
+	const uint* indices = m->indices32();
+	const bool has16 = mesh::has_16bit_indices(mi.num_vertices);
+
+	uint stride = 0;
+	const float3* positions = mesh::find_positions(*m, &stride);
+	auto position = [&](uint v) -> const float3& { return *(const float3*)byte_add(positions, stride, v); };
+
+	mesh::meshlet_options o;
+	std::shared_ptr<mesh::meshlet_set> ms = mesh::make_meshlets(*m, o);
+	const mesh::meshlet_set_info si = ms->get_info();
+	oCHECK(si.num_subsets == mi.num_subsets && si.num_triangles == mi.num_indices / 3, "meshlets don't cover the model");
+
+	const mesh::meshlet* meshlets = ms->meshlets();
+	const mesh::meshlet_bounds* bounds = ms->bounds();
+	const uint* vertices = ms->vertices();
+	const uchar* triangles = ms->triangles();
+
+	uint nCullable = 0;
+	for (uint subset = 0; subset < mi.num_subsets; subset++)
+	{
+		// the meshlets of a subset reproduce its triangles in order
+		const mesh::meshlet_range& r = ms->ranges()[subset];
+		uint index = subsets[subset].start_index;
+		for (uint i = r.start_meshlet; i < r.start_meshlet + r.num_meshlets; i++)
+		{
+			const mesh::meshlet& ml = meshlets[i];
+			const mesh::meshlet_bounds& b = bounds[i];
+			oCHECK(ml.num_vertices <= o.max_vertices && ml.num_triangles <= o.max_triangles, "meshlet %u is too big", i);
+
+			for (uint t = 0; t < ml.num_triangles * 3u; t++, index++)
+			{
+				const uint local = triangles[ml.triangle_offset + t];
+				oCHECK(local < ml.num_vertices, "meshlet %u has a local index out of range", i);
+				const uint expected = has16 ? ((const ushort*)indices)[index] : indices[index];
+				oCHECK(vertices[ml.vertex_offset + local] == expected, "meshlet %u doesn't match the subset's indices", i);
+			}
+
+			const float slop = 0.0001f * b.sphere.radius() + 0.000001f;
+			for (uint v = 0; v < ml.num_vertices; v++)
+			{
+				const float3& p = position(vertices[ml.vertex_offset + v]);
+				oCHECK(all(p >= b.box_min) && all(p <= b.box_max), "meshlet %u box doesn't contain its vertices", i);
+				oCHECK(length(p - b.sphere.xyz()) <= b.sphere.radius() + slop, "meshlet %u sphere doesn't contain its vertices", i);
+			}
+
+			if (b.cone_cutoff >= 1.0f)
+				continue;
+
+			// from inside the cone every triangle is seen from behind
+			nCullable++;
+			const float3 eye = b.cone_apex - b.cone_axis * (b.sphere.radius() * 3.0f + 1.0f);
+			oCHECK(mesh::backfacing(eye, b), "meshlet %u should be backfacing from its cone", i);
+			for (uint t = 0; t < ml.num_triangles; t++)
+			{
+				const uchar* tri = triangles + ml.triangle_offset + t * 3;
+				const float3& a = position(vertices[ml.vertex_offset + tri[0]]);
+				const float3 n = cross(position(vertices[ml.vertex_offset + tri[1]]) - a, position(vertices[ml.vertex_offset + tri[2]]) - a);
+				oCHECK(dot(a - eye, n) >= -0.0001f * length(n) * length(a - eye), "meshlet %u triangle %u faces an eye in its cone", i, t);
+			}
+		}
+
+		oCHECK(index == subsets[subset].start_index + subsets[subset].num_indices, "subset %u isn't fully covered", subset);
+	}
+
+	// a frustum around everything culls nothing, one in front of everything culls all
+	oFrustumf f;
+	f.Left = planef(float3(1.0f, 0.0f, 0.0f), 1e6f);
+	f.Right = planef(float3(-1.0f, 0.0f, 0.0f), 1e6f);
+	f.Top = planef(float3(0.0f, -1.0f, 0.0f), 1e6f);
+	f.Bottom = planef(float3(0.0f, 1.0f, 0.0f), 1e6f);
+	f.Near = planef(float3(0.0f, 0.0f, 1.0f), 1e6f);
+	f.Far = planef(float3(0.0f, 0.0f, -1.0f), 1e6f);
+	for (uint i = 0; i < si.num_meshlets; i++)
+		oCHECK(!mesh::outside(f, bounds[i]), "meshlet %u is outside a frustum containing it", i);
+
+	f.Near = planef(float3(0.0f, 0.0f, 1.0f), -1e6f);
+	for (uint i = 0; i < si.num_meshlets; i++)
+		oCHECK(mesh::outside(f, bounds[i]), "meshlet %u is inside a frustum beyond it", i);
+
+	_Services.report("%s: %u meshlets averaging %.1f triangles, %u backface cullable", kSource, si.num_meshlets, si.num_triangles / float(si.num_meshlets), nCullable);
+}
+
+	}
+}
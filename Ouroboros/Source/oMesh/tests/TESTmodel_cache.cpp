@@ -0,0 +1,97 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/model_cache.h>
+#include <oBase/throw.h>
+#include <oBase/timer.h>
+#include <oCore/filesystem.h>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+static void test_equal(const mesh::model& expected, const mesh::model& m)
+{
+	const mesh::model_info ei = expected.get_info();
+	const mesh::model_info i = m.get_info();
+	oCHECK(ei.num_vertices == i.num_vertices && ei.num_indices == i.num_indices && ei.num_subsets == i.num_subsets, "model counts differ");
+	oCHECK(!memcmp(expected.subsets(), m.subsets(), sizeof(mesh::model_subset) * i.num_subsets), "subsets differ");
+
+	for (uint slot = 0; slot < mesh::max_num_slots; slot++)
+	{
+		const uint size = mesh::calc_vertex_size(i.elements, slot) * i.num_vertices;
+		oCHECK(!size || !memcmp(expected.vertices(slot), m.vertices(slot), size), "vertex slot %u differs", slot);
+	}
+
+	oCHECK(!memcmp(expected.indices(), m.indices(), mesh::index_size(i.num_vertices) * i.num_indices), "indices differ");
+
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+	{
+		oCHECK(!strcmp(expected.material_name(subset), m.material_name(subset)), "material name %u differs", subset);
+		oCHECK(expected.material_hash(subset) == m.material_hash(subset), "material hash %u differs", subset);
+	}
+}
+
+void TESTmodel_cache(test_services& _Services)
+{
+	static const char* kSource = "Test/Geometry/hunter.obj";
+	const mesh::obj::init init = test_obj_init();
+	scoped_allocation text;
+	std::shared_ptr<mesh::obj::mesh> obj = load_test_obj(_Services, kSource, init, &text);
+	std::shared_ptr<mesh::model> built = mesh::make_model(obj->get_info());
+	const uint128 hash = mesh::calc_source_hash(text, text.size(), init);
+
+	// round-trip in memory, both placed in the file and decompressed
+	{
+		scoped_allocation file = built->save(hash);
+		scoped_allocation decompressed;
+		mesh::model* placed = mesh::model::load(file, file.size(), hash, &decompressed);
+		oCHECK(!decompressed && (void*)placed > (void*)file && (void*)placed < (void*)((char*)file + file.size()), "uncompressed model should be used in place");
+		test_equal(*built, *placed);
+
+		scoped_allocation compressed = built->save(hash, mesh::model_compression::snappy);
+		mesh::model* m = mesh::model::load(compressed, compressed.size(), hash, &decompressed);
+		oCHECK(decompressed, "compressed model should be decompressed");
+		test_equal(*built, *m);
+		_Services.report("model file %.1f KB, %.1f KB with snappy", file.size() / 1024.0, compressed.size() / 1024.0);
+
+		bool threw = false;
+		try { mesh::model::load(file, file.size(), uint128(0, 1), &decompressed); }
+		catch (std::exception&) { threw = true; }
+		oCHECK(threw, "a model built from other source should be rejected");
+	}
+
+	// the first load builds, the next is served from the cache
+	{
+		path_string root;
+		_Services.test_root_path(root, root.capacity());
+		const path obj_path = path(root) / path(kSource);
+
+		mesh::model_cache cache(filesystem::temp_path() / path("model_cache"));
+		const path cached = cache.cache_path(hash);
+		if (filesystem::exists(cached))
+			filesystem::remove_filename(cached);
+
+		bool from_cache = true;
+		double start = timer::now();
+		std::shared_ptr<mesh::model> first = cache.load_obj(obj_path, init, &from_cache);
+		const double BuildTime = timer::now() - start;
+		oCHECK(!from_cache && filesystem::exists(cached), "first load should build and save %s", cached.c_str());
+
+		start = timer::now();
+		std::shared_ptr<mesh::model> second = cache.load_obj(obj_path, init, &from_cache);
+		const double CachedTime = timer::now() - start;
+		oCHECK(from_cache, "second load should come from the cache");
+
+		test_equal(*built, *first);
+		test_equal(*built, *second);
+
+		sstring build, cached_time;
+		format_duration(build, BuildTime, true);
+		format_duration(cached_time, CachedTime, true);
+		_Services.report("%s: built in %s, cached load in %s", kSource, build.c_str(), cached_time.c_str());
+	}
+}
+
+	}
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/mesh.h>
+#include <oMesh/obj.h>
+#include <oBase/throw.h>
+#include <oBase/timer.h>
+#include <oHLSL/oHLSLMath.h>
+#include <vector>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+// a flat grid has the same normal and tangent everywhere
+static void test_plane()
+{
+	static const uint kSize = 32;
+	std::vector<float3> positions;
+	std::vector<float2> texcoords;
+	std::vector<uint> indices;
+	for (uint y = 0; y <= kSize; y++)
+		for (uint x = 0; x <= kSize; x++)
+		{
+			positions.push_back(float3(float(x), float(y), 0.0f));
+			texcoords.push_back(float2(x / float(kSize), y / float(kSize)));
+		}
+
+	for (uint y = 0; y < kSize; y++)
+		for (uint x = 0; x < kSize; x++)
+		{
+			const uint a = y * (kSize + 1) + x;
+			const uint quad[] = { a, a + 1, a + kSize + 2, a, a + kSize + 2, a + kSize + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+
+	const uint nVertices = uint(positions.size());
+	std::vector<float3> normals(nVertices);
+	mesh::calc_vertex_normals(normals.data(), indices.data(), uint(indices.size()), positions.data(), nVertices);
+
+	std::vector<float4> tangents(nVertices);
+	mesh::calc_vertex_tangents(tangents.data(), indices.data(), uint(indices.size()), positions.data(), normals.data(), texcoords.data(), nVertices);
+
+	for (uint v = 0; v < nVertices; v++)
+	{
+		oCHECK(abs(normals[v].z) > 0.9999f, "vertex %u normal isn't perpendicular to the plane", v);
+		oCHECK(tangents[v].x > 0.9999f && abs(tangents[v].w) == 1.0f, "vertex %u tangent doesn't follow u", v);
+	}
+}
+
+void TESTnormals(test_services& _Services)
+{
+	test_plane();
+
+	static const char* kSource = "Test/Geometry/buddha.obj";
+	std::shared_ptr<mesh::obj::mesh> obj = load_test_obj(_Services, kSource);
+	const mesh::obj::info oi = obj->get_info();
+	const uint nVertices = oi.mesh_info.num_vertices;
+	const uint nIndices = oi.mesh_info.num_indices;
+
+	std::vector<float3> normals(nVertices);
+	double start = timer::now();
+	mesh::calc_vertex_normals(normals.data(), oi.indices, nIndices, oi.positions, nVertices);
+	const double seconds = timer::now() - start;
+
+	std::vector<bool> referenced(nVertices, false);
+	for (uint i = 0; i < nIndices; i++)
+		referenced[oi.indices[i]] = true;
+
+	for (uint v = 0; v < nVertices; v++)
+		oCHECK(!referenced[v] || dot(normals[v], normals[v]) == 0.0f || abs(length(normals[v]) - 1.0f) < 0.0001f, "%s: vertex %u normal isn't unit length", kSource, v);
+
+	// every triangle should face roughly the same way as its vertices
+	std::vector<float3> faceNormals(nIndices / 3);
+	mesh::calc_face_normals(faceNormals.data(), oi.indices, nIndices, oi.positions, nVertices);
+	uint nFlipped = 0;
+	for (uint t = 0; t < nIndices / 3; t++)
+		for (uint k = 0; k < 3; k++)
+			if (dot(faceNormals[t], normals[oi.indices[t*3+k]]) < 0.0f)
+				nFlipped++;
+	oCHECK(nFlipped < nIndices / 100, "%s: %u corners face away from their vertex normal", kSource, nFlipped);
+
+	sstring duration;
+	format_duration(duration, seconds, true);
+	_Services.report("%s: normals for %u vertices in %s", kSource, nVertices, duration.c_str());
+}
+
+	}
+}
@@ -15,19 +15,16 @@
 namespace ouro {
 	namespace tests {
 
-static void test_correctness(const std::shared_ptr<obj_test>& _Expected, const std::shared_ptr<mesh::obj::mesh>& _OBJ)
+static void test_correctness(const mesh::obj::info& expectedInfo, const mesh::obj::info& objInfo)
 {
-	mesh::obj::info expectedInfo = _Expected->get_info();
-	mesh::obj::info objInfo = _OBJ->get_info();
-
 	oCHECK(!strcmp(expectedInfo.mtl_path, objInfo.mtl_path), "MaterialLibraryPath \"%s\" (should be %s) does not match in obj file \"%s\"", objInfo.mtl_path.c_str(), expectedInfo.mtl_path.c_str(), objInfo.obj_path.c_str());
 	
 	oCHECK(expectedInfo.mesh_info.num_vertices == objInfo.mesh_info.num_vertices, "Position counts do not match in obj file \"%s\"", objInfo.obj_path.c_str());
 	for (uint i = 0; i < objInfo.mesh_info.num_vertices; i++)
 	{
 		oCHECK(equal(expectedInfo.positions[i], objInfo.positions[i]), "Position %u does not match in obj file \"%s\"", i, objInfo.obj_path.c_str());
-		oCHECK(equal(expectedInfo.normals[i], objInfo.normals[i]), "Normal %u does not match in obj file \"%s\"", i, objInfo.obj_path.c_str());
-		oCHECK(equal(expectedInfo.texcoords[i], objInfo.texcoords[i]), "Texcoord %u does not match in obj file \"%s\"", i, objInfo.obj_path.c_str());
+		oCHECK(!expectedInfo.normals == !objInfo.normals && (!objInfo.normals || equal(expectedInfo.normals[i], objInfo.normals[i])), "Normal %u does not match in obj file \"%s\"", i, objInfo.obj_path.c_str());
+		oCHECK(!expectedInfo.texcoords == !objInfo.texcoords && (!objInfo.texcoords || equal(expectedInfo.texcoords[i], objInfo.texcoords[i])), "Texcoord %u does not match in obj file \"%s\"", i, objInfo.obj_path.c_str());
 	}
 	
 	oCHECK(expectedInfo.mesh_info.num_indices == objInfo.mesh_info.num_indices, "Index counts do not match in obj file \"%s\"", objInfo.obj_path.c_str());
@@ -44,17 +41,24 @@ static void test_correctness(const std::shared_ptr<obj_test>& _Expected, const s
 	}
 }
 
-static void obj_load(test_services& _Services, const char* _Path, double* _pLoadTime = nullptr)
+static std::shared_ptr<mesh::obj::mesh> obj_load(test_services& _Services, const char* _Path, uint _ParseChunkSize = mesh::obj::init().parse_chunk_size, double* _pLoadTime = nullptr, double* _pParseTime = nullptr, size_t* _pSize = nullptr)
 {
 	double start = timer::now();
 	scoped_allocation b = _Services.load_buffer(_Path);
 
 	mesh::obj::init init;
 	init.calc_normals_on_error = false; // buddha doesn't have normals and is 300k faces... let's not sit in the test suite calculating such a large test case
-	std::shared_ptr<mesh::obj::mesh> obj = mesh::obj::mesh::make(init, _Path, b);
+	init.parse_chunk_size = _ParseChunkSize;
+	double parse_start = timer::now();
+	std::shared_ptr<mesh::obj::mesh> obj = mesh::obj::mesh::make(init, _Path, b, b.size());
 
 	if (_pLoadTime)
 		*_pLoadTime = timer::now() - start;
+	if (_pParseTime)
+		*_pParseTime = timer::now() - parse_start;
+	if (_pSize)
+		*_pSize = b.size();
+	return obj;
 }
 
 void TESTobj(test_services& _Services)
@@ -63,23 +67,27 @@ void TESTobj(test_services& _Services)
 	{
 		std::shared_ptr<obj_test> test = obj_test::make(obj_test::cube);
 		std::shared_ptr<mesh::obj::mesh> obj = mesh::obj::mesh::make(mesh::obj::init(), "Correctness (cube) obj", test->file_contents());
-		test_correctness(test, obj);
+		test_correctness(test->get_info(), obj->get_info());
 	}
 
-	// Support for negative indices
+	// Support for negative indices, and chunks must merge to the same mesh 
+	// however the text is split
 	{
-		obj_load(_Services, "Test/Geometry/hunter.obj");
+		std::shared_ptr<mesh::obj::mesh> obj = obj_load(_Services, "Test/Geometry/hunter.obj");
+		std::shared_ptr<mesh::obj::mesh> chunked = obj_load(_Services, "Test/Geometry/hunter.obj", 4096);
+		test_correctness(obj->get_info(), chunked->get_info());
 	}
 
 	// Performance
 	{
 		static const char* BenchmarkFilename = "Test/Geometry/buddha.obj";
-		double LoadTime = 0.0;
-		obj_load(_Services, BenchmarkFilename, &LoadTime);
+		double LoadTime = 0.0, ParseTime = 0.0;
+		size_t Size = 0;
+		obj_load(_Services, BenchmarkFilename, mesh::obj::init().parse_chunk_size, &LoadTime, &ParseTime, &Size);
 
 		sstring time;
 		format_duration(time, LoadTime, true);
-		_Services.report("%s to load benchmark file %s", time.c_str(), BenchmarkFilename);
+		_Services.report("%s to load benchmark file %s (parse %.1f MB/s)", time.c_str(), BenchmarkFilename, Size / (1024.0 * 1024.0 * ParseTime));
 	}
 }
 
@@ -0,0 +1,151 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/optimize.h>
+#include <oMesh/obj.h>
+#include <oBase/throw.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+typedef std::array<uint, 3> triangle;
+
+// rotates each triangle to start at its smallest index so winding is kept
+static std::vector<triangle> sorted_triangles(const uint* indices, uint num_indices)
+{
+	std::vector<triangle> t(num_indices / 3);
+	for (uint i = 0; i < num_indices; i += 3)
+	{
+		const uint* tri = indices + i;
+		const uint first = tri[1] < tri[0] ? (tri[2] < tri[1] ? 2 : 1) : (tri[2] < tri[0] ? 2 : 0);
+		triangle& r = t[i / 3];
+		r[0] = tri[first];
+		r[1] = tri[(first + 1) % 3];
+		r[2] = tri[(first + 2) % 3];
+	}
+
+	std::sort(t.begin(), t.end());
+	return t;
+}
+
+static void test_obj(test_services& _Services, const char* _Path)
+{
+	std::shared_ptr<mesh::obj::mesh> obj = load_test_obj(_Services, _Path);
+	const mesh::obj::info oi = obj->get_info();
+	const uint nIndices = oi.mesh_info.num_indices;
+	const uint nVertices = oi.mesh_info.num_vertices;
+
+	std::vector<uint> indices(oi.indices, oi.indices + nIndices);
+	const std::vector<triangle> expected = sorted_triangles(indices.data(), nIndices);
+	const mesh::vertex_cache_stats before = mesh::calc_vertex_cache_stats(indices.data(), nIndices, nVertices);
+
+	mesh::optimize_vertex_cache(indices.data(), nIndices, nVertices);
+	const mesh::vertex_cache_stats cached = mesh::calc_vertex_cache_stats(indices.data(), nIndices, nVertices);
+	oCHECK(cached.acmr <= before.acmr, "%s: vertex cache optimization made ACMR worse (%.3f -> %.3f)", _Path, before.acmr, cached.acmr);
+	oCHECK(sorted_triangles(indices.data(), nIndices) == expected, "%s: vertex cache optimization changed the triangles", _Path);
+
+	const float kThreshold = 1.05f;
+	mesh::optimize_overdraw(indices.data(), nIndices, oi.positions, sizeof(float3), nVertices, kThreshold);
+	const mesh::vertex_cache_stats sorted = mesh::calc_vertex_cache_stats(indices.data(), nIndices, nVertices);
+	oCHECK(sorted_triangles(indices.data(), nIndices) == expected, "%s: overdraw optimization changed the triangles", _Path);
+	oCHECK(sorted.acmr <= before.acmr, "%s: overdraw optimization made ACMR worse than unoptimized (%.3f -> %.3f)", _Path, before.acmr, sorted.acmr);
+
+	std::vector<uint> remap(nVertices);
+	std::vector<uint> fetched(indices);
+	const uint nReferenced = mesh::optimize_vertex_fetch(fetched.data(), nIndices, nVertices, remap.data());
+	oCHECK(nReferenced <= nVertices, "%s: more vertices referenced than exist", _Path);
+
+	std::vector<float3> positions(nVertices);
+	mesh::remap_vertices(positions.data(), oi.positions, sizeof(float3), nVertices, remap.data());
+	uint next = 0;
+	for (uint i = 0; i < nIndices; i++)
+	{
+		oCHECK(fetched[i] <= next, "%s: vertex %u is not in first-use order", _Path, fetched[i]);
+		next = std::max(next, fetched[i] + 1);
+		oCHECK(!memcmp(&positions[fetched[i]], &oi.positions[indices[i]], sizeof(float3)), "%s: remapped vertex %u differs", _Path, fetched[i]);
+	}
+
+	_Services.report("%s: ACMR %.3f -> %.3f (%.3f with overdraw), ATVR %.3f -> %.3f", _Path, before.acmr, cached.acmr, sorted.acmr, before.atvr, sorted.atvr);
+}
+
+// triangles of a model subset as positions since vertices are renumbered
+typedef std::array<float, 9> position_triangle;
+static std::vector<position_triangle> subset_triangles(const mesh::model& m, uint subset)
+{
+	const mesh::model_info i = m.get_info();
+	const mesh::model_subset& ss = m.subsets()[subset];
+	const bool Is16 = mesh::has_16bit_indices(i.num_vertices);
+
+	std::vector<uint> indices(ss.num_indices);
+	for (uint n = 0; n < ss.num_indices; n++)
+		indices[n] = Is16 ? m.indices()[ss.start_index + n] : m.indices32()[ss.start_index + n];
+
+	const float3* positions = (const float3*)m.vertices(0);
+	std::vector<position_triangle> result;
+	for (const triangle& t : sorted_triangles(indices.data(), ss.num_indices))
+	{
+		position_triangle p;
+		for (uint k = 0; k < 3; k++)
+			memcpy(&p[k*3], &positions[t[k]], sizeof(float3));
+		result.push_back(p);
+	}
+
+	// vertex order no longer matches, so rotate to the smallest position
+	for (position_triangle& p : result)
+	{
+		const position_triangle q = p;
+		uint first = 0;
+		for (uint k = 1; k < 3; k++)
+			if (std::lexicographical_compare(&q[k*3], &q[k*3+3], &q[first*3], &q[first*3+3]))
+				first = k;
+		for (uint k = 0; k < 9; k++)
+			p[k] = q[(first*3 + k) % 9];
+	}
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+static void test_model(test_services& _Services, const char* _Path)
+{
+	std::shared_ptr<mesh::model> m = load_test_model(_Services, _Path);
+	const mesh::model_info i = m->get_info();
+
+	std::vector<std::vector<position_triangle>> expected(i.num_subsets);
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+		expected[subset] = subset_triangles(*m, subset);
+
+	const mesh::optimize_stats s = mesh::optimize(*m);
+	oCHECK(s.after.acmr <= s.before.acmr, "%s: model ACMR got worse (%.3f -> %.3f)", _Path, s.before.acmr, s.after.acmr);
+
+	for (uint subset = 0; subset < i.num_subsets; subset++)
+	{
+		const mesh::model_subset& ss = m->subsets()[subset];
+		if (!ss.num_indices)
+			continue;
+
+		uint min_vertex = 0, max_vertex = 0;
+		if (mesh::has_16bit_indices(i.num_vertices))
+			mesh::calc_min_max_indices(m->indices(), ss.start_index, ss.num_indices, i.num_vertices, &min_vertex, &max_vertex);
+		else
+			mesh::calc_min_max_indices(m->indices32(), ss.start_index, ss.num_indices, i.num_vertices, &min_vertex, &max_vertex);
+		oCHECK(ss.start_vertex == min_vertex && ss.num_vertices == max_vertex - min_vertex + 1, "%s: subset %u vertex range is stale", _Path, subset);
+		oCHECK(subset_triangles(*m, subset) == expected[subset], "%s: subset %u triangles changed", _Path, subset);
+	}
+
+	_Services.report("%s model: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", _Path, s.before.acmr, s.after.acmr, s.before.atvr, s.after.atvr);
+}
+
+void TESToptimize(test_services& _Services)
+{
+	test_obj(_Services, "Test/Geometry/hunter.obj");
+	test_obj(_Services, "Test/Geometry/buddha.obj");
+	test_model(_Services, "Test/Geometry/hunter.obj");
+}
+
+	}
+}
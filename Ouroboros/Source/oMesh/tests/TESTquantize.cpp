@@ -0,0 +1,109 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/quantize.h>
+#include <oMesh/obj.h>
+#include <oBase/throw.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oMemory/byte.h>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+static void test_octahedral()
+{
+	static const float3 kNormals[] =
+	{
+		float3(1.0f, 0.0f, 0.0f), float3(-1.0f, 0.0f, 0.0f),
+		float3(0.0f, 1.0f, 0.0f), float3(0.0f, -1.0f, 0.0f),
+		float3(0.0f, 0.0f, 1.0f), float3(0.0f, 0.0f, -1.0f),
+		normalize(float3(1.0f, 1.0f, 1.0f)), normalize(float3(-1.0f, 2.0f, -3.0f)),
+	};
+
+	for (const float3& n : kNormals)
+	{
+		const float3 d = mesh::decode_octahedral(mesh::encode_octahedral(n));
+		oCHECK(dot(n, d) > 0.99999f, "octahedral round-trip of (%.3f, %.3f, %.3f) gave (%.3f, %.3f, %.3f)", n.x, n.y, n.z, d.x, d.y, d.z);
+	}
+}
+
+// returns the element index for semantic or invalid
+static uint find_element(const mesh::element_array& elements, const surface::semantic& s)
+{
+	for (uint e = 0; e < mesh::max_num_elements; e++)
+		if (elements[e].semantic() == s)
+			return e;
+	return invalid;
+}
+
+template<typename T>
+static const T& vertex(const mesh::model& m, uint e, uint v)
+{
+	const mesh::model_info i = m.get_info();
+	const uint slot = i.elements[e].slot();
+	return *(const T*)byte_add(m.vertices(slot), mesh::calc_offset(i.elements, e) + v * mesh::calc_vertex_size(i.elements, slot));
+}
+
+void TESTquantize(test_services& _Services)
+{
+	test_octahedral();
+
+	static const char* kSource = "Test/Geometry/hunter.obj";
+	std::shared_ptr<mesh::model> m = load_test_model(_Services, kSource, mesh::obj::init()); // with normals
+	const mesh::model_info mi = m->get_info();
+
+	mesh::quantize_options o;
+	mesh::quantize_stats s;
+	std::shared_ptr<mesh::model> q = mesh::quantize(*m, o, &s);
+	const mesh::model_info qi = q->get_info();
+
+	oCHECK(s.vertex_size_after < s.vertex_size_before, "quantization didn't reduce the vertex size (%u bytes)", s.vertex_size_before);
+	oCHECK(s.position_error <= o.position_error && s.normal_error <= o.normal_error && s.texcoord_error <= o.texcoord_error, "quantization exceeded the error budget");
+
+	const uint position = find_element(qi.elements, surface::semantic::vertex_position);
+	oCHECK(qi.elements[position].format() == surface::format::r16g16b16a16_snorm, "positions should be snorm16");
+
+	// extents and bounds describe the model, not the encoding
+	{
+		uint stride = 0;
+		const float3* positions = mesh::find_positions(*m, &stride);
+		const float3 extents = mesh::calc_bound(positions, stride, mi.num_vertices).size() / 2.0f;
+		oCHECK(qi.extents.x == extents.x && qi.extents.y == extents.y && qi.extents.z == extents.z, "extents should be half the bounding box");
+		oCHECK(qi.bounding_sphere.radius() == length(extents), "bounding sphere should enclose the bounding box");
+	}
+
+	const uint normal = find_element(qi.elements, surface::semantic::vertex_normal);
+	oCHECK(normal == invalid || qi.elements[normal].format() == surface::format::r16g16_snorm, "normals should be octahedral snorm16");
+
+	oCHECK(!memcmp(m->subsets(), q->subsets(), sizeof(mesh::model_subset) * mi.num_subsets), "subsets should be unchanged");
+	oCHECK(!memcmp(m->indices(), q->indices(), mesh::index_size(mi.num_vertices) * mi.num_indices), "indices should be unchanged");
+
+	// unpacked values must be within the budget of the originals
+	std::shared_ptr<mesh::model> d = mesh::dequantize(*q);
+	const mesh::model_info di = d->get_info();
+	oCHECK(!memcmp(&di.elements, &mi.elements, sizeof(mi.elements)), "dequantized elements should match the source");
+
+	const float3 size = qi.extents * 2.0f;
+	const float scale = max(size.x, max(size.y, size.z));
+	for (uint v = 0; v < mi.num_vertices; v++)
+	{
+		const float3& expected = vertex<float3>(*m, position, v);
+		const float3& actual = vertex<float3>(*d, position, v);
+		const float3 diff = abs(expected - actual);
+		oCHECK(max(diff.x, max(diff.y, diff.z)) <= o.position_error * scale, "position %u is off by %f", v, max(diff.x, max(diff.y, diff.z)));
+
+		if (normal != invalid)
+		{
+			const float3& en = vertex<float3>(*m, normal, v);
+			const float3& an = vertex<float3>(*d, normal, v);
+			oCHECK(dot(en, en) == 0.0f || degrees(acos(clamp(dot(normalize(en), an), -1.0f, 1.0f))) <= o.normal_error, "normal %u is off by more than %.2f degrees", v, o.normal_error);
+		}
+	}
+
+	_Services.report("%s: %u -> %u bytes per vertex, errors: position %.6f, normal %.4f deg, texcoord %.6f"
+		, kSource, s.vertex_size_before, s.vertex_size_after, s.position_error, s.normal_error, s.texcoord_error);
+}
+
+	}
+}
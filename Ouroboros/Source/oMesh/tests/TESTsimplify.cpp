@@ -0,0 +1,164 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oMesh/simplify.h>
+#include <oMesh/obj.h>
+#include <oBase/throw.h>
+#include <oBase/timer.h>
+#include <oHLSL/oHLSLMath.h>
+#include <cfloat>
+#include <vector>
+
+#include "../../test_services.h"
+#include "obj_test.h"
+
+namespace ouro {
+	namespace tests {
+
+// Real-Time Collision Detection, Ericson, 5.1.5
+static float3 closest_point(const float3& p, const float3& a, const float3& b, const float3& c)
+{
+	const float3 ab = b - a, ac = c - a, ap = p - a;
+	const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return a;
+
+	const float3 bp = p - b;
+	const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+		return b;
+
+	const float vc = d1*d4 - d3*d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return a + ab * (d1 / (d1 - d3));
+
+	const float3 cp = p - c;
+	const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+		return c;
+
+	const float vb = d5*d2 - d1*d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return a + ac * (d2 / (d2 - d6));
+
+	const float va = d3*d6 - d5*d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	const float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Returns the largest distance from a sample of the source vertices to the 
+// simplified surface relative to the mesh's size: a one-sided Hausdorff 
+// distance. (Simplified vertices are source vertices, so the other side is 0.)
+static float calc_deviation(const uint* indices, uint num_indices, const float3* positions, uint num_vertices)
+{
+	static const uint kNumSamples = 1024;
+
+	const float3 size = mesh::calc_bound(positions, sizeof(float3), num_vertices).size();
+	const float scale = max(size.x, max(size.y, size.z));
+
+	float deviation = 0.0f;
+	const uint step = max(1u, num_vertices / kNumSamples);
+	for (uint v = 0; v < num_vertices; v += step)
+	{
+		const float3& p = positions[v];
+		float nearest = FLT_MAX;
+		for (uint i = 0; i < num_indices; i += 3)
+		{
+			const float3 d = p - closest_point(p, positions[indices[i]], positions[indices[i+1]], positions[indices[i+2]]);
+			nearest = min(nearest, dot(d, d));
+		}
+		deviation = max(deviation, sqrt(nearest));
+	}
+
+	return deviation / scale;
+}
+
+static void test_simplify(test_services& _Services, const char* _Path)
+{
+	std::shared_ptr<mesh::obj::mesh> obj = load_test_obj(_Services, _Path);
+	const mesh::obj::info oi = obj->get_info();
+	const uint nIndices = oi.mesh_info.num_indices;
+	const uint nVertices = oi.mesh_info.num_vertices;
+
+	std::vector<uint> dst(nIndices);
+
+	// to a triangle count
+	{
+		const uint target = nIndices / 6 * 3;
+		float error = 0.0f;
+		double start = timer::now();
+		const uint n = mesh::simplify(dst.data(), oi.indices, nIndices, oi.positions, sizeof(float3), nVertices, target, 1.0f, &error);
+		const double seconds = timer::now() - start;
+		oCHECK(n <= target && n > 0 && (n % 3) == 0, "%s: simplified to %u indices, expected %u", _Path, n, target);
+		for (uint i = 0; i < n; i++)
+			oCHECK(dst[i] < nVertices, "%s: index %u out of range", _Path, i);
+
+		sstring duration;
+		format_duration(duration, seconds, true);
+		_Services.report("%s: %u -> %u triangles in %s, error %.4f", _Path, nIndices / 3, n / 3, duration.c_str(), error);
+	}
+
+	// to an error: errors are RMS plane distances, so the worst deviation of the
+	// surface can exceed them, but not by much
+	{
+		static const float kTargetError = 0.01f;
+		static const float kMaxDeviation = 4.0f * kTargetError;
+		float error = 0.0f;
+		const uint n = mesh::simplify(dst.data(), oi.indices, nIndices, oi.positions, sizeof(float3), nVertices, 0, kTargetError, &error);
+		oCHECK(n < nIndices && error <= kTargetError, "%s: error %.4f exceeds %.4f", _Path, error, kTargetError);
+
+		const float deviation = calc_deviation(dst.data(), n, oi.positions, nVertices);
+		oCHECK(deviation <= kMaxDeviation, "%s: surface moved %.4f, more than %.4f", _Path, deviation, kMaxDeviation);
+		_Services.report("%s: %u triangles at error %.4f, deviation %.4f", _Path, n / 3, error, deviation);
+	}
+
+	// nothing to do
+	{
+		const uint n = mesh::simplify(dst.data(), oi.indices, nIndices, oi.positions, sizeof(float3), nVertices, nIndices, 1.0f);
+		oCHECK(n == nIndices && !memcmp(dst.data(), oi.indices, nIndices * sizeof(uint)), "%s: indices should be copied unchanged", _Path);
+	}
+}
+
+static void test_lods(test_services& _Services, const char* _Path)
+{
+	std::shared_ptr<mesh::model> m = load_test_model(_Services, _Path);
+	const mesh::model_info mi = m->get_info();
+
+	mesh::lod_options o;
+	float errors[3];
+	std::shared_ptr<mesh::model> lods = mesh::make_lods(*m, o, errors);
+	const mesh::model_info li = lods->get_info();
+	oCHECK(li.num_vertices == mi.num_vertices && li.num_subsets == mi.num_subsets * 3, "%s: unexpected lod model layout", _Path);
+
+	const mesh::model_subset* subsets = lods->subsets();
+	uint nTriangles[3] = { 0, 0, 0 };
+	for (uint lod = 0; lod < 3; lod++)
+	{
+		const mesh::model_subset_range& r = li.lods[lod].opaque_color;
+		oCHECK(r.start_range == lod * mi.num_subsets && r.num_ranges == mi.num_subsets, "%s: lod %u opaque range is wrong", _Path, lod);
+		for (uint s = r.start_range; s < uint(r.start_range + r.num_ranges); s++)
+		{
+			oCHECK(!strcmp(lods->material_name(s), m->material_name(s - r.start_range)), "%s: lod %u subset %u material differs", _Path, lod, s);
+			nTriangles[lod] += subsets[s].num_indices / 3;
+		}
+
+		if (lod)
+		{
+			oCHECK(nTriangles[lod] <= nTriangles[lod-1], "%s: lod %u has more triangles than lod %u", _Path, lod, lod - 1);
+			oCHECK(errors[lod] <= o.target_error[lod-1], "%s: lod %u error %.4f exceeds %.4f", _Path, lod, errors[lod], o.target_error[lod-1]);
+		}
+	}
+
+	oCHECK(nTriangles[0] == mi.num_indices / 3, "%s: lod 0 should be the source", _Path);
+	_Services.report("%s lods: %u, %u (error %.4f), %u (error %.4f) triangles", _Path, nTriangles[0], nTriangles[1], errors[1], nTriangles[2], errors[2]);
+}
+
+void TESTsimplify(test_services& _Services)
+{
+	test_simplify(_Services, "Test/Geometry/buddha.obj");
+	test_lods(_Services, "Test/Geometry/hunter.obj");
+}
+
+	}
+}
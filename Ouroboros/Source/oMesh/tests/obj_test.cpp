@@ -1,8 +1,11 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include "obj_test.h"
+#include <oMesh/model_cache.h>
 #include <oBase/aabox.h>
 #include <oBase/throw.h>
 
+#include "../../test_services.h"
+
 namespace ouro {
 	namespace tests {
 
@@ -241,6 +244,27 @@ std::shared_ptr<obj_test> obj_test::make(which _Which)
 	oTHROW_INVARG("invalid obj_test");
 }
 
+mesh::obj::init test_obj_init()
+{
+	mesh::obj::init init;
+	init.calc_normals_on_error = false;
+	return init;
+}
+
+std::shared_ptr<mesh::obj::mesh> load_test_obj(test_services& _Services, const char* _Path, const mesh::obj::init& _Init, scoped_allocation* _pText)
+{
+	scoped_allocation text = _Services.load_buffer(_Path);
+	std::shared_ptr<mesh::obj::mesh> obj = mesh::obj::mesh::make(_Init, _Path, text, text.size());
+	if (_pText)
+		*_pText = std::move(text);
+	return obj;
+}
+
+std::shared_ptr<mesh::model> load_test_model(test_services& _Services, const char* _Path, const mesh::obj::init& _Init)
+{
+	return mesh::make_model(load_test_obj(_Services, _Path, _Init)->get_info());
+}
+
 	} // tests
 }
 
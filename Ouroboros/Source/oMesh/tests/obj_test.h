@@ -3,9 +3,13 @@
 #ifndef oMeshTests_obj_test_h
 #define oMeshTests_obj_test_h
 
+#include <oMesh/model.h>
 #include <oMesh/obj.h>
 
 namespace ouro {
+
+class test_services;
+
 	namespace tests {
 
 struct obj_test
@@ -30,6 +34,17 @@ struct obj_test
 	virtual const char* file_contents() const = 0;
 };
 
+// The options the mesh tests parse with: no normals are generated for files 
+// that don't have them.
+mesh::obj::init test_obj_init();
+
+// Parses an OBJ file from the test data. If _pText is specified it receives 
+// the file's contents.
+std::shared_ptr<mesh::obj::mesh> load_test_obj(test_services& _Services, const char* _Path, const mesh::obj::init& _Init = test_obj_init(), scoped_allocation* _pText = nullptr);
+
+// Parses an OBJ file from the test data and converts it with make_model.
+std::shared_ptr<mesh::model> load_test_model(test_services& _Services, const char* _Path, const mesh::obj::init& _Init = test_obj_init());
+
 	} // tests
 }
 
@@ -10,6 +10,7 @@ using namespace ouro::tests;
 #define oTEST_REGISTER_MEMORY_TEST_BUGGED0(_Name) oTEST_THROWS_REGISTER_BUGGED0(oCONCAT(oMemory_, _Name), oCONCAT(TEST, _Name))
 #define oTEST_REGISTER_MEMORY_TEST_BUGGED(_Name) oTEST_THROWS_REGISTER_BUGGED(oCONCAT(oMemory_, _Name), oCONCAT(TEST, _Name))
 
+oTEST_REGISTER_MEMORY_TEST(concurrent_heap);
 oTEST_REGISTER_MEMORY_TEST(concurrent_linear_allocator);
 oTEST_REGISTER_MEMORY_TEST(concurrent_pool);
 oTEST_REGISTER_MEMORY_TEST(pool);
@@ -13,6 +13,8 @@ using namespace ouro::tests;
 oTEST_REGISTER_SURFACE_TEST0(surface);
 oTEST_REGISTER_SURFACE_TEST(surface_bccodec);
 oTEST_REGISTER_SURFACE_TEST(surface_codec);
+oTEST_REGISTER_SURFACE_TEST(surface_codec_batch);
+oTEST_REGISTER_SURFACE_TEST(surface_convert);
 oTEST_REGISTER_SURFACE_TEST(surface_fill);
 oTEST_REGISTER_SURFACE_TEST(surface_generate_mips);
 oTEST_REGISTER_SURFACE_TEST(surface_resize);
@@ -1,6 +1,7 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oString/ini.h>
 #include <memory>
+#include <string>
 #include "../../test_services.h"
 
 namespace ouro { namespace tests {
@@ -63,10 +64,10 @@ static const char* sTestINI_RN = {
 	"\r\n"
 };
 
-static void TESTini(test_services& services, const char* _pData)
+static void TESTini(test_services& services, const char* _pData, bool _IndexNames)
 {
 	static const char* ININame = "Test INI";
-	std::shared_ptr<ini> INI = std::make_shared<ini>(ININame, _pData, default_allocator, 100);
+	std::shared_ptr<ini> INI = std::make_shared<ini>(ININame, _pData, default_allocator, 100, 100, _IndexNames);
 
 	bool AtLeastOneExecuted = false;
 	int i = 0;
@@ -85,12 +86,53 @@ static void TESTini(test_services& services, const char* _pData)
 	i = 0;
 	for (ini::key k = INI->first_key(s); k; k = INI->next_key(k), i++)
 		oTEST(!strcmp(INI->value(k), sExpectedCD2Values[i]), "%s: Reading CD2 %d%s entry.", ININame, i, ordinal(i));
+
+	oTEST(INI->find_section("cd1") == INI->find_section("CD1"), "%s: Section lookup should be case-insensitive", ININame);
+	oTEST(!strcmp(INI->find_value(s, "country"), "USA"), "%s: Key lookup should be case-insensitive", ININame);
+	oTEST(!INI->find_section("CD3") && !INI->find_key(s, "Label"), "%s: Found a section or key that does not exist", ININame);
+}
+
+// finds every key of a large section with and without the name index
+static void TESTini_index(test_services& services)
+{
+	static const unsigned int kNumKeys = 1000;
+	std::string Doc = "[Big]\n";
+	for (unsigned int i = 0; i < kNumKeys; i++)
+	{
+		sstring Line;
+		snprintf(Line, "Key%u=%u\n", i, i);
+		Doc += Line;
+	}
+
+	ini Plain("Plain INI", Doc.c_str(), default_allocator, 1, kNumKeys);
+	ini Indexed("Indexed INI", Doc.c_str(), default_allocator, 1, kNumKeys, true);
+	oTEST(Indexed.size() > Plain.size(), "The name index should be counted in size()");
+
+	const ini* INIs[2] = { &Plain, &Indexed };
+	for (int j = 0; j < 2; j++)
+	{
+		const ini& INI = *INIs[j];
+		ini::section s = INI.find_section("big");
+		oTEST(s, "%s: Section [Big] could not be found", INI.name());
+		for (unsigned int i = 0; i < kNumKeys; i++)
+		{
+			sstring Name;
+			snprintf(Name, "Key%u", i);
+			const char* Value = INI.find_value(s, Name);
+			oTEST(Value && (unsigned int)atoi(Value) == i, "%s: Key%u did not match", INI.name(), i);
+		}
+	}
 }
 
 void TESTini(test_services& services)
 {
-	TESTini(services, sTestINI);
-	TESTini(services, sTestINI_RN);
+	for (int i = 0; i < 2; i++)
+	{
+		TESTini(services, sTestINI, !!i);
+		TESTini(services, sTestINI_RN, !!i);
+	}
+
+	TESTini_index(services);
 }
 
 }}
@@ -1,6 +1,7 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oString/json.h>
 #include <oString/string_codec.h>
+#include <string>
 #include "../../test_services.h"
 
 namespace ouro { namespace tests {
@@ -40,9 +41,9 @@ static void TESTjson_node(test_services& services, const json& _JSON, int _RootN
 	oTEST0(0 == strcmp(NodeValue ? NodeValue : "", _Value ? _Value : ""));
 }
 
-void TESTjson(test_services& services)
+static void TESTjson(test_services& services, bool _IndexNames)
 {
-	json JSON("Test JSON", sJSONTestReferenceResult, default_allocator);
+	json JSON("Test JSON", sJSONTestReferenceResult, default_allocator, 100, _IndexNames);
 
 	// Test common API 
 	oTEST0(JSON.size() >= strlen(sJSONTestReferenceResult));
@@ -95,6 +96,60 @@ void TESTjson(test_services& services)
 	lstring EscapedString;
 	json_escape_encode(EscapedString.c_str(), EscapedString.capacity(), "Some test text for \"JSON\" with some\r\n\tcharacters:\f\b\t\\ that need to be escaped and/or turned into unicode format:\v\a\x1b");
 	oTEST0(0 == strcmp(EscapedString.c_str(), JSON.node_value(json::node(9))));
+
+	// names are case-insensitive and a sibling search continues past the prior
+	oTEST0(JSON.first_child(json::node(1), "double") == json::node(8));
+	oTEST0(JSON.first_child(json::node(1), "Missing") == 0);
+	oTEST0(JSON.next_sibling(json::node(2), "Struct") == json::node(29));
+	oTEST0(JSON.next_sibling(json::node(29), "Bool") == 0);
+}
+
+// finds every member of a large object by name with and without the name index
+static void TESTjson_index(test_services& services)
+{
+	static const unsigned int kNumMembers = 5000;
+	std::string Doc = "{";
+	for (unsigned int i = 0; i < kNumMembers; i++)
+	{
+		sstring Member;
+		snprintf(Member, "%s\"Member%u\":%u", i ? "," : "", i, i);
+		Doc += Member;
+	}
+	Doc += ",\"Member0\":-1}";
+
+	json Plain("Plain JSON", Doc.c_str(), default_allocator, kNumMembers + 3);
+	json Indexed("Indexed JSON", Doc.c_str(), default_allocator, kNumMembers + 3, true);
+	oTEST0(Indexed.size() > Plain.size());
+
+	double Elapsed[2];
+	const json* JSONs[2] = { &Plain, &Indexed };
+	for (int j = 0; j < 2; j++)
+	{
+		const json& JSON = *JSONs[j];
+		json::node Root = JSON.root();
+		const double Start = services.now();
+		for (unsigned int i = 0; i < kNumMembers; i++)
+		{
+			sstring Name;
+			snprintf(Name, "Member%u", i);
+			json::node n = JSON.first_child(Root, Name);
+			oTEST(n && (unsigned int)atoi(JSON.node_value(n)) == i, "%s: Member%u did not match", JSON.name(), i);
+		}
+		Elapsed[j] = services.now() - Start;
+
+		// a duplicate name is found by continuing the sibling search
+		json::node Dup = JSON.next_sibling(JSON.first_child(Root, "member0"), "Member0");
+		oTEST(Dup && !strcmp(JSON.node_value(Dup), "-1"), "%s: Duplicate Member0 was not found", JSON.name());
+	}
+
+	services.report("%u member lookups: scan %.2f ms, indexed %.2f ms", kNumMembers, Elapsed[0] * 1000.0, Elapsed[1] * 1000.0);
+}
+
+void TESTjson(test_services& services)
+{
+	TESTjson(services, false);
+	TESTjson(services, true);
+	TESTjson_index(services);
 }
 
 }}
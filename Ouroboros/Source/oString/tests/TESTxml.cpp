@@ -1,6 +1,7 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oString/xml.h>
 #include <memory>
+#include <string>
 #include "../../test_services.h"
 
 namespace ouro { namespace tests {
@@ -54,9 +55,9 @@ public:
 	std::string s;
 };
 
-void TESTxml(test_services& services)
+static void TESTxml(test_services& services, bool _IndexNames)
 {
-	std::shared_ptr<xml> XML = std::make_shared<xml>("Test XML", sTestXML, default_allocator, 200);
+	std::shared_ptr<xml> XML = std::make_shared<xml>("Test XML", sTestXML, default_allocator, 200, 500, _IndexNames);
 
 	xml::node hCatalog = XML->first_child(XML->root(), "CATALOG");
 	oTEST(hCatalog, "Cannot find CATALOG node");
@@ -73,6 +74,13 @@ void TESTxml(test_services& services)
 		oTEST(hArtist, "Invalid CD structure");
 		oTEST(!strcmp(XML->node_value(hArtist), sExpectedArtists[i]), "Artist in %d%s section did not match", i, ordinal(i));
 	}
+
+	// same-named siblings are found in order, skipping others
+	xml::node hCD = XML->first_child(hCatalog, "cd");
+	oTEST(hCD && !strcmp(XML->find_attr_value(hCatalog, "COUNT"), "3"), "Lookups should be case-insensitive");
+	hCD = XML->next_sibling(hCD, "CD");
+	oTEST(hCD && !strcmp(XML->node_value(XML->first_child(hCD, "ARTIST")), sExpectedArtists[2]), "next_sibling by name did not skip SpecialCD");
+	oTEST(!XML->next_sibling(hCD, "CD") && !XML->first_child(hCatalog, "DVD"), "Found a node that does not exist");
 	 
 	// Test xref
 	// @tony: WTF: if this is xml::node n = ... then all kinds of havok 
@@ -121,7 +129,7 @@ void TESTxml(test_services& services)
 	oTEST(!strcmp(val, "boolattr3"), "boolattr3 2 failed");
 
 	// Test compacted XML
- 	XML = std::make_shared<xml>("Test CompactXML", sCompactTestXML, default_allocator, 200);
+ 	XML = std::make_shared<xml>("Test CompactXML", sCompactTestXML, default_allocator, 200, 500, _IndexNames);
 
 	xml::node HeadNode = XML->first_child(XML->first_child(XML->root()), "head");
 	oTEST(!_stricmp(XML->node_name(HeadNode), "head"), "Failed to get head node");
@@ -134,4 +142,55 @@ void TESTxml(test_services& services)
 	oTEST(!strcmp(t.s.c_str(), sCompactExpectedVisitOrder), "Visit out of order: %s", t.s.c_str());
 }
 
+// finds every child and attr of large nodes by name with and without the name index
+static void TESTxml_index(test_services& services)
+{
+	static const unsigned int kNumItems = 1000;
+	std::string Doc = "<ITEMS>";
+	for (unsigned int i = 0; i < kNumItems; i++)
+	{
+		sstring Item;
+		snprintf(Item, "<ITEM%u>%u</ITEM%u>", i, i, i);
+		Doc += Item;
+	}
+	Doc += "<ATTRS";
+	for (unsigned int i = 0; i < kNumItems; i++)
+	{
+		sstring Attr;
+		snprintf(Attr, " a%u='%u'", i, i);
+		Doc += Attr;
+	}
+	Doc += " /></ITEMS>";
+
+	xml Plain("Plain XML", Doc.c_str(), default_allocator, kNumItems + 4, kNumItems + 2);
+	xml Indexed("Indexed XML", Doc.c_str(), default_allocator, kNumItems + 4, kNumItems + 2, true);
+	oTEST(Indexed.size() > Plain.size(), "The name index should be counted in size()");
+
+	const xml* XMLs[2] = { &Plain, &Indexed };
+	for (int j = 0; j < 2; j++)
+	{
+		const xml& XML = *XMLs[j];
+		xml::node Items = XML.first_child(XML.root(), "ITEMS");
+		xml::node Attrs = XML.first_child(Items, "ATTRS");
+		oTEST(Items && Attrs, "%s: Could not find ITEMS/ATTRS", XML.name());
+		for (unsigned int i = 0; i < kNumItems; i++)
+		{
+			sstring Name;
+			snprintf(Name, "ITEM%u", i);
+			xml::node n = XML.first_child(Items, Name);
+			oTEST(n && (unsigned int)atoi(XML.node_value(n)) == i, "%s: %s did not match", XML.name(), Name.c_str());
+			snprintf(Name, "a%u", i);
+			const char* v = XML.find_attr_value(Attrs, Name);
+			oTEST(v && (unsigned int)atoi(v) == i, "%s: attr %s did not match", XML.name(), Name.c_str());
+		}
+	}
+}
+
+void TESTxml(test_services& services)
+{
+	TESTxml(services, false);
+	TESTxml(services, true);
+	TESTxml_index(services);
+}
+
 }}
@@ -1,6 +1,8 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oSurface/codec.h>
 #include <oSurface/convert.h>
+#include "tile_emitter.h"
+#include <oBase/throw.h>
 #include <oMemory/memory.h>
 #include <oString/string.h>
 
@@ -30,6 +32,10 @@ namespace ouro { namespace surface {
 
 FOREACH_EXT(DECLARE_CODEC)
 
+// formats that decode incrementally from a stream_reader
+info decode_tiles_jpg(const stream_reader& read, const uint2& tile_dimensions, const tile_consumer& consume, const allocator& temp_alloc, const format& desired_format);
+info decode_tiles_png(const stream_reader& read, const uint2& tile_dimensions, const tile_consumer& consume, const allocator& temp_alloc, const format& desired_format);
+
 file_format get_file_format(const char* path)
 {
 	const char* extension = rstrstr(path, ".");
@@ -63,6 +69,20 @@ info get_info(const void* buffer, size_t size)
 	throw std::exception("unknown image encoding");
 }
 	
+// BC encoding has no notion of file compression, so the requested level picks
+// the encoder's speed/quality tradeoff instead.
+static bc_quality as_bc_quality(const compression& c)
+{
+	switch (c)
+	{
+		case compression::none: return bc_quality::ultrafast;
+		case compression::medium: return bc_quality::basic;
+		case compression::high: return bc_quality::slow;
+		default: break;
+	}
+	return bc_quality::fast;
+}
+
 scoped_allocation encode(const image& img
 	, const file_format& fmt
 	, const allocator& file_alloc
@@ -95,7 +115,7 @@ scoped_allocation encode(const image& img
 	
 	if (buffer_format != dst_format)
 	{
-		converted = input->convert(dst_format, temp_alloc);
+		converted = input->convert(dst_format, temp_alloc, as_bc_quality(compression));
 		converted_for_bc_input = image();
 		input = &converted;
 	}
@@ -125,6 +145,78 @@ image decode(const void* buffer
 	return decoded;
 }
 
+info decode_tiles(const stream_reader& read
+	, const uint2& tile_dimensions
+	, const tile_consumer& consume
+	, const allocator& temp_alloc
+	, const format& desired_format)
+{
+	oCHECK_ARG(all(tile_dimensions > uint2(0,0)), "tile dimensions must be non-zero");
+
+	// enough for any format's signature; it's replayed ahead of the rest of the stream
+	uchar header[128];
+	const size_t HeaderSize = read(header, sizeof(header));
+	size_t HeaderOffset = 0;
+
+	stream_reader replay = [&](void* dst, size_t size)->size_t
+	{
+		size_t n = 0;
+		if (HeaderOffset < HeaderSize)
+		{
+			n = min(size, HeaderSize - HeaderOffset);
+			memcpy(dst, header + HeaderOffset, n);
+			HeaderOffset += n;
+		}
+		if (n < size)
+			n += read(byte_add(dst, n), size - n);
+		return n;
+	};
+
+	const file_format ff = get_file_format(header, HeaderSize);
+	switch (ff)
+	{
+		case file_format::jpg: return decode_tiles_jpg(replay, tile_dimensions, consume, temp_alloc, desired_format);
+		case file_format::png: return decode_tiles_png(replay, tile_dimensions, consume, temp_alloc, desired_format);
+		case file_format::unknown: throw std::exception("unknown image encoding");
+		default: break;
+	}
+
+	// no incremental decoder: buffer the whole file and decode it all at once
+	size_t size = 0, capacity = 64 * 1024;
+	scoped_allocation file = temp_alloc.scoped_allocate(capacity, memory_alignment::align_default, "decode_tiles file");
+	for (;;)
+	{
+		if (size == capacity)
+		{
+			capacity *= 2;
+			scoped_allocation bigger = temp_alloc.scoped_allocate(capacity, memory_alignment::align_default, "decode_tiles file");
+			memcpy(bigger, file, size);
+			file = std::move(bigger);
+		}
+
+		const size_t Requested = capacity - size;
+		const size_t n = replay(byte_add((void*)file, size), Requested);
+		size += n;
+		if (n < Requested)
+			break;
+	}
+
+	image decoded = decode(file, size, temp_alloc, temp_alloc);
+	file = scoped_allocation();
+
+	info di = decoded.get_info();
+	tile_emitter emitter(di, tile_dimensions, desired_format, consume, temp_alloc);
+	shared_lock lock(decoded);
+	const uint RowSize = row_size(di.format, di.dimensions.x);
+	for (uint y = 0; y < di.dimensions.y; y++)
+	{
+		memcpy(emitter.next_row(), byte_add(lock.mapped.data, y * lock.mapped.row_pitch), RowSize);
+		emitter.commit_row();
+	}
+
+	return emitter.delivered_info();
+}
+
 	}
 
 const char* as_string(const surface::file_format& ff)
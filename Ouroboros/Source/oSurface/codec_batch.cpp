@@ -0,0 +1,278 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oSurface/codec_batch.h>
+#include <oBase/finally.h>
+#include <oBase/throw.h>
+#include <oBase/timer.h>
+#include <oConcurrency/concurrency.h>
+#include <oConcurrency/concurrent_stack.h>
+#include <oMemory/linear_allocator.h>
+#include <atomic>
+#include <cstdio>
+#include <new>
+
+namespace ouro { namespace surface {
+
+// One per concurrently-running task. Items processed by a task reset it, so
+// everything allocated from it must be released by the end of the item. Stats
+// are accumulated per arena and summed once the batch is done.
+struct scratch_arena
+{
+	scratch_arena* next;
+	linear_allocator heap;
+	batch_stats stats;
+};
+
+// codec temp allocations don't carry a context, so route them to the arena
+// borrowed by the current task. A thread with no arena bound (a codec that
+// hands work to its own threads, say) goes straight to default_allocator; 
+// arena memory never outlives its item so it's never freed from such a thread.
+static oTHREAD_LOCAL scratch_arena* tl_arena;
+
+static void* arena_allocate(size_t num_bytes, const allocate_options& options, const char* label)
+{
+	scratch_arena* a = tl_arena;
+	if (!a)
+		return default_allocator.allocate(num_bytes, options, label);
+
+	void* p = a->heap.allocate(num_bytes, options.get_alignment());
+	if (!p)
+	{
+		a->stats.arena_overflows++;
+		p = default_allocator.allocate(num_bytes, options, label);
+	}
+	return p;
+}
+
+static void arena_deallocate(const void* pointer)
+{
+	scratch_arena* a = tl_arena;
+	if (pointer && (!a || !a->heap.owns((void*)pointer)))
+		default_allocator.deallocate(pointer);
+}
+
+static const allocator arena_allocator(arena_allocate, arena_deallocate);
+
+class arena_pool
+{
+public:
+	arena_pool(size_t arena_size) : arena_size(arena_size), num_arenas(0) {}
+	~arena_pool()
+	{
+		while (scratch_arena* a = arenas.pop())
+			destroy(a);
+	}
+
+	// Runs body(begin, end) for sub-ranges of [0,num_items) on the scheduler with
+	// an arena bound to the calling thread for the duration of each sub-range.
+	void parallel_for_range(size_t num_items, const std::function<void(size_t begin, size_t end)>& body)
+	{
+		ouro::parallel_for_range(0, num_items, [&](size_t begin, size_t end)
+		{
+			scratch_arena* a = arenas.pop();
+			if (!a)
+				a = create();
+
+			scratch_arena* prior = tl_arena;
+			tl_arena = a;
+			finally restore([&] { tl_arena = prior; arenas.push(a); });
+			body(begin, end);
+		});
+	}
+
+	// sums the stats of all arenas used
+	batch_stats stats()
+	{
+		batch_stats s;
+		for (scratch_arena* a = arenas.peek(); a; a = a->next)
+		{
+			s.num_images += a->stats.num_images;
+			s.num_failed += a->stats.num_failed;
+			s.read_bytes += a->stats.read_bytes;
+			s.encoded_bytes += a->stats.encoded_bytes;
+			s.decoded_bytes += a->stats.decoded_bytes;
+			s.read_seconds += a->stats.read_seconds;
+			s.decode_seconds += a->stats.decode_seconds;
+			s.encode_seconds += a->stats.encode_seconds;
+			s.arena_overflows += a->stats.arena_overflows;
+		}
+		s.num_arenas = num_arenas;
+		return s;
+	}
+
+private:
+	concurrent_stack<scratch_arena> arenas;
+	size_t arena_size;
+	std::atomic<uint> num_arenas;
+
+	scratch_arena* create()
+	{
+		void* mem = default_allocator.allocate(sizeof(scratch_arena) + arena_size, memory_alignment::cacheline, "batch scratch arena");
+		scratch_arena* a = new (mem) scratch_arena();
+		a->next = nullptr;
+		a->heap.initialize(a + 1, arena_size);
+		num_arenas++;
+		return a;
+	}
+
+	void destroy(scratch_arena* a)
+	{
+		a->~scratch_arena();
+		default_allocator.deallocate(a);
+	}
+};
+
+// Runs one item with the arena reset afterward and failures reported rather
+// than thrown so the rest of the batch continues.
+template<typename Fn>
+static void run_item(size_t index, const batch_failed& failed, const Fn& fn)
+{
+	scratch_arena* a = tl_arena;
+	a->stats.num_images++;
+	try
+	{
+		fn();
+	}
+
+	catch (std::exception& e)
+	{
+		a->stats.num_failed++;
+		if (failed)
+			failed(index, e.what());
+	}
+
+	catch (...)
+	{
+		a->stats.num_failed++;
+		if (failed)
+			failed(index, "unknown exception");
+	}
+
+	a->heap.reset();
+}
+
+// Decodes into the arena if a conversion will be needed anyway so only the
+// delivered image touches texel_alloc.
+static void decode_item(size_t index, const void* buffer, size_t size, const batch_decoded& decoded, const batch_options& options, const allocator& texel_alloc)
+{
+	scratch_arena* a = tl_arena;
+	timer t;
+
+	image img;
+	if (options.desired_format == format::unknown)
+		img = decode(buffer, size, texel_alloc, arena_allocator, format::unknown, options.layout);
+	else
+	{
+		image native = decode(buffer, size, arena_allocator, arena_allocator, format::unknown, options.layout);
+		img = native.convert(options.desired_format, texel_alloc);
+	}
+
+	a->stats.decode_seconds += t.seconds();
+	a->stats.encoded_bytes += size;
+	a->stats.decoded_bytes += img.size();
+	decoded(index, img);
+}
+
+static scoped_allocation load_into_arena(const char* path)
+{
+	FILE* f = nullptr;
+	if (fopen_s(&f, path, "rb") || !f)
+		oTHROW(no_such_file_or_directory, "could not open %s", path ? path : "(null)");
+	finally close_file([&] { fclose(f); });
+
+	_fseeki64(f, 0, SEEK_END);
+	const size_t size = (size_t)_ftelli64(f);
+	_fseeki64(f, 0, SEEK_SET);
+
+	scoped_allocation buffer = arena_allocator.scoped_allocate(size, memory_alignment::align_default, path);
+	if (fread(buffer, 1, size, f) != size)
+		oTHROW(io_error, "failed to read %s", path);
+	return buffer;
+}
+
+batch_stats decode_batch(const void* const* buffers
+	, const size_t* sizes
+	, size_t num_buffers
+	, const batch_decoded& decoded
+	, const batch_options& options
+	, const batch_failed& failed
+	, const allocator& texel_alloc)
+{
+	timer wall;
+	arena_pool pool(options.arena_size);
+	pool.parallel_for_range(num_buffers, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			run_item(i, failed, [&] { decode_item(i, buffers[i], sizes[i], decoded, options, texel_alloc); });
+	});
+
+	batch_stats s = pool.stats();
+	s.wall_seconds = wall.seconds();
+	return s;
+}
+
+batch_stats decode_batch(const char* const* paths
+	, size_t num_paths
+	, const batch_decoded& decoded
+	, const batch_options& options
+	, const batch_failed& failed
+	, const allocator& texel_alloc)
+{
+	timer wall;
+	arena_pool pool(options.arena_size);
+	pool.parallel_for_range(num_paths, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			run_item(i, failed, [&]
+			{
+				scratch_arena* a = tl_arena;
+				timer t;
+				scoped_allocation buffer = load_into_arena(paths[i]);
+				a->stats.read_seconds += t.seconds();
+				a->stats.read_bytes += buffer.size();
+				decode_item(i, buffer, buffer.size(), decoded, options, texel_alloc);
+			});
+	});
+
+	batch_stats s = pool.stats();
+	s.wall_seconds = wall.seconds();
+	return s;
+}
+
+batch_stats encode_batch(const image* const* images
+	, size_t num_images
+	, const file_format& fmt
+	, const batch_encoded& encoded
+	, const batch_options& options
+	, const batch_failed& failed
+	, const allocator& file_alloc)
+{
+	timer wall;
+	arena_pool pool(options.arena_size);
+	pool.parallel_for_range(num_images, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			run_item(i, failed, [&]
+			{
+				scratch_arena* a = tl_arena;
+				timer t;
+				scoped_allocation file;
+				{
+					// codecs grow their output from an estimate, so let that happen in
+					// the arena and only allocate the final size from file_alloc.
+					scoped_allocation scratch = encode(*images[i], fmt, arena_allocator, arena_allocator, options.desired_format, options.compression_level);
+					file = file_alloc.scoped_allocate(scratch.size(), memory_alignment::align_default, "encode_batch");
+					memcpy(file, scratch, scratch.size());
+				}
+				a->stats.encode_seconds += t.seconds();
+				a->stats.decoded_bytes += images[i]->size();
+				a->stats.encoded_bytes += file.size();
+				encoded(i, file);
+			});
+	});
+
+	batch_stats s = pool.stats();
+	s.wall_seconds = wall.seconds();
+	return s;
+}
+
+}}
@@ -3,220 +3,73 @@
 #include <oBase/assert.h>
 #include <oString/stringize.h>
 #include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
 #include <oHLSL/oHLSLMath.h>
 
 #include <ispc_texcomp.h>
 
 namespace ouro { namespace surface {
 
-typedef void (*pixel_convert)(const void* src_pixel, void* dst_pixel);
+// Work is split into bands of whole scanlines (or whole 4x4 block rows for BC
+// compression) so each task writes a disjoint range of the destination and
+// results do not depend on the number of threads. Subresources smaller than 
+// this many pixels are converted on the calling thread.
+static const uint kMinParallelPixels = 64 * 1024;
 
-static void r8g8b8a8_unorm_to_r8g8b8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-}
-
-static void r8g8b8_unorm_to_r8g8b8a8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = 0xff;
-}
-
-static void r8g8b8_unorm_to_b8g8r8a8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = aa[2];
-	*bb++ = aa[1];
-	*bb++ = aa[0];
-	*bb++ = 0xff;
-}
-
-static void b8g8r8a8_unorm_to_b8g8r8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-}
-
-static void b8g8r8_unorm_to_b8g8r8a8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = 0xff;
-}
-
-static void b8g8r8_unorm_to_a8b8g8r8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = 0xff;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-}
-
-static void b8g8r8_unorm_to_x8b8g8r8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = 0xff;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-}
-
-static void b8g8r8_unorm_to_r8g8b8a8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = aa[2];
-	*bb++ = aa[1];
-	*bb++ = aa[0];
-	*bb++ = 0xff;
-}
-
-static void b8g8r8_unorm_to_r8g8b8x8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	*bb++ = aa[2];
-	*bb++ = aa[1];
-	*bb++ = aa[0];
-	*bb++ = 0xff;
-}
-
-static void a8b8g8r8_unorm_to_b8g8r8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	aa++; // alpha
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-}
-
-static void x8b8g8r8_unorm_to_b8g8r8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	aa++; // x
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-}
-
-static void a8b8g8r8_unorm_to_b8g8r8a8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	uchar al = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb   = al;
-}
-
-static void x8b8g8r8_unorm_to_b8g8r8a8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	uchar x = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb++ = *aa++;
-	*bb   = x;
-}
-
-static void swap_red_blue_r8g8b8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	bb[2] = aa[0];
-	bb[1] = aa[1];
-	bb[0] = aa[2];
-}
-
-static void swap_red_blue_r8g8b8a8_unorm(const void* a, void* b)
-{
-	const uchar* aa = (const uchar*)a;
-	uchar* bb = (uchar*)b;
-	bb[2] = aa[0];
-	bb[1] = aa[1];
-	bb[0] = aa[2];
-	bb[3] = aa[3];
-}
-
-static void r8g8b8x8_unorm_to_bc1_unorm(const void* a, void* b)
-{
-}
+// Rows per band: enough work per task to amortize the dispatch.
+static const uint kMinBandPixels = 16 * 1024;
 
-static void r8g8b8a8_unorm_to_bc3_unorm(const void* a, void* b)
+static uint calc_band_rows(uint width, uint height, uint alignment)
 {
+	uint rows = max(1u, kMinBandPixels / max(1u, width));
+	rows = (rows + alignment - 1) & ~(alignment - 1);
+	return min(rows, (height + alignment - 1) & ~(alignment - 1));
 }
 
-static void r16g16b16a16_float_to_bc6h_uf16(const void* a, void* b)
+// Calls band(first_row, num_rows) over [0,height) in bands that are a multiple 
+// of alignment rows. Small surfaces run serially.
+template<typename BandT>
+static void for_each_band(uint width, uint height, uint alignment, const BandT& band)
 {
-}
+	const uint band_rows = calc_band_rows(width, height, alignment);
+	const uint num_bands = (height + band_rows - 1) / band_rows;
 
-static void r8g8b8a8_unorm_to_bc7_unorm(const void* a, void* b)
-{
-}
+	auto run_band = [&](size_t b)
+	{
+		const uint first = uint(b) * band_rows;
+		band(first, min(band_rows, height - first));
+	};
 
-static void r8g8b8x8_unorm_to_bc7_unorm(const void* a, void* b)
-{
+	if (num_bands <= 1 || (width * height) < kMinParallelPixels)
+		for (uint b = 0; b < num_bands; b++)
+			run_band(b);
+	else
+		ouro::parallel_for(0, num_bands, run_band);
 }
 
-pixel_convert get_pixel_convert(format srcfmt, format dstfmt)
+// BC compression is handled by ispc_texcomp on whole subresources rather than 
+// by row kernels. This returns the block-compressed format to encode for a 
+// supported source/destination pair or format::unknown if the pair does not
+// describe BC compression.
+static format get_bc_format(format srcfmt, format dstfmt)
 {
 	#define IO_(s,d) ((uint(s)<<16) | uint(d))
 	#define IO(s,d) IO_(format::s, format::d)
 	uint sel = IO_(srcfmt, dstfmt);
 	switch (sel)
 	{
-		case IO(r8g8b8a8_unorm,			r8g8b8_unorm):		return r8g8b8a8_unorm_to_r8g8b8_unorm;
-		case IO(r8g8b8_unorm,				r8g8b8a8_unorm):	return r8g8b8_unorm_to_r8g8b8a8_unorm;
-		case IO(r8g8b8_unorm,				b8g8r8a8_unorm):	return r8g8b8_unorm_to_b8g8r8a8_unorm;
-		case IO(b8g8r8a8_unorm,			b8g8r8_unorm):		return b8g8r8a8_unorm_to_b8g8r8_unorm;
-		case IO(b8g8r8a8_unorm,			r8g8b8_unorm):		return swap_red_blue_r8g8b8_unorm;
-		case IO(b8g8r8_unorm,				r8g8b8a8_unorm):	return b8g8r8_unorm_to_r8g8b8a8_unorm;
-		case IO(b8g8r8_unorm,				r8g8b8x8_unorm):	return b8g8r8_unorm_to_r8g8b8x8_unorm;
-		case IO(b8g8r8_unorm,				b8g8r8a8_unorm):	return b8g8r8_unorm_to_b8g8r8a8_unorm;
-		case IO(b8g8r8_unorm,				b8g8r8x8_unorm):	return b8g8r8_unorm_to_b8g8r8a8_unorm;
-		case IO(b8g8r8_unorm,				a8b8g8r8_unorm):	return b8g8r8_unorm_to_a8b8g8r8_unorm;
-		case IO(b8g8r8_unorm,				x8b8g8r8_unorm):	return b8g8r8_unorm_to_x8b8g8r8_unorm;
-		case IO(a8b8g8r8_unorm,			b8g8r8_unorm):		return a8b8g8r8_unorm_to_b8g8r8_unorm;
-		case IO(x8b8g8r8_unorm,			b8g8r8_unorm):		return x8b8g8r8_unorm_to_b8g8r8_unorm;
-		case IO(a8b8g8r8_unorm,			b8g8r8a8_unorm):	return a8b8g8r8_unorm_to_b8g8r8a8_unorm;
-		case IO(x8b8g8r8_unorm,			b8g8r8a8_unorm):	return x8b8g8r8_unorm_to_b8g8r8a8_unorm;
-		case IO(b8g8r8_unorm,				r8g8b8_unorm): 
-		case IO(r8g8b8_unorm,				b8g8r8_unorm):		return swap_red_blue_r8g8b8_unorm;
-		case IO(b8g8r8a8_unorm,			r8g8b8a8_unorm): 
-		case IO(r8g8b8a8_unorm,			b8g8r8a8_unorm):	return swap_red_blue_r8g8b8a8_unorm;
-
-		// tag-like noop functions that trigger special conversion routines
-		case IO(r8g8b8x8_unorm,			bc1_unorm):				return r8g8b8x8_unorm_to_bc1_unorm;
-		case IO(r8g8b8a8_unorm,			bc3_unorm):				return r8g8b8a8_unorm_to_bc3_unorm;
-		case IO(r16g16b16a16_float, bc7_unorm):				return r16g16b16a16_float_to_bc6h_uf16;
-		case IO(r8g8b8x8_unorm,			bc7_unorm):				return r8g8b8x8_unorm_to_bc7_unorm;
-		case IO(r8g8b8a8_unorm,			bc7_unorm):				return r8g8b8a8_unorm_to_bc7_unorm;
-
+		case IO(r8g8b8x8_unorm,			bc1_unorm):				return format::bc1_unorm;
+		case IO(r8g8b8a8_unorm,			bc3_unorm):				return format::bc3_unorm;
+		case IO(r16g16b16a16_float, bc7_unorm):				return format::bc6h_uf16;
+		case IO(r8g8b8x8_unorm,			bc7_unorm):				return format::bc7_unorm;
+		case IO(r8g8b8a8_unorm,			bc7_unorm):				return format::bc7_unorm;
+		case IO(r8g8b8x8_unorm_srgb, bc1_unorm_srgb):	return format::bc1_unorm_srgb;
+		case IO(r8g8b8a8_unorm_srgb, bc3_unorm_srgb):	return format::bc3_unorm_srgb;
+		case IO(r8g8b8x8_unorm_srgb, bc7_unorm_srgb):	return format::bc7_unorm_srgb;
+		case IO(r8g8b8a8_unorm_srgb, bc7_unorm_srgb):	return format::bc7_unorm_srgb;
 		default: break;
 	}
-	throw std::invalid_argument(formatf("%s -> %s not supported", as_string(srcfmt), as_string(dstfmt)));
+	return format::unknown;
 	#undef IO
 }
 
@@ -243,6 +96,10 @@ static void check_bc_inputs(const subresource_info& i
 
 static format get_expected_source(const format& f, bool bc7alpha)
 {
+	// the encoders don't care about color space: _srgb data is encoded as is
+	if (is_srgb(f))
+		return as_srgb(get_expected_source(as_unorm(f), bc7alpha));
+
 	// expected inputs of ispc_texcomp
 	switch (f)
 	{
@@ -255,35 +112,42 @@ static format get_expected_source(const format& f, bool bc7alpha)
 	return format::unknown;
 }
 
-static format get_bc_formats(pixel_convert convert)
+static void convert_subresource_scanline(uint num_pixels
+	, uint src_nth_scanline
+	, uint dst_nth_scanline
+	, row_convert convert
+	, const const_mapped_subresource& src
+	, const mapped_subresource& dst)
 {
-	#define		IF_FMT(src,dst) if (convert == src##_to_##dst) return format::##dst;
-						IF_FMT(r8g8b8x8_unorm, bc1_unorm)
-	else			IF_FMT(r8g8b8a8_unorm, bc3_unorm)
-	else			IF_FMT(r16g16b16a16_float, bc6h_uf16)
-	else			IF_FMT(r8g8b8x8_unorm, bc7_unorm)
-	else			IF_FMT(r8g8b8a8_unorm, bc7_unorm)
-	
-	return format::unknown;
+	const uchar* srow = (const uchar*)src.data + (src.row_pitch * src_nth_scanline);
+	uchar* drow = (uchar*)dst.data + (dst.row_pitch * dst_nth_scanline);
+	convert(srow, drow, num_pixels);
 }
 
-static void convert_subresource_scanline(int _HorizontalElementCount
-	, uint _SrcNthScanline
-	, uint _DstNthScanline
-	, pixel_convert _Convert
-	, int SourceElementSize
-	, int DestinationElementSize
-	, const const_mapped_subresource& src
-	, const mapped_subresource& dst)
+static void get_bc7_settings(const bc_quality& quality, bool alpha, bc7_enc_settings* settings)
 {
-	const uchar* srow = (const uchar*)src.data + (src.row_pitch * _SrcNthScanline);
-	uchar* drow = (uchar*)dst.data + (dst.row_pitch * _DstNthScanline);
+	switch (quality)
+	{
+		case bc_quality::ultrafast: alpha ? GetProfile_alpha_ultrafast(settings) : GetProfile_ultrafast(settings); break;
+		case bc_quality::veryfast: alpha ? GetProfile_alpha_veryfast(settings) : GetProfile_veryfast(settings); break;
+		case bc_quality::fast: alpha ? GetProfile_alpha_fast(settings) : GetProfile_fast(settings); break;
+		case bc_quality::basic: alpha ? GetProfile_alpha_basic(settings) : GetProfile_basic(settings); break;
+		case bc_quality::slow: alpha ? GetProfile_alpha_slow(settings) : GetProfile_slow(settings); break;
+		default: oTHROW_INVARG("invalid bc_quality");
+	}
+}
 
-	for (int x = 0; x < _HorizontalElementCount; x++)
+// BC6H has no ultrafast profile, so the scale is shifted by one.
+static void get_bc6h_settings(const bc_quality& quality, bc6h_enc_settings* settings)
+{
+	switch (quality)
 	{
-		const uchar* spixel = srow + (SourceElementSize * x);
-		uchar* dpixel = drow + (DestinationElementSize * x);
-		_Convert(spixel, dpixel);
+		case bc_quality::ultrafast:
+		case bc_quality::veryfast: GetProfile_bc6h_veryfast(settings); break;
+		case bc_quality::fast: GetProfile_bc6h_fast(settings); break;
+		case bc_quality::basic: GetProfile_bc6h_basic(settings); break;
+		case bc_quality::slow: GetProfile_bc6h_slow(settings); break;
+		default: oTHROW_INVARG("invalid bc_quality");
 	}
 }
 
@@ -291,7 +155,8 @@ static bool convert_subresource_to_bc(const subresource_info& i
 	, const const_mapped_subresource& src
 	, format dst_format
 	, const mapped_subresource& dst
-	, const copy_option& option)
+	, const copy_option& option
+	, const bc_quality& quality)
 {
 	if (!is_block_compressed(dst_format))
 		return false;
@@ -300,94 +165,90 @@ static bool convert_subresource_to_bc(const subresource_info& i
 
 	check_bc_inputs(i, src, dst_format, dst, option, get_expected_source(dst_format, src_has_alpha));
 
-	rgba_surface s;
-	s.ptr = (uint8_t*)src.data;
-	s.width = i.dimensions.x;
-	s.height = i.dimensions.y;
-	s.stride = src.row_pitch;
+	const format encoder = is_srgb(dst_format) ? as_unorm(dst_format) : dst_format;
+	bc6h_enc_settings bc6h_settings;
+	bc7_enc_settings bc7_settings;
+	switch (encoder)
+	{
+		case format::bc1_unorm: case format::bc3_unorm: break;
+		case format::bc6h_uf16: get_bc6h_settings(quality, &bc6h_settings); break;
+		case format::bc7_unorm: get_bc7_settings(quality, src_has_alpha, &bc7_settings); break;
+		default: oTHROW_INVARG("unsupported block compression format %s", as_string(dst_format));
+	}
 
-	switch (dst_format)
+	// Each 4x4 block is encoded independently of its neighbors, so bands of 
+	// whole block rows produce the same bits as one call over the subresource.
+	// dst.row_pitch is the pitch of one row of blocks.
+	for_each_band(i.dimensions.x, i.dimensions.y, 4, [&](uint first_row, uint num_rows)
 	{
-		case format::bc1_unorm: CompressBlocksBC1(&s, (uchar*)dst.data); break;
-		case format::bc3_unorm: CompressBlocksBC3(&s, (uchar*)dst.data); break;
-		case format::bc6h_uf16:
+		rgba_surface s;
+		s.ptr = (uint8_t*)src.data + src.row_pitch * first_row;
+		s.width = i.dimensions.x;
+		s.height = num_rows;
+		s.stride = src.row_pitch;
+
+		uchar* d = (uchar*)dst.data + dst.row_pitch * (first_row / 4);
+		
+		switch (encoder)
 		{
-			bc6h_enc_settings settings;
-			GetProfile_bc6h_fast(&settings);
-			CompressBlocksBC6H(&s, (uchar*)dst.data, &settings);
-			break;
-		}
-			
-		case format::bc7_unorm:
-		{
-			bc7_enc_settings settings;
-			src_has_alpha ? GetProfile_alpha_fast(&settings) : GetProfile_fast(&settings);
-			CompressBlocksBC7(&s, (uchar*)dst.data, &settings);
-			break;
+			case format::bc1_unorm: CompressBlocksBC1(&s, d); break;
+			case format::bc3_unorm: CompressBlocksBC3(&s, d); break;
+			case format::bc6h_uf16: { bc6h_enc_settings settings = bc6h_settings; CompressBlocksBC6H(&s, d, &settings); break; }
+			case format::bc7_unorm: { bc7_enc_settings settings = bc7_settings; CompressBlocksBC7(&s, d, &settings); break; }
+			default: break;
 		}
-
-		default:
-			oTHROW_INVARG("unsupported block compression format %s", as_string(dst_format));
-	}
+	});
 
 	return true;
 }
 
-static void convert_subresource(pixel_convert convert
+static void convert_subresource(row_convert convert
 	, const subresource_info& i
 	, const const_mapped_subresource& src
-	, format dst_format
 	, const mapped_subresource& dst
 	, const copy_option& option)
 {
-	format bc_fmt = get_bc_formats(convert);
-	if (convert_subresource_to_bc(i, src, bc_fmt, dst, option))
-		return;
-
-	const auto selSize = element_size(i.format);
-	const auto delSize = element_size(dst_format);
-	if (option == copy_option::flip_vertically)
+	const bool flip = option == copy_option::flip_vertically;
+	const uint bottom = i.dimensions.y - 1;
+	for_each_band(i.dimensions.x, i.dimensions.y, 1, [&](uint first_row, uint num_rows)
 	{
-		const uint bottom = i.dimensions.y - 1;
-		for (uint y = 0; y < i.dimensions.y; y++)
-			convert_subresource_scanline(i.dimensions.x, y, bottom - y, convert, selSize, delSize, src, dst);
-	}
-	else
-		for (uint y = 0; y < i.dimensions.y; y++)
-			convert_subresource_scanline(i.dimensions.x, y, y, convert, selSize, delSize, src, dst);
+		const uint end = first_row + num_rows;
+		for (uint y = first_row; y < end; y++)
+			convert_subresource_scanline(i.dimensions.x, y, flip ? bottom - y : y, convert, src, dst);
+	});
 }
 
 void convert_subresource(const subresource_info& i
 	, const const_mapped_subresource& src
 	, format dst_format
 	, const mapped_subresource& dst
-	, const copy_option& option)
+	, const copy_option& option
+	, const bc_quality& quality)
 {
 	if (i.format == dst_format)
 		copy(i, src, dst, option);
 	
-	else if (convert_subresource_to_bc(i, src, dst_format, dst, option))
+	else if (convert_subresource_to_bc(i, src, dst_format, dst, option, quality))
 		return;
 
 	else
-	{
-		pixel_convert cv = get_pixel_convert(i.format, dst_format);
-		convert_subresource(cv, i, src, dst_format, dst, option);
-	}
+		convert_subresource(get_row_convert(i.format, dst_format), i, src, dst, option);
 }
 
 void convert(const info& src_info
 	, const const_mapped_subresource& src
 	, const info& dst_info
 	, const mapped_subresource& dst
-	, const copy_option& option)
+	, const copy_option& option
+	, const bc_quality& quality)
 {
 	if (any(src_info.dimensions != dst_info.dimensions))
 		throw std::invalid_argument("dimensions must be the same");
 	if (src_info.array_size != src_info.array_size)
 		throw std::invalid_argument("array_size mismatch");
 
-	pixel_convert cv = get_pixel_convert(src_info.format, dst_info.format);
+	const format bc_fmt = get_bc_format(src_info.format, dst_info.format);
+	const row_convert cv = bc_fmt == format::unknown ? get_row_convert(src_info.format, dst_info.format) : nullptr;
 
 	const int nSubresources = surface::num_subresources(src_info);
 	for (int subresource = 0; subresource < nSubresources; subresource++)
@@ -403,44 +264,30 @@ void convert(const info& src_info
 
 		for (uint slice = 0; slice < srcSri.dimensions.z; slice++)
 		{
-			convert_subresource(cv, srcSri, Source, dst_info.format, Destination, option);
+			if (cv)
+				convert_subresource(cv, srcSri, Source, Destination, option);
+			else
+				convert_subresource_to_bc(srcSri, Source, bc_fmt, Destination, option, quality);
 
 			Source.data = byte_add(Source.data, Source.depth_pitch);
-			Destination.data = byte_add(Destination.data, Source.depth_pitch);
+			Destination.data = byte_add(Destination.data, Destination.depth_pitch);
 		}
 	}
 }
 
-typedef void (*pixel_swizzle)(void* _pPixel);
-
-static void sw_red_blue(void* _pPixel)
+void convert_swizzle(const info& i, const surface::format& new_format, const mapped_subresource& mapped)
 {
-	uchar* r = (uchar*)_pPixel;
-	uchar* b = r + 2;
-	std::swap(*r, *b);
-}
+	// only same-size permutations are safe to run in-place
+	if (element_size(i.format) != element_size(new_format))
+		throw std::invalid_argument(formatf("%s -> %s conversion not supported", as_string(i.format), as_string(new_format)));
 
-pixel_swizzle get_pixel_swizzle(surface::format src_format, surface::format dst_format)
-{
-	#define IO_(s,d) ((uint(s)<<16) | uint(d))
-	#define IO(s,d) IO_(format::s,format::d)
-	uint sel = IO_(src_format, dst_format);
-	switch (sel)
+	row_convert sw = get_row_convert(i.format, new_format);
+	for_each_band(i.dimensions.x, i.dimensions.y, 1, [&](uint first_row, uint num_rows)
 	{
-		case IO(r8g8b8_unorm,		b8g8r8_unorm):
-		case IO(b8g8r8_unorm,		r8g8b8_unorm):
-		case IO(r8g8b8a8_unorm, b8g8r8a8_unorm):
-		case IO(b8g8r8a8_unorm, r8g8b8a8_unorm): return sw_red_blue;
-		default: break;
-	}
-	throw std::invalid_argument(formatf("%s -> %s conversion not supported", as_string(src_format), as_string(dst_format)));
-	#undef IO
-}
-
-void convert_swizzle(const info& i, const surface::format& new_format, const mapped_subresource& mapped)
-{
-	pixel_swizzle sw = get_pixel_swizzle(i.format, new_format);
-	surface::enumerate_pixels(i, mapped, sw);
+		uchar* row = (uchar*)mapped.data + mapped.row_pitch * first_row;
+		for (uint y = 0; y < num_rows; y++, row += mapped.row_pitch)
+			sw(row, row, i.dimensions.x);
+	});
 }
 
 }}
@@ -0,0 +1,528 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+// Scanline conversion kernels. Each supported format pair has a scalar kernel
+// that serves as the reference and fallback and optionally faster kernels for
+// wider instruction sets. The best kernel the CPU supports is chosen at
+// runtime. All kernels of a pair must produce bit-identical results.
+#include <oSurface/convert.h>
+#include <oBase/rgb.h>
+#include <oBase/throw.h>
+#include <oString/stringize.h>
+#include <intrin.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#include <stdexcept>
+
+namespace ouro {
+
+const char* as_string(const surface::simd_level& level)
+{
+	switch (level)
+	{
+		case surface::simd_level::scalar: return "scalar";
+		case surface::simd_level::sse2: return "sse2";
+		case surface::simd_level::ssse3: return "ssse3";
+		case surface::simd_level::avx2: return "avx2";
+		default: break;
+	}
+	return "?";
+}
+
+	namespace surface {
+
+static simd_level detect_simd_level()
+{
+	int regs[4];
+	__cpuid(regs, 0);
+	const int max_leaf = regs[0];
+
+	__cpuid(regs, 1);
+	const bool sse2 = (regs[3] & (1<<26)) != 0;
+	const bool ssse3 = (regs[2] & (1<<9)) != 0;
+	const bool osxsave = (regs[2] & (1<<27)) != 0;
+	const bool avx = (regs[2] & (1<<28)) != 0;
+
+	bool avx2 = false;
+	if (max_leaf >= 7 && osxsave && avx)
+	{
+		// the OS must also save YMM registers on a context switch
+		if ((_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(regs, 7, 0);
+			avx2 = (regs[1] & (1<<5)) != 0;
+		}
+	}
+
+	simd_level level = simd_level::scalar;
+	if (sse2) level = simd_level::sse2;
+	if (sse2 && ssse3) level = simd_level::ssse3;
+	if (sse2 && ssse3 && avx2) level = simd_level::avx2;
+	return level;
+}
+
+static const simd_level s_max_simd_level = detect_simd_level();
+
+simd_level max_simd_level()
+{
+	return s_max_simd_level;
+}
+
+// _____________________________________________________________________________
+// Lookup tables
+
+static const int kLinToSrgbBits = 12;
+static const int kLinToSrgbSize = 1 << kLinToSrgbBits;
+static const float kLinToSrgbScale = float(kLinToSrgbSize - 1);
+
+struct srgb_tables
+{
+	srgb_tables()
+	{
+		for (int i = 0; i < 256; i++)
+			to_linear[i] = srgbtolin(i / 255.0f);
+
+		for (int i = 0; i < kLinToSrgbSize; i++)
+		{
+			float s = lintosrgb(i / kLinToSrgbScale);
+			s = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+			to_srgb[i] = uchar(s * 255.0f + 0.5f);
+		}
+	}
+
+	float to_linear[256];
+	uchar to_srgb[kLinToSrgbSize];
+};
+
+// initialized at load time so kernels never race a lazy initialization
+static const srgb_tables s_srgb;
+
+// _____________________________________________________________________________
+// Byte shuffles: every 8-bit rgb/rgba permutation is described by the number of
+// bytes per source and destination pixel and, for each destination byte, the
+// source byte it comes from or -1 to write 0xff (opaque alpha/x).
+
+template<int S, int D, int M0, int M1, int M2, int M3>
+struct shuffle
+{
+	static void scalar(const void* src_row, void* dst_row, uint num_pixels)
+	{
+		const uchar* s = (const uchar*)src_row;
+		uchar* d = (uchar*)dst_row;
+		for (uint x = 0; x < num_pixels; x++, s += S, d += D)
+		{
+			const uchar s0 = s[0], s1 = s[1], s2 = s[2], s3 = S == 4 ? s[3] : 0xff;
+			const uchar sp[4] = { s0, s1, s2, s3 };
+			d[0] = M0 < 0 ? 0xff : sp[M0 & 3];
+			d[1] = M1 < 0 ? 0xff : sp[M1 & 3];
+			d[2] = M2 < 0 ? 0xff : sp[M2 & 3];
+			if (D == 4)
+				d[3] = M3 < 0 ? 0xff : sp[M3 & 3];
+		}
+	}
+
+	// byte index into a register of 4 packed source pixels, or 0x80 to zero
+	static char index(int pixel, int byte)
+	{
+		const int m = byte == 0 ? M0 : (byte == 1 ? M1 : (byte == 2 ? M2 : M3));
+		return (char)((byte >= D || m < 0) ? 0x80 : (pixel * S + m));
+	}
+
+	static char fill(int byte)
+	{
+		const int m = byte == 0 ? M0 : (byte == 1 ? M1 : (byte == 2 ? M2 : M3));
+		return (char)((byte < D && m < 0) ? 0xff : 0);
+	}
+
+	// packs the destination bytes of 4 pixels tightly into the low bytes
+	static __m128i mask()
+	{
+		char m[16];
+		for (int i = 0; i < 16; i++)
+			m[i] = (char)0x80;
+		for (int p = 0; p < 4; p++)
+			for (int b = 0; b < D; b++)
+				m[p*D + b] = index(p, b);
+		return _mm_loadu_si128((const __m128i*)m);
+	}
+
+	static __m128i fill_mask()
+	{
+		char m[16];
+		for (int i = 0; i < 16; i++)
+			m[i] = 0;
+		for (int p = 0; p < 4; p++)
+			for (int b = 0; b < D; b++)
+				m[p*D + b] = fill(b);
+		return _mm_loadu_si128((const __m128i*)m);
+	}
+
+	// loads/stores exactly 4 pixels so no bytes outside the row are touched
+	static __m128i load4(const uchar* s)
+	{
+		if (S == 4)
+			return _mm_loadu_si128((const __m128i*)s);
+		return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)s), _mm_cvtsi32_si128(*(const int*)(s + 8)));
+	}
+
+	static void store4(uchar* d, __m128i v)
+	{
+		if (D == 4)
+			_mm_storeu_si128((__m128i*)d, v);
+		else
+		{
+			_mm_storel_epi64((__m128i*)d, v);
+			*(int*)(d + 8) = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		}
+	}
+
+	static void ssse3(const void* src_row, void* dst_row, uint num_pixels)
+	{
+		const uchar* s = (const uchar*)src_row;
+		uchar* d = (uchar*)dst_row;
+		const __m128i m = mask();
+		const __m128i f = fill_mask();
+		uint x = 0;
+		for (; x + 4 <= num_pixels; x += 4, s += 4*S, d += 4*D)
+			store4(d, _mm_or_si128(_mm_shuffle_epi8(load4(s), m), f));
+		scalar(s, d, num_pixels - x);
+	}
+
+	static void avx2(const void* src_row, void* dst_row, uint num_pixels)
+	{
+		const uchar* s = (const uchar*)src_row;
+		uchar* d = (uchar*)dst_row;
+		const __m256i m = _mm256_broadcastsi128_si256(mask());
+		const __m256i f = _mm256_broadcastsi128_si256(fill_mask());
+		uint x = 0;
+		for (; x + 8 <= num_pixels; x += 8, s += 8*S, d += 8*D)
+		{
+			// pixels never straddle a 128-bit lane, so the in-lane shuffle suffices
+			__m256i v;
+			if (S == 4)
+				v = _mm256_loadu_si256((const __m256i*)s);
+			else
+				v = _mm256_inserti128_si256(_mm256_castsi128_si256(load4(s)), load4(s + 4*S), 1);
+
+			v = _mm256_or_si256(_mm256_shuffle_epi8(v, m), f);
+
+			if (D == 4)
+				_mm256_storeu_si256((__m256i*)d, v);
+			else
+			{
+				store4(d, _mm256_castsi256_si128(v));
+				store4(d + 4*D, _mm256_extracti128_si256(v, 1));
+			}
+		}
+		ssse3(s, d, num_pixels - x);
+	}
+};
+
+// _____________________________________________________________________________
+// unorm <-> float. Clamping mirrors the semantics of minps/maxps so NaN maps to
+// 0 in every kernel.
+
+static inline float saturate_like_sse(float f)
+{
+	f = f > 0.0f ? f : 0.0f;
+	return f < 1.0f ? f : 1.0f;
+}
+
+static void r8g8b8a8_unorm_to_r32g32b32a32_float_scalar(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const uchar* s = (const uchar*)src_row;
+	float* d = (float*)dst_row;
+	const float k = 1.0f / 255.0f;
+	for (uint i = 0; i < num_pixels * 4; i++)
+		d[i] = float(s[i]) * k;
+}
+
+static void r8g8b8a8_unorm_to_r32g32b32a32_float_sse2(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const uchar* s = (const uchar*)src_row;
+	float* d = (float*)dst_row;
+	const __m128 k = _mm_set1_ps(1.0f / 255.0f);
+	const __m128i z = _mm_setzero_si128();
+	uint x = 0;
+	for (; x + 4 <= num_pixels; x += 4, s += 16, d += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)s);
+		const __m128i lo = _mm_unpacklo_epi8(v, z);
+		const __m128i hi = _mm_unpackhi_epi8(v, z);
+		_mm_storeu_ps(d +  0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, z)), k));
+		_mm_storeu_ps(d +  4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, z)), k));
+		_mm_storeu_ps(d +  8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, z)), k));
+		_mm_storeu_ps(d + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, z)), k));
+	}
+	r8g8b8a8_unorm_to_r32g32b32a32_float_scalar(s, d, num_pixels - x);
+}
+
+static void r8g8b8a8_unorm_to_r32g32b32a32_float_avx2(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const uchar* s = (const uchar*)src_row;
+	float* d = (float*)dst_row;
+	const __m256 k = _mm256_set1_ps(1.0f / 255.0f);
+	uint x = 0;
+	for (; x + 4 <= num_pixels; x += 4, s += 16, d += 16)
+	{
+		const __m256i lo = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)s));
+		const __m256i hi = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s + 8)));
+		_mm256_storeu_ps(d + 0, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), k));
+		_mm256_storeu_ps(d + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), k));
+	}
+	r8g8b8a8_unorm_to_r32g32b32a32_float_scalar(s, d, num_pixels - x);
+}
+
+static void r32g32b32a32_float_to_r8g8b8a8_unorm_scalar(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const float* s = (const float*)src_row;
+	uchar* d = (uchar*)dst_row;
+	for (uint i = 0; i < num_pixels * 4; i++)
+		d[i] = uchar(int(saturate_like_sse(s[i]) * 255.0f + 0.5f));
+}
+
+static inline __m128i float_to_unorm_sse2(__m128 v, __m128 zero, __m128 one, __m128 scale, __m128 half)
+{
+	v = _mm_min_ps(_mm_max_ps(v, zero), one);
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+}
+
+static void r32g32b32a32_float_to_r8g8b8a8_unorm_sse2(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const float* s = (const float*)src_row;
+	uchar* d = (uchar*)dst_row;
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+	uint x = 0;
+	for (; x + 4 <= num_pixels; x += 4, s += 16, d += 16)
+	{
+		const __m128i a = float_to_unorm_sse2(_mm_loadu_ps(s +  0), zero, one, scale, half);
+		const __m128i b = float_to_unorm_sse2(_mm_loadu_ps(s +  4), zero, one, scale, half);
+		const __m128i c = float_to_unorm_sse2(_mm_loadu_ps(s +  8), zero, one, scale, half);
+		const __m128i e = float_to_unorm_sse2(_mm_loadu_ps(s + 12), zero, one, scale, half);
+		_mm_storeu_si128((__m128i*)d, _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e)));
+	}
+	r32g32b32a32_float_to_r8g8b8a8_unorm_scalar(s, d, num_pixels - x);
+}
+
+static void r32g32b32a32_float_to_r8g8b8a8_unorm_avx2(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const float* s = (const float*)src_row;
+	uchar* d = (uchar*)dst_row;
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	uint x = 0;
+	for (; x + 8 <= num_pixels; x += 8, s += 32, d += 32)
+	{
+		__m256i v[4];
+		for (int i = 0; i < 4; i++)
+		{
+			__m256 f = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(s + i*8), zero), one);
+			v[i] = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(f, scale), half));
+		}
+		// packs interleave lanes, so restore pixel order with a dword permute
+		const __m256i p = _mm256_packus_epi16(_mm256_packs_epi32(v[0], v[1]), _mm256_packs_epi32(v[2], v[3]));
+		_mm256_storeu_si256((__m256i*)d, _mm256_permutevar8x32_epi32(p, order));
+	}
+	r32g32b32a32_float_to_r8g8b8a8_unorm_sse2(s, d, num_pixels - x);
+}
+
+// _____________________________________________________________________________
+// sRGB <-> linear float. Color channels go through the lookup tables, alpha is
+// always linear.
+
+static void r8g8b8a8_unorm_srgb_to_r32g32b32a32_float_scalar(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const uchar* s = (const uchar*)src_row;
+	float* d = (float*)dst_row;
+	const float k = 1.0f / 255.0f;
+	for (uint x = 0; x < num_pixels; x++, s += 4, d += 4)
+	{
+		d[0] = s_srgb.to_linear[s[0]];
+		d[1] = s_srgb.to_linear[s[1]];
+		d[2] = s_srgb.to_linear[s[2]];
+		d[3] = float(s[3]) * k;
+	}
+}
+
+static void r8g8b8a8_unorm_srgb_to_r32g32b32a32_float_avx2(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const uchar* s = (const uchar*)src_row;
+	float* d = (float*)dst_row;
+	const __m256 k = _mm256_set1_ps(1.0f / 255.0f);
+	const __m256 alpha = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+	uint x = 0;
+	for (; x + 2 <= num_pixels; x += 2, s += 8, d += 8)
+	{
+		const __m256i i = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)s));
+		const __m256 lin = _mm256_i32gather_ps(s_srgb.to_linear, i, 4);
+		const __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(i), k);
+		_mm256_storeu_ps(d, _mm256_blendv_ps(lin, a, alpha));
+	}
+	r8g8b8a8_unorm_srgb_to_r32g32b32a32_float_scalar(s, d, num_pixels - x);
+}
+
+static void r32g32b32a32_float_to_r8g8b8a8_unorm_srgb_scalar(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const float* s = (const float*)src_row;
+	uchar* d = (uchar*)dst_row;
+	for (uint x = 0; x < num_pixels; x++, s += 4, d += 4)
+	{
+		d[0] = s_srgb.to_srgb[int(saturate_like_sse(s[0]) * kLinToSrgbScale + 0.5f)];
+		d[1] = s_srgb.to_srgb[int(saturate_like_sse(s[1]) * kLinToSrgbScale + 0.5f)];
+		d[2] = s_srgb.to_srgb[int(saturate_like_sse(s[2]) * kLinToSrgbScale + 0.5f)];
+		d[3] = uchar(int(saturate_like_sse(s[3]) * 255.0f + 0.5f));
+	}
+}
+
+static void r32g32b32a32_float_to_r8g8b8a8_unorm_srgb_sse2(const void* src_row, void* dst_row, uint num_pixels)
+{
+	const float* s = (const float*)src_row;
+	uchar* d = (uchar*)dst_row;
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+	const __m128 scale = _mm_setr_ps(kLinToSrgbScale, kLinToSrgbScale, kLinToSrgbScale, 255.0f);
+	int i[4];
+	for (uint x = 0; x < num_pixels; x++, s += 4, d += 4)
+	{
+		_mm_storeu_si128((__m128i*)i, float_to_unorm_sse2(_mm_loadu_ps(s), zero, one, scale, half));
+		d[0] = s_srgb.to_srgb[i[0]];
+		d[1] = s_srgb.to_srgb[i[1]];
+		d[2] = s_srgb.to_srgb[i[2]];
+		d[3] = uchar(i[3]);
+	}
+}
+
+// The other 4-byte sRGB layouts differ only in where red and blue are and in
+// whether the fourth byte is alpha or padding.
+template<int R, int B, bool Alpha>
+struct srgb8
+{
+	static void to_float_scalar(const void* src_row, void* dst_row, uint num_pixels)
+	{
+		const uchar* s = (const uchar*)src_row;
+		float* d = (float*)dst_row;
+		const float k = 1.0f / 255.0f;
+		for (uint x = 0; x < num_pixels; x++, s += 4, d += 4)
+		{
+			d[0] = s_srgb.to_linear[s[R]];
+			d[1] = s_srgb.to_linear[s[1]];
+			d[2] = s_srgb.to_linear[s[B]];
+			d[3] = Alpha ? float(s[3]) * k : 1.0f;
+		}
+	}
+
+	static void from_float_scalar(const void* src_row, void* dst_row, uint num_pixels)
+	{
+		const float* s = (const float*)src_row;
+		uchar* d = (uchar*)dst_row;
+		for (uint x = 0; x < num_pixels; x++, s += 4, d += 4)
+		{
+			d[R] = s_srgb.to_srgb[int(saturate_like_sse(s[0]) * kLinToSrgbScale + 0.5f)];
+			d[1] = s_srgb.to_srgb[int(saturate_like_sse(s[1]) * kLinToSrgbScale + 0.5f)];
+			d[B] = s_srgb.to_srgb[int(saturate_like_sse(s[2]) * kLinToSrgbScale + 0.5f)];
+			d[3] = Alpha ? uchar(int(saturate_like_sse(s[3]) * 255.0f + 0.5f)) : 0xff;
+		}
+	}
+
+	static void from_float_sse2(const void* src_row, void* dst_row, uint num_pixels)
+	{
+		const float* s = (const float*)src_row;
+		uchar* d = (uchar*)dst_row;
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+		const __m128 scale = _mm_setr_ps(kLinToSrgbScale, kLinToSrgbScale, kLinToSrgbScale, 255.0f);
+		int i[4];
+		for (uint x = 0; x < num_pixels; x++, s += 4, d += 4)
+		{
+			_mm_storeu_si128((__m128i*)i, float_to_unorm_sse2(_mm_loadu_ps(s), zero, one, scale, half));
+			d[R] = s_srgb.to_srgb[i[0]];
+			d[1] = s_srgb.to_srgb[i[1]];
+			d[B] = s_srgb.to_srgb[i[2]];
+			d[3] = Alpha ? uchar(i[3]) : 0xff;
+		}
+	}
+};
+
+// _____________________________________________________________________________
+// Conversion table
+
+struct row_convert_entry
+{
+	format src;
+	format dst;
+	row_convert kernels[(int)simd_level::count];
+};
+
+#define oSHUFFLE(S,D,M0,M1,M2,M3) { shuffle<S,D,M0,M1,M2,M3>::scalar, nullptr, shuffle<S,D,M0,M1,M2,M3>::ssse3, shuffle<S,D,M0,M1,M2,M3>::avx2 }
+#define oKERNELS(s,d,sse2,avx2) { s##_to_##d##_scalar, sse2, sse2, avx2 }
+#define oSRGB8_TO_FLOAT(R,B,A) { srgb8<R,B,A>::to_float_scalar, nullptr, nullptr, nullptr }
+#define oFLOAT_TO_SRGB8(R,B,A) { srgb8<R,B,A>::from_float_scalar, srgb8<R,B,A>::from_float_sse2, srgb8<R,B,A>::from_float_sse2, nullptr }
+
+static const row_convert_entry s_row_converts[] =
+{
+	{ format::r8g8b8a8_unorm, format::r8g8b8_unorm, oSHUFFLE(4,3, 0,1,2,-1) },
+	{ format::r8g8b8_unorm, format::r8g8b8a8_unorm, oSHUFFLE(3,4, 0,1,2,-1) },
+	{ format::r8g8b8_unorm, format::b8g8r8a8_unorm, oSHUFFLE(3,4, 2,1,0,-1) },
+	{ format::b8g8r8a8_unorm, format::b8g8r8_unorm, oSHUFFLE(4,3, 0,1,2,-1) },
+	{ format::b8g8r8a8_unorm, format::r8g8b8_unorm, oSHUFFLE(4,3, 2,1,0,-1) },
+	{ format::b8g8r8_unorm, format::r8g8b8a8_unorm, oSHUFFLE(3,4, 2,1,0,-1) },
+	{ format::b8g8r8_unorm, format::r8g8b8x8_unorm, oSHUFFLE(3,4, 2,1,0,-1) },
+	{ format::b8g8r8_unorm, format::b8g8r8a8_unorm, oSHUFFLE(3,4, 0,1,2,-1) },
+	{ format::b8g8r8_unorm, format::b8g8r8x8_unorm, oSHUFFLE(3,4, 0,1,2,-1) },
+	{ format::b8g8r8_unorm, format::a8b8g8r8_unorm, oSHUFFLE(3,4, -1,0,1,2) },
+	{ format::b8g8r8_unorm, format::x8b8g8r8_unorm, oSHUFFLE(3,4, -1,0,1,2) },
+	{ format::a8b8g8r8_unorm, format::b8g8r8_unorm, oSHUFFLE(4,3, 1,2,3,-1) },
+	{ format::x8b8g8r8_unorm, format::b8g8r8_unorm, oSHUFFLE(4,3, 1,2,3,-1) },
+	{ format::a8b8g8r8_unorm, format::b8g8r8a8_unorm, oSHUFFLE(4,4, 1,2,3,0) },
+	{ format::x8b8g8r8_unorm, format::b8g8r8a8_unorm, oSHUFFLE(4,4, 1,2,3,0) },
+	{ format::b8g8r8_unorm, format::r8g8b8_unorm, oSHUFFLE(3,3, 2,1,0,-1) },
+	{ format::r8g8b8_unorm, format::b8g8r8_unorm, oSHUFFLE(3,3, 2,1,0,-1) },
+	{ format::b8g8r8a8_unorm, format::r8g8b8a8_unorm, oSHUFFLE(4,4, 2,1,0,3) },
+	{ format::r8g8b8a8_unorm, format::b8g8r8a8_unorm, oSHUFFLE(4,4, 2,1,0,3) },
+	{ format::b8g8r8a8_unorm, format::r8g8b8x8_unorm, oSHUFFLE(4,4, 2,1,0,3) },
+	{ format::b8g8r8a8_unorm_srgb, format::r8g8b8a8_unorm_srgb, oSHUFFLE(4,4, 2,1,0,3) },
+	{ format::b8g8r8a8_unorm_srgb, format::r8g8b8x8_unorm_srgb, oSHUFFLE(4,4, 2,1,0,3) },
+
+	{ format::r8g8b8a8_unorm, format::r32g32b32a32_float, oKERNELS(r8g8b8a8_unorm, r32g32b32a32_float, r8g8b8a8_unorm_to_r32g32b32a32_float_sse2, r8g8b8a8_unorm_to_r32g32b32a32_float_avx2) },
+	{ format::r32g32b32a32_float, format::r8g8b8a8_unorm, oKERNELS(r32g32b32a32_float, r8g8b8a8_unorm, r32g32b32a32_float_to_r8g8b8a8_unorm_sse2, r32g32b32a32_float_to_r8g8b8a8_unorm_avx2) },
+	{ format::r8g8b8x8_unorm, format::r32g32b32a32_float, oKERNELS(r8g8b8a8_unorm, r32g32b32a32_float, r8g8b8a8_unorm_to_r32g32b32a32_float_sse2, r8g8b8a8_unorm_to_r32g32b32a32_float_avx2) },
+	{ format::r32g32b32a32_float, format::r8g8b8x8_unorm, oKERNELS(r32g32b32a32_float, r8g8b8a8_unorm, r32g32b32a32_float_to_r8g8b8a8_unorm_sse2, r32g32b32a32_float_to_r8g8b8a8_unorm_avx2) },
+	{ format::r8g8b8a8_unorm_srgb, format::r32g32b32a32_float, oKERNELS(r8g8b8a8_unorm_srgb, r32g32b32a32_float, nullptr, r8g8b8a8_unorm_srgb_to_r32g32b32a32_float_avx2) },
+	{ format::r32g32b32a32_float, format::r8g8b8a8_unorm_srgb, oKERNELS(r32g32b32a32_float, r8g8b8a8_unorm_srgb, r32g32b32a32_float_to_r8g8b8a8_unorm_srgb_sse2, nullptr) },
+	{ format::r8g8b8x8_unorm_srgb, format::r32g32b32a32_float, oSRGB8_TO_FLOAT(0,2,false) },
+	{ format::r32g32b32a32_float, format::r8g8b8x8_unorm_srgb, oFLOAT_TO_SRGB8(0,2,false) },
+	{ format::b8g8r8a8_unorm_srgb, format::r32g32b32a32_float, oSRGB8_TO_FLOAT(2,0,true) },
+	{ format::r32g32b32a32_float, format::b8g8r8a8_unorm_srgb, oFLOAT_TO_SRGB8(2,0,true) },
+	{ format::b8g8r8x8_unorm_srgb, format::r32g32b32a32_float, oSRGB8_TO_FLOAT(2,0,false) },
+	{ format::r32g32b32a32_float, format::b8g8r8x8_unorm_srgb, oFLOAT_TO_SRGB8(2,0,false) },
+};
+
+#undef oFLOAT_TO_SRGB8
+#undef oSRGB8_TO_FLOAT
+#undef oKERNELS
+#undef oSHUFFLE
+
+bool has_row_convert(const format& src_format, const format& dst_format)
+{
+	for (const auto& e : s_row_converts)
+		if (e.src == src_format && e.dst == dst_format)
+			return true;
+	return false;
+}
+
+row_convert get_row_convert(const format& src_format, const format& dst_format, const simd_level& max_level)
+{
+	const simd_level cpu_level = max_simd_level();
+	const int level = (int)(max_level < cpu_level ? max_level : cpu_level);
+
+	for (const auto& e : s_row_converts)
+	{
+		if (e.src == src_format && e.dst == dst_format)
+		{
+			for (int i = level; i >= 0; i--)
+				if (e.kernels[i])
+					return e.kernels[i];
+		}
+	}
+
+	throw std::invalid_argument(formatf("%s -> %s not supported", as_string(src_format), as_string(dst_format)));
+}
+
+}}
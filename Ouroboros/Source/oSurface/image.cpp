@@ -3,7 +3,10 @@
 #include <oSurface/convert.h>
 #include <oMemory/memory.h>
 #include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oString/stringize.h>
 #include <mutex>
+#include <vector>
 
 namespace ouro { namespace surface {
 
@@ -204,13 +207,13 @@ image image::convert(const info& dst_info) const
 	return convert(dst_info, alloc);
 }
 
-image image::convert(const info& dst_info, const allocator& a) const
+image image::convert(const info& dst_info, const allocator& a, const bc_quality& quality) const
 {
 	info src_info = get_info();
 	image converted(dst_info, a);
 	shared_lock slock(this);
 	lock_guard dlock(converted);
-	surface::convert(src_info, slock.mapped, dst_info, dlock.mapped);
+	surface::convert(src_info, slock.mapped, dst_info, dlock.mapped, copy_option::none, quality);
 	return converted;
 }
 
@@ -250,31 +253,139 @@ void image::convert_in_place(const format& fmt)
 }
 
 void image::generate_mips(const filter& f)
+{
+	mip_options o;
+	o.mip_filter = f;
+	o.gamma_correct = false;
+	generate_mips(o);
+}
+
+void image::generate_mips(const mip_options& options)
 {
 	lock_t lock(mtx);
+	surface::generate_mips(inf, bits, options);
+}
 
-	uint nMips = num_mips(inf);
-	uint nSlices = max(1u, inf.array_size);
+// the input format ispc_texcomp expects for each supported bc format
+static format bc_input_format(const format& bc_format, bool alpha)
+{
+	if (is_srgb(bc_format))
+		return as_srgb(bc_input_format(as_unorm(bc_format), alpha));
 
-	for (uint slice = 0; slice < nSlices; slice++)
+	switch (bc_format)
 	{
-		int mip0subresource = calc_subresource(0, slice, 0, nMips, inf.array_size);
-		const_mapped_subresource mip0 = get_const_mapped_subresource(inf, mip0subresource, 0, bits);
+		case format::bc1_unorm: return format::r8g8b8x8_unorm;
+		case format::bc3_unorm: return format::r8g8b8a8_unorm;
+		case format::bc6h_uf16: return format::r16g16b16a16_float;
+		case format::bc7_unorm: return alpha ? format::r8g8b8a8_unorm : format::r8g8b8x8_unorm;
+		default: break;
+	}
+	oTHROW_INVARG("unsupported block compression format %s", as_string(bc_format));
+}
 
-		for (uint mip = 1; mip < nMips; mip++)
-		{
-			uint subresource = calc_subresource(mip, slice, 0, nMips, inf.array_size);
-			subresource_info subinfo = surface::subresource(inf, subresource);
+// Returns level converted to f in converted, going through linear float when
+// there's no direct row kernel, or level itself if it's already in f.
+static const_mapped_subresource convert_level(const info& li, const const_mapped_subresource& level, const format& f, std::vector<uchar>& converted, std::vector<uchar>& linear)
+{
+	if (li.format == f)
+		return level;
+
+	info ci = li;
+	ci.format = f;
+	converted.resize(total_size(ci));
+	mapped_subresource c = get_mapped_subresource(ci, 0, 0, converted.data());
+
+	if (has_row_convert(li.format, f))
+		convert_subresource(subresource(li, 0), level, f, c);
+	else
+	{
+		info fi = li;
+		fi.format = format::r32g32b32a32_float;
+		linear.resize(total_size(fi));
+		mapped_subresource l = get_mapped_subresource(fi, 0, 0, linear.data());
+		convert_subresource(subresource(li, 0), level, fi.format, l);
+		convert_subresource(subresource(fi, 0), l, f, c);
+	}
+
+	return c;
+}
 
-			for (uint depth = 0; depth < subinfo.dimensions.z; depth++)
+// Copies a level into a buffer whose dimensions are a multiple of 4 by 
+// replicating the last column and row.
+static void pad_to_blocks(const info& i, const const_mapped_subresource& src, const info& padded_info, const mapped_subresource& dst)
+{
+	const uint ElementSize = element_size(i.format);
+	for (uint y = 0; y < padded_info.dimensions.y; y++)
+	{
+		const uchar* s = (const uchar*)src.data + min(y, i.dimensions.y - 1) * src.row_pitch;
+		uchar* d = (uchar*)dst.data + y * dst.row_pitch;
+		memcpy(d, s, i.dimensions.x * ElementSize);
+		for (uint x = i.dimensions.x; x < padded_info.dimensions.x; x++)
+			memcpy(d + x * ElementSize, s + (i.dimensions.x - 1) * ElementSize, ElementSize);
+	}
+}
+
+image compress_mips(const image& src, const format& bc_format, const mip_options& options, const bc_quality& quality, const allocator& a)
+{
+	const info src_info = src.get_info();
+	oCHECK_ARG(src_info.dimensions.z == 1, "3d surfaces cannot be block compressed");
+	const format InputFormat = bc_input_format(bc_format, has_alpha(src_info.format));
+
+	// an _srgb source is filtered as is so options.gamma_correct applies, anything
+	// else in the linear twin of the encoder's input
+	const format ChainFormat = is_srgb(src_info.format) ? src_info.format : (is_srgb(InputFormat) ? as_unorm(InputFormat) : InputFormat);
+
+	info dst_info = src_info;
+	dst_info.format = bc_format;
+	dst_info.mip_layout = mip_layout::tight;
+	image dst(dst_info, a);
+
+	const uint nSrcMips = num_mips(src_info);
+	const uint nMips = num_mips(dst_info);
+	const uint nSlices = max(1u, dst_info.array_size);
+	info mip0_info = src_info;
+	mip0_info.dimensions.z = 1;
+	mip0_info.array_size = 0;
+	mip0_info.mip_layout = mip_layout::none;
+
+	{
+		// map once: mapping per level would serialize slices on the image's mutex
+		lock_guard dlock(dst);
+		parallel_for(0, nSlices, [&](size_t slice)
+		{
+			shared_lock slock(src, calc_subresource(0, uint(slice), 0, nSrcMips, src_info.array_size));
+			std::vector<uchar> chain0, converted, linear, padded;
+			info chain0_info = mip0_info;
+			chain0_info.format = ChainFormat;
+			const const_mapped_subresource mip0 = convert_level(mip0_info, slock.mapped, ChainFormat, chain0, linear);
+			
+			build_mip_chain(chain0_info, mip0, options, [&](uint mip, const info& li, const const_mapped_subresource& level)->bool
 			{
-				mapped_subresource dst = get_mapped_subresource(inf, subresource, depth, bits);
-				info di = inf;
-				di.dimensions = subinfo.dimensions;
-				resize(inf, mip0, di, dst, f);
-			}
-		}
+				// mip0 is encoded from the chain's input so it isn't round-tripped through float
+				info bi = mip ? li : chain0_info;
+				const_mapped_subresource bc_input = convert_level(bi, mip ? level : mip0, InputFormat, converted, linear);
+				bi.format = InputFormat;
+
+				if ((bi.dimensions.x & 3) || (bi.dimensions.y & 3))
+				{
+					info pi = bi;
+					pi.dimensions.x = (bi.dimensions.x + 3) & ~3u;
+					pi.dimensions.y = (bi.dimensions.y + 3) & ~3u;
+					padded.resize(total_size(pi));
+					mapped_subresource p = get_mapped_subresource(pi, 0, 0, padded.data());
+					pad_to_blocks(bi, bc_input, pi, p);
+					bi = pi;
+					bc_input = p;
+				}
+
+				mapped_subresource d = get_mapped_subresource(dst_info, calc_subresource(mip, uint(slice), 0, nMips, dst_info.array_size), 0, dlock.mapped.data);
+				convert_subresource(subresource(bi, 0), bc_input, bc_format, d, copy_option::none, quality);
+				return true;
+			});
+		});
 	}
+
+	return dst;
 }
 
 float calc_rms(const image& b1, const image& b2)
@@ -1,5 +1,6 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oSurface/codec.h>
+#include "tile_emitter.h"
 #include <oMemory/allocate.h>
 #include <oBase/finally.h>
 #include <oBase/throw.h>
@@ -245,4 +246,106 @@ image decode_jpg(const void* buffer, size_t size, const allocator& texel_alloc,
 	return img;
 }
 
+// A jpeg_source_mgr that pulls from a stream_reader through a small fixed 
+// buffer rather than requiring the whole file in memory.
+struct reader_source
+{
+	jpeg_source_mgr pub;
+	const stream_reader* read;
+	JOCTET* buffer;
+	size_t buffer_size;
+};
+
+static void reader_init_source(j_decompress_ptr cinfo)
+{
+}
+
+static boolean reader_fill_input_buffer(j_decompress_ptr cinfo)
+{
+	reader_source* src = (reader_source*)cinfo->src;
+	size_t n = (*src->read)(src->buffer, src->buffer_size);
+	if (!n)
+	{
+		// same as libjpeg's stdio source: warn and insert a fake EOI marker
+		WARNMS(cinfo, JWRN_JPEG_EOF);
+		src->buffer[0] = (JOCTET)0xff;
+		src->buffer[1] = (JOCTET)JPEG_EOI;
+		n = 2;
+	}
+
+	src->pub.next_input_byte = src->buffer;
+	src->pub.bytes_in_buffer = n;
+	return TRUE;
+}
+
+static void reader_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+	reader_source* src = (reader_source*)cinfo->src;
+	while (num_bytes > (long)src->pub.bytes_in_buffer)
+	{
+		num_bytes -= (long)src->pub.bytes_in_buffer;
+		reader_fill_input_buffer(cinfo);
+	}
+	if (num_bytes > 0)
+	{
+		src->pub.next_input_byte += num_bytes;
+		src->pub.bytes_in_buffer -= num_bytes;
+	}
+}
+
+static void reader_term_source(j_decompress_ptr cinfo)
+{
+}
+
+info decode_tiles_jpg(const stream_reader& read, const uint2& tile_dimensions, const tile_consumer& consume, const allocator& temp_alloc, const format& desired_format)
+{
+	tl_alloc = &temp_alloc;
+	finally reset_alloc([&] { tl_alloc = nullptr; });
+
+	jpeg_decompress_struct cinfo;
+	jpeg_error_mgr jerr;
+	cinfo.err = jpeg_std_error(&jerr);
+	jerr.error_exit = error_exit_throw;
+	jerr.output_message = dont_output_message;
+	cinfo.alloc = &s_jalloc;
+
+	jpeg_create_decompress(&cinfo);
+	finally Destroy([&] { jpeg_destroy_decompress(&cinfo); });
+
+	static const size_t kReadSize = 64 * 1024;
+	scoped_allocation buffer = temp_alloc.scoped_allocate(kReadSize, memory_alignment::align_default, "libjpegturbo stream");
+	reader_source src;
+	src.pub.init_source = reader_init_source;
+	src.pub.fill_input_buffer = reader_fill_input_buffer;
+	src.pub.skip_input_data = reader_skip_input_data;
+	src.pub.resync_to_restart = jpeg_resync_to_restart;
+	src.pub.term_source = reader_term_source;
+	src.pub.next_input_byte = nullptr;
+	src.pub.bytes_in_buffer = 0;
+	src.read = &read;
+	src.buffer = buffer;
+	src.buffer_size = kReadSize;
+	cinfo.src = &src.pub;
+
+	jpeg_read_header(&cinfo, TRUE);
+
+	info si;
+	si.format = from_jcs(cinfo.out_color_space);
+	si.mip_layout = mip_layout::none;
+	si.dimensions = int3(cinfo.image_width, cinfo.image_height, 1);
+
+	tile_emitter emitter(si, tile_dimensions, desired_format, consume, temp_alloc);
+	jpeg_start_decompress(&cinfo);
+	while (cinfo.output_scanline < cinfo.output_height)
+	{
+		JSAMPROW row[1];
+		row[0] = (JSAMPLE*)emitter.next_row();
+		jpeg_read_scanlines(&cinfo, row, 1);
+		emitter.commit_row();
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	return emitter.delivered_info();
+}
+
 }}
@@ -1,5 +1,6 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oSurface/codec.h>
+#include "tile_emitter.h"
 #include <oMemory/allocate.h>
 #include <oMemory/byte.h>
 #include <oBase/finally.h>
@@ -31,6 +32,13 @@ static void user_read_data(png_structp png_ptr, png_bytep data, png_size_t lengt
 	r.offset += length;
 }
 
+static void user_read_stream(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	const ouro::surface::stream_reader& read = *(const ouro::surface::stream_reader*)png_get_io_ptr(png_ptr);
+	if (read(data, length) != length)
+		png_error(png_ptr, "unexpected end of png stream");
+}
+
 void user_write_data(png_structp png_ptr, png_bytep data, png_size_t length)
 {
 	write_state& w = *(write_state*)png_get_io_ptr(png_ptr);
@@ -54,6 +62,73 @@ void user_flush_data(png_structp png_ptr)
 {
 }
 
+// libpng reports errors by longjmp'ing to the last setjmp, which would skip the
+// destructors of any C++ frame in between. Every libpng call that can fail goes
+// through one of these instead: they have no locals to destroy and return false
+// if libpng jumped back.
+
+static bool safe_read_header(png_structp png_ptr, png_infop info_ptr, unsigned int* out_width, unsigned int* out_height, int* out_depth, int* out_color_type)
+{
+	if (setjmp(png_jmpbuf(png_ptr)))
+		return false;
+	png_read_info(png_ptr, info_ptr);
+	png_get_IHDR(png_ptr, info_ptr, out_width, out_height, out_depth, out_color_type, nullptr, nullptr, nullptr);
+	return true;
+}
+
+static bool safe_read_update_info(png_structp png_ptr, png_infop info_ptr)
+{
+	if (setjmp(png_jmpbuf(png_ptr)))
+		return false;
+	png_read_update_info(png_ptr, info_ptr);
+	return true;
+}
+
+static bool safe_read_image(png_structp png_ptr, png_bytepp rows)
+{
+	if (setjmp(png_jmpbuf(png_ptr)))
+		return false;
+	png_read_image(png_ptr, rows);
+	return true;
+}
+
+static bool safe_read_row(png_structp png_ptr, png_bytep row)
+{
+	if (setjmp(png_jmpbuf(png_ptr)))
+		return false;
+	png_read_row(png_ptr, row, nullptr);
+	return true;
+}
+
+static bool safe_read_end(png_structp png_ptr)
+{
+	if (setjmp(png_jmpbuf(png_ptr)))
+		return false;
+	png_read_end(png_ptr, nullptr);
+	return true;
+}
+
+static bool safe_write_header(png_structp png_ptr, png_infop info_ptr, unsigned int width, unsigned int height, int color_type, int compression_level, bool bgr)
+{
+	if (setjmp(png_jmpbuf(png_ptr)))
+		return false;
+	png_set_compression_level(png_ptr, compression_level);
+	png_set_IHDR(png_ptr, info_ptr, width, height, 8, color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png_ptr, info_ptr);
+	if (bgr)
+		png_set_bgr(png_ptr);
+	return true;
+}
+
+static bool safe_write_image(png_structp png_ptr, png_infop info_ptr, png_bytepp rows)
+{
+	if (setjmp(png_jmpbuf(png_ptr)))
+		return false;
+	png_write_image(png_ptr, rows);
+	png_write_end(png_ptr, info_ptr);
+	return true;
+}
+
 namespace ouro { namespace surface {
 
 static surface::format to_format(int _Type, int _BitDepth)
@@ -101,21 +176,15 @@ info get_info_png(const void* buffer, size_t size)
 	if (!info_ptr)
 		throw std::exception("get_info_png failed");
 
-	#pragma warning(disable:4611) // interaction between '_setjmp' and C++ object destruction is non-portable
-	if (setjmp(png_jmpbuf(png_ptr)))
-		throw std::exception("png read failed");
-	#pragma warning(default:4611) // interaction between '_setjmp' and C++ object destruction is non-portable
-
 	read_state rs;
 	rs.data = buffer;
 	rs.offset = 0;
 	png_set_read_fn(png_ptr, &rs, user_read_data);
-	png_read_info(png_ptr, info_ptr);
 
-	// Read initial information and configure the decoder accordingly
 	unsigned int w = 0, h = 0;
 	int depth = 0, color_type = 0;
-	png_get_IHDR(png_ptr, info_ptr, &w, &h, &depth, &color_type, nullptr, nullptr, nullptr);
+	if (!safe_read_header(png_ptr, info_ptr, &w, &h, &depth, &color_type))
+		throw std::exception("png read failed");
 	
 	surface::info i;
 	i.format = to_format(color_type, depth);
@@ -141,11 +210,6 @@ scoped_allocation encode_png(const image& img, const allocator& file_alloc, cons
 	if (!info_ptr)
 		throw std::exception("png read failed");
 
-	#pragma warning(disable:4611) // interaction between '_setjmp' and C++ object destruction is non-portable
-	if (setjmp(png_jmpbuf(png_ptr)))
-		throw std::exception("png read failed");
-	#pragma warning(default:4611) // interaction between '_setjmp' and C++ object destruction is non-portable
-
 	write_state ws;
 	ws.capacity = si.dimensions.y * si.dimensions.x * element_size(si.format);
 	ws.capacity += (ws.capacity / 2);
@@ -162,8 +226,6 @@ scoped_allocation encode_png(const image& img, const allocator& file_alloc, cons
 		case compression::high: zcomp = Z_BEST_COMPRESSION; break;
 		default: throw std::exception("invalid compression");
 	}
-	png_set_compression_level(png_ptr, zcomp);
-
 	int color_type = 0;
 	switch (si.format)
 	{
@@ -175,14 +237,9 @@ scoped_allocation encode_png(const image& img, const allocator& file_alloc, cons
 		default: throw std::exception("invalid format");
 	}
 
-	// how big a buffer?
-	png_set_IHDR(png_ptr, info_ptr, si.dimensions.x, si.dimensions.y, 8
-		, color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-	png_write_info(png_ptr, info_ptr);
-	
-	if (si.format == format::b8g8r8_unorm || si.format == format::b8g8r8a8_unorm)
-		png_set_bgr(png_ptr);
+	const bool bgr = si.format == format::b8g8r8_unorm || si.format == format::b8g8r8a8_unorm;
+	if (!safe_write_header(png_ptr, info_ptr, si.dimensions.x, si.dimensions.y, color_type, zcomp, bgr))
+		throw std::exception("png write failed");
 
 	{
 		std::vector<uchar*> rows;
@@ -192,43 +249,21 @@ scoped_allocation encode_png(const image& img, const allocator& file_alloc, cons
 		rows[0] = (uchar*)lock.mapped.data;
 		for (uint y = 1; y < si.dimensions.y; y++)
 			rows[y] = byte_add(rows[y-1], lock.mapped.row_pitch);
-		png_write_image(png_ptr, rows.data());
-		png_write_end(png_ptr, info_ptr);
+		if (!safe_write_image(png_ptr, info_ptr, rows.data()))
+			throw std::exception("png write failed");
 	}
 
 	return scoped_allocation(ws.data, ws.size, tl_alloc->deallocate);
 }
 
-image decode_png(const void* buffer, size_t size, const allocator& texel_alloc, const allocator& temp_alloc, const mip_layout& layout)
+// Reads the header and sets up transforms so rows decode to the returned format
+static info configure_read(png_structp png_ptr, png_infop info_ptr)
 {
-	tl_alloc = &temp_alloc;
-	finally reset_alloc([&] { tl_alloc = nullptr; });
-
-	// initialze libpng with user functions pointing to _pBuffer
-	png_infop info_ptr = nullptr;
-	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-	if (!png_ptr)
-		throw std::exception("png read failed");
-	finally cleanup_png_ptr([&] { png_destroy_read_struct(&png_ptr, &info_ptr, nullptr); });
-	info_ptr = png_create_info_struct(png_ptr);
-	if (!info_ptr)
-		throw std::exception("png read failed");
-
-	#pragma warning(disable:4611) // interaction between '_setjmp' and C++ object destruction is non-portable
-	if (setjmp(png_jmpbuf(png_ptr)))
-		throw std::exception("png read failed");
-	#pragma warning(default:4611) // interaction between '_setjmp' and C++ object destruction is non-portable
-
-	read_state rs;
-	rs.data = buffer;
-	rs.offset = 0;
-	png_set_read_fn(png_ptr, &rs, user_read_data);
-	png_read_info(png_ptr, info_ptr);
-
 	// Read initial information and configure the decoder accordingly
 	unsigned int w = 0, h = 0;
 	int depth = 0, color_type = 0;
-	png_get_IHDR(png_ptr, info_ptr, &w, &h, &depth, &color_type, nullptr, nullptr, nullptr);
+	if (!safe_read_header(png_ptr, info_ptr, &w, &h, &depth, &color_type))
+		throw std::exception("png read failed");
 	
 	if (depth == 16)
 		png_set_strip_16(png_ptr);
@@ -236,7 +271,7 @@ image decode_png(const void* buffer, size_t size, const allocator& texel_alloc,
 	png_set_bgr(png_ptr);
 
 	info si;
-	si.mip_layout = layout;
+	si.mip_layout = mip_layout::none;
 	si.dimensions = int3(w, h, 1);
 	switch (color_type)
 	{
@@ -260,8 +295,34 @@ image decode_png(const void* buffer, size_t size, const allocator& texel_alloc,
 			throw std::exception("unsupported gray/alpha");
 	}
 
+	if (!safe_read_update_info(png_ptr, info_ptr))
+		throw std::exception("png read failed");
+	return si;
+}
+
+image decode_png(const void* buffer, size_t size, const allocator& texel_alloc, const allocator& temp_alloc, const mip_layout& layout)
+{
+	tl_alloc = &temp_alloc;
+	finally reset_alloc([&] { tl_alloc = nullptr; });
+
+	// initialze libpng with user functions pointing to _pBuffer
+	png_infop info_ptr = nullptr;
+	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	if (!png_ptr)
+		throw std::exception("png read failed");
+	finally cleanup_png_ptr([&] { png_destroy_read_struct(&png_ptr, &info_ptr, nullptr); });
+	info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr)
+		throw std::exception("png read failed");
+
+	read_state rs;
+	rs.data = buffer;
+	rs.offset = 0;
+	png_set_read_fn(png_ptr, &rs, user_read_data);
+	info si = configure_read(png_ptr, info_ptr);
+	si.mip_layout = layout;
+
 	// Set up the surface buffer
-	png_read_update_info(png_ptr, info_ptr);
 	image img(si, texel_alloc);
 	{
 		std::vector<uchar*> rows;
@@ -272,9 +333,64 @@ image decode_png(const void* buffer, size_t size, const allocator& texel_alloc,
 		for (uint y = 1; y < si.dimensions.y; y++)
 			rows[y] = byte_add(rows[y-1], lock.mapped.row_pitch);
 
-		png_read_image(png_ptr, rows.data());
+		if (!safe_read_image(png_ptr, rows.data()))
+			throw std::exception("png read failed");
 	}
 	return img;
 }
 
+info decode_tiles_png(const stream_reader& read, const uint2& tile_dimensions, const tile_consumer& consume, const allocator& temp_alloc, const format& desired_format)
+{
+	tl_alloc = &temp_alloc;
+	finally reset_alloc([&] { tl_alloc = nullptr; });
+
+	png_infop info_ptr = nullptr;
+	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	if (!png_ptr)
+		throw std::exception("png read failed");
+	finally cleanup_png_ptr([&] { png_destroy_read_struct(&png_ptr, &info_ptr, nullptr); });
+	info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr)
+		throw std::exception("png read failed");
+
+	png_set_read_fn(png_ptr, (void*)&read, user_read_stream);
+	info si = configure_read(png_ptr, info_ptr);
+	tile_emitter emitter(si, tile_dimensions, desired_format, consume, temp_alloc);
+
+	if (png_get_interlace_type(png_ptr, info_ptr) == PNG_INTERLACE_NONE)
+	{
+		for (uint y = 0; y < si.dimensions.y; y++)
+		{
+			if (!safe_read_row(png_ptr, (png_bytep)emitter.next_row()))
+				throw std::exception("png read failed");
+			emitter.commit_row();
+		}
+	}
+
+	else
+	{
+		// Adam7 passes revisit every row so the whole image must be resident
+		image img(si, temp_alloc);
+		std::vector<uchar*> rows;
+		rows.resize(si.dimensions.y);
+		lock_guard lock(img);
+		rows[0] = (uchar*)lock.mapped.data;
+		for (uint y = 1; y < si.dimensions.y; y++)
+			rows[y] = byte_add(rows[y-1], lock.mapped.row_pitch);
+		if (!safe_read_image(png_ptr, rows.data()))
+			throw std::exception("png read failed");
+
+		const uint RowSize = row_size(si.format, si.dimensions.x);
+		for (uint y = 0; y < si.dimensions.y; y++)
+		{
+			memcpy(emitter.next_row(), rows[y], RowSize);
+			emitter.commit_row();
+		}
+	}
+
+	if (!safe_read_end(png_ptr))
+		throw std::exception("png read failed");
+	return emitter.delivered_info();
+}
+
 }}
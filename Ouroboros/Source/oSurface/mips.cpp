@@ -0,0 +1,204 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oSurface/resize.h>
+#include <oSurface/convert.h>
+#include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oHLSL/oHLSLMath.h>
+#include <oString/stringize.h>
+#include <algorithm>
+#include <vector>
+
+namespace ouro { namespace surface {
+
+static info make_level_info(const format& f, const uint2& dimensions)
+{
+	info i;
+	i.dimensions = uint3(dimensions, 1);
+	i.format = f;
+	i.mip_layout = mip_layout::none;
+	return i;
+}
+
+// A tightly-packed single-level buffer reused as the chain shrinks.
+struct level_buffer
+{
+	std::vector<uchar> bytes;
+	info inf;
+	mapped_subresource mapped;
+
+	void resize(const format& f, const uint2& dimensions)
+	{
+		inf = make_level_info(f, dimensions);
+		const size_t size = total_size(inf);
+		if (bytes.size() < size)
+			bytes.resize(size);
+		mapped = get_mapped_subresource(inf, 0, 0, bytes.data());
+	}
+};
+
+// Alpha is accessible for formats where it's the 4th 8-bit or 32-bit float
+// component.
+static bool alpha_layout(const format& f, uint* out_element_size, bool* out_float)
+{
+	switch (f)
+	{
+		case format::r8g8b8a8_unorm: case format::r8g8b8a8_unorm_srgb: case format::b8g8r8a8_unorm: case format::b8g8r8a8_unorm_srgb:
+			*out_element_size = 4;
+			*out_float = false;
+			return true;
+		case format::r32g32b32a32_float:
+			*out_element_size = 16;
+			*out_float = true;
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+static inline float get_alpha(const void* element, bool is_float)
+{
+	return is_float ? ((const float*)element)[3] : ((const uchar*)element)[3] / 255.0f;
+}
+
+static float calc_alpha_coverage(const info& i, const const_mapped_subresource& mapped, float reference, float scale)
+{
+	uint ElementSize; bool IsFloat;
+	alpha_layout(i.format, &ElementSize, &IsFloat);
+
+	uint covered = 0;
+	for (uint y = 0; y < i.dimensions.y; y++)
+	{
+		const uchar* row = (const uchar*)mapped.data + y * mapped.row_pitch;
+		for (uint x = 0; x < i.dimensions.x; x++, row += ElementSize)
+			if (get_alpha(row, IsFloat) * scale >= reference)
+				covered++;
+	}
+
+	return covered / float(i.dimensions.x * i.dimensions.y);
+}
+
+// Scales alpha so the fraction of texels at or above reference matches
+// coverage (Castano, "Computing Alpha Mipmaps").
+static void preserve_alpha_coverage(const info& i, const mapped_subresource& mapped, float reference, float coverage)
+{
+	uint ElementSize; bool IsFloat;
+	alpha_layout(i.format, &ElementSize, &IsFloat);
+
+	float lo = 0.0f, hi = 4.0f, scale = 1.0f;
+	for (int iteration = 0; iteration < 10; iteration++)
+	{
+		const float c = calc_alpha_coverage(i, mapped, reference, scale);
+		if (abs(c - coverage) < 0.001f)
+			break;
+		if (c < coverage)
+			lo = scale;
+		else
+			hi = scale;
+		scale = (lo + hi) * 0.5f;
+	}
+
+	for (uint y = 0; y < i.dimensions.y; y++)
+	{
+		uchar* row = (uchar*)mapped.data + y * mapped.row_pitch;
+		for (uint x = 0; x < i.dimensions.x; x++, row += ElementSize)
+		{
+			if (IsFloat)
+				((float*)row)[3] = saturate(((float*)row)[3] * scale);
+			else
+				row[3] = static_cast<uchar>(saturate(row[3] / 255.0f * scale) * 255.0f + 0.5f);
+		}
+	}
+}
+
+void build_mip_chain(const info& mip0_info, const const_mapped_subresource& mip0, const mip_options& options, const mip_emitter& emit)
+{
+	const format NativeFormat = mip0_info.format;
+
+	// _srgb formats without float kernels are filtered as stored
+	const bool Linearize = options.gamma_correct && is_srgb(NativeFormat)
+		&& has_row_convert(NativeFormat, format::r32g32b32a32_float)
+		&& has_row_convert(format::r32g32b32a32_float, NativeFormat);
+	const format WorkingFormat = Linearize ? format::r32g32b32a32_float : NativeFormat;
+	const bool PreserveCoverage = options.alpha_coverage_reference > 0.0f && has_alpha(NativeFormat);
+
+	uint AlphaElementSize; bool AlphaIsFloat;
+	if (PreserveCoverage && !alpha_layout(WorkingFormat, &AlphaElementSize, &AlphaIsFloat))
+		oTHROW_INVARG("alpha coverage preservation does not support %s", as_string(NativeFormat));
+
+	level_buffer levels[2];
+	info prev_info = make_level_info(WorkingFormat, mip0_info.dimensions.xy());
+	const_mapped_subresource prev = mip0;
+
+	if (Linearize)
+	{
+		levels[0].resize(WorkingFormat, prev_info.dimensions.xy());
+		convert_subresource(subresource(make_level_info(NativeFormat, prev_info.dimensions.xy()), 0), mip0, WorkingFormat, levels[0].mapped);
+		prev = levels[0].mapped;
+	}
+
+	if (!emit(0, prev_info, prev))
+		return;
+
+	const float Coverage = PreserveCoverage ? calc_alpha_coverage(prev_info, prev, options.alpha_coverage_reference, 1.0f) : 0.0f;
+	const uint nMips = num_mips(true, mip0_info.dimensions.xy());
+	for (uint mip = 1; mip < nMips; mip++)
+	{
+		level_buffer& cur = levels[mip & 1];
+		cur.resize(WorkingFormat, max(uint2(1,1), prev_info.dimensions.xy() / uint2(2,2)));
+		resize(prev_info, prev, cur.inf, cur.mapped, options.mip_filter, true);
+
+		if (PreserveCoverage)
+			preserve_alpha_coverage(cur.inf, cur.mapped, options.alpha_coverage_reference, Coverage);
+
+		if (!emit(mip, cur.inf, cur.mapped))
+			return;
+
+		prev_info = cur.inf;
+		prev = cur.mapped;
+	}
+}
+
+void generate_mips(const info& inf, void* surface_bytes, const mip_options& options)
+{
+	if (is_block_compressed(inf.format))
+		throw std::invalid_argument("block compressed formats cannot be filtered");
+
+	const uint nMips = num_mips(inf);
+	if (nMips <= 1)
+		return;
+
+	const uint nSlices = max(1u, inf.array_size);
+	const uint nDepth = max(1u, inf.dimensions.z);
+	const info mip0_info = make_level_info(inf.format, inf.dimensions.xy());
+
+	// A chain per slice and per mip0 depth slice. For 3D surfaces each level's
+	// depth slice d is built from depth slice 2d of the level above it, so the
+	// chain starting at depth d0 writes levels for as long as d0 is even.
+	ouro::parallel_for(0, nSlices * nDepth, [&](size_t index)
+	{
+		const uint slice = uint(index / nDepth);
+		const uint depth0 = uint(index % nDepth);
+		const uint mip0subresource = calc_subresource(0, slice, 0, nMips, inf.array_size);
+		const_mapped_subresource mip0 = get_const_mapped_subresource(inf, mip0subresource, depth0, surface_bytes);
+
+		build_mip_chain(mip0_info, mip0, options, [&](uint mip, const info& li, const const_mapped_subresource& level)->bool
+		{
+			if (mip == 0)
+				return true;
+
+			const uint depth = depth0 >> mip;
+			const uint subresource = calc_subresource(mip, slice, 0, nMips, inf.array_size);
+			subresource_info subinfo = surface::subresource(inf, subresource);
+			if ((depth << mip) != depth0 || depth >= subinfo.dimensions.z)
+				return false;
+
+			subresource_info leveli = surface::subresource(li, 0);
+			mapped_subresource dst = get_mapped_subresource(inf, subresource, depth, surface_bytes);
+			convert_subresource(leveli, level, inf.format, dst);
+			return true;
+		});
+	});
+}
+
+}}
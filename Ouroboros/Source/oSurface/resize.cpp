@@ -1,7 +1,12 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oSurface/resize.h>
-#include <oBase/fixed_vector.h>
+#include <oBase/throw.h>
+#include <oConcurrency/concurrency.h>
+#include <oHLSL/oHLSLMath.h>
 #include <oMemory/memory.h>
+#include <oString/stringize.h>
+#include <emmintrin.h>
+#include <algorithm>
 #include <vector>
 #include <float.h>
 
@@ -16,6 +21,7 @@ const char* as_string(const surface::filter& _Filter)
 		case surface::filter::triangle: return "triangle";
 		case surface::filter::lanczos2: return "lanczos2";
 		case surface::filter::lanczos3: return "lanczos3";
+		case surface::filter::kaiser: return "kaiser";
 		default: break;
 	}
 	return "?";
@@ -104,21 +110,59 @@ protected:
 	}
 };
 
+// Weights for one dimension of a separable resize. Every destination texel 
+// reads exactly num_taps source texels starting at left[i] so the inner loops
+// have no per-texel bounds. Weights are stored contiguously, num_taps per 
+// destination texel, and zero-padded where the filter's footprint is narrower
+// or was shifted to stay within the source.
+struct filter_table
+{
+	std::vector<int> left;
+	std::vector<float> weights;
+	int num_taps;
+
+	inline const float* weights_for(int i) const { return weights.data() + i * num_taps; }
+};
+
+// zeroth-order modified Bessel function of the first kind
+static float bessel_i0(float _Value)
+{
+	float sum = 1.0f, term = 1.0f;
+	const float halfx2 = (_Value * _Value) * 0.25f;
+	for (int k = 1; k < 32 && term > sum * 1e-7f; k++)
+	{
+		term *= halfx2 / float(k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+struct filter_kaiser
+{
+	static const int Width = 3;
+protected:
+	float value(float _Offset) const
+	{
+		static const float Alpha = 4.0f;
+		const float invWidth = 1.0f/Width;
+		float absOffset = abs(_Offset);
+		if (absOffset <= Width)
+		{
+			const float t = _Offset*invWidth;
+			return sinc(_Offset) * bessel_i0(Alpha * sqrt(1.0f - t*t)) / bessel_i0(Alpha);
+		}
+		else
+			return 0.0f;
+	}
+};
+
 template<typename T>
 struct Filter : public T
 {
 	static const int Support = 2*Width + 1;
-	struct Entry
-	{
-		fixed_vector<float, Support> Cache;
-		int Left, Right;
-	};
-	std::vector<Entry> FilterCache;
 
-	void InitFilter(int srcDim, int dstDim)
+	void InitFilter(int srcDim, int dstDim, filter_table* out_table)
 	{
-		FilterCache.resize(dstDim);
-
 		//this is a hack for magnification. need to widen the filter since our source is actually discrete, but the math is mostly continuous, otherwise nothing to grab from adjacent pixels.
 		float scale = dstDim/(float)srcDim;
 		if (scale <= 1.0f)
@@ -128,134 +172,279 @@ struct Filter : public T
 		float halfPixel = 0.5f/dstDim;
 		float srcHalfPixel = 0.5f/srcDim;
 
+		const int NumTaps = srcDim < Support ? srcDim : Support;
+		out_table->num_taps = NumTaps;
+		out_table->left.resize(dstDim);
+		out_table->weights.assign(dstDim * NumTaps, 0.0f);
+
 		for (int i = 0; i < dstDim; i++)
 		{
 			float dstCenter = i / (float)dstDim + halfPixel;
 			int closestSource = static_cast<int>(round((dstCenter - srcHalfPixel) * srcDim));
 			
-			auto& entry = FilterCache[i];
-			entry.Left = std::max(closestSource - Width, 0);
-			entry.Right = std::min(closestSource + Width, srcDim-1);
+			const int Left = std::max(closestSource - Width, 0);
+			const int Right = std::min(closestSource + Width, srcDim-1);
+
+			// keep the footprint inside the source; this keeps left monotonic 
+			// which the vertical pass's row ring depends on.
+			const int TableLeft = std::min(Left, srcDim - NumTaps);
+			out_table->left[i] = TableLeft;
+			float* w = out_table->weights.data() + i * NumTaps;
 
 			float totalWeight = 0;
-			for (int j = entry.Left; j <= entry.Right; ++j)
+			for (int j = Left; j <= Right; ++j)
 			{
 				float loc = (j / (float)srcDim) + srcHalfPixel;
 				float filterLoc = (loc - dstCenter)*dstDim*scale;
 				float weight = value(filterLoc);
-				if (abs(weight) < std::numeric_limits<float>::epsilon() && entry.Cache.empty()) //strip any if we don't have a real weight yet.
-				{
-					entry.Left++;
-				}
-				else
-				{
-					totalWeight += weight;
-					entry.Cache.push_back(weight);
-				}
-			}
-			for (int j = entry.Right; j >= entry.Left; --j)
-			{
-				if (abs(entry.Cache[j - entry.Left]) < std::numeric_limits<float>::epsilon())
-				{
-					--entry.Right;
-					entry.Cache.pop_back();
-				}
-				else
-				{
-					break;
-				}
+				if (abs(weight) < std::numeric_limits<float>::epsilon())
+					weight = 0.0f;
+				totalWeight += weight;
+				w[j - TableLeft] = weight;
 			}
 
-			for (int j = entry.Left; j <= entry.Right; ++j)
-			{
-				entry.Cache[j - entry.Left] /= totalWeight;
-			}
+			for (int j = 0; j < NumTaps; ++j)
+				w[j] /= totalWeight;
 		}
 	}
 };
 
-template<typename FILTER, size_t ELEMENT_SIZE>
-void resize_horizontal(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst)
+// Texel storage types. The filter runs on float rows with the same numeric 
+// range as the storage type. 8-bit results are truncated by default so they 
+// match the historical path and its golden images.
+enum class component_type
 {
-	if (src_info.dimensions.y != dst_info.dimensions.y)
-		throw std::invalid_argument("Horizontal resize assumes y dimensions are the same for source and destination");
+	unorm8,
+	unorm16,
+	float16,
+	float32,
+};
 
-	FILTER filter;
-	filter.InitFilter(src_info.dimensions.x, dst_info.dimensions.x);
+static bool get_component_type(const format& f, component_type* out_type, int* out_num_channels)
+{
+	switch (f)
+	{
+		case format::r32g32b32a32_float: case format::r32g32b32_float: case format::r32g32_float: case format::r32_float:
+			*out_type = component_type::float32;
+			*out_num_channels = element_size(f) / 4;
+			return true;
+		case format::r16g16b16a16_float: case format::r16g16_float: case format::r16_float:
+			*out_type = component_type::float16;
+			*out_num_channels = element_size(f) / 2;
+			return true;
+		case format::r16g16b16a16_unorm: case format::r16g16_unorm: case format::r16_unorm:
+			*out_type = component_type::unorm16;
+			*out_num_channels = element_size(f) / 2;
+			return true;
+		default:
+			break;
+	}
 
-	const char* srcData = (char*)src.data;
-	char* dstData = (char*)dst.data;
+	// historically anything up to 4 bytes per texel was filtered a byte at a time
+	const int ElementSize = element_size(f);
+	if (ElementSize > 4)
+		return false;
+	*out_type = component_type::unorm8;
+	*out_num_channels = ElementSize;
+	return true;
+}
 
-	for (uint y = 0; y < dst_info.dimensions.y; y++)
+static void decode_row(component_type type, const void* oRESTRICT src, float* oRESTRICT dst, uint num_components)
+{
+	switch (type)
 	{
-		const uchar* oRESTRICT srcRow = (uchar*)byte_add(srcData, y*src.row_pitch);
-		uchar* oRESTRICT dstRow = (uchar*)byte_add(dstData, y*dst.row_pitch);
-
-		for (uint x = 0; x < dst_info.dimensions.x; x++)
-		{
-			auto& filterEntry = filter.FilterCache[x];
-			std::array<float, ELEMENT_SIZE> result;
-			result.fill(0.0f);
+		case component_type::unorm8: { const uchar* s = (const uchar*)src; for (uint i = 0; i < num_components; i++) dst[i] = float(s[i]); break; }
+		case component_type::unorm16: { const ushort* s = (const ushort*)src; for (uint i = 0; i < num_components; i++) dst[i] = float(s[i]); break; }
+		case component_type::float16: { const ushort* s = (const ushort*)src; for (uint i = 0; i < num_components; i++) dst[i] = f16tof32(s[i]); break; }
+		case component_type::float32: memcpy(dst, src, num_components * sizeof(float)); break;
+		default: oASSUME(0);
+	}
+}
 
-			for (int srcX = filterEntry.Left; srcX <= filterEntry.Right; srcX++)
-			{
-				for (size_t i = 0; i < ELEMENT_SIZE; i++)
-				{
-					float src = srcRow[srcX*ELEMENT_SIZE + i];
-					src *= filterEntry.Cache[srcX - filterEntry.Left];
-					result[i] += src;
-				}
-			}
-			
-			for (size_t i = 0; i < ELEMENT_SIZE; i++)
-				dstRow[x*ELEMENT_SIZE + i] = static_cast<uchar>(clamp(result[i], 0.0f, 255.0f));
-		}
+// unorm8_bias is 0.5f to round 8-bit results to nearest, 0.0f to truncate.
+static void encode_row(component_type type, float unorm8_bias, const float* oRESTRICT src, void* oRESTRICT dst, uint num_components)
+{
+	switch (type)
+	{
+		case component_type::unorm8: { uchar* d = (uchar*)dst; for (uint i = 0; i < num_components; i++) d[i] = static_cast<uchar>(clamp(src[i], 0.0f, 255.0f) + unorm8_bias); break; }
+		case component_type::unorm16: { ushort* d = (ushort*)dst; for (uint i = 0; i < num_components; i++) d[i] = static_cast<ushort>(clamp(src[i], 0.0f, 65535.0f) + 0.5f); break; }
+		case component_type::float16: { ushort* d = (ushort*)dst; for (uint i = 0; i < num_components; i++) d[i] = static_cast<ushort>(f32tof16(src[i])); break; }
+		case component_type::float32: memcpy(dst, src, num_components * sizeof(float)); break;
+		default: oASSUME(0);
 	}
 }
 
-template<typename FILTER, int ELEMENT_SIZE>
-void resize_vertical(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst)
+// Filters one decoded row of NumChannels-interleaved floats horizontally.
+template<int NumChannels>
+static void filter_row(const filter_table& t, const float* oRESTRICT src, float* oRESTRICT dst, uint dst_width)
 {
-	if (src_info.dimensions.x != dst_info.dimensions.x)
-		throw std::invalid_argument("vertical resize assumes x dimensions are the same for source and destination");
+	const int NumTaps = t.num_taps;
+	for (uint x = 0; x < dst_width; x++)
+	{
+		const float* oRESTRICT s = src + t.left[x] * NumChannels;
+		const float* oRESTRICT w = t.weights_for(x);
+		float result[NumChannels] = {0};
+		for (int tap = 0; tap < NumTaps; tap++, s += NumChannels)
+			for (int c = 0; c < NumChannels; c++)
+				result[c] += s[c] * w[tap];
+		for (int c = 0; c < NumChannels; c++)
+			dst[x*NumChannels + c] = result[c];
+	}
+}
 
-	FILTER filter;
-	filter.InitFilter(src_info.dimensions.y, dst_info.dimensions.y);
+// 4-channel texels fill an SSE register, so each tap is one multiply-add.
+template<>
+void filter_row<4>(const filter_table& t, const float* oRESTRICT src, float* oRESTRICT dst, uint dst_width)
+{
+	const int NumTaps = t.num_taps;
+	for (uint x = 0; x < dst_width; x++)
+	{
+		const float* oRESTRICT s = src + t.left[x] * 4;
+		const float* oRESTRICT w = t.weights_for(x);
+		__m128 result = _mm_setzero_ps();
+		for (int tap = 0; tap < NumTaps; tap++, s += 4)
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(s), _mm_set1_ps(w[tap])));
+		_mm_storeu_ps(dst + x*4, result);
+	}
+}
 
-	const uchar* oRESTRICT srcData = (uchar*)src.data;
-	uchar* oRESTRICT dstData = (uchar*)dst.data;
+typedef void (*filter_row_fn)(const filter_table& t, const float* oRESTRICT src, float* oRESTRICT dst, uint dst_width);
 
-	for (uint y = 0; y < dst_info.dimensions.y; y++)
+static filter_row_fn get_filter_row(int num_channels)
+{
+	switch (num_channels)
 	{
-		uchar* oRESTRICT dstRow = byte_add(dstData, y*dst.row_pitch);
+		case 1: return filter_row<1>;
+		case 2: return filter_row<2>;
+		case 3: return filter_row<3>;
+		case 4: return filter_row<4>;
+		default: break;
+	}
+	throw std::invalid_argument("unsupported number of channels");
+}
 
-		for (uint x = 0; x < dst_info.dimensions.x; x++)
+// dst = sum(rows[i] * weights[i]) over whole rows: contiguous for any channel 
+// count so this is where most of the vectorization pays off.
+static void filter_column(const float* const* rows, const float* weights, int num_taps, float* oRESTRICT dst, uint num_components)
+{
+	uint i = 0;
+	for (; i + 8 <= num_components; i += 8)
+	{
+		__m128 a = _mm_setzero_ps();
+		__m128 b = _mm_setzero_ps();
+		for (int tap = 0; tap < num_taps; tap++)
 		{
-			auto& filterEntry = filter.FilterCache[y];
-			std::array<float, ELEMENT_SIZE> result;
-			result.fill(0.0f);
+			const __m128 w = _mm_set1_ps(weights[tap]);
+			a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(rows[tap] + i), w));
+			b = _mm_add_ps(b, _mm_mul_ps(_mm_loadu_ps(rows[tap] + i + 4), w));
+		}
+		_mm_storeu_ps(dst + i, a);
+		_mm_storeu_ps(dst + i + 4, b);
+	}
 
-			for (int srcY = filterEntry.Left;srcY <= filterEntry.Right; ++srcY)
-			{
-				const uchar* oRESTRICT srcElement = byte_add(srcData, srcY*src.row_pitch + x*ELEMENT_SIZE);
+	for (; i < num_components; i++)
+	{
+		float result = 0.0f;
+		for (int tap = 0; tap < num_taps; tap++)
+			result += rows[tap][i] * weights[tap];
+		dst[i] = result;
+	}
+}
 
-				for (size_t i = 0;i < ELEMENT_SIZE; i++)
-				{
-					float src = srcElement[i];
-					src *= filterEntry.Cache[srcY - filterEntry.Left];
-					result[i] += src;
-				}
-			}
-			for (size_t i = 0;i < ELEMENT_SIZE; i++)
+// widest vertical footprint (lanczos3 is 7)
+static const int kMaxTaps = 16;
+
+struct resize_job
+{
+	component_type type;
+	float unorm8_bias;
+	int num_channels;
+	uint2 src_dimensions;
+	uint2 dst_dimensions;
+	filter_table horizontal;
+	filter_table vertical;
+	filter_row_fn filter_row;
+	const_mapped_subresource src;
+	mapped_subresource dst;
+};
+
+// Produces destination rows [first_row, end_row). Each source row the band 
+// needs is decoded and horizontally filtered exactly once into a ring of 
+// num_taps rows, so the source is streamed top to bottom rather than walked 
+// by columns. Any row is computed the same way regardless of how the image 
+// is banded, so results do not depend on the number of threads.
+static void resize_band(const resize_job& j, uint first_row, uint end_row)
+{
+	const uint SrcComponents = j.src_dimensions.x * j.num_channels;
+	const uint DstComponents = j.dst_dimensions.x * j.num_channels;
+	const int NumTaps = j.vertical.num_taps;
+	const bool ResizeX = j.src_dimensions.x != j.dst_dimensions.x;
+
+	std::vector<float> scratch((ResizeX ? SrcComponents : 0) + DstComponents * (NumTaps + 1));
+	float* decoded = scratch.data();
+	float* ring = decoded + (ResizeX ? SrcComponents : 0);
+	float* result = ring + DstComponents * NumTaps;
+
+	const float* rows[kMaxTaps];
+	int next_row = j.vertical.left[first_row];
+
+	for (uint y = first_row; y < end_row; y++)
+	{
+		const int Left = j.vertical.left[y];
+		next_row = std::max(next_row, Left);
+		for (; next_row < Left + NumTaps; next_row++)
+		{
+			float* filtered = ring + (next_row % NumTaps) * DstComponents;
+			const void* srow = byte_add(j.src.data, next_row * j.src.row_pitch);
+			if (ResizeX)
 			{
-				dstRow[x*ELEMENT_SIZE + i] = static_cast<uchar>(clamp(result[i], 0.0f, 255.0f));
+				decode_row(j.type, srow, decoded, SrcComponents);
+				j.filter_row(j.horizontal, decoded, filtered, j.dst_dimensions.x);
 			}
+			else
+				decode_row(j.type, srow, filtered, SrcComponents);
 		}
+
+		for (int tap = 0; tap < NumTaps; tap++)
+			rows[tap] = ring + ((Left + tap) % NumTaps) * DstComponents;
+
+		filter_column(rows, j.vertical.weights_for(y), NumTaps, result, DstComponents);
+		encode_row(j.type, j.unorm8_bias, result, byte_add(j.dst.data, y * j.dst.row_pitch), DstComponents);
 	}
 }
 
-template<typename FILTER, int ELEMENT_SIZE>
-void resize_internal(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst)
+// bands smaller than this are not worth a task
+static const uint kMinParallelTexels = 64 * 1024;
+
+template<typename FILTER>
+void resize_separable(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, bool round_to_nearest)
+{
+	resize_job j;
+	if (!get_component_type(src_info.format, &j.type, &j.num_channels))
+		throw std::invalid_argument(formatf("resize does not support %s", as_string(src_info.format)));
+	j.unorm8_bias = round_to_nearest ? 0.5f : 0.0f;
+
+	j.src_dimensions = src_info.dimensions.xy();
+	j.dst_dimensions = dst_info.dimensions.xy();
+	j.src = src;
+	j.dst = dst;
+	j.filter_row = get_filter_row(j.num_channels);
+
+	FILTER filter;
+	filter.InitFilter(j.src_dimensions.x, j.dst_dimensions.x, &j.horizontal);
+	filter.InitFilter(j.src_dimensions.y, j.dst_dimensions.y, &j.vertical);
+
+	if (j.vertical.num_taps > kMaxTaps)
+		throw std::invalid_argument("filter support too wide");
+
+	if (j.dst_dimensions.x * j.dst_dimensions.y < kMinParallelTexels)
+		resize_band(j, 0, j.dst_dimensions.y);
+	else
+		parallel_for_range(0, j.dst_dimensions.y, [&](size_t begin, size_t end) { resize_band(j, uint(begin), uint(end)); });
+}
+
+template<typename FILTER>
+void resize_internal(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, bool round_to_nearest)
 {
 	// Assuming all our filters are separable for now.
 
@@ -263,11 +452,12 @@ void resize_internal(const info& src_info, const const_mapped_subresource& src,
 		copy(src_info, src, dst);
 	else if (FILTER::Support == 1) // point sampling
 	{		
+		const int ElementSize = element_size(src_info.format);
 		const char* srcData = (char*)src.data;
 		char* dstData = (char*)dst.data;
 
 		// Bresenham style for x
-		int fixedStep = (src_info.dimensions.x / dst_info.dimensions.x)*ELEMENT_SIZE;
+		int fixedStep = (src_info.dimensions.x / dst_info.dimensions.x)*ElementSize;
 		int remainder = (src_info.dimensions.x % dst_info.dimensions.x);
 
 		for (uint y = 0; y < dst_info.dimensions.y; y++)
@@ -279,54 +469,28 @@ void resize_internal(const info& src_info, const const_mapped_subresource& src,
 			uint step = 0;
 			for (uint x = 0; x < dst_info.dimensions.x; ++x)
 			{
-				for (size_t i = 0; i < ELEMENT_SIZE; i++)
-					*dstRow++ = *(srcRow+i);
+				memcpy(dstRow, srcRow, ElementSize);
+				dstRow += ElementSize;
 				srcRow += fixedStep;
 				step += remainder;
 				if (step >= dst_info.dimensions.x)
 				{
-					srcRow += ELEMENT_SIZE;
+					srcRow += ElementSize;
 					step -= dst_info.dimensions.x;
 				}
 			}
 		}
 	}
 	else // have to run a real filter
-	{
-		if (src_info.dimensions.x == dst_info.dimensions.x) //Only need a y filter
-			resize_vertical<FILTER, ELEMENT_SIZE>(src_info, src, dst_info, dst);
-		else if (src_info.dimensions.y == dst_info.dimensions.y) //Only need a x filter
-			resize_horizontal<FILTER, ELEMENT_SIZE>(src_info, src, dst_info, dst);
-		else if (dst_info.dimensions.x*src_info.dimensions.y <= dst_info.dimensions.y*src_info.dimensions.x) // more efficient to run x filter then y
-		{
-			info tempInfo = src_info;
-			tempInfo.dimensions.x = dst_info.dimensions.x;
-			tempInfo.mip_layout = mip_layout::tight;
-			std::vector<char> tempImage;
-			tempImage.resize(total_size(tempInfo));
-
-			mapped_subresource tempMap = get_mapped_subresource(tempInfo, 0, 0, tempImage.data());
-			resize_horizontal<FILTER, ELEMENT_SIZE>(src_info, src, tempInfo, tempMap);
-			const_mapped_subresource tempMapConst = tempMap;
-			resize_vertical<FILTER, ELEMENT_SIZE>(tempInfo, tempMapConst, dst_info, dst);
-		}
-		else // more efficient to run y filter then x
-		{
-			info tempInfo = src_info;
-			tempInfo.dimensions.y = dst_info.dimensions.y;
-			tempInfo.mip_layout = mip_layout::tight;
-			std::vector<char> tempImage; // todo: fix internal allocation
-			tempImage.resize(total_size(tempInfo));
-
-			mapped_subresource tempMap = get_mapped_subresource(tempInfo, 0, 0, tempImage.data());
-			resize_vertical<FILTER, ELEMENT_SIZE>(src_info, src, tempInfo, tempMap);
-			const_mapped_subresource tempMapConst = tempMap;
-			resize_horizontal<FILTER, ELEMENT_SIZE>(tempInfo, tempMapConst, dst_info, dst);
-		}
-	}
+		resize_separable<FILTER>(src_info, src, dst_info, dst, round_to_nearest);
 }
 
 void resize(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, const filter& f)
+{
+	resize(src_info, src, dst_info, dst, f, false);
+}
+
+void resize(const info& src_info, const const_mapped_subresource& src, const info& dst_info, const mapped_subresource& dst, const filter& f, bool round_to_nearest)
 {
 	if (src_info.mip_layout != dst_info.mip_layout || src_info.format != dst_info.format)
 		throw std::invalid_argument("incompatible surfaces");
@@ -334,19 +498,7 @@ void resize(const info& src_info, const const_mapped_subresource& src, const inf
 	if (is_block_compressed(src_info.format))
 		throw std::invalid_argument("block compressed formats cannot be resized");
 
-	const int elementSize = element_size(src_info.format);
-
-	#define FILTER_CASE(filter_type) \
-	case filter::filter_type: \
-	{	switch (elementSize) \
-		{	case 1: resize_internal<Filter<filter_##filter_type>,1>(src_info, src, dst_info, dst); break; \
-			case 2: resize_internal<Filter<filter_##filter_type>,2>(src_info, src, dst_info, dst); break; \
-			case 3: resize_internal<Filter<filter_##filter_type>,3>(src_info, src, dst_info, dst); break; \
-			case 4: resize_internal<Filter<filter_##filter_type>,4>(src_info, src, dst_info, dst); break; \
-			default: oASSUME(0); \
-		} \
-		break; \
-	}
+	#define FILTER_CASE(filter_type) case filter::filter_type: resize_internal<Filter<filter_##filter_type>>(src_info, src, dst_info, dst, round_to_nearest); break;
 
 	switch (f)
 	{
@@ -355,6 +507,7 @@ void resize(const info& src_info, const const_mapped_subresource& src, const inf
 		FILTER_CASE(triangle)
 		FILTER_CASE(lanczos2)
 		FILTER_CASE(lanczos3)
+		FILTER_CASE(kaiser)
 		default: throw std::invalid_argument("unsupported filter type");
 	}
 
@@ -98,10 +98,10 @@ static const subformats kSFD_BC4_3 = {format::bc4_unorm, format::bc4_unorm, form
 static const format_info sFormatInfo[] = 
 {
   { "unknown",                    kUnknownFCC,  kUnknownBits, kNoSubformats,    0, 0, 0, traits::none },
-  { "r32g32b32a32_typeless",      oFCC('?i4 '), kBS_4_32,     kNoSubformats,  128, 4, 1, traits::has_alpha },
-  { "r32g32b32a32_float",         oFCC('f4  '), kBS_4_32,     kNoSubformats,  128, 4, 1, traits::has_alpha },
-  { "r32g32b32a32_uint",          oFCC('ui4 '), kBS_4_32,     kNoSubformats,  128, 4, 1, traits::has_alpha },
-  { "r32g32b32a32_sint",          oFCC('si4 '), kBS_4_32,     kNoSubformats,  128, 4, 1, traits::has_alpha },
+  { "r32g32b32a32_typeless",      oFCC('?i4 '), kBS_4_32,     kNoSubformats,   16, 4, 1, traits::has_alpha },
+  { "r32g32b32a32_float",         oFCC('f4  '), kBS_4_32,     kNoSubformats,   16, 4, 1, traits::has_alpha },
+  { "r32g32b32a32_uint",          oFCC('ui4 '), kBS_4_32,     kNoSubformats,   16, 4, 1, traits::has_alpha },
+  { "r32g32b32a32_sint",          oFCC('si4 '), kBS_4_32,     kNoSubformats,   16, 4, 1, traits::has_alpha },
   { "r32g32b32_typeless",         oFCC('?i3 '), kBS_3_32,     kNoSubformats,   12, 3, 1, traits::has_alpha },
   { "r32g32b32_float",            oFCC('f3  '), kBS_3_32,     kNoSubformats,   12, 3, 1, traits::none },
   { "r32g32b32_uint",             oFCC('ui3 '), kBS_3_32,     kNoSubformats,   12, 3, 1, traits::none },
@@ -1042,14 +1042,13 @@ uint slice_pitch(const info& inf, uint subsurface)
 
 		case mip_layout::tight:
 		{
-			// Sum the size of all mip levels
-			int3 dimensions = inf.dimensions;
-			int nMips = num_mips(inf.mip_layout, dimensions);
-			while (nMips > 0)
+			// Sum the size of all mip levels, block-aligned the same way offset_tight
+			// sees them
+			const int nMips = num_mips(inf.mip_layout, inf.dimensions);
+			for (int mip = 0; mip < nMips; mip++)
 			{
-				pitch += mip_size(inf.format, dimensions.xy(), subsurface) * dimensions.z;
-				dimensions = ::max(int3(1,1,1), dimensions / int3(2,2,2));
-				nMips--;
+				auto mipDimensions = dimensions_npot(inf.format, inf.dimensions, mip, subsurface);
+				pitch += mip_size(inf.format, mipDimensions.xy(), subsurface) * mipDimensions.z;
 			}
 
 			// Align slicePitch to mip0RowPitch
@@ -104,6 +104,42 @@ void compare_load(test_services& services, const char* path, const char* desktop
 	save_bmp_to_desktop(decoded, fname);
 }
 
+// Decodes through a reader that returns small chunks and reassembles the tiles,
+// which must match a whole-buffer decode exactly and arrive in tile id order.
+static void compare_streamed(test_services& _Services, const char* _Path, const uint2& _TileDimensions)
+{
+	auto encoded = _Services.load_buffer(_Path);
+	surface::image expected = surface::decode(encoded, encoded.size(), surface::format::b8g8r8a8_unorm);
+	surface::info si = expected.get_info();
+	surface::image assembled(si);
+
+	size_t offset = 0;
+	auto read = [&](void* dst, size_t size)->size_t
+	{
+		size_t n = min(min(size, size_t(1000)), encoded.size() - offset);
+		memcpy(dst, (const uchar*)encoded + offset, n);
+		offset += n;
+		return n;
+	};
+
+	uint next_tile_id = 0;
+	auto consume = [&](const surface::tile_info& tile, const surface::const_mapped_subresource& mapped)
+	{
+		surface::tile_info nominal = tile;
+		nominal.dimensions = min(_TileDimensions, si.dimensions.xy());
+		uint2 position;
+		const uint id = surface::calc_tile_id(si, nominal, &position);
+		oCHECK(id == next_tile_id++, "%s: tile %u arrived out of order", _Path, id);
+
+		surface::box region(tile.position.x, tile.position.x + tile.dimensions.x, tile.position.y, tile.position.y + tile.dimensions.y);
+		assembled.update_subresource(0, region, mapped);
+	};
+
+	surface::info di = surface::decode_tiles(read, _TileDimensions, consume, default_allocator, surface::format::b8g8r8a8_unorm);
+	oCHECK(di == si, "%s: streamed info differs from decode", _Path);
+	oCHECK(surface::calc_rms(expected, assembled) == 0.0f, "%s: streamed decode differs from decode", _Path);
+}
+
 void TESTsurface_codec(test_services& _Services)
 {
 	// still a WIP
@@ -115,6 +151,10 @@ void TESTsurface_codec(test_services& _Services)
 	compare_checkboards(uint2(11,21), surface::format::b8g8r8a8_unorm, surface::file_format::jpg, 4.0f);
 	compare_checkboards(uint2(11,21), surface::format::b8g8r8a8_unorm, surface::file_format::png, 1.0f);
 	compare_checkboards(uint2(11,21), surface::format::b8g8r8a8_unorm, surface::file_format::tga, 1.0f);
+
+	compare_streamed(_Services, "Test/Textures/lena_1.png", uint2(64,32));
+	compare_streamed(_Services, "Test/Textures/lena_1.jpg", uint2(~0u,16));
+	compare_streamed(_Services, "Test/Textures/lena_1.tga", uint2(100,100));
 }
 
 	}
@@ -0,0 +1,151 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oSurface/codec_batch.h>
+#include <oBase/throw.h>
+#include <oCore/filesystem.h>
+#include <oString/fixed_string.h>
+#include <string>
+#include <vector>
+
+#include "../../test_services.h"
+
+namespace ouro {
+	namespace tests {
+
+static const char* sTextures[] =
+{
+	"Test/Textures/Blue.png",
+	"Test/Textures/Cube.dds",
+	"Test/Textures/CubeNegX.png",
+	"Test/Textures/CubePosX.png",
+	"Test/Textures/OldPlasterBump.jpg",
+	"Test/Textures/OldPlasterDiffuse.jpg",
+	"Test/Textures/OldPlasterNormal.jpg",
+	"Test/Textures/UVTest.png",
+	"Test/Textures/lena444_1.jpg",
+	"Test/Textures/lena_1.bmp",
+	"Test/Textures/lena_1.dds",
+	"Test/Textures/lena_1.jpg",
+	"Test/Textures/lena_1.png",
+	"Test/Textures/lena_1.tga",
+	"Test/Textures/lena_layout_below.jpg",
+	"Test/Textures/lena_layout_below.png",
+	"Test/Textures/lena_npot.png",
+};
+
+// each file is decoded this many times so there's enough work to spread
+static const uint kRepeat = 8;
+
+static void report(test_services& _Services, const char* _Name, const surface::batch_stats& _Stats)
+{
+	_Services.report("%s: %u images in %.3f sec, %.1f images/s, %.1f MB/s encoded, %.1f MB/s decoded (%u arenas, %u overflows)"
+		, _Name, _Stats.num_images, _Stats.wall_seconds, _Stats.images_per_second(), _Stats.encoded_mb_per_second(), _Stats.decoded_mb_per_second(), _Stats.num_arenas, _Stats.arena_overflows);
+}
+
+void TESTsurface_codec_batch(test_services& _Services)
+{
+	const uint nFiles = oCOUNTOF(sTextures);
+	const uint nItems = nFiles * kRepeat;
+
+	std::vector<scoped_allocation> files(nFiles);
+	std::vector<const void*> buffers(nItems);
+	std::vector<size_t> sizes(nItems);
+	for (uint i = 0; i < nFiles; i++)
+		files[i] = _Services.load_buffer(sTextures[i]);
+	for (uint i = 0; i < nItems; i++)
+	{
+		buffers[i] = files[i % nFiles];
+		sizes[i] = files[i % nFiles].size();
+	}
+
+	// failures are called from workers, so record them and throw afterward
+	std::vector<std::string> errors(nItems);
+	auto fail = [&](size_t index, const char* error) { errors[index] = error; };
+	auto check_batch = [&](const char* name, const surface::batch_stats& stats)
+	{
+		report(_Services, name, stats);
+		if (stats.num_failed)
+			for (size_t i = 0; i < errors.size(); i++)
+				if (!errors[i].empty())
+					oTHROW(io_error, "%s: item %u failed: %s", name, uint(i), errors[i].c_str());
+	};
+
+	// serial baseline
+	std::vector<surface::image> expected(nFiles);
+	{
+		test_services::timer t(_Services);
+		for (uint i = 0; i < nItems; i++)
+		{
+			surface::image img = surface::decode(buffers[i], sizes[i]);
+			if (i < nFiles)
+				expected[i] = std::move(img);
+		}
+		_Services.report("serial decode: %u images in %.3f sec, %.1f images/s", nItems, t.seconds(), nItems / t.seconds());
+	}
+
+	// in-memory batch must match the serial decode exactly
+	std::vector<surface::image> decoded(nItems);
+	surface::batch_stats stats = surface::decode_batch(buffers.data(), sizes.data(), nItems
+		, [&](size_t index, surface::image& img) { decoded[index] = std::move(img); }, surface::batch_options(), fail);
+	check_batch("decode_batch", stats);
+	oCHECK(stats.num_images == nItems, "decode_batch processed %u of %u images", stats.num_images, nItems);
+	for (uint i = 0; i < nItems; i++)
+	{
+		const surface::image& e = expected[i % nFiles];
+		oCHECK(decoded[i].get_info() == e.get_info(), "%s: batch info differs from decode", sTextures[i % nFiles]);
+		oCHECK(surface::calc_rms(e, decoded[i]) == 0.0f, "%s: batch decode differs from decode", sTextures[i % nFiles]);
+	}
+
+	// from paths, converting to a format every encoder accepts
+	std::vector<surface::image> bgra(nItems);
+	{
+		path_string root;
+		_Services.test_root_path(root, root.capacity());
+
+		std::vector<path> paths(nFiles);
+		std::vector<const char*> cpaths(nItems);
+		for (uint i = 0; i < nFiles; i++)
+			paths[i] = path(root) / path(sTextures[i]);
+		for (uint i = 0; i < nItems; i++)
+			cpaths[i] = paths[i % nFiles].c_str();
+
+		surface::batch_options o;
+		o.desired_format = surface::format::b8g8r8a8_unorm;
+		stats = surface::decode_batch(cpaths.data(), nItems, [&](size_t index, surface::image& img) { bgra[index] = std::move(img); }, o, fail);
+		check_batch("decode_batch (paths, bgra)", stats);
+		_Services.report("  read %.1f MB/s, decode %.1f MB/s per thread", stats.read_mb_per_second(), stats.decode_mb_per_second());
+		oCHECK(stats.read_bytes == stats.encoded_bytes, "decode_batch read %llu bytes but decoded %llu", stats.read_bytes, stats.encoded_bytes);
+	}
+
+	// encode the 2D images and round-trip the lossless formats
+	{
+		std::vector<const surface::image*> images;
+		for (const auto& img : bgra)
+			if (!img.get_info().is_array())
+				images.push_back(&img);
+		const uint nImages = uint(images.size());
+
+		static const surface::file_format kFormats[] = { surface::file_format::png, surface::file_format::jpg, surface::file_format::tga };
+		for (const auto& ff : kFormats)
+		{
+			std::vector<scoped_allocation> encoded(nImages);
+			stats = surface::encode_batch(images.data(), nImages, ff
+				, [&](size_t index, scoped_allocation& file) { encoded[index] = std::move(file); }, surface::batch_options(), fail);
+
+			mstring name;
+			snprintf(name, "encode_batch (%s)", as_string(ff));
+			check_batch(name, stats);
+
+			if (ff == surface::file_format::jpg)
+				continue;
+
+			for (uint i = 0; i < nImages; i++)
+			{
+				surface::image roundtrip = surface::decode(encoded[i], surface::format::b8g8r8a8_unorm);
+				oCHECK(surface::calc_rms(*images[i], roundtrip) == 0.0f, "%s round-trip of image %u differs", as_string(ff), i);
+			}
+		}
+	}
+}
+
+	}
+}
@@ -0,0 +1,162 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#include <oSurface/convert.h>
+#include <oBase/throw.h>
+#include <oString/stringize.h>
+#include <algorithm>
+#include <vector>
+
+#include "../../test_services.h"
+
+namespace ouro {
+	namespace tests {
+
+struct convert_pair
+{
+	surface::format src;
+	surface::format dst;
+};
+
+static const convert_pair sPairs[] =
+{
+	{ surface::format::r8g8b8a8_unorm, surface::format::r8g8b8_unorm },
+	{ surface::format::r8g8b8_unorm, surface::format::r8g8b8a8_unorm },
+	{ surface::format::r8g8b8_unorm, surface::format::b8g8r8a8_unorm },
+	{ surface::format::b8g8r8a8_unorm, surface::format::b8g8r8_unorm },
+	{ surface::format::b8g8r8a8_unorm, surface::format::r8g8b8_unorm },
+	{ surface::format::b8g8r8_unorm, surface::format::r8g8b8a8_unorm },
+	{ surface::format::b8g8r8_unorm, surface::format::a8b8g8r8_unorm },
+	{ surface::format::a8b8g8r8_unorm, surface::format::b8g8r8_unorm },
+	{ surface::format::a8b8g8r8_unorm, surface::format::b8g8r8a8_unorm },
+	{ surface::format::b8g8r8_unorm, surface::format::r8g8b8_unorm },
+	{ surface::format::r8g8b8a8_unorm, surface::format::b8g8r8a8_unorm },
+	{ surface::format::r8g8b8a8_unorm, surface::format::r32g32b32a32_float },
+	{ surface::format::r32g32b32a32_float, surface::format::r8g8b8a8_unorm },
+	{ surface::format::r8g8b8a8_unorm_srgb, surface::format::r32g32b32a32_float },
+	{ surface::format::r32g32b32a32_float, surface::format::r8g8b8a8_unorm_srgb },
+};
+
+static void fill_random(test_services& _Services, const surface::format& _Format, std::vector<uchar>& _Buffer)
+{
+	if (_Format == surface::format::r32g32b32a32_float)
+	{
+		// exercise clamping on both ends as well as the full unorm range
+		float* f = (float*)_Buffer.data();
+		const size_t n = _Buffer.size() / sizeof(float);
+		for (size_t i = 0; i < n; i++)
+			f[i] = ((_Services.rand() % 1500) - 250) / 1000.0f;
+	}
+	else
+		for (auto& b : _Buffer)
+			b = uchar(_Services.rand());
+}
+
+static void TESTsurface_convert_rows(test_services& _Services, const convert_pair& _Pair)
+{
+	const uint kMaxPixels = 67; // covers every simd width plus a scalar tail
+	const uint SrcSize = surface::element_size(_Pair.src);
+	const uint DstSize = surface::element_size(_Pair.dst);
+
+	std::vector<uchar> src(SrcSize * kMaxPixels);
+	std::vector<uchar> expected(DstSize * kMaxPixels + 1);
+	std::vector<uchar> result(DstSize * kMaxPixels + 1);
+	fill_random(_Services, _Pair.src, src);
+
+	surface::row_convert reference = surface::get_row_convert(_Pair.src, _Pair.dst, surface::simd_level::scalar);
+
+	for (int level = 1; level <= (int)surface::max_simd_level(); level++)
+	{
+		surface::row_convert cv = surface::get_row_convert(_Pair.src, _Pair.dst, (surface::simd_level)level);
+		for (uint n = 0; n <= kMaxPixels; n++)
+		{
+			// the sentinel byte catches kernels writing past the end of the row
+			std::fill(expected.begin(), expected.end(), uchar(0xcd));
+			std::fill(result.begin(), result.end(), uchar(0xcd));
+			reference(src.data(), expected.data(), n);
+			cv(src.data(), result.data(), n);
+			oCHECK(expected == result, "%s -> %s %s kernel differs from scalar for %u pixels"
+				, as_string(_Pair.src), as_string(_Pair.dst), as_string((surface::simd_level)level), n);
+		}
+	}
+}
+
+static void TESTsurface_convert_known_values()
+{
+	const uchar rgb[] = { 1,2,3, 4,5,6, 7,8,9, 10,11,12, 13,14,15 };
+	uchar bgra[5*4];
+	surface::get_row_convert(surface::format::r8g8b8_unorm, surface::format::b8g8r8a8_unorm)(rgb, bgra, 5);
+	for (int i = 0; i < 5; i++)
+		oCHECK(bgra[i*4+0] == rgb[i*3+2] && bgra[i*4+1] == rgb[i*3+1] && bgra[i*4+2] == rgb[i*3+0] && bgra[i*4+3] == 0xff, "r8g8b8_unorm -> b8g8r8a8_unorm failed on pixel %d", i);
+
+	const float lin[] = { 0.0f, 0.5f, 1.0f, 1.0f };
+	uchar srgb[4];
+	surface::get_row_convert(surface::format::r32g32b32a32_float, surface::format::r8g8b8a8_unorm_srgb)(lin, srgb, 1);
+	oCHECK(srgb[0] == 0 && srgb[1] == 188 && srgb[2] == 255 && srgb[3] == 255, "linear -> srgb produced (%u,%u,%u,%u)", srgb[0], srgb[1], srgb[2], srgb[3]);
+}
+
+static void TESTsurface_convert_throughput(test_services& _Services)
+{
+	// a 4k row of the common ingest case
+	const uint kWidth = 3840, kHeight = 256;
+	std::vector<uchar> src(kWidth * kHeight * 3);
+	std::vector<uchar> dst(kWidth * kHeight * 4);
+	fill_random(_Services, surface::format::r8g8b8_unorm, src);
+
+	double Scalar = 0.0;
+	for (int level = 0; level <= (int)surface::max_simd_level(); level++)
+	{
+		surface::row_convert cv = surface::get_row_convert(surface::format::r8g8b8_unorm, surface::format::r8g8b8a8_unorm, (surface::simd_level)level);
+		test_services::timer t(_Services);
+		for (uint y = 0; y < kHeight; y++)
+			cv(&src[y * kWidth * 3], &dst[y * kWidth * 4], kWidth);
+		const double MBps = (src.size() / (1024.0 * 1024.0)) / t.seconds();
+		if (!level)
+			Scalar = MBps;
+		_Services.report("r8g8b8->r8g8b8a8 %s: %.0f MB/s (%.1fx)", as_string((surface::simd_level)level), MBps, MBps / Scalar);
+	}
+}
+
+static void TESTsurface_convert_banded(test_services& _Services)
+{
+	// large enough that convert() splits rows into bands across threads
+	const uint kWidth = 1024, kHeight = 509;
+	surface::info si;
+	si.dimensions = uint3(kWidth, kHeight, 1);
+	si.format = surface::format::r8g8b8_unorm;
+	surface::info di = si;
+	di.format = surface::format::r8g8b8a8_unorm;
+
+	std::vector<uchar> src(kWidth * kHeight * 3);
+	std::vector<uchar> expected(kWidth * kHeight * 4);
+	std::vector<uchar> result(kWidth * kHeight * 4);
+	fill_random(_Services, si.format, src);
+
+	surface::row_convert reference = surface::get_row_convert(si.format, di.format, surface::simd_level::scalar);
+	for (uint y = 0; y < kHeight; y++)
+		reference(&src[y * kWidth * 3], &expected[(kHeight - 1 - y) * kWidth * 4], kWidth);
+
+	surface::const_mapped_subresource s;
+	s.data = src.data();
+	s.row_pitch = kWidth * 3;
+	s.depth_pitch = s.row_pitch * kHeight;
+
+	surface::mapped_subresource d;
+	d.data = result.data();
+	d.row_pitch = kWidth * 4;
+	d.depth_pitch = d.row_pitch * kHeight;
+
+	surface::convert(si, s, di, d, surface::copy_option::flip_vertically);
+	oCHECK(expected == result, "banded, flipped convert differs from the serial reference");
+}
+
+void TESTsurface_convert(test_services& _Services)
+{
+	for (const auto& p : sPairs)
+		TESTsurface_convert_rows(_Services, p);
+
+	TESTsurface_convert_known_values();
+	TESTsurface_convert_banded(_Services);
+	TESTsurface_convert_throughput(_Services);
+}
+
+	}
+}
@@ -1,6 +1,9 @@
 // Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
 #include <oSurface/codec.h>
 #include <oBase/colors.h>
+#include <oBase/enum_iterator.h>
+#include <oMemory/byte.h>
+#include <oString/stringize.h>
 #include <oString/path.h>
 #include <oBase/throw.h>
 
@@ -114,8 +117,128 @@ static void test_mipchain_layouts(test_services& _Services, const surface::image
 	test_mipchain(_Services, _Image, _Filter, surface::mip_layout::right, _StartIndex+2);
 }
 
+// Every level of a constant image must be the same constant for any filter.
+static void test_mipchain_constant(surface::filter _Filter)
+{
+	surface::info si;
+	si.dimensions = int3(300, 200, 1);
+	si.format = surface::format::r8g8b8a8_unorm;
+	si.mip_layout = surface::mip_layout::tight;
+	surface::image img(si);
+	{
+		surface::lock_guard lock(img);
+		uint* texels = (uint*)lock.mapped.data;
+		for (uint i = 0; i < si.dimensions.x * si.dimensions.y; i++)
+			texels[i] = 0x80402010;
+	}
+
+	surface::mip_options o;
+	o.mip_filter = _Filter;
+	img.generate_mips(o);
+
+	const uint nMips = surface::num_mips(si);
+	for (uint mip = 1; mip < nMips; mip++)
+	{
+		surface::shared_lock lock(img, mip);
+		const uint2 dim = surface::subresource(si, mip).dimensions.xy();
+		for (uint y = 0; y < dim.y; y++)
+		{
+			const uint* row = (const uint*)byte_add(lock.mapped.data, y * lock.mapped.row_pitch);
+			for (uint x = 0; x < dim.x; x++)
+				oCHECK(row[x] == 0x80402010, "%s mip %u texel (%u,%u) is 0x%08x", as_string(_Filter), mip, x, y, row[x]);
+		}
+	}
+}
+
+static float alpha_coverage(const surface::image& _Image, uint _Mip, uchar _Reference)
+{
+	const uint2 dim = surface::subresource(_Image.get_info(), _Mip).dimensions.xy();
+	surface::shared_lock lock(_Image, _Mip);
+	uint covered = 0;
+	for (uint y = 0; y < dim.y; y++)
+	{
+		const uchar* row = (const uchar*)byte_add(lock.mapped.data, y * lock.mapped.row_pitch);
+		for (uint x = 0; x < dim.x; x++)
+			covered += row[x*4+3] >= _Reference ? 1 : 0;
+	}
+	return covered / float(dim.x * dim.y);
+}
+
+static void test_mipchain_alpha_coverage(test_services& _Services)
+{
+	surface::info si;
+	si.dimensions = int3(256, 256, 1);
+	si.format = surface::format::r8g8b8a8_unorm;
+	si.mip_layout = surface::mip_layout::tight;
+	surface::image img(si);
+	{
+		// sparse foliage-like mask: thin features that fade out without correction
+		surface::lock_guard lock(img);
+		for (uint y = 0; y < si.dimensions.y; y++)
+		{
+			uchar* row = (uchar*)byte_add(lock.mapped.data, y * lock.mapped.row_pitch);
+			for (uint x = 0; x < si.dimensions.x; x++)
+			{
+				row[x*4+0] = row[x*4+1] = row[x*4+2] = 0xff;
+				row[x*4+3] = ((x % 8) == 0 || (_Services.rand() % 16) == 0) ? 0xff : 0;
+			}
+		}
+	}
+
+	static const uchar kReference = 128;
+	surface::mip_options o;
+	o.alpha_coverage_reference = kReference / 255.0f;
+	img.generate_mips(o);
+
+	const float Coverage0 = alpha_coverage(img, 0, kReference);
+	for (uint mip = 1; mip < 5; mip++)
+	{
+		const float Coverage = alpha_coverage(img, mip, kReference);
+		oCHECK(abs(Coverage - Coverage0) < 0.05f, "mip %u alpha coverage %.3f, mip0 %.3f", mip, Coverage, Coverage0);
+	}
+}
+
+static void test_compress_mips(test_services& _Services)
+{
+	auto image = surface_load(_Services, "Test/Textures/lena_1.png");
+	auto compressed = surface::compress_mips(image, surface::format::bc7_unorm);
+	auto ci = compressed.get_info();
+	oCHECK(ci.format == surface::format::bc7_unorm && ci.mip_layout == surface::mip_layout::tight, "compress_mips produced the wrong layout");
+
+	// the top level must match compressing mip0 on its own
+	auto rgbx = image.convert(surface::format::r8g8b8x8_unorm);
+	surface::info si = rgbx.get_info();
+	si.format = surface::format::bc7_unorm;
+	auto expected = rgbx.convert(si);
+	surface::shared_lock e(expected);
+	surface::shared_lock r(compressed);
+	const uint2 bd = surface::byte_dimensions(si.format, si.dimensions.xy());
+	for (uint y = 0; y < bd.y; y++)
+		oCHECK(!memcmp(byte_add(e.mapped.data, y * e.mapped.row_pitch), byte_add(r.mapped.data, y * r.mapped.row_pitch), bd.x), "compress_mips mip0 differs from convert on block row %u", y);
+
+	// an _srgb source must compress to _srgb and plain bc formats alike
+	auto bgra = image.convert(surface::format::b8g8r8a8_unorm);
+	surface::shared_lock l(bgra);
+	surface::info srgbi = bgra.get_info();
+	srgbi.format = surface::format::b8g8r8a8_unorm_srgb;
+	surface::image srgb(srgbi, l.mapped.data);
+
+	static const surface::format sBCFormats[] = { surface::format::bc1_unorm_srgb, surface::format::bc7_unorm_srgb, surface::format::bc1_unorm, surface::format::bc7_unorm };
+	for (const auto& f : sBCFormats)
+	{
+		auto c = surface::compress_mips(srgb, f);
+		oCHECK(c.get_info().format == f, "compress_mips from %s produced the wrong format", as_string(srgbi.format));
+	}
+}
+
 void TESTsurface_generate_mips(test_services& _Services)
 {
+	for (const auto& f : enum_iterator<surface::filter>())
+		test_mipchain_constant(f);
+
+	test_mipchain_alpha_coverage(_Services);
+	test_compress_mips(_Services);
+
 	auto image = make_test_1d(227); // 1D NPOT
 	test_mipchain_layouts(_Services, image, kFilter, 0);
 
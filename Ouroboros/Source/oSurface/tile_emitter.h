@@ -0,0 +1,108 @@
+// Copyright (c) 2014 Antony Arciuolo. See License.txt regarding use.
+#pragma once
+
+// Shared by the streaming decoders: collects decoded scanlines into a band one
+// tile tall, converts the band to the desired format and passes it to a
+// tile_consumer one tile at a time. Only the band is ever resident.
+#include <oSurface/codec.h>
+#include <oSurface/convert.h>
+#include <oMemory/allocate.h>
+#include <oMemory/byte.h>
+
+namespace ouro { namespace surface {
+
+class tile_emitter
+{
+public:
+	tile_emitter(const info& decoded_info, const uint2& tile_dimensions, const format& desired_format, const tile_consumer& consume, const allocator& temp_alloc)
+		: consume(consume)
+		, decoded_format(decoded_info.format)
+		, delivered_format(desired_format == format::unknown ? decoded_info.format : desired_format)
+		, dimensions(decoded_info.dimensions.xy())
+		, tile_dimensions(min(tile_dimensions, dimensions))
+		, convert(nullptr)
+		, band_y(0)
+		, band_rows(0)
+	{
+		if (delivered_format != decoded_format)
+			convert = get_row_convert(decoded_format, delivered_format);
+
+		decoded_pitch = row_size(decoded_format, dimensions.x);
+		delivered_pitch = row_size(delivered_format, dimensions.x);
+		decoded = temp_alloc.scoped_allocate(decoded_pitch * this->tile_dimensions.y, memory_alignment::align_default, "tile_emitter band");
+		if (convert)
+			delivered = temp_alloc.scoped_allocate(delivered_pitch * this->tile_dimensions.y, memory_alignment::align_default, "tile_emitter converted band");
+	}
+
+	// returns the info of the whole image as it is delivered to the consumer
+	info delivered_info() const
+	{
+		info i;
+		i.dimensions = uint3(dimensions, 1);
+		i.format = delivered_format;
+		i.mip_layout = mip_layout::none;
+		return i;
+	}
+
+	// where the decoder should write the next scanline
+	void* next_row() { return byte_add((void*)decoded, band_rows * decoded_pitch); }
+
+	// call once the scanline returned by next_row() is filled
+	void commit_row()
+	{
+		band_rows++;
+		if (band_rows == tile_dimensions.y || (band_y + band_rows) == dimensions.y)
+			flush();
+	}
+
+private:
+	tile_consumer consume;
+	scoped_allocation decoded;
+	scoped_allocation delivered;
+	format decoded_format;
+	format delivered_format;
+	uint2 dimensions;
+	uint2 tile_dimensions;
+	row_convert convert;
+	uint decoded_pitch;
+	uint delivered_pitch;
+	uint band_y;
+	uint band_rows;
+
+	void flush()
+	{
+		const void* band = decoded;
+		uint pitch = decoded_pitch;
+		if (convert)
+		{
+			for (uint y = 0; y < band_rows; y++)
+				convert(byte_add((const void*)decoded, y * decoded_pitch), byte_add((void*)delivered, y * delivered_pitch), dimensions.x);
+			band = delivered;
+			pitch = delivered_pitch;
+		}
+
+		const uint ElementSize = element_size(delivered_format);
+		for (uint x = 0; x < dimensions.x; x += tile_dimensions.x)
+		{
+			tile_info t;
+			t.position = uint2(x, band_y);
+			t.dimensions = uint2(min(tile_dimensions.x, dimensions.x - x), band_rows);
+			t.mip_level = 0;
+			t.array_slice = 0;
+
+			const_mapped_subresource mapped;
+			mapped.data = byte_add(band, x * ElementSize);
+			mapped.row_pitch = pitch;
+			mapped.depth_pitch = pitch * band_rows;
+			consume(t, mapped);
+		}
+
+		band_y += band_rows;
+		band_rows = 0;
+	}
+
+	tile_emitter(const tile_emitter&);
+	const tile_emitter& operator=(const tile_emitter&);
+};
+
+}}